@@ -3,7 +3,7 @@
 include(FindPackageHandleStandardArgs)
 
 find_path(Assimp_INCLUDE_DIR 
-    NAMES assimp.h)
+    NAMES assimp.h assimp/Importer.hpp)
 
 find_file(Assimp_BINARY_RELEASE
     NAMES assimp.dll
@@ -17,13 +17,26 @@ find_library(Assimp_LIBRARY_DEBUG
     NAMES assimpD 
     PATHS ${Assimp_INCLUDE_DIR}/../lib)
     
-FIND_PACKAGE_HANDLE_STANDARD_ARGS(Assimp 
-    DEFAULT_MSG 
-    Assimp_INCLUDE_DIR 
-    Assimp_LIBRARY_RELEASE 
-    Assimp_LIBRARY_DEBUG)
+# only Windows builds link a separate debug library
+if(WIN32)
+    FIND_PACKAGE_HANDLE_STANDARD_ARGS(Assimp 
+        DEFAULT_MSG 
+        Assimp_INCLUDE_DIR 
+        Assimp_LIBRARY_RELEASE 
+        Assimp_LIBRARY_DEBUG)
+else()
+    FIND_PACKAGE_HANDLE_STANDARD_ARGS(Assimp 
+        DEFAULT_MSG 
+        Assimp_INCLUDE_DIR 
+        Assimp_LIBRARY_RELEASE)
+endif()
     
 if(ASSIMP_FOUND)
-    set(Assimp_LIBRARY optimized ${Assimp_LIBRARY_RELEASE} debug ${Assimp_LIBRARY_DEBUG} CACHE STRING "")
+    if(Assimp_LIBRARY_DEBUG)
+        set(Assimp_LIBRARY optimized ${Assimp_LIBRARY_RELEASE} debug ${Assimp_LIBRARY_DEBUG} CACHE STRING "")
+    else()
+        set(Assimp_LIBRARY ${Assimp_LIBRARY_RELEASE} CACHE STRING "")
+    endif()
+
     mark_as_advanced(Assimp_LIBRARY_RELEASE Assimp_LIBRARY_DEBUG Assimp_BINARY_RELEASE)
-endif()
\ No newline at end of file
+endif()
\ No newline at end of file
@@ -0,0 +1,26 @@
+# Find DirectXMath, e.g. the headers of the directxmath package on Linux
+
+include(FindPackageHandleStandardArgs)
+
+find_path(DirectXMath_INCLUDE_DIR
+    NAMES DirectXMath.h
+    PATH_SUFFIXES directxmath)
+
+# DirectXMath includes sal.h, which the Windows SDK provides and other platforms need as a stub
+find_path(DirectXMath_SAL_INCLUDE_DIR
+    NAMES sal.h
+    PATH_SUFFIXES wsl/stubs directx/wsl/stubs)
+
+FIND_PACKAGE_HANDLE_STANDARD_ARGS(DirectXMath
+    DEFAULT_MSG
+    DirectXMath_INCLUDE_DIR)
+
+if(DIRECTXMATH_FOUND)
+    set(DirectXMath_INCLUDE_DIRS ${DirectXMath_INCLUDE_DIR})
+
+    if(DirectXMath_SAL_INCLUDE_DIR)
+        list(APPEND DirectXMath_INCLUDE_DIRS ${DirectXMath_SAL_INCLUDE_DIR})
+    endif()
+
+    mark_as_advanced(DirectXMath_INCLUDE_DIR DirectXMath_SAL_INCLUDE_DIR)
+endif()
\ No newline at end of file
@@ -22,6 +22,7 @@
 #define SLOT_TEX_LPV_INJECT_RSM_START   6
 #define SLOT_TEX_LPV_PROPAGATE_START    7
 #define SLOT_TEX_LPV_DEFERRED_START     7
+#define SLOT_TEX_LPV_HISTORY_START      17
 
 #define SLOT_TEX_DEFERRED_START         2
 #define SLOT_TEX_DEFERRED_KINECT_START  0
@@ -34,6 +35,8 @@
 #define SLOT_TEX_ALPHA                  3
 #define SLOT_TEX_OVERLAY                10
 #define SLOT_TEX_NOISE                  14
+#define SLOT_TEX_IBL_ENVMAP             15
+#define SLOT_TEX_IBL_BRDF               16
 
 #define SLOT_ONETIME_VS                 2
 #define SLOT_CAMERA_VS                  0
@@ -54,6 +57,7 @@
 #define GAMMA                           2.2
 #define SHADOW_BIAS                     0.015
 #define LPV_SIZE                        32
+#define LPV_CASCADES                    3
 #define M_PI                            3.14159265358
 #define PCF_SAMPLES                     64
 #define SSAO_SAMPLES                    8
@@ -16,7 +16,8 @@ cbuffer gi_parameters_ps        : register(b3)
     bool debug_gi               : packoffset(c0.w);
 }
 
-Texture2D env_map               : register(t13);
+Texture2D env_map               : register(t15);
+Texture2D brdf_lut              : register(t16);
 
 float4 ps_lpv(PS_INPUT inp) : SV_Target
 {
@@ -107,7 +108,7 @@ float4 ps_lpv(PS_INPUT inp) : SV_Target
 
         gb.specular_albedo.rgb = float3(F0_GOLD);
 #if 1
-        Rs = specular_ibl_is(gb.specular_albedo.rgb, roughness, N, V, env_map, StandardFilter) * main_light.color.rgb;
+        Rs = specular_ibl_split_sum(gb.specular_albedo.rgb, roughness, N, V, env_map, brdf_lut, StandardFilter) * main_light.color.rgb;
 #else
         Rs = ibl_specular_blinn_phong_mip(gb.diffuse_albedo.rgb, gb.specular_albedo.rgb, roughness, N, V, env_map, StandardFilter) * main_light.color.rgb;
 #endif
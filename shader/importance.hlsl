@@ -135,6 +135,32 @@ float3 specular_ibl_is(in float3 specular_albedo, in float roughness, in float3
     return specular / num_samples;
 }
 
+// Split-sum approximation of specular_ibl_is with a prefiltered environment map and a BRDF lookup table,
+// both baked on the CPU with dune::bake_ibl(). Mip level i of the environment map is filtered for roughness
+// i/(levels-1), the lookup table stores a scale and a bias to the specular albedo over (NoV, roughness).
+// From Real Shading in Unreal Engine 4
+// by Brian Karis
+// http://blog.selfshadow.com/publications/s2013-shading-course/karis/s2013_pbs_epic_notes_v2.pdf
+float3 specular_ibl_split_sum(in float3 specular_albedo, in float roughness, in float3 N, in float3 V, in Texture2D prefiltered_env_map, in Texture2D brdf_lut, in SamplerState env_sampler)
+{
+    uint w, h, levels;
+    prefiltered_env_map.GetDimensions(0, w, h, levels);
+
+    uint lw, lh;
+    brdf_lut.GetDimensions(lw, lh);
+
+    float NoV = saturate(dot(N, V));
+    float3 R = reflect(-V, N);
+
+    float3 prefiltered = prefiltered_env_map.SampleLevel(env_sampler, latlong(R), roughness * (levels - 1)).rgb;
+
+    // stay on texel centers to avoid wrapping around the table
+    float2 uv = clamp(float2(NoV, roughness), 0.5/float2(lw, lh), 1.0 - 0.5/float2(lw, lh));
+    float2 ab = brdf_lut.SampleLevel(env_sampler, uv, 0).rg;
+
+    return prefiltered * (specular_albedo * ab.x + ab.y);
+}
+
 // Importance sample a specular Phong function from an environment map.
 // Morgan McGuire et al., Plausible Blinn-Phong Reflection of Standard Cube MIP-Maps
 // http://graphics.cs.williams.edu/papers/EnvMipReport2013/
@@ -6,8 +6,7 @@
 
 #include "common.h"
 #include "tools.hlsl"
-
-#define VPLS 1024
+#include "lpv_parameters.hlsl"
 
 SamplerState VPLFilter          : register(s0);
 
@@ -42,13 +41,6 @@ cbuffer light_vs                : register(b0)
     float pad0                  : packoffset(c8.w);
 }
 
-cbuffer lpv_parameters          : register(b7)
-{
-    float4x4 world_to_lpv       : packoffset(c0);
-    uint lpv_size               : packoffset(c4.x);
-    float3 pad1                 : packoffset(c4.y);
-}
-
 cbuffer delta_inject            : register(b6)
 {
     float dscale                : packoffset(c0.x);
@@ -60,35 +52,51 @@ Texture2D rt_rsm_lineardepth    : register(t6);
 Texture2D rt_rsm_colors         : register(t7);
 Texture2D rt_rsm_normals        : register(t8);
 
+// smallest cosine between a surfel and the light, same as MIN_SURFEL_COS in geometry_volume.cpp
+#define GV_MIN_SURFEL_COS       0.25
+
+// Texture coordinate of the VPL generated from texel id of the RSM
+float2 vpl_texcoord(in uint id)
+{
+    uint width, height;
+    rt_rsm_colors.GetDimensions(width, height);
+
+    return float2((id % width) + 0.5, (id / width) + 0.5) / float2(width, height);
+}
+
 VS_LPV_INJECT vs_lpv_inject(in uint id : SV_VertexID)
 {
     VS_LPV_INJECT output;
 
     bool outside = false;
 
-    uint nvpls = VPLS;
-
-    uint x = id % nvpls;
-    uint y = id / nvpls;
-
     // texture coords of vpl
-    float2 tc = float2((float)x/(float)nvpls, (float)y/(float)nvpls);
+    float2 tc = vpl_texcoord(id);
 
     // get vpl
     directional_light vpl = gen_vpl(tc, light_vp_inv, float4(main_light, 1.0), rt_rsm_colors, rt_rsm_normals, rt_rsm_lineardepth, VPLFilter);
 
-    float4 ppos = mul(world_to_lpv, vpl.position);
-    float4 pnor = normalize(mul(world_to_lpv, vpl.normal));
+    // inject into the finest cascade containing the VPL
+    float3 lpv_pos;
+    uint cascade = lpv_select_cascade(vpl.position.xyz, lpv_pos);
+    uint c = min(cascade, lpv_num_cascades - 1);
+
+    float4 ppos = mul(world_to_cascade[c], vpl.position);
+    float4 pnor = normalize(mul(world_to_cascade[c], vpl.normal));
 
     // shift by half a cell size into direction of normal
     ppos += pnor * (0.5/lpv_size);
 
+    // the shift must not cross into the slices of another cascade
+    if (cascade >= lpv_num_cascades || any(ppos.xyz < 0) || any(ppos.xyz >= 1))
+        outside = true;
+
     // create z index into array
-    ppos.z *= lpv_size;
+    ppos.z = (ppos.z + c) * lpv_size;
 
     // kill accidental injects with wrong normals
     float4 d = (float4(main_light, 1.0) - vpl.position);
-    if (dot(vpl.normal, normalize(d)) < 0)
+    if (outside || dot(vpl.normal, normalize(d)) < 0)
         ppos *= 50000;
 
     float3 w = main_light - vpl.position.xyz;
@@ -100,19 +108,61 @@ VS_LPV_INJECT vs_lpv_inject(in uint id : SV_VertexID)
     return output;
 }
 
-VS_LPV_INJECT vs_delta_lpv_inject(in uint id : SV_VertexID)
+// Position of an RSM texel at a linear depth, like gen_vpl()
+float4 rsm_position(in float2 tc, in float depth)
+{
+    return float4((float4(main_light, 1.0) + normalize(to_ray(tc, light_vp_inv)) * depth).xyz, 1);
+}
+
+// One surfel per RSM texel for the geometry volume, same as dune::generate_surfels() and dune::geometry_volume::inject()
+VS_LPV_INJECT vs_gv_inject(in uint id : SV_VertexID)
 {
     VS_LPV_INJECT output;
 
-    bool outside = false;
+    uint width, height;
+    rt_rsm_colors.GetDimensions(width, height);
+
+    float2 tc = vpl_texcoord(id);
 
-    uint nvpls = VPLS;
+    directional_light vpl = gen_vpl(tc, light_vp_inv, float4(main_light, 1.0), rt_rsm_colors, rt_rsm_normals, rt_rsm_lineardepth, VPLFilter);
+
+    float3 lpv_pos;
+    uint cascade = lpv_select_cascade(vpl.position.xyz, lpv_pos);
+    uint c = min(cascade, lpv_num_cascades - 1);
+
+    // footprint of the texel on the surface, in cell faces of the cascade
+    float depth = rt_rsm_lineardepth.SampleLevel(VPLFilter, tc, 0).r;
+
+    float3 p  = mul(world_to_cascade[c], vpl.position).xyz * lpv_size;
+    float3 pu = mul(world_to_cascade[c], rsm_position(tc + float2(1.0/width, 0), depth)).xyz * lpv_size;
+    float3 pv = mul(world_to_cascade[c], rsm_position(tc + float2(0, 1.0/height), depth)).xyz * lpv_size;
+
+    float cos_theta = abs(dot(normalize(main_light - vpl.position.xyz), vpl.normal.xyz));
+    float area = length(cross(pu - p, pv - p)) / max(cos_theta, GV_MIN_SURFEL_COS);
+
+    // GV cells sit on the lower corners of LPV cells, corners on the upper border of a cascade are dropped
+    float3 corner = floor(p + 0.5);
+
+    float4 ppos = float4((corner.xy + 0.5) / lpv_size, corner.z + 0.5 + c * lpv_size, 1.0);
+
+    if (cascade >= lpv_num_cascades || is_invalid(vpl) || any(corner < 0) || any(corner >= lpv_size))
+        ppos = float4(-50000, -50000, 0, 1);
+
+    output.pos    = ppos;
+    output.color  = area;
+    output.normal = is_invalid(vpl) ? float3(0, 0, 1) : lpv_normal(c, vpl.normal.xyz);
+
+    return output;
+}
+
+VS_LPV_INJECT vs_delta_lpv_inject(in uint id : SV_VertexID)
+{
+    VS_LPV_INJECT output;
 
-    uint x = id % nvpls;
-    uint y = id / nvpls;
+    bool outside = false;
 
     // texture coords of vpl
-    float2 tc = float2((float)x/(float)nvpls, (float)y/(float)nvpls);
+    float2 tc = vpl_texcoord(id);
 
     // get vpl
     directional_light vpl = gen_vpl(tc, light_vp_inv, float4(main_light, 1.0), rt_rsm_colors, rt_rsm_normals, rt_rsm_lineardepth, VPLFilter);
@@ -149,13 +199,8 @@ VS_LPV_INJECT vs_delta_lpv_direct_inject(in uint id : SV_VertexID)
 
     bool outside = false;
 
-    uint nvpls = VPLS;
-
-    uint x = id % nvpls;
-    uint y = id / nvpls;
-
     // texture coords of vpl
-    float2 tc = float2((float)x/(float)nvpls, (float)y/(float)nvpls);
+    float2 tc = vpl_texcoord(id);
 
     // get vpl
     directional_light vpl = gen_vpl(tc, light_vp_inv, float4(main_light, 1.0), rt_rsm_colors, rt_rsm_normals, rt_rsm_lineardepth, VPLFilter);
@@ -216,6 +261,12 @@ PS_LPV_INJECT ps_lpv_inject(in GS_LPV_INJECT input)
     return output;
 }
 
+float4 ps_gv_inject(in GS_LPV_INJECT input) : SV_Target0
+{
+    // blocking potential of the surfel scaled by its area
+    return sh_clamped_cos_coeff(normalize(input.normal)) * input.color.x;
+}
+
 PS_LPV_INJECT ps_delta_lpv_inject(in GS_LPV_INJECT input)
 {
     PS_LPV_INJECT output;
@@ -0,0 +1,68 @@
+/*
+ * The Dirtchamber - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+#include "lpv_tools.hlsl"
+
+struct PS_LPV_PACK
+{
+    float4 history_r                : SV_Target0;
+    float4 history_g                : SV_Target1;
+    float4 history_b                : SV_Target2;
+};
+
+struct GS_LPV_PROPAGATE
+{
+    float4 pos                      : SV_Position;
+    float3 tex                      : TEXCOORD;
+    uint rtindex                    : SV_RenderTargetArrayIndex;
+};
+
+// packs the accumulation volumes bound to lpv_r, lpv_g and lpv_b into the history format
+PS_LPV_PACK ps_lpv_pack(in GS_LPV_PROPAGATE input)
+{
+    PS_LPV_PACK output;
+
+    int4 lpv_pos = int4(input.pos.x, input.pos.y, input.tex.z, 0);
+
+    float4 r = lpv_r.Load(lpv_pos);
+    float4 g = lpv_g.Load(lpv_pos);
+    float4 b = lpv_b.Load(lpv_pos);
+
+    float4 y = 0, co = 0, cg = 0;
+
+    [unroll]
+    for (int k = 0; k < 4; ++k)
+    {
+        float3 ycocg = rgb_to_ycocg(float3(r[k], g[k], b[k]));
+
+        y[k] = ycocg.x;
+        co[k] = ycocg.y;
+        cg[k] = ycocg.z;
+    }
+
+    output.history_r = r;
+    output.history_g = g;
+    output.history_b = b;
+
+    if (lpv_history_format == LPV_HISTORY_SHARED_EXPONENT)
+    {
+        float s = y.x > 0 ? 1.0 / (y.x * LPV_SH_DIRECTION_RANGE) : 0;
+
+        output.history_r = float4(max(float3(r.x, g.x, b.x), 0), 0);
+        output.history_g = float4(y.yzw * s, 0);
+        output.history_b = 0;
+    }
+    else if (lpv_history_format == LPV_HISTORY_YCOCG)
+    {
+        float s = y.x > 0 ? 1.0 / (y.x * LPV_SH_CHROMA_RANGE) : 0;
+
+        output.history_r = y;
+        output.history_g = co * s;
+        output.history_b = cg * s;
+    }
+
+    return output;
+}
@@ -0,0 +1,62 @@
+/*
+ * The Dirtchamber - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+#ifndef LPV_PARAMETERS_HLSL
+#define LPV_PARAMETERS_HLSL
+
+#include "common.h"
+
+// size of world_to_cascade, same as dune::light_propagation_volume::MAX_CASCADES
+#define LPV_MAX_CASCADES            4
+
+// cells a position keeps from the border of a cascade to use it, same as dune::lpv_cascades::margin()
+#define LPV_CASCADE_MARGIN          1.0
+
+// the cascades are stacked along the array index, cascade c starts at slice c * lpv_size
+cbuffer lpv_parameters              : register(b7)
+{
+    float4x4 world_to_lpv           : packoffset(c0);
+    uint lpv_size                   : packoffset(c4.x);
+    float lpv_history_weight        : packoffset(c4.y);
+    uint lpv_history_format         : packoffset(c4.z);
+    uint lpv_num_cascades           : packoffset(c4.w);
+    float4x4 world_to_cascade[LPV_MAX_CASCADES] : packoffset(c5);
+}
+
+// finest cascade containing pos, same as dune::lpv_cascades::select(); lpv_num_cascades if there is none
+uint lpv_select_cascade(in float3 pos, out float3 lpv_pos)
+{
+    const float m = LPV_CASCADE_MARGIN / lpv_size;
+
+    lpv_pos = 0;
+
+    for (uint c = 0; c < lpv_num_cascades; ++c)
+    {
+        lpv_pos = mul(world_to_cascade[c], float4(pos, 1)).xyz;
+
+        if (all(lpv_pos >= m) && all(lpv_pos < 1 - m))
+            return c;
+    }
+
+    // fall back to the coarsest cascade without margin
+    if (all(lpv_pos >= 0) && all(lpv_pos < 1))
+        return lpv_num_cascades - 1;
+
+    return lpv_num_cascades;
+}
+
+// normal in the space of cascade c, transformed by the inverse transpose of world_to_cascade[c]
+float3 lpv_normal(in uint c, in float3 n)
+{
+    float3 r0 = world_to_cascade[c][0].xyz;
+    float3 r1 = world_to_cascade[c][1].xyz;
+    float3 r2 = world_to_cascade[c][2].xyz;
+
+    // the rows of the cofactor matrix, the determinant cancels out
+    return normalize(float3(dot(cross(r1, r2), n), dot(cross(r2, r0), n), dot(cross(r0, r1), n)));
+}
+
+#endif
@@ -6,6 +6,7 @@
 
 #include "common.h"
 #include "tools.hlsl"
+#include "lpv_parameters.hlsl"
 
 struct VS_LPV_PROPAGATE
 {
@@ -49,6 +50,9 @@ Texture2DArray lpv_sh_r         : register(t7);
 Texture2DArray lpv_sh_g         : register(t8);
 Texture2DArray lpv_sh_b         : register(t9);
 
+// blocking potential on the lower corners of LPV cells, see vs_gv_inject()
+Texture2DArray lpv_gv           : register(t10);
+
 VS_LPV_PROPAGATE vs_lpv_propagate(in float3 pos : POSITION, float3 tex : TEXCOORD)
 {
     VS_LPV_PROPAGATE output;
@@ -74,6 +78,33 @@ void gs_lpv_propagate(in triangle VS_LPV_PROPAGATE input[3], inout TriangleStrea
     stream.RestartStrip();
 }
 
+// Fraction of flux from a neighbor passing the face shared with it, same as dune::geometry_volume::update()
+float gv_transmittance(in int3 lpv_pos, in int cascade_z, in int3 neighbor_offset)
+{
+    int axis = neighbor_offset.x != 0 ? 0 : (neighbor_offset.y != 0 ? 1 : 2);
+
+    int3 a = axis == 0 ? int3(0, 1, 0) : (axis == 1 ? int3(0, 0, 1) : int3(1, 0, 0));
+    int3 b = axis == 0 ? int3(0, 0, 1) : (axis == 1 ? int3(1, 0, 0) : int3(0, 1, 0));
+
+    int3 base = lpv_pos + max(neighbor_offset, 0);
+
+    // blocking potential towards the neighbor, which is where the light comes from
+    float4 dir_sh = sh4(float3(neighbor_offset));
+
+    float occlusion = 0;
+
+    for (int k = 0; k < 4; ++k)
+    {
+        int3 p = base + a * (k & 1) + b * (k >> 1);
+
+        // the upper corners of a cascade have no GV cell, loads past the other borders return 0
+        if (cascade_z + p.z - lpv_pos.z < (int)lpv_size)
+            occlusion += dot(lpv_gv.Load(int4(p, 0)), dir_sh);
+    }
+
+    return 1 - saturate(occlusion * 0.25);
+}
+
 PS_LPV_PROPAGATE ps_lpv_propagate(in GS_LPV_PROPAGATE input)
 {
     PS_LPV_PROPAGATE output;
@@ -82,6 +113,9 @@ PS_LPV_PROPAGATE ps_lpv_propagate(in GS_LPV_PROPAGATE input)
 
     int3 lpv_pos = int3(input.pos.x, input.pos.y, input.tex.z);
 
+    // slice within the cascade, neighbors in other cascades are outside of the volume
+    int cascade_z = lpv_pos.z % (int)lpv_size;
+
     float3 offsets[6];
     offsets[0] = float3(0, 0, 1);
     offsets[1] = float3(1, 0, 0);
@@ -113,11 +147,19 @@ PS_LPV_PROPAGATE ps_lpv_propagate(in GS_LPV_PROPAGATE input)
         //load the light value in the neighbor cell
         ppos = float4(lpv_pos + neighbor_offset, 0);
 
+        int neighbor_z = cascade_z + (int)neighbor_offset.z;
+
+        if (neighbor_z < 0 || neighbor_z >= (int)lpv_size)
+            continue;
+
         // read from lpv
         float4 old_sh_r = lpv_sh_r.Load(ppos);
         float4 old_sh_g = lpv_sh_g.Load(ppos);
         float4 old_sh_b = lpv_sh_b.Load(ppos);
 
+        // attenuate by the geometry between this cell and the neighbor, which is empty without occlusion
+        float pass = gv_transmittance(lpv_pos, cascade_z, (int3)neighbor_offset);
+
         // add up new incoming flux from surrounding nodes
         for(int face = 0; face < 6; face++)
         {
@@ -137,9 +179,9 @@ PS_LPV_PROPAGATE ps_lpv_propagate(in GS_LPV_PROPAGATE input)
 
             float4 dir_sh = sh4(dir);
 
-            float r = famp * solid_angle * dot(old_sh_r, dir_sh);
-            float g = famp * solid_angle * dot(old_sh_g, dir_sh);
-            float b = famp * solid_angle * dot(old_sh_b, dir_sh);
+            float r = famp * solid_angle * pass * dot(old_sh_r, dir_sh);
+            float g = famp * solid_angle * pass * dot(old_sh_g, dir_sh);
+            float b = famp * solid_angle * pass * dot(old_sh_b, dir_sh);
 
             float4 coeffs = face_coeffs[face];
 
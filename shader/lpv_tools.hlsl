@@ -8,6 +8,7 @@
 #define LPV_TOOLS_HLSL
 
 #include "common.h"
+#include "lpv_parameters.hlsl"
 
 SamplerState LPVFilter      : register(s1);
 
@@ -15,15 +16,53 @@ Texture2DArray lpv_r        : register(t7);
 Texture2DArray lpv_g        : register(t8);
 Texture2DArray lpv_b        : register(t9);
 
-cbuffer lpv_parameters      : register(b7)
+// last converged result of amortized propagation
+Texture2DArray lpv_history_r : register(t17);
+Texture2DArray lpv_history_g : register(t18);
+Texture2DArray lpv_history_b : register(t19);
+
+// storage formats of the history volumes, see dune::sh_format
+#define LPV_HISTORY_FP16            0
+#define LPV_HISTORY_SHARED_EXPONENT 1
+#define LPV_HISTORY_YCOCG           2
+
+// ranges of the SNORM volumes relative to the DC of luma, same as in sh_packing.cpp
+#define LPV_SH_DIRECTION_RANGE      2.0
+#define LPV_SH_CHROMA_RANGE         4.0
+
+float3 rgb_to_ycocg(in float3 c)
+{
+    return float3(dot(c, float3(0.25, 0.5, 0.25)), dot(c, float3(0.5, 0, -0.5)), dot(c, float3(-0.25, 0.5, -0.25)));
+}
+
+void lpv_unpack_history(inout float4 sh_r_val, inout float4 sh_g_val, inout float4 sh_b_val)
 {
-    float4x4 world_to_lpv   : packoffset(c0);
-    uint lpv_size           : packoffset(c4.x);
-    float3 pad              : packoffset(c4.y);
+    if (lpv_history_format == LPV_HISTORY_SHARED_EXPONENT)
+    {
+        // DC in r, direction of luma in g
+        float3 dc = sh_r_val.rgb;
+        float3 dir = sh_g_val.xyz * LPV_SH_DIRECTION_RANGE;
+
+        sh_r_val = dc.r * float4(1, dir);
+        sh_g_val = dc.g * float4(1, dir);
+        sh_b_val = dc.b * float4(1, dir);
+    }
+    else if (lpv_history_format == LPV_HISTORY_YCOCG)
+    {
+        // luma SH in r, chroma SH relative to the DC of luma in g and b
+        float4 y = sh_r_val;
+        float4 co = sh_g_val * max(y.x, 0) * LPV_SH_CHROMA_RANGE;
+        float4 cg = sh_b_val * max(y.x, 0) * LPV_SH_CHROMA_RANGE;
+
+        sh_r_val = y + co - cg;
+        sh_g_val = y + cg;
+        sh_b_val = y - co - cg;
+    }
 }
 
+// first_slice is the array index of the first slice of the cascade lpv_pos is in
 void lpv_trilinear_lookup(in float3 lpv_pos, inout float4 sh_r_val, inout float4 sh_g_val, inout float4 sh_b_val,
-                          in Texture2DArray lpvr, in Texture2DArray lpvg, in Texture2DArray lpvb, in int lpv_size, in SamplerState LPVFilter)
+                          in Texture2DArray lpvr, in Texture2DArray lpvg, in Texture2DArray lpvb, in int lpv_size, in SamplerState LPVFilter, in int first_slice)
 {
     float3 tc = float3(lpv_pos.x, lpv_pos.y, lpv_pos.z * lpv_size);
 
@@ -33,8 +72,8 @@ void lpv_trilinear_lookup(in float3 lpv_pos, inout float4 sh_r_val, inout float4
     float inv_zh = tc.z - zl;
     float inv_zl = 1.0f - inv_zh;
 
-    float3 tc_l = float3(tc.x, tc.y, zl);
-    float3 tc_h = float3(tc.x, tc.y, zh);
+    float3 tc_l = float3(tc.x, tc.y, first_slice + zl);
+    float3 tc_h = float3(tc.x, tc.y, first_slice + zh);
 
     sh_r_val = inv_zl * lpvr.SampleLevel(LPVFilter, tc_l, 0) + inv_zh * lpvr.SampleLevel(LPVFilter, tc_h, 0);
     sh_g_val = inv_zl * lpvg.SampleLevel(LPVFilter, tc_l, 0) + inv_zh * lpvg.SampleLevel(LPVFilter, tc_h, 0);
@@ -51,8 +90,13 @@ float4 gi_from_lpv(in float3 pos, in float3 N)
     float4 shcoeff_green = float4(0,0,0,0);
     float4 shcoeff_blue  = float4(0,0,0,0);
 
-    float3 lpv_pos = mul(world_to_lpv, float4(pos, 1)).xyz;
-    float3 lpv_normal = normalize(mul(world_to_lpv, float4(N, 0))).xyz;
+    float3 lpv_pos;
+    uint cascade = lpv_select_cascade(pos, lpv_pos);
+
+    if (cascade >= lpv_num_cascades)
+        return 0.f;
+
+    int first_slice = cascade * LPV_SIZE;
 
     // bias
     lpv_pos.z -= 0.5/LPV_SIZE;
@@ -63,7 +107,19 @@ float4 gi_from_lpv(in float3 pos, in float3 N)
         lpv_pos.z < 0 || lpv_pos.z > 1)
         return 0.f;
 
-    lpv_trilinear_lookup(lpv_pos, shcoeff_red, shcoeff_green, shcoeff_blue, lpv_r, lpv_g, lpv_b, LPV_SIZE, LPVFilter);
+    lpv_trilinear_lookup(lpv_pos, shcoeff_red, shcoeff_green, shcoeff_blue, lpv_r, lpv_g, lpv_b, LPV_SIZE, LPVFilter, first_slice);
+
+    // blend with the last converged result while propagation is in progress
+    if (lpv_history_weight > 0)
+    {
+        float4 history_red, history_green, history_blue;
+        lpv_trilinear_lookup(lpv_pos, history_red, history_green, history_blue, lpv_history_r, lpv_history_g, lpv_history_b, LPV_SIZE, LPVFilter, first_slice);
+        lpv_unpack_history(history_red, history_green, history_blue);
+
+        shcoeff_red   = lerp(shcoeff_red,   history_red,   lpv_history_weight);
+        shcoeff_green = lerp(shcoeff_green, history_green, lpv_history_weight);
+        shcoeff_blue  = lerp(shcoeff_blue,  history_blue,  lpv_history_weight);
+    }
 
     indirect.r = dot(shcoeff_red,   normal_sh)/M_PI;
     indirect.g = dot(shcoeff_green, normal_sh)/M_PI;
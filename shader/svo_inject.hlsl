@@ -6,6 +6,7 @@
 
 #include "common.h"
 #include "tools.hlsl"
+#include "svo_parameters.hlsl"
 
 SamplerState StandardFilter : register(s0);
 
@@ -33,14 +34,6 @@ cbuffer light_ps                            : register(b2)
     float4x4 light_vp_tex                   : packoffset(c11);
 }
 
-cbuffer parameters                          : register(b7)
-{
-    float4x4 world_to_svo                   : packoffset(c0);
-    float4 bb_min                           : packoffset(c4);
-    float4 bb_max                           : packoffset(c5);
-    float4 pad2[2]                          : packoffset(c6);
-};
-
 Texture2D diffuse_tex                       : register(t0);
 
 Texture2D rsm_rho_depth                     : register(t6);
@@ -98,7 +91,7 @@ float4 calc_bounce(in float3 color, in float3 P, in float3 N)
 
 uint3 calc_voxel(in float3 P)
 {
-    return floor(mul(world_to_svo, float4(P, 1)).xyz * SVO_SIZE);
+    return svo_texel(floor(mul(world_to_window, float4(P, 1)).xyz * SVO_SIZE));
 }
 
 void splat_rho(in uint3 voxel, in float4 bounce)
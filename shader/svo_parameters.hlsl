@@ -0,0 +1,47 @@
+/*
+ * The Dirtchamber - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+#ifndef SVO_PARAMETERS_HLSL
+#define SVO_PARAMETERS_HLSL
+
+#include "common.h"
+
+SamplerState SVOFilter              : register(s1);
+SamplerState SVOWrapFilter          : register(s3);
+
+// world_to_window maps the voxelized window to [0, 1], world_to_svo to texture coordinates. For a camera clipmap
+// both differ: the window is stored toroidally, starting at window_texel, and only region is revoxelized.
+cbuffer svo_parameters              : register(b7)
+{
+    float4x4 world_to_svo           : packoffset(c0);
+    float4 bb_min                   : packoffset(c4);
+    float4 bb_max                   : packoffset(c5);
+    float4x4 world_to_window        : packoffset(c6);
+    uint3 window_texel              : packoffset(c10);
+    bool svo_toroidal               : packoffset(c10.w);
+    uint3 region_min                : packoffset(c11);
+    uint3 region_max                : packoffset(c12);
+};
+
+// texel a voxel of the window is stored at, same as dune::voxel_clipmap::texel(); out of range if it is outside
+uint3 svo_texel(in float3 voxel)
+{
+    if (any(voxel < 0) || any(voxel >= SVO_SIZE))
+        return uint3(0xffffffff, 0xffffffff, 0xffffffff);
+
+    return ((uint3)voxel + window_texel) % SVO_SIZE;
+}
+
+// sample a volume at SVO texture coordinates, which wrap around for a clipmap
+float4 svo_sample(in Texture3D<float4> volume, in float3 pos, in float lod)
+{
+    if (svo_toroidal)
+        return volume.SampleLevel(SVOWrapFilter, pos, lod);
+
+    return volume.SampleLevel(SVOFilter, pos, lod);
+}
+
+#endif
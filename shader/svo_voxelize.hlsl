@@ -5,6 +5,7 @@
  */
 
 #include "common.h"
+#include "svo_parameters.hlsl"
 
 SamplerState StandardFilter : register(s0);
 
@@ -43,14 +44,6 @@ cbuffer meshdata_vs                  : register(b1)
     float4x4 world                   : packoffset(c0);
 }
 
-cbuffer parameters                   : register(b7)
-{
-    float4x4 world_to_svo;
-    float4 bb_min;
-    float4 bb_max;
-    float4 pad[2];
-};
-
 cbuffer meshdata_ps : register(b0)
 {
     float4 diffuse_color             : packoffset(c0);
@@ -74,7 +67,7 @@ VS_OUT vs_svo_voxelize(in VS_IN input)
 {
     VS_OUT output = (VS_OUT) 0;
 
-    output.pos = mul(world_to_svo, mul(world, float4(input.pos, 1.0)));
+    output.pos = mul(world_to_window, mul(world, float4(input.pos, 1.0)));
     output.norm = input.norm;
     output.texcoord = input.texcoord;
 
@@ -179,5 +172,8 @@ void ps_svo_voxelize(in GS_OUT input)
         pos = pos.zyx;
     }
 
-    splat(pos, input.norm, input.texcoord);
+    // only the region of the window which is revoxelized is written, the rest keeps its voxels
+    if (any(pos < region_min) || any(pos >= region_max)) return;
+
+    splat(svo_texel(pos), input.norm, input.texcoord);
 }
@@ -9,6 +9,7 @@
 
 #include "common.h"
 #include "tools.hlsl"
+#include "svo_parameters.hlsl"
 
 Texture3D<float4> v_normal  : register(t7);
 Texture3D<float4> v_rho     : register(t8);
@@ -17,15 +18,6 @@ Texture3D<float4> v_rho     : register(t8);
 Texture3D<float4> v_delta   : register(t9);
 #endif
 
-SamplerState SVOFilter      : register(s1);
-
-cbuffer svo_parameters      : register(b7)
-{
-    float4x4 world_to_svo   : packoffset(c0);
-    float4 bb_min           : packoffset(c4);
-    float4 bb_max           : packoffset(c5);
-};
-
 // Check if a point P is inside the world space SVO volume.
 bool in_svo(in float3 P)
 {
@@ -105,9 +97,9 @@ bool intersect(in float3 P, in float3 V, in float t0, in float t1)
 // Fetch a voxel from the SVO (V_mu or V_rho) with colors and average occlusion.
 float4 voxel_fetch(in float3 sample_pos, in float3 vV, in float mip, in bool is_real_surface)
 {
-    float3 v_d = v_delta.SampleLevel(SVOFilter, sample_pos, mip).rgb;
-    float3 v_r = v_rho.SampleLevel(SVOFilter, sample_pos, mip).rgb;
-    float4 N = v_normal.SampleLevel(SVOFilter, sample_pos, mip).rgba;
+    float3 v_d = svo_sample(v_delta, sample_pos, mip).rgb;
+    float3 v_r = svo_sample(v_rho, sample_pos, mip).rgb;
+    float4 N = svo_sample(v_normal, sample_pos, mip).rgba;
     float occlusion = N.a;
 
     if (is_real_surface)
@@ -121,11 +113,12 @@ float4 voxel_fetch(in float3 sample_pos, in float3 vV, in float mip, in bool is_
 float4 voxel_fetch(in float3 sample_pos, in float3 vV, in float mip)
 {
 #ifndef UNFILTERED
-    float3 bounce = v_rho.SampleLevel(SVOFilter, sample_pos, mip).rgb;
-    float4 Nrgba = v_normal.SampleLevel(SVOFilter, sample_pos, mip).rgba;
+    float3 bounce = svo_sample(v_rho, sample_pos, mip).rgb;
+    float4 Nrgba = svo_sample(v_normal, sample_pos, mip).rgba;
 #else
-    float3 bounce = v_rho[sample_pos*SVO_SIZE];
-    float4 Nrgba = v_normal[sample_pos*SVO_SIZE];
+    uint3 texel = (svo_toroidal ? frac(sample_pos) : sample_pos) * SVO_SIZE;
+    float3 bounce = v_rho[texel];
+    float4 Nrgba = v_normal[texel];
 #endif
 
     float3 N = Nrgba.rgb * 2.0 - 1.0;
@@ -237,7 +230,7 @@ float trace_shadow_cone(in float3 P, in float3 V, in float cone_ratio, in float
 
         dist += sample_diameter * step_mult;
 
-        float sample_value = v_normal.SampleLevel(SVOFilter, sample_pos, sample_lod).a;
+        float sample_value = svo_sample(v_normal, sample_pos, sample_lod).a;
 
         float a = 1.0 - accum;
         accum += sample_value * a;
@@ -0,0 +1,395 @@
+/*
+ * The Dirtchamber - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+#include "bench_tools.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <random>
+#include <sstream>
+
+#include <dune/common_tools.h>
+#include <dune/parallel_tools.h>
+#include <dune/serializer.h>
+
+namespace bench
+{
+    std::string data_directory(std::vector<std::string>& args)
+    {
+        for (auto a = args.begin(); a != args.end(); ++a)
+        {
+            if (*a != "--data" || a + 1 == args.end())
+                continue;
+
+            std::string directory = *(a + 1);
+            args.erase(a, a + 2);
+
+            if (directory.back() != '/' && directory.back() != '\\')
+                directory += '/';
+
+            return directory;
+        }
+
+        return dune::to_string(dune::make_absolute_path(L"../../data/"));
+    }
+
+    double best_of(size_t runs, const std::function<void()>& f)
+    {
+        double best = std::numeric_limits<double>::max();
+
+        for (size_t i = 0; i < runs; ++i)
+        {
+            auto start = clock::now();
+            f();
+            best = std::min(best, std::chrono::duration<double, std::milli>(clock::now() - start).count());
+        }
+
+        return best;
+    }
+
+    void random_inject(dune::lpv_grid& grid)
+    {
+        std::mt19937 rng(1337);
+        std::uniform_real_distribution<float> dist(-1.f, 1.f);
+
+        dune::sh_volume& v = grid.injected();
+
+        for (size_t c = 0; c < 12; ++c)
+        for (size_t i = 0; i < v.size(); ++i)
+            v.coeffs[c][i] = c % 4 == 0 ? std::abs(dist(rng)) : dist(rng) * 0.5f;
+
+        std::fill(grid.inject_counter().begin(), grid.inject_counter().end(), 1.f);
+
+        grid.update_bricks();
+    }
+
+    bool obj_surfels(const std::string& filename, float density, std::vector<dune::surfel>& surfels)
+    {
+        std::ifstream f(filename);
+
+        if (!f)
+            return false;
+
+        std::vector<DirectX::XMFLOAT3> positions, normals;
+
+        std::mt19937 rng(1337);
+        std::uniform_real_distribution<float> dist(0.f, 1.f);
+
+        std::string line;
+
+        while (std::getline(f, line))
+        {
+            std::istringstream ss(line);
+            std::string type;
+            ss >> type;
+
+            DirectX::XMFLOAT3 v;
+
+            if (type == "v")
+            {
+                ss >> v.x >> v.y >> v.z;
+                positions.push_back(v);
+            }
+            else if (type == "vn")
+            {
+                ss >> v.x >> v.y >> v.z;
+                normals.push_back(v);
+            }
+            else if (type == "f")
+            {
+                size_t p[3], n[3];
+                char slash;
+
+                for (size_t i = 0; i < 3; ++i)
+                    ss >> p[i] >> slash >> slash >> n[i];
+
+                if (!ss)
+                    continue;
+
+                DirectX::XMVECTOR a = DirectX::XMLoadFloat3(&positions[p[0] - 1]);
+                DirectX::XMVECTOR e0 = DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&positions[p[1] - 1]), a);
+                DirectX::XMVECTOR e1 = DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&positions[p[2] - 1]), a);
+
+                float area = DirectX::XMVectorGetX(DirectX::XMVector3Length(DirectX::XMVector3Cross(e0, e1))) * 0.5f;
+                size_t num = std::max<size_t>(1, static_cast<size_t>(std::ceil(area * density)));
+
+                for (size_t i = 0; i < num; ++i)
+                {
+                    float s = dist(rng), t = dist(rng);
+
+                    if (s + t > 1.f)
+                    {
+                        s = 1.f - s;
+                        t = 1.f - t;
+                    }
+
+                    dune::surfel sf;
+                    DirectX::XMStoreFloat3(&sf.position, DirectX::XMVectorAdd(a, DirectX::XMVectorAdd(DirectX::XMVectorScale(e0, s), DirectX::XMVectorScale(e1, t))));
+                    sf.normal = normals[n[0] - 1];
+                    sf.area = area / num;
+
+                    surfels.push_back(sf);
+                }
+            }
+        }
+
+        return true;
+    }
+
+    bool obj_fragments(const std::string& filename, size_t resolution, std::vector<dune::voxel_fragment>& fragments)
+    {
+        std::vector<dune::surfel> surfels;
+
+        // a first pass with few samples to find the extent of the scene
+        if (!obj_surfels(filename, 0.f, surfels) || surfels.empty())
+            return false;
+
+        DirectX::XMVECTOR bb_min = DirectX::XMLoadFloat3(&surfels[0].position), bb_max = bb_min;
+
+        for (auto s = surfels.begin(); s != surfels.end(); ++s)
+        {
+            bb_min = DirectX::XMVectorMin(bb_min, DirectX::XMLoadFloat3(&s->position));
+            bb_max = DirectX::XMVectorMax(bb_max, DirectX::XMLoadFloat3(&s->position));
+        }
+
+        DirectX::XMFLOAT3 extent;
+        DirectX::XMStoreFloat3(&extent, DirectX::XMVectorSubtract(bb_max, bb_min));
+
+        float scale = resolution / (std::max(extent.x, std::max(extent.y, extent.z)) * 1.001f);
+
+        surfels.clear();
+        obj_surfels(filename, 3.f * scale * scale, surfels);
+
+        fragments.resize(surfels.size());
+
+        for (size_t i = 0; i < surfels.size(); ++i)
+        {
+            DirectX::XMFLOAT3 p;
+            DirectX::XMStoreFloat3(&p, DirectX::XMVectorScale(DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&surfels[i].position), bb_min), scale));
+
+            dune::voxel_fragment& f = fragments[i];
+            f.x = static_cast<uint32_t>(p.x);
+            f.y = static_cast<uint32_t>(p.y);
+            f.z = static_cast<uint32_t>(p.z);
+            f.normal = surfels[i].normal;
+            f.albedo = DirectX::XMFLOAT3(1.f, 1.f, 1.f);
+        }
+
+        return true;
+    }
+
+    bool obj_triangles(const std::string& filename, std::vector<dune::voxel_triangle>& triangles, DirectX::XMFLOAT3& bb_min, DirectX::XMFLOAT3& bb_max)
+    {
+        std::ifstream f(filename);
+
+        if (!f)
+            return false;
+
+        std::vector<DirectX::XMFLOAT3> positions, normals;
+
+        std::string line;
+
+        while (std::getline(f, line))
+        {
+            std::istringstream ss(line);
+            std::string type;
+            ss >> type;
+
+            DirectX::XMFLOAT3 v;
+
+            if (type == "v")
+            {
+                ss >> v.x >> v.y >> v.z;
+                positions.push_back(v);
+            }
+            else if (type == "vn")
+            {
+                ss >> v.x >> v.y >> v.z;
+                normals.push_back(v);
+            }
+            else if (type == "f")
+            {
+                dune::voxel_triangle t;
+                t.albedo = DirectX::XMFLOAT3(1.f, 1.f, 1.f);
+
+                bool ok = true;
+
+                for (size_t i = 0; i < 3 && ok; ++i)
+                {
+                    // p//n or p/t/n
+                    std::string vertex;
+                    ss >> vertex;
+
+                    size_t first = vertex.find('/'), last = vertex.rfind('/');
+
+                    ok = first != std::string::npos && last != first;
+
+                    if (ok)
+                    {
+                        size_t p = std::stoul(vertex.substr(0, first)), n = std::stoul(vertex.substr(last + 1));
+
+                        ok = p >= 1 && p <= positions.size() && n >= 1 && n <= normals.size();
+
+                        if (ok)
+                        {
+                            t.position[i] = positions[p - 1];
+                            t.normal[i] = normals[n - 1];
+                        }
+                    }
+                }
+
+                if (ok)
+                    triangles.push_back(t);
+            }
+        }
+
+        if (positions.empty())
+            return false;
+
+        DirectX::XMVECTOR mi = DirectX::XMLoadFloat3(&positions[0]), ma = mi;
+
+        for (auto p = positions.begin(); p != positions.end(); ++p)
+        {
+            mi = DirectX::XMVectorMin(mi, DirectX::XMLoadFloat3(&*p));
+            ma = DirectX::XMVectorMax(ma, DirectX::XMLoadFloat3(&*p));
+        }
+
+        // a cube around the center with a small margin
+        DirectX::XMVECTOR center = DirectX::XMVectorScale(DirectX::XMVectorAdd(mi, ma), 0.5f);
+        DirectX::XMVECTOR extent = DirectX::XMVectorSubtract(ma, mi);
+        float half = std::max(DirectX::XMVectorGetX(extent), std::max(DirectX::XMVectorGetY(extent), DirectX::XMVectorGetZ(extent))) * 0.501f;
+
+        DirectX::XMStoreFloat3(&bb_min, DirectX::XMVectorSubtract(center, DirectX::XMVectorReplicate(half)));
+        DirectX::XMStoreFloat3(&bb_max, DirectX::XMVectorAdd(center, DirectX::XMVectorReplicate(half)));
+
+        return true;
+    }
+
+    void cube_triangles(const DirectX::XMFLOAT4X4& world, std::vector<dune::voxel_triangle>& triangles)
+    {
+        DirectX::XMMATRIX w = DirectX::XMLoadFloat4x4(&world);
+
+        for (int axis = 0; axis < 3; ++axis)
+        for (int side = 0; side < 2; ++side)
+        {
+            const int u = (axis + 1) % 3, v = (axis + 2) % 3;
+
+            float corners[4][3];
+
+            for (int c = 0; c < 4; ++c)
+            {
+                corners[c][axis] = side ? 0.5f : -0.5f;
+                corners[c][u] = (c == 1 || c == 2) ? 0.5f : -0.5f;
+                corners[c][v] = (c >= 2) ? 0.5f : -0.5f;
+            }
+
+            const int tris[2][3] = { { 0, 1, 2 }, { 0, 2, 3 } };
+
+            for (int t = 0; t < 2; ++t)
+            {
+                dune::voxel_triangle tri;
+
+                for (int k = 0; k < 3; ++k)
+                {
+                    const float* p = corners[tris[t][k]];
+                    DirectX::XMStoreFloat3(&tri.position[k], DirectX::XMVector3TransformCoord(DirectX::XMVectorSet(p[0], p[1], p[2], 1.f), w));
+
+                    float n[3] = { 0.f, 0.f, 0.f };
+                    n[axis] = side ? 1.f : -1.f;
+                    DirectX::XMStoreFloat3(&tri.normal[k], DirectX::XMVector3Normalize(DirectX::XMVector3TransformNormal(DirectX::XMVectorSet(n[0], n[1], n[2], 0.f), w)));
+                }
+
+                tri.albedo = DirectX::XMFLOAT3(0.8f, 0.8f, 0.8f);
+                triangles.push_back(tri);
+            }
+        }
+    }
+
+    void stencil_step(const dune::tiled_volume<DirectX::XMFLOAT4>& src, dune::tiled_volume<DirectX::XMFLOAT4>& dst)
+    {
+        dune::parallel_for(0, dst.data().size(), [&](size_t first, size_t last)
+        {
+            for (size_t i = first; i < last; ++i)
+            {
+                auto c = src.at(i);
+
+                DirectX::XMVECTOR sum = DirectX::XMVectorZero();
+
+                for (size_t axis = 0; axis < 3; ++axis)
+                for (int dir = -1; dir <= 1; dir += 2)
+                    if (c.has_neighbour(axis, dir))
+                        sum = DirectX::XMVectorAdd(sum, DirectX::XMLoadFloat4(&src.data()[c.neighbour(axis, dir)]));
+
+                DirectX::XMVECTOR v = DirectX::XMVectorMultiplyAdd(sum, DirectX::XMVectorReplicate(1.f / 12.f), DirectX::XMVectorScale(DirectX::XMLoadFloat4(&src[c]), 0.5f));
+                DirectX::XMStoreFloat4(&dst.data()[i], v);
+            }
+        });
+    }
+
+    void reduce_step(const dune::tiled_volume<DirectX::XMFLOAT4>& src, dune::tiled_volume<DirectX::XMFLOAT4>& dst)
+    {
+        dune::parallel_for(0, dst.data().size(), [&](size_t first, size_t last)
+        {
+            for (size_t i = first; i < last; ++i)
+            {
+                auto p = dst.at(i);
+                auto c = src.at(p.x() * 2, p.y() * 2, p.z() * 2);
+
+                // walk the eight children along a Gray code
+                const size_t axes[7] = { 0, 1, 0, 2, 0, 1, 0 };
+                const int dirs[7] = { 1, 1, -1, 1, 1, -1, -1 };
+
+                DirectX::XMVECTOR sum = DirectX::XMLoadFloat4(&src[c]);
+
+                for (size_t s = 0; s < 7; ++s)
+                {
+                    c.step(axes[s], dirs[s]);
+                    sum = DirectX::XMVectorAdd(sum, DirectX::XMLoadFloat4(&src[c]));
+                }
+
+                DirectX::XMStoreFloat4(&dst.data()[i], DirectX::XMVectorScale(sum, 0.125f));
+            }
+        });
+    }
+
+    void write_settings(const std::string& settings_file, size_t groups, const std::string& path_file, size_t frames)
+    {
+        std::mt19937 gen(42);
+        std::uniform_real_distribution<float> value(-100.f, 100.f);
+
+        dune::serializer settings;
+
+        for (size_t g = 0; g < groups; ++g)
+        {
+            const dune::tstring group = L"settings.group" + std::to_wstring(g) + L".";
+
+            settings.put(group + L"enabled", static_cast<dune::BOOL>(g % 2));
+            settings.put(group + L"count", static_cast<int>(g));
+            settings.put(group + L"name", L"group_" + std::to_wstring(g));
+
+            for (size_t p = 0; p < 16; ++p)
+                settings.put(group + L"parameter" + std::to_wstring(p), value(gen));
+        }
+
+        dune::serializer path;
+
+        for (size_t f = 0; f < frames; ++f)
+        {
+            const dune::tstring frame = L"camera_path.frame" + std::to_wstring(f) + L".";
+
+            path.put(frame + L"time", static_cast<float>(f) / 60.f);
+            path.put(frame + L"fov", 60.f);
+
+            for (auto c : { L"pos.x", L"pos.y", L"pos.z", L"lookat.x", L"lookat.y", L"lookat.z" })
+                path.put(frame + c, value(gen));
+        }
+
+        settings.save(dune::to_tstring(settings_file));
+        path.save(dune::to_tstring(path_file));
+    }
+}
@@ -0,0 +1,123 @@
+/*
+ * The Dirtchamber - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+/*! \file */
+
+#ifndef BENCH_TOOLS_H
+#define BENCH_TOOLS_H
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/property_tree/xml_parser.hpp>
+
+#include <dune/geometry_volume.h>
+#include <dune/lpv_grid.h>
+#include <dune/tiled_volume.h>
+#include <dune/unicode.h>
+#include <dune/voxel_octree.h>
+#include <dune/voxelizer.h>
+
+/*! \brief Scenes, reference implementations and timing shared by the CPU benchmarks and tests. */
+namespace bench
+{
+    typedef std::chrono::high_resolution_clock clock;
+
+    /*!
+     * \brief Find the data directory and remove its option from the command line arguments.
+     *
+     * The directory is given with --data <directory>. Without it, it is ../../data relative to the
+     * executable like for the demos, and never relative to the current directory.
+     *
+     * \return The directory with a trailing slash.
+     */
+    std::string data_directory(std::vector<std::string>& args);
+
+    //! Time a function over a number of runs and return the fastest run in milliseconds.
+    double best_of(size_t runs, const std::function<void()>& f);
+
+    //! Fill the injected volume of an LPV with random flux and mark all cells as injected once.
+    void random_inject(dune::lpv_grid& grid);
+
+    /*!
+     * Sample surfels on all triangles of an OBJ file with about density surfels per unit area.
+     * Only positions, normals and triangular faces with a normal index are read.
+     */
+    bool obj_surfels(const std::string& filename, float density, std::vector<dune::surfel>& surfels);
+
+    /*!
+     * Voxelize an OBJ file into fragments at a resolution by sampling surfels, about three per voxel face.
+     * The bounding box of the scene is scaled uniformly to fit the volume.
+     */
+    bool obj_fragments(const std::string& filename, size_t resolution, std::vector<dune::voxel_fragment>& fragments);
+
+    /*!
+     * Read the triangles of an OBJ file with white albedo, and compute their bounding cube.
+     * Faces need a normal index, texture coordinates are skipped.
+     */
+    bool obj_triangles(const std::string& filename, std::vector<dune::voxel_triangle>& triangles, DirectX::XMFLOAT3& bb_min, DirectX::XMFLOAT3& bb_max);
+
+    //! Append the 12 triangles of a unit cube centered at the origin, transformed by world.
+    void cube_triangles(const DirectX::XMFLOAT4X4& world, std::vector<dune::voxel_triangle>& triangles);
+
+    //! One step of a 6-neighbour stencil, iterating the destination in storage order.
+    void stencil_step(const dune::tiled_volume<DirectX::XMFLOAT4>& src, dune::tiled_volume<DirectX::XMFLOAT4>& dst);
+
+    //! Average 2x2x2 texels of src into dst, iterating the destination in storage order.
+    void reduce_step(const dune::tiled_volume<DirectX::XMFLOAT4>& src, dune::tiled_volume<DirectX::XMFLOAT4>& dst);
+
+    //! Loads settings with boost::property_tree and parses values with a stringstream per get, like the serializer used to.
+    struct reference_settings
+    {
+        typedef boost::property_tree::basic_ptree<dune::tstring, dune::tstring> tptree;
+
+        std::map<dune::tstring, dune::tstring> properties;
+
+        void flatten(const dune::tstring& path, const tptree& pt)
+        {
+            for (auto i = pt.begin(); i != pt.end(); ++i)
+            {
+                const dune::tstring subpath = path.empty() ? i->first : path + L"." + i->first;
+
+                if (!i->second.empty())
+                    flatten(subpath, i->second);
+                else
+                    properties[subpath] = i->second.data();
+            }
+        }
+
+        void load(const std::string& filename)
+        {
+            tptree pt;
+            boost::property_tree::read_xml(filename, pt);
+
+            properties.clear();
+            flatten(L"", pt);
+        }
+
+        template<typename T>
+        bool get(const dune::tstring& key, T& value) const
+        {
+            auto i = properties.find(key);
+
+            if (i == properties.end())
+                return false;
+
+            dune::tstringstream ss(i->second);
+            ss >> std::boolalpha >> value;
+
+            return !ss.fail();
+        }
+    };
+
+    //! Write a large settings file and a camera path with a key frame per frame for the serializer.
+    void write_settings(const std::string& settings_file, size_t groups, const std::string& path_file, size_t frames);
+}
+
+#endif
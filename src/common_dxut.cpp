@@ -9,6 +9,12 @@
 
 namespace dc
 {
+    // constant uploads of the last complete frame
+    static dune::upload_counters frame_uploads = { 0, 0, 0, 0, 0 };
+
+    // state changes of the last complete frame
+    static dune::state_counters frame_states = { 0, 0 };
+
     void CALLBACK on_releasing_swap_chain(void* pUserContext)
     {
         dc::gui::dlg_manager.OnD3D11ReleasingSwapChain();
@@ -25,6 +31,8 @@ namespace dc
 
     void CALLBACK on_render(ID3D11Device* device, ID3D11DeviceContext* context, double fTime, float fElapsedTime, void* pUserContext)
     {
+        DUNE_PROFILE_ZONE("Frame");
+
         static float clear_color[4] = { 0.0f, 0.f, 0.0f, 1.0f };
 
         if (the_renderer)
@@ -48,6 +56,11 @@ namespace dc
 
     void CALLBACK on_frame_move(double fTime, float fElapsedTime, void* pUserContext)
     {
+        DUNE_PROFILE_ZONE("Update");
+
+        frame_uploads = dune::reset_upload_stats();
+        frame_states = dune::reset_state_stats();
+
         if (the_renderer)
             the_renderer->update_frame(the_context, fTime, fElapsedTime);
     }
@@ -75,6 +88,26 @@ namespace dc
         dc::gui::dlg_manager.OnD3D11DestroyDevice();
     }
 
+    void save_trace(const dune::tstring& filename)
+    {
+        dune::frame_profiler& profiler = dune::frame_profiler::i();
+
+        profiler.save_trace(filename);
+
+        tclog << L"Saved trace " << filename << std::endl;
+
+        auto zones = profiler.zone_stats();
+
+        for (auto z = zones.begin(); z != zones.end(); ++z)
+            tclog << (z->gpu ? L"GPU " : L"CPU ") << dune::to_tstring(z->name) << L": " << z->count << L"x, avg " << z->average
+                  << L"ms, min " << z->min << L"ms, max " << z->max << L"ms" << std::endl;
+
+        tclog << L"Constant uploads per frame: " << frame_uploads.maps << L" maps, " << frame_uploads.skipped << L" skipped, "
+              << frame_uploads.ring_pushes << L" ring pushes (" << frame_uploads.ring_bytes << L" bytes, "
+              << frame_uploads.ring_discards << L" discards)" << std::endl;
+        tclog << L"State changes per frame: " << frame_states.issued << L" issued, " << frame_states.dropped << L" dropped" << std::endl;
+    }
+
     void CALLBACK on_keyboard(UINT nChar, bool bKeyDown, bool bAltDown, void* pUserContext)
     {
         if (!the_renderer)
@@ -102,6 +135,9 @@ namespace dc
 
         if (nChar == 'P' && bKeyDown)
             dc::gui::save_settings(save_stuff);
+
+        if (nChar == 'T' && bKeyDown)
+            save_trace(L"../../data/trace.json");
     }
 
     void CALLBACK on_gui_event(UINT nEvent, int nControlID, CDXUTControl* pControl, void* pUserContext)
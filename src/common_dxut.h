@@ -37,6 +37,9 @@ namespace dc
     void CALLBACK on_render(ID3D11Device* device, ID3D11DeviceContext* context, double fTime, float fElapsedTime, void* pUserContext);
     void CALLBACK on_gui_event(UINT nEvent, int nControlID, CDXUTControl* pControl, void* pUserContext);
     //!@}
+
+    /*! \brief Save the frame_profiler timeline as a Chrome trace and log the statistics of each zone. Bound to the T key. */
+    void save_trace(const dune::tstring& filename);
 }
 
 #endif
@@ -106,6 +106,18 @@ namespace dc
             dynamic_cast<CDXUTStatic*>(find_control(idc))->SetText(text);
         }
 
+        dune::tstring timing_text(float latest, const dune::profile_stats& stats)
+        {
+            dune::tstringstream ss;
+
+            ss << std::fixed << std::setprecision(2) << latest << L"ms";
+
+            if (stats.samples > 0)
+                ss << L" (avg " << stats.average << L", p95 " << stats.p95 << L")";
+
+            return ss.str();
+        }
+
         bool checkbox_value(int idc)
         {
             return dynamic_cast<CDXUTCheckBox*>(find_control(idc))->GetChecked();
@@ -251,6 +263,30 @@ namespace dc
             hud_gi.AddCheckBox(IDC_GI_DEBUG2, L"Show LPV", x, y += db, w, h, false);
 #endif
 
+#ifdef LPV
+            // budget of amortized propagation in iterations and 1/10 ms, 0 means unlimited; defaults as in gi_renderer
+            hud_gi.AddCheckBox(IDC_LPV_AMORTIZED, L"Amortize propagation", x, y += db, w, h, false);
+            hud_gi.AddStatic(IDC_LPV_BUDGET_INFO, L"Budget: 8 it. 2.0ms", x, y += db, w, h);
+            hud_gi.AddSlider(IDC_LPV_BUDGET_ITERATIONS, x, y += dd, w, h, 0, LPV_SIZE, 8);
+            hud_gi.AddSlider(IDC_LPV_BUDGET_MS, x, y += dd, w, h, 0, 100, 20);
+
+            // in the order of dune::sh_format
+            CDXUTComboBox* combo_history_format = nullptr;
+            hud_gi.AddStatic(-1, L"History format:", x, y += db, w, h);
+            hud_gi.AddComboBox(IDC_LPV_HISTORY_FORMAT, x, y += dd, w, h + 2, 0, false, &combo_history_format);
+            combo_history_format->AddItem(L"FP16", IntToPtr(dune::SH_FORMAT_FP16));
+            combo_history_format->AddItem(L"Shared exponent", IntToPtr(dune::SH_FORMAT_SHARED_EXPONENT));
+            combo_history_format->AddItem(L"YCoCg", IntToPtr(dune::SH_FORMAT_YCOCG));
+            combo_history_format->SetSelectedByIndex(dune::SH_FORMAT_FP16);
+
+            hud_gi.AddCheckBox(IDC_LPV_CASCADED, L"Camera cascades", x, y += db, w, h, false);
+            hud_gi.AddCheckBox(IDC_LPV_OCCLUSION, L"Geometry occlusion", x, y += db, w, h, false);
+#endif
+
+#if !defined(LPV) && !defined(DLPV)
+            hud_gi.AddCheckBox(IDC_SVO_CLIPMAP, L"Camera clipmap", x, y += db, w, h, false);
+#endif
+
             // Postprocessing 1 settings
             y = start;
             combo_settings->AddItem(L"Postprocess 1", reinterpret_cast<void*>(&hud_postp1));
@@ -362,7 +398,7 @@ namespace dc
             ofn.lStructSize = sizeof(ofn);
             ofn.lpstrFile = file;
             ofn.nMaxFile = MAX_PATH;
-            ofn.lpstrFilter = L"XML\0*.xml\0";
+            ofn.lpstrFilter = L"XML\0*.xml\0JSON\0*.json\0";
             ofn.nFilterIndex = 1;
             ofn.Flags = OFN_PATHMUSTEXIST | OFN_FILEMUSTEXIST;
 
@@ -378,6 +414,12 @@ namespace dc
                 if (load_more)
                     load_more(s);
 
+                // settings nobody read are misspelled, obsolete or meant for another renderer
+                auto unread = s.unread();
+
+                for (auto k = unread.begin(); k != unread.end(); ++k)
+                    tclog << L"Unused setting: " << *k << std::endl;
+
                 return true;
             }
 
@@ -443,6 +485,27 @@ namespace dc
             }
         }
 
+#ifdef LPV
+        static void set_budget_text(const dune::propagation_schedule& schedule)
+        {
+            dune::tstringstream ss;
+            ss << L"Budget: ";
+
+            if (schedule.budget_iterations() == 0 && schedule.budget_ms() <= 0)
+                ss << L"unlimited";
+            else
+            {
+                if (schedule.budget_iterations() > 0)
+                    ss << schedule.budget_iterations() << L" it. ";
+
+                if (schedule.budget_ms() > 0)
+                    ss << std::fixed << std::setprecision(1) << schedule.budget_ms() << L"ms";
+            }
+
+            set_text(IDC_LPV_BUDGET_INFO, ss.str().c_str());
+        }
+#endif
+
         void get_parameters(dune::light_propagation_volume& lpv)
         {
             // update constant buffer variables
@@ -460,6 +523,18 @@ namespace dc
             ss << L"LPV propagations: " << num_lpv_propagations;
             set_text(IDC_GI_INFO1, ss.str().c_str());
             lpv.set_num_propagations(num_lpv_propagations);
+
+#ifdef LPV
+            lpv.set_amortized(checkbox_value(IDC_LPV_AMORTIZED));
+            lpv.schedule().set_budget_iterations(static_cast<size_t>(slider_value(IDC_LPV_BUDGET_ITERATIONS)));
+            lpv.schedule().set_budget_ms(slider_value(IDC_LPV_BUDGET_MS, 0, 10));
+            set_budget_text(lpv.schedule());
+
+            auto combo = dynamic_cast<CDXUTComboBox*>(find_control(IDC_LPV_HISTORY_FORMAT));
+            lpv.set_history_format(static_cast<dune::sh_format>(combo->GetSelectedIndex()));
+
+            lpv.set_occlusion(checkbox_value(IDC_LPV_OCCLUSION));
+#endif
         }
 
         void set_parameters(const dune::light_propagation_volume& lpv)
@@ -478,6 +553,18 @@ namespace dc
             dune::tstringstream ss;
             ss << L"LPV propagations: " << lpv.num_propagations();
             set_text(IDC_GI_INFO1, ss.str().c_str());
+
+#ifdef LPV
+            set_checkbox_value(IDC_LPV_AMORTIZED, lpv.amortized());
+            set_slider_value(IDC_LPV_BUDGET_ITERATIONS, static_cast<float>(lpv.schedule().budget_iterations()));
+            set_slider_value(IDC_LPV_BUDGET_MS, 0, 10, lpv.schedule().budget_ms());
+            set_budget_text(lpv.schedule());
+
+            auto combo = dynamic_cast<CDXUTComboBox*>(find_control(IDC_LPV_HISTORY_FORMAT));
+            combo->SetSelectedByIndex(lpv.history_format());
+
+            set_checkbox_value(IDC_LPV_OCCLUSION, lpv.occlusion());
+#endif
         }
 
         void get_parameters(dune::sparse_voxel_octree& svo)
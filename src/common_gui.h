@@ -77,6 +77,9 @@ namespace dc
         void set_slider_value(int idc, float v, bool normalized = false);
         //!@}
 
+        /*! \brief Returns the newest result of a GPU timing with the average and 95th percentile of the last ones. */
+        dune::tstring timing_text(float latest, const dune::profile_stats& stats);
+
         //!@{
         /*!
          * \brief Save/Load dialog to dump current renderer state.
@@ -23,8 +23,12 @@ namespace dc
 
         camera_.create(device);
 
-        for (size_t i = 0; i < files_scene.size(); ++i)
-            scene_.create_from_dir(device, files_scene[i].c_str());
+        {
+            DUNE_PROFILE_ZONE("Load scene");
+
+            for (size_t i = 0; i < files_scene.size(); ++i)
+                scene_.create_from_dir(device, files_scene[i].c_str());
+        }
 
         DirectX::XMMATRIX model = DirectX::XMMatrixIdentity();
 
@@ -39,8 +43,14 @@ namespace dc
         sky_.create(device, L"../../data/skydome/skydome_sphere.obj");
         sky_.set_envmap(device, L"../../data/skydome/sunny_day.jpg");
 
+        // prefilter the sky for image based lighting, which is only rebaked if the cached textures are missing or stale
+        dune::bake_ibl(L"../../data/skydome/sunny_day.jpg", L"../../data/skydome/sunny_day_ggx.dds", L"../../data/brdf_lut.dds");
+        dune::load_texture(device, L"../../data/skydome/sunny_day_ggx.dds", &ibl_env_srv_);
+        dune::load_texture(device, L"../../data/brdf_lut.dds", &ibl_brdf_srv_);
+
         cb_per_frame_.create(device);
         cb_onetime_.create(device);
+        constant_ring_.create(device);
 
 #if defined(DEBUG) || defined(_DEBUG)
         dune::logger::show_warnings();
@@ -108,6 +118,7 @@ namespace dc
 
         cb_onetime_.destroy();
         cb_per_frame_.destroy();
+        constant_ring_.destroy();
     }
 
     void common_renderer::resize(UINT width, UINT height)
@@ -168,6 +179,8 @@ namespace dc
     {
         update_bbox(context, mesh);
         context->PSSetShaderResources(SLOT_TEX_NOISE, 1, &noise_srv_);
+        context->PSSetShaderResources(SLOT_TEX_IBL_ENVMAP, 1, &ibl_env_srv_);
+        context->PSSetShaderResources(SLOT_TEX_IBL_BRDF, 1, &ibl_brdf_srv_);
     }
 
     // TODO: update_scene_parameters?
@@ -260,7 +273,11 @@ namespace dc
         for (size_t x = 0; x < scene_.size(); ++x)
         {
             dune::gilga_mesh* m = dynamic_cast<dune::gilga_mesh*>(scene_[x].get());
-            if (m) m->set_alpha_slot(SLOT_TEX_ALPHA);
+            if (m)
+            {
+                m->set_alpha_slot(SLOT_TEX_ALPHA);
+                m->set_constant_ring(&constant_ring_);
+            }
         }
 
         scene_.render(context);
@@ -9,6 +9,8 @@
 #ifndef COMMON_RENDERER_H
 #define COMMON_RENDERER_H
 
+#include <cstring>
+
 #undef NOMINMAX
 #include <DXUT.h>
 #include <dune/dune.h>
@@ -60,6 +62,7 @@ namespace dc
         dune::camera camera_;
         dune::cbuffer<per_frame> cb_per_frame_;
         dune::cbuffer<onetime> cb_onetime_;
+        dune::constant_ring constant_ring_;
         dune::gilga_mesh debug_box_;
         dune::composite_mesh scene_;
         dune::gbuffer def_;
@@ -70,6 +73,8 @@ namespace dc
 
         pppipe postprocessor_;
         ID3D11ShaderResourceView* noise_srv_;
+        ID3D11ShaderResourceView* ibl_env_srv_;
+        ID3D11ShaderResourceView* ibl_brdf_srv_;
 
     protected:
         /*! \brief Derived classes can overload this method to call render() on more dune objects. Buffers etc. are all set up already. */
@@ -164,7 +169,14 @@ namespace dc
         L main_light_;
         dune::render_target rsm_depth_;
         dune::render_target dummy_spec_;
-        bool update_rsm_;
+
+        // the RSM and the GI stages of derived renderers only run when their inputs changed
+        dune::gi_pipeline pipeline_;
+        size_t stage_rsm_;
+
+        DirectX::XMFLOAT4X4 gi_world_;
+        DirectX::XMFLOAT3 gi_bb_min_;
+        DirectX::XMFLOAT3 gi_bb_max_;
 
     protected:
         /*! \brief Update and upload RSM camera parameters (i.e. light view projection matrix etc.). */
@@ -235,6 +247,27 @@ namespace dc
             scene_.render(context);
         }
 
+        /*!
+         * \brief Invalidate the GI stages reading the placement of the GI volume if it changed, and those reading GI parameters.
+         *
+         * \param world The world matrix the GI volume is placed with, together with bb_min_ and bb_max_.
+         */
+        void invalidate_gi_parameters(const DirectX::XMFLOAT4X4& world)
+        {
+            if (std::memcmp(&world, &gi_world_, sizeof(world)) != 0 ||
+                std::memcmp(&bb_min_, &gi_bb_min_, sizeof(bb_min_)) != 0 ||
+                std::memcmp(&bb_max_, &gi_bb_max_, sizeof(bb_max_)) != 0)
+            {
+                gi_world_ = world;
+                gi_bb_min_ = bb_min_;
+                gi_bb_max_ = bb_max_;
+
+                pipeline_.invalidate(dune::gi_pipeline::WORLD);
+            }
+
+            pipeline_.invalidate(dune::gi_pipeline::GI_PARAMETERS);
+        }
+
     public:
         virtual void create(ID3D11Device* device)
         {
@@ -263,6 +296,13 @@ namespace dc
 
             // add buffers to deferred renderer
             add_buffer(*main_light_.rsm()[L"lineardepth"], SLOT_TEX_SVO_RSM_RHO_START);
+
+            // the RSM sees the meshes and the light
+            pipeline_.destroy();
+            stage_rsm_ = pipeline_.add_stage(L"RSM", dune::gi_pipeline::GEOMETRY | dune::gi_pipeline::WORLD | dune::gi_pipeline::LIGHT);
+
+            std::memset(&gi_world_, 0, sizeof(gi_world_));
+            gi_bb_min_ = gi_bb_max_ = DirectX::XMFLOAT3(0.f, 0.f, 0.f);
         }
 
         /*! \brief Update and upload parameters (view projection matrix, flux etc.) of a directional light. */
@@ -286,7 +326,7 @@ namespace dc
 
             l.parameters().to_ps(context, SLOT_LIGHT_PS);
 
-            update_rsm_ = true;
+            pipeline_.invalidate(dune::gi_pipeline::LIGHT);
         }
 
         virtual void destroy()
@@ -295,6 +335,7 @@ namespace dc
             main_light_.destroy();
             rsm_depth_.destroy();
             dummy_spec_.destroy();
+            pipeline_.destroy();
         }
 
         inline dune::directional_light& main_light()
@@ -302,6 +343,12 @@ namespace dc
             return main_light_;
         }
 
+        /*! \brief Returns the GI stages, and which of them ran this frame. */
+        inline const dune::gi_pipeline& pipeline() const
+        {
+            return pipeline_;
+        }
+
         virtual void save(dune::serializer& s)
         {
             common_renderer::save(s);
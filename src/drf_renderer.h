@@ -48,6 +48,7 @@ protected:
 #define VOLUME_PARAMETERS_SLOT SLOT_LPV_PARAMETERS_VS_PS
 #else
     dune::delta_sparse_voxel_octree delta_radiance_field_;
+    dune::voxel_ownership ownership_;
 #define VOLUME_SIZE SVO_SIZE
 #define VOLUME_PARAMETERS_SLOT SLOT_SVO_PARAMETERS_VS_GS_PS
 #endif
@@ -60,6 +61,9 @@ protected:
 
     dune::tracker tracker_;
     dune::profile_query profiler_;
+    dune::profile_query profiler_rho_;
+    dune::profile_query profiler_mu_;
+    size_t stage_drf_;
     dune::gilga_mesh synthetic_object_;
 #define reconstructed_real_scene_ scene_
 
@@ -185,18 +189,39 @@ protected:
 
         delta_radiance_field_.render_direct(context, 5, SLOT_TEX_LPV_DEFERRED_START);
 #else
-        // TODO: voxelize only on geo change
-        // voxelize reconstructed real scene
+        // find meshes of the reconstructed real scene and the synthetic object which moved since the last voxelization
+        const size_t synthetic = reconstructed_real_scene_.size();
+
         for (size_t x = 0; x < reconstructed_real_scene_.size(); ++x)
         {
             dune::gilga_mesh* m = dynamic_cast<dune::gilga_mesh*>(reconstructed_real_scene_[x].get());
 
             if (m)
-                delta_radiance_field_.voxelize(context, *m);
+                ownership_.set_mesh(x, m->bb_min(), m->bb_max(), m->world());
         }
 
-        // voxelize synthetic object
-        delta_radiance_field_.voxelize(context, synthetic_object_);
+        ownership_.set_mesh(synthetic, synthetic_object_.bb_min(), synthetic_object_.bb_max(), synthetic_object_.world());
+        ownership_.update();
+
+        // inject() clears the radiance volume, so only the voxels of moved meshes need to be cleared and voxelized
+        if (!ownership_.light_only())
+        {
+            delta_radiance_field_.clear(context, ownership_.regions());
+
+            for (auto x = ownership_.meshes().begin(); x != ownership_.meshes().end(); ++x)
+            {
+                if (*x == synthetic)
+                {
+                    delta_radiance_field_.voxelize(context, synthetic_object_, false);
+                    continue;
+                }
+
+                dune::gilga_mesh* m = dynamic_cast<dune::gilga_mesh*>(reconstructed_real_scene_[*x].get());
+
+                if (m)
+                    delta_radiance_field_.voxelize(context, *m, false);
+            }
+        }
 
         // inject differential light, i.e. RSM rho and mu
         delta_radiance_field_.inject(context, main_light_);
@@ -218,27 +243,38 @@ protected:
     */
     void render_gi(ID3D11DeviceContext* context, float* clear_color)
     {
-        if (update_rsm_)
+        DUNE_PROFILE_ZONE("GI");
+
+        pipeline_.schedule();
+
+        if (pipeline_.busy())
         {
             // setup rsm view
             update_rsm_camera_parameters(context, main_light_);
 
             // inject first bounce
-            render_mu_ = false;
-            profiler_.begin(context);
-            render_rsm(context, clear_color, main_light_.rho());
-            time_rsm_rho_ = profiler_.result();
-
-            render_mu_ = true;
-            profiler_.begin(context);
-            render_rsm(context, clear_color, main_light_.mu());
-            time_rsm_mu_ = profiler_.result();
+            if (pipeline_.runs(stage_rsm_))
+            {
+                render_mu_ = false;
+                profiler_rho_.begin(context);
+                render_rsm(context, clear_color, main_light_.rho());
+                profiler_rho_.end();
+
+                render_mu_ = true;
+                profiler_mu_.begin(context);
+                render_rsm(context, clear_color, main_light_.mu());
+                profiler_mu_.end();
+            }
 
             // render delta radiance field
-            render_drf(context, clear_color);
-
-            update_rsm_ = false;
+            if (pipeline_.runs(stage_drf_))
+                render_drf(context, clear_color);
         }
+
+        // timings of earlier frames, also of stages which didn't run this one
+        time_rsm_rho_ = profiler_rho_.latest();
+        time_rsm_mu_ = profiler_mu_.latest();
+        delta_radiance_field_.update_timings();
     }
 
     virtual void do_render_scene(ID3D11DeviceContext* context)
@@ -276,7 +312,17 @@ public:
 
         rsm_renderer::create(device);
 
-        profiler_.create(device);
+        // the delta radiance field reads both RSMs and the placement of the synthetic object
+#ifdef DLPV
+        // vpl_scale scales the injection
+        stage_drf_ = pipeline_.add_stage(L"DRF", dune::gi_pipeline::WORLD | dune::gi_pipeline::GI_PARAMETERS, { stage_rsm_ });
+#else
+        stage_drf_ = pipeline_.add_stage(L"DRF", dune::gi_pipeline::WORLD, { stage_rsm_ });
+#endif
+
+        profiler_.create(device, "Deferred");
+        profiler_rho_.create(device, "RSM rho");
+        profiler_mu_.create(device, "RSM mu");
         tracker_.create(L"../../data/camera_parameters.xml");
         tracker_.load_pattern(L"../../data/marker.png");
 
@@ -286,6 +332,8 @@ public:
 
 #ifdef DLPV
         lpv_rho_.create(device, VOLUME_SIZE);
+#else
+        ownership_.create(VOLUME_SIZE);
 #endif
 
         CD3D11_RASTERIZER_DESC raster_desc = CD3D11_RASTERIZER_DESC(CD3D11_DEFAULT());
@@ -320,9 +368,13 @@ public:
         synthetic_object_.destroy();
         dune::safe_release(no_culling_);
         profiler_.destroy();
+        profiler_rho_.destroy();
+        profiler_mu_.destroy();
 
 #ifdef DLPV
         lpv_rho_.destroy();
+#else
+        ownership_.destroy();
 #endif
     }
 
@@ -361,9 +413,11 @@ public:
 #ifdef DLPV
         lpv_rho_.set_model_matrix(context, synthetic_object_.world(), bb_min_, bb_max_, VOLUME_PARAMETERS_SLOT);
         lpv_rho_.parameters().to_ps(context, SLOT_GI_PARAMETERS_PS);
+#else
+        ownership_.set_model_matrix(synthetic_object_.world(), bb_min_, bb_max_);
 #endif
 
-        update_rsm_ = true;
+        invalidate_gi_parameters(synthetic_object_.world());
     }
 
     /*! \brief Update all objects (synthetic and real reconstructed scene) with a matrix from the tracker. */
@@ -443,6 +497,8 @@ public:
 
     void update_everything(ID3D11DeviceContext* context)
     {
+        pipeline_.invalidate(dune::gi_pipeline::ALL);
+
         update_tracked_scene(context);
         update_onetime_parameters(context, synthetic_object_);
         update_camera_parameters(context);
@@ -477,6 +533,21 @@ public:
         return delta_radiance_field_;
     }
 
+    //!@{
+    /*! \brief Returns rolling statistics of the GPU timings of both RSMs and the deferred pass. */
+    dune::profile_stats stats_rsm_mu() const   { return profiler_mu_.stats(); }
+    dune::profile_stats stats_rsm_rho() const  { return profiler_rho_.stats(); }
+    dune::profile_stats stats_deferred() const { return profiler_.stats(); }
+    //!@}
+
+#ifndef DLPV
+    /*! \brief Returns what the last GI update voxelized and skipped. */
+    const dune::revoxelization_stats& revoxelization() const
+    {
+        return ownership_.stats();
+    }
+#endif
+
 #ifdef DLPV
     inline dune::light_propagation_volume& lpv_rho()
     {
@@ -0,0 +1,251 @@
+/*
+ * Dune D3D library - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+#include "anisotropic_voxels.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "parallel_tools.h"
+
+namespace dune
+{
+    namespace detail
+    {
+        // front to back compositing with premultiplied alpha
+        inline DirectX::XMVECTOR XM_CALLCONV over(DirectX::FXMVECTOR front, DirectX::FXMVECTOR back)
+        {
+            return DirectX::XMVectorMultiplyAdd(DirectX::XMVectorSubtract(DirectX::XMVectorSplatOne(), DirectX::XMVectorSplatW(front)), back, front);
+        }
+
+        /*
+         * Reduce the 2x2x2 voxels v, indexed by x | y << 1 | z << 2, for travel along an axis. The voxel with
+         * the lower coordinate along the axis is in front for the positive direction.
+         */
+        inline DirectX::XMVECTOR reduce(const DirectX::XMVECTOR v[8], size_t axis, bool positive)
+        {
+            const size_t step = static_cast<size_t>(1) << axis;
+
+            DirectX::XMVECTOR sum = DirectX::XMVectorZero();
+
+            for (size_t c = 0; c < 8; ++c)
+            {
+                if (c & step)
+                    continue;
+
+                sum = DirectX::XMVectorAdd(sum, positive ? over(v[c], v[c | step]) : over(v[c | step], v[c]));
+            }
+
+            return DirectX::XMVectorScale(sum, 0.25f);
+        }
+
+        inline void load_block(const std::vector<DirectX::XMFLOAT4>& src, size_t r, size_t x, size_t y, size_t z, DirectX::XMVECTOR v[8])
+        {
+            for (size_t c = 0; c < 8; ++c)
+            {
+                size_t i = ((2 * z + ((c >> 2) & 1)) * r + 2 * y + ((c >> 1) & 1)) * r + 2 * x + (c & 1);
+                v[c] = DirectX::XMLoadFloat4(&src[i]);
+            }
+        }
+    }
+
+    anisotropic_voxels::anisotropic_voxels() :
+        resolution_(0),
+        levels_(0),
+        base_()
+    {
+    }
+
+    void anisotropic_voxels::create(size_t resolution)
+    {
+        destroy();
+
+        assert(resolution > 0 && (resolution & (resolution - 1)) == 0);
+
+        resolution_ = resolution;
+
+        for (size_t r = resolution; r > 0; r /= 2)
+            ++levels_;
+
+        base_.assign(resolution * resolution * resolution, DirectX::XMFLOAT4(0.f, 0.f, 0.f, 0.f));
+
+        for (size_t d = 0; d < 6; ++d)
+        {
+            mips_[d].resize(levels_ - 1);
+
+            for (size_t l = 1; l < levels_; ++l)
+            {
+                size_t r = resolution >> l;
+                mips_[d][l - 1].assign(r * r * r, DirectX::XMFLOAT4(0.f, 0.f, 0.f, 0.f));
+            }
+        }
+    }
+
+    void anisotropic_voxels::destroy()
+    {
+        resolution_ = 0;
+        levels_ = 0;
+
+        base_.clear();
+        base_.shrink_to_fit();
+
+        for (size_t d = 0; d < 6; ++d)
+            mips_[d].clear();
+    }
+
+    void anisotropic_voxels::filter()
+    {
+        for (size_t l = 1; l < levels_; ++l)
+        {
+            const size_t r = resolution_ >> l;
+            const size_t r_src = r * 2;
+
+            parallel_for(0, r, [&](size_t first, size_t last)
+            {
+                DirectX::XMVECTOR v[8];
+
+                for (size_t z = first; z < last; ++z)
+                for (size_t y = 0; y < r; ++y)
+                for (size_t x = 0; x < r; ++x)
+                {
+                    const size_t i = (z * r + y) * r + x;
+
+                    // the first level is reduced from the shared mip 0, so load it only once
+                    if (l == 1)
+                        detail::load_block(base_, r_src, x, y, z, v);
+
+                    for (size_t d = 0; d < 6; ++d)
+                    {
+                        if (l > 1)
+                            detail::load_block(mips_[d][l - 2], r_src, x, y, z, v);
+
+                        DirectX::XMStoreFloat4(&mips_[d][l - 1][i], detail::reduce(v, d / 2, d % 2 == 0));
+                    }
+                }
+            });
+        }
+    }
+
+    const std::vector<DirectX::XMFLOAT4>& anisotropic_voxels::level(direction d, size_t mip) const
+    {
+        assert(mip < levels_);
+        return mip == 0 ? base_ : mips_[d][mip - 1];
+    }
+
+    DirectX::XMFLOAT4 anisotropic_voxels::get(direction d, size_t mip, int x, int y, int z) const
+    {
+        const int r = static_cast<int>(resolution_ >> mip);
+
+        if (mip >= levels_ || x < 0 || y < 0 || z < 0 || x >= r || y >= r || z >= r)
+            return DirectX::XMFLOAT4(0.f, 0.f, 0.f, 0.f);
+
+        return level(d, mip)[(z * r + y) * r + x];
+    }
+
+    DirectX::XMFLOAT4 anisotropic_voxels::sample(const DirectX::XMFLOAT3& p, const DirectX::XMFLOAT3& dir, float mip) const
+    {
+        if (levels_ == 0)
+            return DirectX::XMFLOAT4(0.f, 0.f, 0.f, 0.f);
+
+        mip = std::min(std::max(mip, 0.f), static_cast<float>(levels_ - 1));
+
+        const size_t m0 = static_cast<size_t>(mip);
+        const size_t m1 = std::min(m0 + 1, levels_ - 1);
+        const float mf = mip - m0;
+
+        const float d[3] = { dir.x, dir.y, dir.z };
+        const float pos[3] = { p.x, p.y, p.z };
+
+        DirectX::XMVECTOR result = DirectX::XMVectorZero();
+
+        for (size_t m = m0; m <= m1; ++m)
+        {
+            const float wm = m0 == m1 ? 1.f : (m == m0 ? 1.f - mf : mf);
+
+            if (wm <= 0.f)
+                continue;
+
+            const float r = static_cast<float>(resolution_ >> m);
+
+            int i0[3];
+            float f[3];
+
+            for (size_t a = 0; a < 3; ++a)
+            {
+                float u = pos[a] * r - 0.5f;
+                float fl = std::floor(u);
+
+                i0[a] = static_cast<int>(fl);
+                f[a] = u - fl;
+            }
+
+            for (size_t a = 0; a < 3; ++a)
+            {
+                const float wa = wm * d[a] * d[a];
+
+                if (wa <= 0.f)
+                    continue;
+
+                const direction chain = static_cast<direction>(a * 2 + (d[a] >= 0.f ? 0 : 1));
+
+                for (int c = 0; c < 8; ++c)
+                {
+                    const float w = wa * ((c & 1) ? f[0] : 1.f - f[0]) * ((c & 2) ? f[1] : 1.f - f[1]) * ((c & 4) ? f[2] : 1.f - f[2]);
+
+                    DirectX::XMFLOAT4 v = get(chain, m, i0[0] + (c & 1), i0[1] + ((c >> 1) & 1), i0[2] + ((c >> 2) & 1));
+                    result = DirectX::XMVectorMultiplyAdd(DirectX::XMLoadFloat4(&v), DirectX::XMVectorReplicate(w), result);
+                }
+            }
+        }
+
+        DirectX::XMFLOAT4 out;
+        DirectX::XMStoreFloat4(&out, result);
+        return out;
+    }
+
+    void generate_mips(const std::vector<DirectX::XMFLOAT4>& base, size_t resolution, std::vector<std::vector<DirectX::XMFLOAT4>>& mips)
+    {
+        size_t levels = 0;
+
+        for (size_t r = resolution / 2; r > 0; r /= 2)
+            ++levels;
+
+        mips.resize(levels);
+
+        const std::vector<DirectX::XMFLOAT4>* src = &base;
+
+        for (size_t l = 0; l < levels; ++l)
+        {
+            const size_t r = resolution >> (l + 1);
+            const size_t rs = r * 2;
+
+            std::vector<DirectX::XMFLOAT4>& dst = mips[l];
+            dst.resize(r * r * r);
+
+            for (size_t z = 0; z < r; ++z)
+            for (size_t y = 0; y < r; ++y)
+            for (size_t x = 0; x < r; ++x)
+            {
+                float sum[4] = { 0.f, 0.f, 0.f, 0.f };
+
+                for (size_t c = 0; c < 8; ++c)
+                {
+                    const DirectX::XMFLOAT4& v = (*src)[((2 * z + ((c >> 2) & 1)) * rs + 2 * y + ((c >> 1) & 1)) * rs + 2 * x + (c & 1)];
+
+                    sum[0] += v.x;
+                    sum[1] += v.y;
+                    sum[2] += v.z;
+                    sum[3] += v.w;
+                }
+
+                dst[(z * r + y) * r + x] = DirectX::XMFLOAT4(sum[0] / 8.f, sum[1] / 8.f, sum[2] / 8.f, sum[3] / 8.f);
+            }
+
+            src = &dst;
+        }
+    }
+}
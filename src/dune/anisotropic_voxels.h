@@ -0,0 +1,101 @@
+/*
+ * Dune D3D library - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+/*! \file */
+
+#ifndef DUNE_ANISOTROPIC_VOXELS
+#define DUNE_ANISOTROPIC_VOXELS
+
+#include <vector>
+
+#include <DirectXMath.h>
+
+namespace dune
+{
+    /*!
+     * \brief A voxel volume with six directional mip chains.
+     *
+     * sparse_voxel_octree::filter() uses GenerateMips(), which averages 2x2x2 voxels. A wall one voxel thick
+     * thus becomes half transparent one mip level up, and cones traced through it leak light. Following
+     * [[Crassin et al. 2011]](http://dl.acm.org/citation.cfm?id=2071382), this class keeps one mip chain per
+     * direction of travel (+X, -X, +Y, -Y, +Z, -Z). To reduce 2x2x2 voxels for a direction, each pair of voxels
+     * along the axis is composited front to back with premultiplied alpha, and the four results are averaged.
+     *
+     * Voxels are RGBA with color premultiplied by opacity. Mip 0 is shared by all directions. filter() reduces
+     * slabs of each level in parallel with DirectXMath vector math; generate_mips() is the isotropic reference.
+     */
+    class anisotropic_voxels
+    {
+    public:
+        /*! \brief The direction of travel a mip chain is filtered for. */
+        enum direction
+        {
+            POS_X,
+            NEG_X,
+            POS_Y,
+            NEG_Y,
+            POS_Z,
+            NEG_Z
+        };
+
+    protected:
+        size_t                                          resolution_;
+        size_t                                          levels_;
+
+        std::vector<DirectX::XMFLOAT4>                  base_;
+        std::vector<std::vector<DirectX::XMFLOAT4>>     mips_[6];
+
+    public:
+        anisotropic_voxels();
+        virtual ~anisotropic_voxels() {}
+
+        /*! \brief Create a volume of resolution^3 empty voxels, where resolution is a power of two. */
+        void create(size_t resolution);
+        void destroy();
+
+        size_t resolution() const { return resolution_; }
+
+        /*! \brief Returns the number of mip levels, including mip 0 and the final 1x1x1 voxel. */
+        size_t num_mips() const { return levels_; }
+
+        //!@{
+        /*! \brief Returns the voxels of mip 0, x fastest, then y, then z. Call filter() after changing them. */
+        std::vector<DirectX::XMFLOAT4>& base() { return base_; }
+        const std::vector<DirectX::XMFLOAT4>& base() const { return base_; }
+        //!@}
+
+        /*! \brief Compute all directional mip chains from mip 0. */
+        void filter();
+
+        /*! \brief Returns the voxels of a mip level of the chain of a direction, which is base() for mip 0. */
+        const std::vector<DirectX::XMFLOAT4>& level(direction d, size_t mip) const;
+
+        /*! \brief Returns a voxel of a mip level, or zero outside of the volume. */
+        DirectX::XMFLOAT4 get(direction d, size_t mip, int x, int y, int z) const;
+
+        /*!
+         * \brief Trilinearly sample the volume for a direction of travel.
+         *
+         * The three chains facing the direction are blended by the squared components of the direction.
+         *
+         * \param p A position in [0,1]^3.
+         * \param dir A normalized direction.
+         * \param mip A fractional mip level, clamped to the range of the volume.
+         */
+        DirectX::XMFLOAT4 sample(const DirectX::XMFLOAT3& p, const DirectX::XMFLOAT3& dir, float mip) const;
+    };
+
+    /*!
+     * \brief The isotropic box filter of GenerateMips() as a reference.
+     *
+     * \param base The voxels of mip 0.
+     * \param resolution The number of voxels of mip 0 along each axis, a power of two.
+     * \param mips The mip levels from 1 down to 1x1x1.
+     */
+    void generate_mips(const std::vector<DirectX::XMFLOAT4>& base, size_t resolution, std::vector<std::vector<DirectX::XMFLOAT4>>& mips);
+}
+
+#endif
@@ -20,6 +20,8 @@
 #include "texture_cache.h"
 #include "common_tools.h"
 #include "exception.h"
+#include "frame_profiler.h"
+#include "voxelizer.h"
 
 namespace dune
 {
@@ -100,6 +102,8 @@ namespace dune
 
     void assimp_mesh::load(const tstring& file)
     {
+        DUNE_PROFILE_ZONE("Load mesh");
+
         std::string name = to_string(make_absolute_path(file));
         tclog << L"Loading: " << file << std::endl;
 
@@ -231,33 +235,62 @@ namespace dune
 
     void gilga_mesh::prepare_context(ID3D11DeviceContext* context)
     {
-        context->VSSetShader(vs_, nullptr, 0);
-        context->GSSetShader(nullptr, nullptr, 0);
-        context->PSSetShader(ps_, nullptr, 0);
-
-        ss_.to_ps(context, 0);
-
-        context->OMSetBlendState(nullptr, nullptr, 0xFF);
+        state_.begin(context);
+        prepare_context(state_);
     }
 
     void gilga_mesh::render(ID3D11DeviceContext* context, DirectX::XMFLOAT4X4* to_clip)
     {
-        prepare_context(context);
-        render_direct(context, to_clip);
+        state_.begin(context);
+        render(state_, to_clip);
     }
 
     void gilga_mesh::render_direct(ID3D11DeviceContext* context, DirectX::XMFLOAT4X4* to_clip)
     {
+        state_.begin(context);
+        render_direct(state_, to_clip);
+    }
+
+    void gilga_mesh::prepare_context(state_cache& state)
+    {
+        state.set_vs(vs_);
+        state.set_gs(nullptr);
+        state.set_ps(ps_);
+
+        state.set_samplers(STAGE_PS, 0, 1, &ss_.state);
+
+        state.set_blend_state(nullptr, nullptr, 0xFF);
+    }
+
+    void gilga_mesh::render(state_cache& state, DirectX::XMFLOAT4X4* to_clip)
+    {
+        prepare_context(state);
+        render_direct(state, to_clip);
+    }
+
+    void gilga_mesh::render_direct(state_cache& state, DirectX::XMFLOAT4X4* to_clip)
+    {
+        ID3D11DeviceContext* context = state.context();
+
         assert(context);
-        context->IASetInputLayout(vertex_layout_);
-        context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+        state.set_input_layout(vertex_layout_);
+        state.set_topology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
-        auto cbvs = &cb_mesh_data_vs_.data();
+        mesh_data_vs cbvs;
         {
-            DirectX::XMStoreFloat4x4(&cbvs->world,
+            DirectX::XMStoreFloat4x4(&cbvs.world,
                 DirectX::XMLoadFloat4x4(&world()));
         }
-        cb_mesh_data_vs_.to_vs(context, 1);
+
+        upload_range range;
+
+        if (constants_ && constants_->push(context, cbvs, range))
+            constants_->bind(state, STAGE_VS, 1, range);
+        else
+        {
+            cb_mesh_data_vs_.data() = cbvs;
+            cb_mesh_data_vs_.bind(state, STAGE_VS, 1);
+        }
 
         mesh_data* prev = nullptr;
 
@@ -290,39 +323,47 @@ namespace dune
                 const bool has_specular_tex = data->specular_tex != nullptr && specular_tex_slot_ != -1;
                 const bool has_alpha_tex = data->alpha_tex != nullptr && alpha_tex_slot_ != -1;
 
-                auto cbps = &cb_mesh_data_ps_.data();
+                mesh_data_ps cbps;
+                {
+                    cbps.diffuse_color = data->diffuse_color;
+                    cbps.specular_color = data->specular_color;
+                    cbps.emissive_color = data->emissive_color;
+                    cbps.has_diffuse_tex = has_diffuse_tex;
+                    cbps.has_normal_tex = has_normal_tex;
+                    cbps.has_specular_tex = has_specular_tex;
+                    cbps.has_alpha_tex = has_alpha_tex;
+                    cbps.shading_mode = data->shading_mode;
+                    cbps.roughness = data->roughness;
+                    cbps.refractive_index = data->refractive_index;
+                    cbps.pad = 0.f;
+                }
+
+                if (constants_ && constants_->push(context, cbps, range))
+                    constants_->bind(state, STAGE_PS, 0, range);
+                else
                 {
-                    cbps->diffuse_color = data->diffuse_color;
-                    cbps->specular_color = data->specular_color;
-                    cbps->emissive_color = data->emissive_color;
-                    cbps->has_diffuse_tex = has_diffuse_tex;
-                    cbps->has_normal_tex = has_normal_tex;
-                    cbps->has_specular_tex = has_specular_tex;
-                    cbps->has_alpha_tex = has_alpha_tex;
-                    cbps->shading_mode = data->shading_mode;
-                    cbps->roughness = data->roughness;
-                    cbps->refractive_index = data->refractive_index;
+                    cb_mesh_data_ps_.data() = cbps;
+                    cb_mesh_data_ps_.bind(state, STAGE_PS, 0);
                 }
-                cb_mesh_data_ps_.to_ps(context, 0);
 
                 if (has_diffuse_tex)
-                    context->PSSetShaderResources(diffuse_tex_slot_, 1, &data->diffuse_tex);
+                    state.set_resources(STAGE_PS, diffuse_tex_slot_, 1, &data->diffuse_tex);
 
                 if (has_normal_tex)
-                    context->PSSetShaderResources(normal_tex_slot_, 1, &data->normal_tex);
+                    state.set_resources(STAGE_PS, normal_tex_slot_, 1, &data->normal_tex);
 
                 if (has_specular_tex)
-                    context->PSSetShaderResources(specular_tex_slot_, 1, &data->specular_tex);
+                    state.set_resources(STAGE_PS, specular_tex_slot_, 1, &data->specular_tex);
 
                 if (has_alpha_tex)
-                    context->PSSetShaderResources(alpha_tex_slot_, 1, &data->alpha_tex);
+                    state.set_resources(STAGE_PS, alpha_tex_slot_, 1, &data->alpha_tex);
             }
 
-            context->IASetIndexBuffer(data->index, DXGI_FORMAT_R32_UINT, 0);
+            state.set_index_buffer(data->index, DXGI_FORMAT_R32_UINT, 0);
 
             static const UINT stride = sizeof(gilga_vertex);
             static const UINT offset = 0;
-            context->IASetVertexBuffers(0, 1, &data->vertex, &stride, &offset);
+            state.set_vertex_buffers(0, 1, &data->vertex, &stride, &offset);
 
             context->DrawIndexed(info->num_faces * 3, 0, 0);
 
@@ -333,7 +374,9 @@ namespace dune
     gilga_mesh::gilga_mesh() :
         cb_mesh_data_ps_(),
         cb_mesh_data_vs_(),
+        constants_(nullptr),
         ss_(),
+        state_(),
         alpha_tex_slot_(-1),
         vertices_(),
         meshes_()
@@ -495,6 +538,35 @@ namespace dune
         importer_.FreeScene();
     }
 
+    void gilga_mesh::voxel_triangles(std::vector<voxel_triangle>& triangles)
+    {
+        DirectX::XMMATRIX w = DirectX::XMLoadFloat4x4(&world());
+
+        for (auto i = mesh_infos_.begin(); i != mesh_infos_.end(); ++i)
+        {
+            aiMaterial* mat = assimp_scene()->mMaterials[i->material_index];
+
+            aiColor4D color(0.f, 0.f, 0.f, 0.f);
+            mat->Get(AI_MATKEY_COLOR_DIFFUSE, color);
+
+            for (size_t f = 0; f < i->num_faces; ++f)
+            {
+                voxel_triangle t;
+                t.albedo = DirectX::XMFLOAT3(color.r, color.g, color.b);
+
+                for (size_t k = 0; k < 3; ++k)
+                {
+                    const gilga_vertex& v = vertices_[i->vstart_index + indices_[i->istart_index + f * 3 + k]];
+
+                    DirectX::XMStoreFloat3(&t.position[k], DirectX::XMVector3TransformCoord(DirectX::XMLoadFloat3(&v.position), w));
+                    DirectX::XMStoreFloat3(&t.normal[k], DirectX::XMVector3Normalize(DirectX::XMVector3TransformNormal(DirectX::XMLoadFloat3(&v.normal), w)));
+                }
+
+                triangles.push_back(t);
+            }
+        }
+    }
+
     void gilga_mesh::destroy()
     {
         assimp_mesh::destroy();
@@ -506,6 +578,7 @@ namespace dune
         }
 
         ss_.destroy();
+        state_.destroy();
 
         cb_mesh_data_vs_.destroy();
         cb_mesh_data_ps_.destroy();
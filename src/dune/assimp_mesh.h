@@ -18,6 +18,12 @@
 
 #include "mesh.h"
 #include "cbuffer.h"
+#include "constant_ring.h"
+
+namespace dune
+{
+    struct voxel_triangle;
+}
 
 namespace dune
 {
@@ -174,8 +180,10 @@ namespace dune
     protected:
         cbuffer<mesh_data_ps> cb_mesh_data_ps_;
         cbuffer<mesh_data_vs> cb_mesh_data_vs_;
+        constant_ring* constants_;
 
         sampler_state ss_;
+        state_cache state_;
 
         INT alpha_tex_slot_;
 
@@ -201,6 +209,16 @@ namespace dune
         /*! \brief Render the gilga_mesh without touching the current state, which is useful if the shader has been set externally. */
         void render_direct(ID3D11DeviceContext* context, DirectX::XMFLOAT4X4* to_clip);
 
+        //!@{
+        /*! \brief Same as above, but skipping state that is already bound in a state_cache shared with other meshes. */
+        void render(state_cache& state, DirectX::XMFLOAT4X4* to_clip = nullptr);
+        void prepare_context(state_cache& state);
+        void render_direct(state_cache& state, DirectX::XMFLOAT4X4* to_clip);
+        //!@}
+
+        /*! \brief Append all triangles in world space with the diffuse color of their material to a list for a CPU voxelizer. */
+        void voxel_triangles(std::vector<voxel_triangle>& triangles);
+
         /*!
          * \brief Set the texture register for alpha textures.
          *
@@ -213,6 +231,19 @@ namespace dune
         {
             alpha_tex_slot_ = alpha_tex;
         }
+
+        /*!
+         * \brief Set a constant_ring for the per-draw constants of the mesh.
+         *
+         * Instead of mapping its own constant buffers for every draw, the mesh then appends
+         * its constants to the ring. If the ring is not supported, the constant buffers are used.
+         *
+         * \param constants The ring, which must outlive the mesh, or nullptr to use the constant buffers.
+         */
+        void set_constant_ring(constant_ring* constants)
+        {
+            constants_ = constants;
+        }
     };
 }
 
@@ -9,7 +9,9 @@
 #ifndef DUNE_CONSTANT_BUFFER
 #define DUNE_CONSTANT_BUFFER
 
+#include "constant_upload.h"
 #include "shader_resource.h"
+#include "state_cache.h"
 #include "d3d_tools.h"
 
 namespace dune
@@ -22,22 +24,19 @@ namespace dune
      * accessed and modified. A call to the member update() will copy the local version into
      * the mapped resource. Every call to upload the constant buffer to a shader will automatically
      * update it first.
+     *
+     * Modifying the local copy through data() marks it as changed, and the buffer is only mapped
+     * by the first update() after a change. Binding the same constants to several stages therefore
+     * maps the buffer once.
      */
     template<typename T>
-    class cbuffer : public shader_resource
+    class cbuffer : public shader_resource, public upload_target
     {
     protected:
         ID3D11Buffer* cb_;
         ID3D11DeviceContext* context_;
         D3D11_MAPPED_SUBRESOURCE mapped_res_;
-        T local_;
-
-        T* map(ID3D11DeviceContext* context)
-        {
-            context_ = context;
-            context_->Map(cb_, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped_res_);
-            return reinterpret_cast<T*>(mapped_res_.pData);
-        }
+        tracked_constants<T> local_;
 
         void unmap()
         {
@@ -54,20 +53,26 @@ namespace dune
             context_(nullptr)
         {
             ZeroMemory(&mapped_res_, sizeof(D3D11_MAPPED_SUBRESOURCE));
-            ZeroMemory(&local_, sizeof(T));
         }
 
         virtual ~cbuffer() {}
 
+        /*! \brief Returns a reference to the local copy of the constant buffer and marks it as changed. */
         T& data()
         {
-            return local_;
+            return local_.data();
         }
 
         /*! \brief Returns a reference to the local copy of the constant buffer. */
         const T& data() const
         {
-            return local_;
+            return local_.data();
+        }
+
+        /*! \brief Returns true if the local copy changed since the last update(). */
+        bool dirty() const
+        {
+            return local_.dirty();
         }
 
         void create(ID3D11Device* device)
@@ -81,39 +86,59 @@ namespace dune
 
             cbd.ByteWidth = sizeof(T);
             assert_hr(device->CreateBuffer(&cbd, nullptr, &cb_));
+
+            local_.invalidate();
         }
 
         void to_vs(ID3D11DeviceContext* context, UINT start_slot)
         {
             update(context);
-            context_->VSSetConstantBuffers(start_slot, 1, &cb_);
+            context->VSSetConstantBuffers(start_slot, 1, &cb_);
         }
 
         void to_gs(ID3D11DeviceContext* context, UINT start_slot)
         {
             update(context);
-            context_->GSSetConstantBuffers(start_slot, 1, &cb_);
+            context->GSSetConstantBuffers(start_slot, 1, &cb_);
         }
 
         void to_ps(ID3D11DeviceContext* context, UINT start_slot)
         {
             update(context);
-            context_->PSSetConstantBuffers(start_slot, 1, &cb_);
+            context->PSSetConstantBuffers(start_slot, 1, &cb_);
         }
 
         void to_cs(ID3D11DeviceContext* context, UINT start_slot)
         {
             update(context);
-            context_->CSSetConstantBuffers(start_slot, 1, &cb_);
+            context->CSSetConstantBuffers(start_slot, 1, &cb_);
+        }
+
+        /*! \brief Update the buffer and bind it to register slot of a stage through a state_cache. */
+        void bind(state_cache& state, shader_stage stage, UINT slot)
+        {
+            update(state.context());
+            state.set_constants(stage, slot, 1, &cb_);
         }
 
-        /*! \brief Copy over the local buffer into the mapped resource. */
+        /*! \brief Copy over the local buffer into the mapped resource if it changed since the last update. */
         void update(ID3D11DeviceContext* context)
         {
-            T* mapped = map(context);
-            {
-                *mapped = local_;
-            }
+            context_ = context;
+            local_.upload(*this);
+        }
+
+        // a dynamic constant buffer can only be mapped with WRITE_DISCARD before D3D11.1
+        virtual void* begin_upload(bool discard)
+        {
+            if (FAILED(context_->Map(cb_, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped_res_)))
+                return nullptr;
+
+            return mapped_res_.pData;
+        }
+
+        virtual void end_upload()
+        {
             unmap();
         }
 
@@ -128,7 +153,7 @@ namespace dune
             cb_ = nullptr;
             context_ = nullptr;
             ZeroMemory(&mapped_res_, sizeof(D3D11_MAPPED_SUBRESOURCE));
-            ZeroMemory(&local_, sizeof(T));
+            local_.clear();
         }
     };
 }
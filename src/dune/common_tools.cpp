@@ -11,7 +11,12 @@
 #include <codecvt>
 #include <locale>
 
+#ifdef _WIN32
 #include <Windows.h>
+#else
+#include <climits>
+#include <unistd.h>
+#endif
 
 namespace dune
 {
@@ -21,11 +26,35 @@ namespace dune
 
         if (arg != L"")
         {
+#ifdef _WIN32
             int argsc;
             LPWSTR *args = CommandLineToArgvW(arg.c_str(), &argsc);
 
             for (int i = 0; i < argsc; ++i)
                 files.push_back(dune::make_absolute_path(args[i]));
+#else
+            // split at spaces outside of double quotes
+            tstring current;
+            bool quoted = false;
+
+            for (auto c = arg.begin(); c != arg.end(); ++c)
+            {
+                if (*c == L'"')
+                    quoted = !quoted;
+                else if (*c == L' ' && !quoted)
+                {
+                    if (!current.empty())
+                        files.push_back(dune::make_absolute_path(current));
+
+                    current.clear();
+                }
+                else
+                    current += *c;
+            }
+
+            if (!current.empty())
+                files.push_back(dune::make_absolute_path(current));
+#endif
         }
 
         if (files.empty() && default_file != L"")
@@ -46,6 +75,11 @@ namespace dune
 
     bool path_is_relative(const tstring& p)
     {
+#ifndef _WIN32
+        if (!p.empty() && p[0] == L'/')
+            return false;
+#endif
+
         return (p.find(L":\\") == tstring::npos) &&
                (p.find(L":/")  == tstring::npos);
     }
@@ -53,6 +87,7 @@ namespace dune
     tstring absolute_path()
     {
         // get executable path
+#ifdef _WIN32
         const size_t s = 512;
         TCHAR path[s];
         if (GetModuleFileName(nullptr, path, s) == ERROR_INSUFFICIENT_BUFFER)
@@ -62,6 +97,18 @@ namespace dune
         }
 
         return extract_path(path);
+#else
+        char path[PATH_MAX];
+        ssize_t length = readlink("/proc/self/exe", path, sizeof(path) - 1);
+
+        if (length <= 0)
+        {
+            tcerr << L"Failed to determine execution path" << std::endl;
+            return L"";
+        }
+
+        return extract_path(to_tstring(std::string(path, length)));
+#endif
     }
 
     tstring make_absolute_path(const tstring& relative_filename)
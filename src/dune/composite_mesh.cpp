@@ -8,6 +8,7 @@
 
 #include <algorithm>
 
+#include "assimp_mesh.h"
 #include "d3d_tools.h"
 #include "unicode.h"
 #include "exception.h"
@@ -79,13 +80,28 @@ namespace dune
 
     void composite_mesh::render(ID3D11DeviceContext* context, DirectX::XMFLOAT4X4* to_clip)
     {
-        std::for_each(meshes_.begin(), meshes_.end(), [&](mesh_ptr& m){ m->render(context, to_clip); });
+        state_.begin(context);
+
+        for (auto m = meshes_.begin(); m != meshes_.end(); ++m)
+        {
+            gilga_mesh* g = dynamic_cast<gilga_mesh*>(m->get());
+
+            if (g)
+                g->render(state_, to_clip);
+            else
+            {
+                (*m)->render(context, to_clip);
+                state_.invalidate();
+            }
+        }
     }
 
     void composite_mesh::destroy()
     {
         d3d_mesh::destroy();
 
+        state_.destroy();
+
         std::for_each(meshes_.begin(), meshes_.end(), [&](mesh_ptr& m){ m->destroy(); });
         meshes_.clear();
     }
@@ -10,6 +10,7 @@
 #define DUNE_COMPOSITE_MESH
 
 #include "mesh.h"
+#include "state_cache.h"
 
 #include <memory>
 #include <vector>
@@ -24,12 +25,16 @@ namespace dune
      * for many loaded meshes.
      *
      * This is not a scenegraph node!
+     *
+     * Submeshes which are gilga_mesh objects share a state_cache while rendering, so that state
+     * they have in common, e.g. shaders and samplers, is only bound once.
      */
     class composite_mesh : public d3d_mesh
     {
     protected:
         typedef std::shared_ptr<d3d_mesh> mesh_ptr;
         std::vector<mesh_ptr> meshes_;
+        state_cache state_;
 
     public:
         size_t num_vertices();
@@ -0,0 +1,562 @@
+/*
+ * Dune D3D library - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+#include "cone_tracer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include <DirectXPackedVector.h>
+
+#include "anisotropic_voxels.h"
+#include "gi_snapshot.h"
+#include "parallel_tools.h"
+
+namespace dune
+{
+    namespace detail
+    {
+        const float CONE_PI = 3.14159265358f;
+
+        // simple_noise() of tools.hlsl
+        inline float simple_noise(float x, float y)
+        {
+            float s = std::sin(x * 12.9898f + y * 78.233f) * 43758.5453f;
+            return s - std::floor(s);
+        }
+
+        inline float saturate(float x)
+        {
+            return std::min(std::max(x, 0.f), 1.f);
+        }
+
+        inline float F_schlick(float f0, float LoH)
+        {
+            return f0 + (1.f - f0) * std::pow(1.f - LoH, 5.f);
+        }
+
+        /*
+         * brdf() of brdf.hlsl for a white diffuse and specular color. At roughness 0, D_ggx() is 0/0 for H = N,
+         * which is exactly where specular_from_vct() evaluates it. On the GPU, rounding leaves NoH just below one
+         * for almost every pixel and the term vanishes, so it is dropped here.
+         */
+        inline float brdf(DirectX::FXMVECTOR L, DirectX::FXMVECTOR V, DirectX::FXMVECTOR N, float cdiff, float cspec, float roughness)
+        {
+            const float alpha = roughness * roughness;
+
+            DirectX::XMVECTOR H = DirectX::XMVector3Normalize(DirectX::XMVectorAdd(L, V));
+
+            const float NoL = DirectX::XMVectorGetX(DirectX::XMVector3Dot(N, L));
+            const float NoV = DirectX::XMVectorGetX(DirectX::XMVector3Dot(N, V));
+            const float NoH = DirectX::XMVectorGetX(DirectX::XMVector3Dot(N, H));
+            const float LoH = DirectX::XMVectorGetX(DirectX::XMVector3Dot(L, H));
+
+            const float n = 1.5f;
+            const float f0 = ((1.f - n) / (1.f + n)) * ((1.f - n) / (1.f + n));
+
+            float Rs = 0.f;
+
+            if (cspec != 0.f)
+            {
+                const float F = F_schlick(f0, LoH);
+
+                const float k = alpha / 2.f;
+                const float G = NoV / (NoV * (1.f - k) + k);
+
+                const float d = NoH * NoH * (alpha * alpha - 1.f) + 1.f;
+                const float D = d != 0.f ? (1.f / CONE_PI) * (alpha / d) * (alpha / d) : 0.f;
+
+                const float denom = 4.f * NoL * NoV;
+
+                if (denom != 0.f && std::isfinite(G))
+                    Rs = cspec / CONE_PI * (F * G * D) / denom;
+            }
+
+            const float Rd = cdiff / CONE_PI * (1.f - F_schlick(f0, NoL));
+
+            return Rd + Rs;
+        }
+
+        // intersect() of vct_tools.hlsl with the unit cube of the volume
+        inline bool intersect(const float P[3], const float V[3], float t0, float t1)
+        {
+            float tmin = -std::numeric_limits<float>::max();
+            float tmax = std::numeric_limits<float>::max();
+
+            for (size_t a = 0; a < 3; ++a)
+            {
+                float lo = (0.f - P[a]) / V[a];
+                float hi = (1.f - P[a]) / V[a];
+
+                if (V[a] < 0.f)
+                    std::swap(lo, hi);
+
+                if (tmin > hi || lo > tmax)
+                    return false;
+
+                tmin = std::max(tmin, lo);
+                tmax = std::min(tmax, hi);
+            }
+
+            return tmin < t1 && tmax > t0;
+        }
+    }
+
+    void gbuffer_image::create(size_t w, size_t h)
+    {
+        width = w;
+        height = h;
+
+        gbuffer_texel empty = {};
+
+        texels.assign(w * h, empty);
+    }
+
+    cone_tracer::cone_tracer() :
+        resolution_(0),
+        levels_(0),
+        parameters_(),
+        distances_(),
+        mips_()
+    {
+        DirectX::XMStoreFloat4x4(&world_to_volume_, DirectX::XMMatrixIdentity());
+    }
+
+    void cone_tracer::create(size_t resolution)
+    {
+        destroy();
+
+        assert(resolution > 1 && (resolution & (resolution - 1)) == 0);
+
+        resolution_ = resolution;
+
+        for (size_t r = resolution; r > 1; r /= 2)
+            ++levels_;
+
+        mips_.resize(1);
+        mips_[0].assign(resolution * resolution * resolution, DirectX::XMFLOAT4(0.f, 0.f, 0.f, 0.f));
+
+        distances_.create(resolution);
+    }
+
+    void cone_tracer::destroy()
+    {
+        resolution_ = 0;
+        levels_ = 0;
+
+        mips_.clear();
+        distances_.destroy();
+    }
+
+    void cone_tracer::set_model_matrix(const DirectX::XMFLOAT4X4& model, const DirectX::XMFLOAT3& volume_min, const DirectX::XMFLOAT3& volume_max)
+    {
+        DirectX::XMMATRIX model_inv = DirectX::XMMatrixInverse(nullptr, DirectX::XMLoadFloat4x4(&model));
+
+        DirectX::XMMATRIX trans = DirectX::XMMatrixTranslation(-volume_min.x, -volume_min.y, -volume_min.z);
+        DirectX::XMMATRIX scale = DirectX::XMMatrixScaling(1.f / (volume_max.x - volume_min.x),
+                                                           1.f / (volume_max.y - volume_min.y),
+                                                           1.f / (volume_max.z - volume_min.z));
+
+        DirectX::XMStoreFloat4x4(&world_to_volume_, model_inv * trans * scale);
+    }
+
+    void cone_tracer::set_volume(const std::vector<DirectX::XMFLOAT4>& voxels)
+    {
+        assert(voxels.size() == resolution_ * resolution_ * resolution_);
+
+        std::vector<std::vector<DirectX::XMFLOAT4>> mips;
+        generate_mips(voxels, resolution_, mips);
+
+        // GenerateMips() stops at 2x2x2 for a texture with log2(resolution) levels
+        mips.resize(levels_ - 1);
+        mips.insert(mips.begin(), voxels);
+
+        mips_.swap(mips);
+
+        distances_.build(mips_[0]);
+    }
+
+    bool cone_tracer::load_snapshot(const gi_snapshot& snapshot)
+    {
+        const snapshot_volume* normal = snapshot.find("svo.normal");
+        const snapshot_volume* rho = snapshot.find("svo.rho");
+
+        for (const snapshot_volume* v : { normal, rho })
+            if (!v || v->texel_size != 8 || v->width != resolution_ || v->height != resolution_ || v->depth != resolution_)
+                return false;
+
+        std::vector<DirectX::XMFLOAT4> voxels(resolution_ * resolution_ * resolution_);
+
+        parallel_for(0, voxels.size(), [&](size_t first, size_t last)
+        {
+            for (size_t i = first; i < last; ++i)
+            {
+                DirectX::PackedVector::XMHALF4 n, c;
+                std::memcpy(&n, &normal->data[i * 8], 8);
+                std::memcpy(&c, &rho->data[i * 8], 8);
+
+                DirectX::XMVECTOR bounce = DirectX::PackedVector::XMLoadHalf4(&c);
+                DirectX::XMVECTOR occlusion = DirectX::PackedVector::XMLoadHalf4(&n);
+
+                DirectX::XMStoreFloat4(&voxels[i], DirectX::XMVectorSetW(bounce, DirectX::XMVectorGetW(occlusion)));
+            }
+        });
+
+        set_volume(voxels);
+
+        return true;
+    }
+
+    DirectX::XMVECTOR XM_CALLCONV cone_tracer::fetch(size_t mip, int x, int y, int z) const
+    {
+        const int r = static_cast<int>(resolution_ >> mip);
+
+        if (x < 0 || y < 0 || z < 0 || x >= r || y >= r || z >= r)
+            return DirectX::XMVectorZero();
+
+        return DirectX::XMLoadFloat4(&mips_[mip][(static_cast<size_t>(z) * r + y) * r + x]);
+    }
+
+    DirectX::XMVECTOR XM_CALLCONV cone_tracer::lookup(DirectX::FXMVECTOR p, float mip) const
+    {
+        mip = std::min(std::max(mip, 0.f), static_cast<float>(levels_ - 1));
+
+        const size_t m0 = static_cast<size_t>(mip);
+        const size_t m1 = std::min(m0 + 1, levels_ - 1);
+        const float mf = mip - m0;
+
+        DirectX::XMFLOAT3 pos;
+        DirectX::XMStoreFloat3(&pos, p);
+
+        DirectX::XMVECTOR result = DirectX::XMVectorZero();
+
+        for (size_t m = m0; m <= m1; ++m)
+        {
+            const float wm = m0 == m1 ? 1.f : (m == m0 ? 1.f - mf : mf);
+
+            if (wm <= 0.f)
+                continue;
+
+            const float r = static_cast<float>(resolution_ >> m);
+
+            const float u[3] = { pos.x * r - 0.5f, pos.y * r - 0.5f, pos.z * r - 0.5f };
+            const float fl[3] = { std::floor(u[0]), std::floor(u[1]), std::floor(u[2]) };
+            const float f[3] = { u[0] - fl[0], u[1] - fl[1], u[2] - fl[2] };
+            const int i[3] = { static_cast<int>(fl[0]), static_cast<int>(fl[1]), static_cast<int>(fl[2]) };
+
+            for (int c = 0; c < 8; ++c)
+            {
+                const float w = wm * ((c & 1) ? f[0] : 1.f - f[0]) * ((c & 2) ? f[1] : 1.f - f[1]) * ((c & 4) ? f[2] : 1.f - f[2]);
+
+                result = DirectX::XMVectorMultiplyAdd(fetch(m, i[0] + (c & 1), i[1] + ((c >> 1) & 1), i[2] + ((c >> 2) & 1)),
+                                                      DirectX::XMVectorReplicate(w), result);
+            }
+        }
+
+        return result;
+    }
+
+    DirectX::XMFLOAT4 cone_tracer::sample(const DirectX::XMFLOAT3& p, float mip) const
+    {
+        DirectX::XMFLOAT4 out(0.f, 0.f, 0.f, 0.f);
+
+        if (levels_ > 0)
+            DirectX::XMStoreFloat4(&out, lookup(DirectX::XMLoadFloat3(&p), mip));
+
+        return out;
+    }
+
+    float cone_tracer::reach(float dist, float cone_ratio) const
+    {
+        const float min_voxel_diameter = 0.5f / static_cast<float>(resolution_);
+        const float sample_diameter = std::max(min_voxel_diameter, cone_ratio * dist);
+
+        // the texels of the coarser of both mip levels with a weight, which are at most 1.5 texels away along each axis
+        const size_t mip = std::min(static_cast<size_t>(std::ilogb(sample_diameter / min_voxel_diameter)) + 1, levels_ - 1);
+
+        return 1.5f * 1.7320508f * static_cast<float>(static_cast<size_t>(1) << mip);
+    }
+
+    float cone_tracer::skip_distance(const DirectX::XMFLOAT3& p, float dist, float cone_ratio, float voxels_per_dist) const
+    {
+        const float clearance = distances_.clearance(p);
+        const float reach_now = reach(dist, cone_ratio);
+
+        // a sample here may read an occupied voxel
+        if (clearance <= reach_now)
+            return -1.f;
+
+        // the reach grows along the cone, so bound it at the end of the skip and shorten the skip accordingly
+        const float skip = (clearance - reach_now) / voxels_per_dist;
+
+        return std::max((clearance - reach(dist + skip, cone_ratio)) / voxels_per_dist, 0.f);
+    }
+
+    DirectX::XMVECTOR XM_CALLCONV cone_tracer::trace_cone(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR dir, float cone_ratio, float max_dist, float bias, cone_trace_stats& stats) const
+    {
+        DirectX::XMFLOAT3 o, d;
+        DirectX::XMStoreFloat3(&o, origin);
+        DirectX::XMStoreFloat3(&d, dir);
+
+        const float of[3] = { o.x, o.y, o.z };
+        const float df[3] = { d.x, d.y, d.z };
+
+        if (!detail::intersect(of, df, 0.f, 1.f))
+            return DirectX::XMVectorZero();
+
+        // minimum diameter is half the sample size to avoid hitting empty space
+        const float min_voxel_diameter = 0.5f / static_cast<float>(resolution_);
+        const float min_voxel_diameter_inv = 1.f / min_voxel_diameter;
+
+        const float noise = detail::simple_noise(o.x, o.z);
+        const float voxels_per_dist = DirectX::XMVectorGetX(DirectX::XMVector3Length(dir)) * static_cast<float>(resolution_);
+
+        DirectX::XMVECTOR accum = DirectX::XMVectorZero();
+        float occlusion = 0.f;
+
+        // push out the starting point to avoid self-intersection
+        float dist = min_voxel_diameter * bias * cone_ratio;
+
+        bool entered_svo = false;
+
+        auto step_at = [&](float at)
+        {
+            const float sample_diameter = std::max(min_voxel_diameter, cone_ratio * at);
+            const float sample_lod = std::log2(sample_diameter * min_voxel_diameter_inv);
+
+            return sample_diameter * (1.f + noise * sample_lod * sample_diameter) * parameters_.step_scale;
+        };
+
+        while (dist < max_dist && occlusion < 0.05f / dist)
+        {
+            const float sample_diameter = std::max(min_voxel_diameter, cone_ratio * dist);
+            const float sample_lod = std::log2(sample_diameter * min_voxel_diameter_inv);
+
+            DirectX::XMVECTOR sample_pos = DirectX::XMVectorMultiplyAdd(dir, DirectX::XMVectorReplicate(dist), origin);
+
+            DirectX::XMFLOAT3 sp;
+            DirectX::XMStoreFloat3(&sp, sample_pos);
+
+            if (!(sp.x > 0.f && sp.y > 0.f && sp.z > 0.f && sp.x < 1.f && sp.y < 1.f && sp.z < 1.f))
+            {
+                if (entered_svo)
+                    break;
+            }
+            else
+                entered_svo = true;
+
+            const float step = step_at(dist);
+
+            // a zero sample is not taken, and all samples up to the clearance of this position would be zero as well
+            if (entered_svo && parameters_.skip_empty_space)
+            {
+                const float skip = skip_distance(sp, dist, cone_ratio, voxels_per_dist);
+
+                if (skip >= 0.f)
+                {
+                    // land on the last position of the regular step sequence within the clearance, so that
+                    // skipping takes the same samples as marching
+                    const float end = dist + skip;
+
+                    dist += step;
+
+                    while (dist < max_dist && occlusion < 0.05f / dist)
+                    {
+                        const float next = step_at(dist);
+
+                        if (dist + next > end)
+                            break;
+
+                        dist += next;
+                    }
+
+                    ++stats.skips;
+                    continue;
+                }
+            }
+
+            dist += step;
+
+            DirectX::XMVECTOR sample_value = lookup(sample_pos, sample_lod);
+
+            // correct the opacity of a sample for the length of the step, which is a no-op at a step scale of one
+            if (parameters_.step_scale != 1.f)
+            {
+                const float a = DirectX::XMVectorGetW(sample_value);
+
+                if (a > 0.f)
+                {
+                    const float corrected = 1.f - std::pow(std::max(1.f - a, 0.f), parameters_.step_scale);
+                    sample_value = DirectX::XMVectorScale(sample_value, corrected / a);
+                }
+            }
+
+            accum = DirectX::XMVectorMultiplyAdd(sample_value, DirectX::XMVectorReplicate(1.f - occlusion), accum);
+            occlusion = DirectX::XMVectorGetW(accum);
+
+            ++stats.steps;
+        }
+
+        return accum;
+    }
+
+    DirectX::XMVECTOR XM_CALLCONV cone_tracer::diffuse(float u, float v, DirectX::FXMVECTOR P, DirectX::FXMVECTOR N, DirectX::FXMVECTOR V, cone_trace_stats& stats) const
+    {
+        const DirectX::XMMATRIX world_to_volume = DirectX::XMLoadFloat4x4(&world_to_volume_);
+
+        DirectX::XMVECTOR vP = DirectX::XMVector3TransformCoord(P, world_to_volume);
+        DirectX::XMVECTOR vN = DirectX::XMVector3Normalize(DirectX::XMVector3TransformNormal(N, world_to_volume));
+
+        DirectX::XMVECTOR diffdir = DirectX::XMVector3Normalize(DirectX::XMVectorSwizzle<2, 0, 1, 3>(N));
+        DirectX::XMVECTOR crossdir = DirectX::XMVector3Cross(N, diffdir);
+        DirectX::XMVECTOR crossdir2 = DirectX::XMVector3Cross(N, crossdir);
+
+        // jitter cones
+        const float j = 1.f + detail::simple_noise(u, v) * 0.2f;
+
+        const DirectX::XMVECTOR c[9] =
+        {
+            DirectX::XMVectorZero(),
+            crossdir,
+            DirectX::XMVectorNegate(crossdir),
+            crossdir2,
+            DirectX::XMVectorNegate(crossdir2),
+            DirectX::XMVectorAdd(crossdir, crossdir2),
+            DirectX::XMVectorSubtract(crossdir, crossdir2),
+            DirectX::XMVectorSubtract(crossdir2, crossdir),
+            DirectX::XMVectorNegate(DirectX::XMVectorAdd(crossdir, crossdir2)),
+        };
+
+        const size_t num_d = std::min<size_t>(std::max<size_t>(parameters_.num_diffuse_cones, 1), 9);
+        const float bias_step = 1.f / static_cast<float>(resolution_);
+
+        DirectX::XMVECTOR result = DirectX::XMVectorZero();
+
+        for (size_t d = 0; d < num_d; ++d)
+        {
+            DirectX::XMVECTOR D = DirectX::XMVector3Normalize(DirectX::XMVectorMultiplyAdd(c[d], DirectX::XMVectorReplicate(j), N));
+            DirectX::XMVECTOR vD = DirectX::XMVector3Normalize(DirectX::XMVector3TransformNormal(D, world_to_volume));
+
+            // the shader moves the origin further away from the surface with every cone
+            vP = DirectX::XMVectorMultiplyAdd(vN, DirectX::XMVectorReplicate(bias_step), vP);
+
+            const float NdotL = detail::saturate(DirectX::XMVectorGetX(DirectX::XMVector3Dot(N, D)));
+            const float f = detail::brdf(D, V, N, 1.f, 0.f, 1.f);
+
+            DirectX::XMVECTOR cone = trace_cone(vP, vD, parameters_.diffuse_aperture, parameters_.diffuse_max_dist, parameters_.diffuse_bias, stats);
+            result = DirectX::XMVectorMultiplyAdd(cone, DirectX::XMVectorSet(NdotL * f, NdotL * f, NdotL * f, NdotL), result);
+        }
+
+        return DirectX::XMVectorScale(result, 4.f / static_cast<float>(num_d));
+    }
+
+    DirectX::XMVECTOR XM_CALLCONV cone_tracer::specular(DirectX::FXMVECTOR P, DirectX::FXMVECTOR N, DirectX::FXMVECTOR V, float cone_ratio, cone_trace_stats& stats) const
+    {
+        const DirectX::XMMATRIX world_to_volume = DirectX::XMLoadFloat4x4(&world_to_volume_);
+
+        DirectX::XMVECTOR R = DirectX::XMVector3Reflect(DirectX::XMVectorNegate(V), N);
+
+        DirectX::XMVECTOR vP = DirectX::XMVector3TransformCoord(P, world_to_volume);
+        DirectX::XMVECTOR vR = DirectX::XMVector3TransformNormal(R, world_to_volume);
+        DirectX::XMVECTOR vN = DirectX::XMVector3Normalize(DirectX::XMVector3TransformNormal(N, world_to_volume));
+
+        // bias a bit to avoid self intersection
+        vP = DirectX::XMVectorMultiplyAdd(vN, DirectX::XMVectorReplicate(4.f / static_cast<float>(resolution_)), vP);
+
+        const float NdotL = detail::saturate(DirectX::XMVectorGetX(DirectX::XMVector3Dot(N, R)));
+
+        // the shader takes steps twice as long along the reflection
+        DirectX::XMVECTOR vvR = DirectX::XMVectorScale(DirectX::XMVector3Normalize(vR), 2.f);
+
+        DirectX::XMVECTOR bounce = trace_cone(vP, vvR, cone_ratio, parameters_.specular_max_dist, 1.f, stats);
+
+        return DirectX::XMVectorScale(bounce, NdotL * detail::brdf(R, V, N, 1.f, 1.f, 0.f));
+    }
+
+    cone_trace_stats cone_tracer::render(const gbuffer_image& gbuffer, const DirectX::XMFLOAT3& camera_pos, float_image& image) const
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        image.create(gbuffer.width, gbuffer.height);
+
+        cone_trace_stats stats = { 0.0, 0, 0, 0, 0 };
+
+        if (levels_ == 0)
+            return stats;
+
+        const size_t tiles_x = (gbuffer.width + TILE_SIZE - 1) / TILE_SIZE;
+        const size_t tiles_y = (gbuffer.height + TILE_SIZE - 1) / TILE_SIZE;
+
+        const size_t num_d = std::min<size_t>(std::max<size_t>(parameters_.num_diffuse_cones, 1), 9);
+
+        std::vector<cone_trace_stats> worker_stats(num_workers(), stats);
+
+        // tiles have very different costs, so hand them out one by one
+        parallel_for_dynamic(0, tiles_x * tiles_y, 1, [&](size_t worker, size_t first, size_t last)
+        {
+            cone_trace_stats& ws = worker_stats[worker];
+
+            for (size_t t = first; t < last; ++t)
+            {
+                const size_t x0 = (t % tiles_x) * TILE_SIZE, y0 = (t / tiles_x) * TILE_SIZE;
+                const size_t x1 = std::min(x0 + TILE_SIZE, gbuffer.width), y1 = std::min(y0 + TILE_SIZE, gbuffer.height);
+
+                for (size_t y = y0; y < y1; ++y)
+                for (size_t x = x0; x < x1; ++x)
+                {
+                    const gbuffer_texel& gb = gbuffer(x, y);
+                    DirectX::XMFLOAT4& out = image(x, y);
+
+                    out = DirectX::XMFLOAT4(0.f, 0.f, 0.f, 1.f);
+
+                    DirectX::XMVECTOR N = DirectX::XMLoadFloat3(&gb.normal);
+
+                    // ignore parts with no normals
+                    if (DirectX::XMVector3Equal(N, DirectX::XMVectorZero()))
+                        continue;
+
+                    N = DirectX::XMVector3Normalize(N);
+
+                    DirectX::XMVECTOR P = DirectX::XMLoadFloat3(&gb.position);
+                    DirectX::XMVECTOR V = DirectX::XMVector3Normalize(DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&camera_pos), P));
+
+                    // have no gloss maps, roughness is simply inverse spec color/smoothness
+                    const float roughness = 1.f - gb.specular_albedo.x + parameters_.glossiness / 10.f;
+
+                    const float u = (x + 0.5f) / static_cast<float>(gbuffer.width);
+                    const float v = (y + 0.5f) / static_cast<float>(gbuffer.height);
+
+                    DirectX::XMVECTOR d = diffuse(u, v, P, N, V, ws);
+                    DirectX::XMVECTOR s = specular(P, N, V, roughness, ws);
+
+                    DirectX::XMVECTOR gi = DirectX::XMVectorAdd(DirectX::XMVectorMultiply(d, DirectX::XMLoadFloat3(&gb.diffuse_albedo)),
+                                                                DirectX::XMVectorMultiply(s, DirectX::XMLoadFloat3(&gb.specular_albedo)));
+
+                    DirectX::XMStoreFloat4(&out, DirectX::XMVectorSetW(gi, 1.f));
+
+                    ws.pixels++;
+                    ws.cones += num_d + 1;
+                }
+            }
+        });
+
+        for (auto w = worker_stats.begin(); w != worker_stats.end(); ++w)
+        {
+            stats.pixels += w->pixels;
+            stats.cones += w->cones;
+            stats.steps += w->steps;
+            stats.skips += w->skips;
+        }
+
+        stats.ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+        return stats;
+    }
+}
@@ -0,0 +1,205 @@
+/*
+ * Dune D3D library - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+/*! \file */
+
+#ifndef DUNE_CONE_TRACER
+#define DUNE_CONE_TRACER
+
+#include <vector>
+
+#include <DirectXMath.h>
+
+#include "distance_field.h"
+#include "ibl_tools.h"
+
+namespace dune
+{
+    class gi_snapshot;
+
+    /*! \brief A texel of a G-buffer in world space. A zero normal marks the background. */
+    struct gbuffer_texel
+    {
+        DirectX::XMFLOAT3 position;
+        DirectX::XMFLOAT3 normal;
+        DirectX::XMFLOAT3 diffuse_albedo;
+        DirectX::XMFLOAT3 specular_albedo;
+    };
+
+    /*! \brief A G-buffer on the CPU, the input of cone_tracer::render(). */
+    struct gbuffer_image
+    {
+        size_t width, height;
+        std::vector<gbuffer_texel> texels;
+
+        gbuffer_image() : width(0), height(0), texels() {}
+
+        void create(size_t w, size_t h);
+
+        gbuffer_texel& operator()(size_t x, size_t y)             { return texels[y*width + x]; }
+        const gbuffer_texel& operator()(size_t x, size_t y) const { return texels[y*width + x]; }
+    };
+
+    /*! \brief The parameters of the cones traced per pixel. The defaults are the constants of vct_tools.hlsl. */
+    struct cone_parameters
+    {
+        /*! \brief The number of diffuse cones, 1 (the normal), 5 or 9. */
+        size_t num_diffuse_cones;
+
+        /*! \brief The diameter to length ratio of the diffuse cones. */
+        float diffuse_aperture;
+
+        /*! \brief The maximum length of diffuse cones in volume space. */
+        float diffuse_max_dist;
+
+        /*! \brief The offset of the first sample of a diffuse cone in multiples of its first sample diameter. */
+        float diffuse_bias;
+
+        /*! \brief The maximum length of the specular cone in volume space. */
+        float specular_max_dist;
+
+        /*! \brief The glossiness of gi_renderer, added to the roughness for the aperture of the specular cone. */
+        float glossiness;
+
+        /*! \brief A factor on the distance between two samples of a cone. Opacity is corrected for it, the shader uses one. */
+        float step_scale;
+
+        /*! \brief If true, cones skip empty space with the distance field of the volume. */
+        bool skip_empty_space;
+
+        cone_parameters() :
+            num_diffuse_cones(9),
+            diffuse_aperture(0.6f),
+            diffuse_max_dist(2.f),
+            diffuse_bias(5.f),
+            specular_max_dist(11.f),
+            glossiness(0.f),
+            step_scale(1.f),
+            skip_empty_space(false)
+        {
+        }
+    };
+
+    /*! \brief Counters of a cone_tracer::render() call. */
+    struct cone_trace_stats
+    {
+        double ms;
+        size_t pixels;
+        size_t cones;
+
+        /*! \brief The number of samples taken. */
+        size_t steps;
+
+        /*! \brief The number of times a cone skipped empty space instead of taking a sample. */
+        size_t skips;
+    };
+
+    /*!
+     * \brief A CPU reference of the voxel cone tracing of deferred_vct.hlsl.
+     *
+     * The tracer holds the volumes of a sparse_voxel_octree, the bounce in v_rho and the occupancy in the alpha of
+     * v_normal, with the same number of box filtered mip levels as GenerateMips() creates. Cones are marched front
+     * to back like trace_cone() in vct_tools.hlsl: the sample diameter grows with the distance, selects a fractional
+     * mip level which is sampled quadrilinearly (trilinear in two levels, with a zero border like the SVOFilter
+     * sampler), and a cone terminates early once it is opaque enough.
+     *
+     * render() computes the indirect light of gi_from_vct() for every pixel of a G-buffer, which is what the
+     * renderer shows with debug_gi, before gi_scale. Tiles of TILE_SIZE^2 pixels are traced in parallel. The cone
+     * count and step size are parameters, so they can be tuned offline against a reference with many small steps.
+     *
+     * With skip_empty_space, a cone looks up the clearance of its position in a distance_field of the volume. If
+     * no voxel a sample there would read can be occupied, the sample is not taken, and the cone moves ahead to the
+     * last of its regular steps within the clearance minus the reach of the samples on the way, or by one step if
+     * that is longer. Skipping therefore takes the same samples as marching, only fewer of them.
+     */
+    class cone_tracer
+    {
+    public:
+        /*! \brief The edge length of the tiles of pixels traced by one worker at a time. */
+        static const size_t TILE_SIZE = 16;
+
+    protected:
+        size_t                                          resolution_;
+        size_t                                          levels_;
+        DirectX::XMFLOAT4X4                             world_to_volume_;
+        cone_parameters                                 parameters_;
+        distance_field                                  distances_;
+
+        // rgb is the bounce, alpha the occupancy; mips_[0] is the full resolution
+        std::vector<std::vector<DirectX::XMFLOAT4>>     mips_;
+
+    protected:
+        DirectX::XMVECTOR XM_CALLCONV fetch(size_t mip, int x, int y, int z) const;
+        DirectX::XMVECTOR XM_CALLCONV lookup(DirectX::FXMVECTOR p, float mip) const;
+
+        float reach(float dist, float cone_ratio) const;
+        float skip_distance(const DirectX::XMFLOAT3& p, float dist, float cone_ratio, float voxels_per_dist) const;
+
+        DirectX::XMVECTOR XM_CALLCONV trace_cone(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR dir, float cone_ratio, float max_dist, float bias, cone_trace_stats& stats) const;
+
+        DirectX::XMVECTOR XM_CALLCONV diffuse(float u, float v, DirectX::FXMVECTOR P, DirectX::FXMVECTOR N, DirectX::FXMVECTOR V, cone_trace_stats& stats) const;
+        DirectX::XMVECTOR XM_CALLCONV specular(DirectX::FXMVECTOR P, DirectX::FXMVECTOR N, DirectX::FXMVECTOR V, float cone_ratio, cone_trace_stats& stats) const;
+
+    public:
+        cone_tracer();
+        virtual ~cone_tracer() {}
+
+        /*! \brief Create a tracer for volumes of resolution^3 voxels, where resolution is a power of two. */
+        void create(size_t resolution);
+        void destroy();
+
+        size_t resolution() const { return resolution_; }
+
+        /*! \brief Returns the number of mip levels, log2(resolution) like the textures of sparse_voxel_octree. */
+        size_t num_mips() const { return levels_; }
+
+        /*! \brief Set the transformation of the volume, see sparse_voxel_octree::set_model_matrix(). */
+        void set_model_matrix(const DirectX::XMFLOAT4X4& model, const DirectX::XMFLOAT3& volume_min, const DirectX::XMFLOAT3& volume_max);
+
+        //!@{
+        /*! \brief Get/set the parameters of the cones. */
+        const cone_parameters& parameters() const { return parameters_; }
+        void set_parameters(const cone_parameters& parameters) { parameters_ = parameters; }
+        //!@}
+
+        /*!
+         * \brief Set the volume, filter its mip levels and compute its distance field.
+         *
+         * \param voxels resolution^3 voxels, x fastest, then y, then z, with the bounce in rgb and the occupancy in alpha.
+         */
+        void set_volume(const std::vector<DirectX::XMFLOAT4>& voxels);
+
+        /*!
+         * \brief Set the volume from the half float volumes of a snapshot of a sparse_voxel_octree.
+         *
+         * \return False if the snapshot has no SVO volumes of the resolution of the tracer.
+         */
+        bool load_snapshot(const gi_snapshot& snapshot);
+
+        /*! \brief Returns the distance field of the volume. */
+        const distance_field& distances() const { return distances_; }
+
+        /*!
+         * \brief Sample the volume like SampleLevel() with the SVOFilter sampler.
+         *
+         * \param p A position in volume space, i.e. [0,1]^3.
+         * \param mip A fractional mip level, clamped to the range of the volume.
+         */
+        DirectX::XMFLOAT4 sample(const DirectX::XMFLOAT3& p, float mip) const;
+
+        /*!
+         * \brief Trace the indirect light of every pixel of a G-buffer.
+         *
+         * \param gbuffer The G-buffer in world space.
+         * \param camera_pos The position of the camera in world space.
+         * \param image The indirect light of each pixel, with alpha set to one. Background pixels are zero.
+         * \return The time and the number of cones and samples traced.
+         */
+        cone_trace_stats render(const gbuffer_image& gbuffer, const DirectX::XMFLOAT3& camera_pos, float_image& image) const;
+    };
+}
+
+#endif
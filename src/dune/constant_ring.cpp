@@ -0,0 +1,155 @@
+/*
+ * Dune D3D library - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+#include "constant_ring.h"
+
+#include "d3d_tools.h"
+
+namespace dune
+{
+    constant_ring::constant_ring() :
+        buffer_(nullptr),
+        context_(nullptr),
+        context1_(nullptr),
+        ring_(),
+        supported_(false)
+    {
+        ZeroMemory(&mapped_res_, sizeof(D3D11_MAPPED_SUBRESOURCE));
+    }
+
+    void constant_ring::create(ID3D11Device* device, UINT size)
+    {
+        destroy();
+
+        D3D11_FEATURE_DATA_D3D11_OPTIONS options;
+        ZeroMemory(&options, sizeof(options));
+
+        supported_ = SUCCEEDED(device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options))) &&
+                     options.ConstantBufferOffsetting &&
+                     options.MapNoOverwriteOnDynamicConstantBuffer;
+
+        if (!supported_)
+            return;
+
+        D3D11_BUFFER_DESC bd;
+        bd.Usage = D3D11_USAGE_DYNAMIC;
+        bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+        bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+        bd.MiscFlags = 0;
+        bd.StructureByteStride = 0;
+        bd.ByteWidth = (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+
+        assert_hr(device->CreateBuffer(&bd, nullptr, &buffer_));
+
+        ring_.create(this, bd.ByteWidth, ALIGNMENT);
+    }
+
+    void constant_ring::destroy()
+    {
+        ring_.destroy();
+
+        safe_release(context1_);
+        safe_release(buffer_);
+
+        context_ = nullptr;
+        supported_ = false;
+        ZeroMemory(&mapped_res_, sizeof(D3D11_MAPPED_SUBRESOURCE));
+    }
+
+    bool constant_ring::set_context(ID3D11DeviceContext* context)
+    {
+        if (!supported_)
+            return false;
+
+        if (context != context_)
+        {
+            safe_release(context1_);
+
+            context_ = context;
+
+            if (FAILED(context_->QueryInterface(__uuidof(ID3D11DeviceContext1), reinterpret_cast<void**>(&context1_))))
+                context1_ = nullptr;
+        }
+
+        return context1_ != nullptr;
+    }
+
+    bool constant_ring::push(ID3D11DeviceContext* context, const void* data, size_t size, upload_range& range)
+    {
+        if (!set_context(context))
+            return false;
+
+        return ring_.push(data, size, range);
+    }
+
+    void* constant_ring::begin_upload(bool discard)
+    {
+        if (FAILED(context_->Map(buffer_, 0, discard ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE, 0, &mapped_res_)))
+            return nullptr;
+
+        return mapped_res_.pData;
+    }
+
+    void constant_ring::end_upload()
+    {
+        context_->Unmap(buffer_, 0);
+        ZeroMemory(&mapped_res_, sizeof(D3D11_MAPPED_SUBRESOURCE));
+    }
+
+    namespace detail
+    {
+        // offsets and sizes of constant buffer ranges are counted in 16 byte constants
+        inline void constants(const upload_range& range, UINT& first, UINT& num)
+        {
+            first = static_cast<UINT>(range.offset / 16);
+            num = static_cast<UINT>(range.size / 16);
+        }
+    }
+
+    void constant_ring::to_vs(ID3D11DeviceContext* context, UINT slot, const upload_range& range)
+    {
+        UINT first, num;
+        detail::constants(range, first, num);
+
+        if (set_context(context))
+            context1_->VSSetConstantBuffers1(slot, 1, &buffer_, &first, &num);
+    }
+
+    void constant_ring::to_gs(ID3D11DeviceContext* context, UINT slot, const upload_range& range)
+    {
+        UINT first, num;
+        detail::constants(range, first, num);
+
+        if (set_context(context))
+            context1_->GSSetConstantBuffers1(slot, 1, &buffer_, &first, &num);
+    }
+
+    void constant_ring::to_ps(ID3D11DeviceContext* context, UINT slot, const upload_range& range)
+    {
+        UINT first, num;
+        detail::constants(range, first, num);
+
+        if (set_context(context))
+            context1_->PSSetConstantBuffers1(slot, 1, &buffer_, &first, &num);
+    }
+
+    void constant_ring::to_cs(ID3D11DeviceContext* context, UINT slot, const upload_range& range)
+    {
+        UINT first, num;
+        detail::constants(range, first, num);
+
+        if (set_context(context))
+            context1_->CSSetConstantBuffers1(slot, 1, &buffer_, &first, &num);
+    }
+
+    void constant_ring::bind(state_cache& state, shader_stage stage, UINT slot, const upload_range& range)
+    {
+        UINT first, num;
+        detail::constants(range, first, num);
+
+        state.set_constants(stage, slot, buffer_, first, num);
+    }
+}
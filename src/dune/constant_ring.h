@@ -0,0 +1,81 @@
+/*
+ * Dune D3D library - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+/*! \file */
+
+#ifndef DUNE_CONSTANT_RING
+#define DUNE_CONSTANT_RING
+
+#include <D3D11.h>
+#include <d3d11_1.h>
+
+#include "constant_upload.h"
+#include "state_cache.h"
+
+namespace dune
+{
+    /*!
+     * \brief A large constant buffer which small per-draw constants are suballocated from.
+     *
+     * The constants of a draw call are appended to the buffer with push() and bound with an offset, so that a
+     * mesh with many draw calls does not map a buffer of its own for each of them. See upload_ring.
+     *
+     * Binding with an offset and mapping a constant buffer without discarding need D3D11.1. On older runtimes
+     * supported() is false and push() always fails, in which case callers should fall back to a cbuffer.
+     */
+    class constant_ring : public upload_target
+    {
+    protected:
+        ID3D11Buffer*               buffer_;
+        ID3D11DeviceContext*        context_;
+        ID3D11DeviceContext1*       context1_;
+        D3D11_MAPPED_SUBRESOURCE    mapped_res_;
+        upload_ring                 ring_;
+        bool                        supported_;
+
+        bool set_context(ID3D11DeviceContext* context);
+
+    public:
+        /*! \brief The alignment of constant buffer offsets in bytes. */
+        static const UINT ALIGNMENT = 256;
+
+        constant_ring();
+        virtual ~constant_ring() {}
+
+        /*! \brief Create a ring of size bytes, if the device supports it. */
+        void create(ID3D11Device* device, UINT size = 1 << 20);
+        void destroy();
+
+        /*! \brief Returns true if the device supports constant buffer offsets. */
+        bool supported() const { return supported_; }
+
+        /*! \brief Copy size bytes of constants into the ring. Returns false if this is not possible. */
+        bool push(ID3D11DeviceContext* context, const void* data, size_t size, upload_range& range);
+
+        /*! \brief Copy a constant buffer struct into the ring. Returns false if this is not possible. */
+        template<typename T>
+        bool push(ID3D11DeviceContext* context, const T& data, upload_range& range)
+        {
+            return push(context, &data, sizeof(T), range);
+        }
+
+        //!@{
+        /*! \brief Bind a range returned by push() to register slot of a shader. */
+        void to_vs(ID3D11DeviceContext* context, UINT slot, const upload_range& range);
+        void to_gs(ID3D11DeviceContext* context, UINT slot, const upload_range& range);
+        void to_ps(ID3D11DeviceContext* context, UINT slot, const upload_range& range);
+        void to_cs(ID3D11DeviceContext* context, UINT slot, const upload_range& range);
+        //!@}
+
+        /*! \brief Bind a range returned by push() to register slot of a stage through a state_cache. */
+        void bind(state_cache& state, shader_stage stage, UINT slot, const upload_range& range);
+
+        virtual void* begin_upload(bool discard);
+        virtual void end_upload();
+    };
+}
+
+#endif
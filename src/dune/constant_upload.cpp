@@ -0,0 +1,91 @@
+/*
+ * Dune D3D library - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+#include "constant_upload.h"
+
+#include <cassert>
+
+namespace dune
+{
+    upload_counters& upload_stats()
+    {
+        static upload_counters counters = { 0, 0, 0, 0, 0 };
+        return counters;
+    }
+
+    upload_counters reset_upload_stats()
+    {
+        upload_counters& counters = upload_stats();
+        upload_counters before = counters;
+
+        std::memset(&counters, 0, sizeof(upload_counters));
+
+        return before;
+    }
+
+    upload_ring::upload_ring() :
+        target_(nullptr),
+        capacity_(0),
+        alignment_(1),
+        head_(0)
+    {
+    }
+
+    void upload_ring::create(upload_target* target, size_t capacity, size_t alignment)
+    {
+        destroy();
+
+        assert(alignment > 0 && capacity >= alignment);
+
+        target_ = target;
+        capacity_ = capacity;
+        alignment_ = alignment;
+
+        // the contents of a new buffer are undefined, so the first push discards
+        head_ = capacity_;
+    }
+
+    void upload_ring::destroy()
+    {
+        target_ = nullptr;
+        capacity_ = 0;
+        alignment_ = 1;
+        head_ = 0;
+    }
+
+    bool upload_ring::push(const void* data, size_t size, upload_range& range)
+    {
+        const size_t aligned = (size + alignment_ - 1) / alignment_ * alignment_;
+
+        if (!target_ || aligned > capacity_)
+            return false;
+
+        const bool discard = head_ + aligned > capacity_;
+        const size_t offset = discard ? 0 : head_;
+
+        unsigned char* mapped = static_cast<unsigned char*>(target_->begin_upload(discard));
+
+        if (!mapped)
+            return false;
+
+        std::memcpy(mapped + offset, data, size);
+        target_->end_upload();
+
+        upload_counters& counters = upload_stats();
+        ++counters.maps;
+        ++counters.ring_pushes;
+        counters.ring_bytes += aligned;
+
+        if (discard)
+            ++counters.ring_discards;
+
+        range.offset = offset;
+        range.size = aligned;
+        head_ = offset + aligned;
+
+        return true;
+    }
+}
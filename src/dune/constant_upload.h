@@ -0,0 +1,194 @@
+/*
+ * Dune D3D library - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+/*! \file */
+
+#ifndef DUNE_CONSTANT_UPLOAD
+#define DUNE_CONSTANT_UPLOAD
+
+#include <cstddef>
+#include <cstring>
+
+namespace dune
+{
+    /*!
+     * \brief Counters of constant uploads.
+     *
+     * All cbuffer and constant_ring uploads count here. The counters are not synchronized and should only be
+     * touched by the rendering thread.
+     */
+    struct upload_counters
+    {
+        size_t maps;            //!< the number of buffers mapped for writing
+        size_t skipped;         //!< the number of uploads skipped because the constants did not change
+        size_t ring_pushes;     //!< the number of constants suballocated from an upload_ring
+        size_t ring_bytes;      //!< the number of bytes suballocated from an upload_ring, including alignment
+        size_t ring_discards;   //!< the number of times an upload_ring wrapped around and discarded its buffer
+    };
+
+    /*! \brief Returns the counters of all uploads since the last reset_upload_stats(). */
+    upload_counters& upload_stats();
+
+    /*! \brief Reset the upload counters, e.g. once per frame, and return their values before the reset. */
+    upload_counters reset_upload_stats();
+
+    /*!
+     * \brief A buffer which constants are written into, e.g. the D3D11 buffer of a cbuffer.
+     *
+     * This is the interface tracked_constants and upload_ring drive, which lets both be tested with a fake.
+     */
+    class upload_target
+    {
+    public:
+        virtual ~upload_target() {}
+
+        /*!
+         * \brief Map the buffer for writing.
+         *
+         * \param discard True to discard the previous contents, false to promise not to overwrite anything in use.
+         * \return A pointer to the start of the buffer, or nullptr if it cannot be mapped.
+         */
+        virtual void* begin_upload(bool discard) = 0;
+
+        /*! \brief Unmap the buffer mapped with begin_upload(). */
+        virtual void end_upload() = 0;
+    };
+
+    /*!
+     * \brief A local copy of constants which is only uploaded if it changed.
+     *
+     * Every non-const access through data() marks the constants as changed. upload() writes them into a
+     * target once and skips all further uploads until the next change, so the same constants can be bound to
+     * several stages without mapping the buffer again.
+     */
+    template<typename T>
+    class tracked_constants
+    {
+    protected:
+        T local_;
+        bool dirty_;
+
+    public:
+        tracked_constants() :
+            local_(),
+            dirty_(true)
+        {
+        }
+
+        /*! \brief Returns a reference to the local constants and marks them as changed. */
+        T& data()
+        {
+            dirty_ = true;
+            return local_;
+        }
+
+        /*! \brief Returns a reference to the local constants. */
+        const T& data() const
+        {
+            return local_;
+        }
+
+        /*! \brief Returns true if the constants changed since the last upload. */
+        bool dirty() const
+        {
+            return dirty_;
+        }
+
+        /*! \brief Force the next upload, e.g. because the target lost its contents. */
+        void invalidate()
+        {
+            dirty_ = true;
+        }
+
+        /*! \brief Zero the local constants. */
+        void clear()
+        {
+            local_ = T();
+            dirty_ = true;
+        }
+
+        /*! \brief Copy the local constants into target if they changed. Returns true if target was written. */
+        bool upload(upload_target& target)
+        {
+            if (!dirty_)
+            {
+                ++upload_stats().skipped;
+                return false;
+            }
+
+            void* mapped = target.begin_upload(true);
+
+            if (!mapped)
+                return false;
+
+            std::memcpy(mapped, &local_, sizeof(T));
+            target.end_upload();
+
+            ++upload_stats().maps;
+            dirty_ = false;
+
+            return true;
+        }
+    };
+
+    /*! \brief A range of an upload_ring in bytes. */
+    struct upload_range
+    {
+        size_t offset;
+        size_t size;
+    };
+
+    /*!
+     * \brief A ring allocator for small constants which change with every draw call.
+     *
+     * Instead of mapping a buffer of its own for each draw, constants are appended to one large buffer, which is
+     * mapped without discarding as long as there is space left. The ranges written before are not touched, so
+     * draw calls still using them are unaffected. Once the ring is full it discards the whole buffer and starts
+     * over at the beginning, which lets the driver hand out fresh memory while earlier draws finish.
+     *
+     * Ranges are aligned, e.g. to the 256 bytes D3D11.1 requires for constant buffer offsets.
+     */
+    class upload_ring
+    {
+    protected:
+        upload_target*  target_;
+        size_t          capacity_;
+        size_t          alignment_;
+        size_t          head_;
+
+    public:
+        upload_ring();
+        virtual ~upload_ring() {}
+
+        /*!
+         * \brief Create a ring.
+         *
+         * \param target The buffer to write, which must outlive the ring.
+         * \param capacity The size of the buffer in bytes.
+         * \param alignment The alignment of all ranges in bytes.
+         */
+        void create(upload_target* target, size_t capacity, size_t alignment);
+        void destroy();
+
+        /*!
+         * \brief Copy size bytes into the next free range.
+         *
+         * \param data The constants to copy.
+         * \param size The size of data in bytes.
+         * \param range The range the constants were written to, with a size rounded up to the alignment.
+         * \return False if the constants are larger than the whole ring or the buffer could not be mapped.
+         */
+        bool push(const void* data, size_t size, upload_range& range);
+
+        /*! \brief Returns the offset of the next free range. */
+        size_t head() const { return head_; }
+
+        /*! \brief Returns the size of the ring in bytes. */
+        size_t capacity() const { return capacity_; }
+    };
+}
+
+#endif
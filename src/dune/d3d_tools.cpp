@@ -12,6 +12,7 @@
 
 #include "unicode.h"
 #include "exception.h"
+#include "frame_profiler.h"
 
 namespace dune
 {
@@ -30,64 +31,114 @@ namespace dune
     }
 
     profile_query::profile_query() :
-        frequency_(nullptr),
-        start_(nullptr),
-        stop_(nullptr),
+        sets_(),
+        issued_(),
+        ring_(),
+        name_(nullptr),
         context_(nullptr)
     {
     }
 
-    void profile_query::create(ID3D11Device* device)
+    void profile_query::create(ID3D11Device* device, const char* name, size_t num_sets)
     {
+        name_ = name;
+
         D3D11_QUERY_DESC desc;
         desc.MiscFlags = 0;
 
-        desc.Query = D3D11_QUERY_TIMESTAMP_DISJOINT;
-        assert_hr(device->CreateQuery(&desc, &frequency_));
+        sets_.resize(num_sets);
+        issued_.assign(num_sets, 0);
+
+        for (auto s = sets_.begin(); s != sets_.end(); ++s)
+        {
+            desc.Query = D3D11_QUERY_TIMESTAMP_DISJOINT;
+            assert_hr(device->CreateQuery(&desc, &s->frequency));
+
+            desc.Query = D3D11_QUERY_TIMESTAMP;
+            assert_hr(device->CreateQuery(&desc, &s->start));
+            assert_hr(device->CreateQuery(&desc, &s->stop));
+        }
 
-        desc.Query = D3D11_QUERY_TIMESTAMP;
-        assert_hr(device->CreateQuery(&desc, &start_));
-        assert_hr(device->CreateQuery(&desc, &stop_));
+        ring_.create(this, num_sets, WINDOW);
     }
 
     void profile_query::destroy()
     {
-        safe_release(frequency_);
-        safe_release(start_);
-        safe_release(stop_);
+        for (auto s = sets_.begin(); s != sets_.end(); ++s)
+        {
+            safe_release(s->frequency);
+            safe_release(s->start);
+            safe_release(s->stop);
+        }
+
+        sets_.clear();
+        issued_.clear();
+        ring_.destroy();
+        name_ = nullptr;
         context_ = nullptr;
     }
 
-    void profile_query::begin(ID3D11DeviceContext* context)
+    void profile_query::begin_query(size_t set)
     {
-        context_ = context;
+        issued_[set] = frame_profiler::now();
 
-        context_->Begin(frequency_);
-        context_->End(start_);
+        context_->Begin(sets_[set].frequency);
+        context_->End(sets_[set].start);
     }
 
-    void profile_query::end()
+    void profile_query::end_query(size_t set)
     {
-        context_->End(stop_);
-        context_->End(frequency_);
+        context_->End(sets_[set].stop);
+        context_->End(sets_[set].frequency);
     }
 
-    float profile_query::result()
+    bool profile_query::read_query(size_t set, float& ms, bool& valid)
     {
-        end();
+        // don't flush, the queries are submitted with the frame anyway
+        const UINT flags = D3D11_ASYNC_GETDATA_DONOTFLUSH;
 
-        UINT64 start = 0;
-        while(context_->GetData(start_, &start, sizeof(UINT64), 0) != S_OK);
+        // the disjoint query ends last, so start and stop are done once it is
+        D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint;
+        if (context_->GetData(sets_[set].frequency, &disjoint, sizeof(D3D11_QUERY_DATA_TIMESTAMP_DISJOINT), flags) != S_OK)
+            return false;
 
-        UINT64 stop = 0;
-        while(context_->GetData(stop_, &stop, sizeof(UINT64), 0) != S_OK);
+        UINT64 start = 0, stop = 0;
+        if (context_->GetData(sets_[set].start, &start, sizeof(UINT64), flags) != S_OK ||
+            context_->GetData(sets_[set].stop, &stop, sizeof(UINT64), flags) != S_OK)
+            return false;
 
-        D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint;
-        while(context_->GetData(frequency_, &disjoint, sizeof(D3D11_QUERY_DATA_TIMESTAMP_DISJOINT), 0) != S_OK);
+        valid = !disjoint.Disjoint && disjoint.Frequency > 0;
+        ms = valid ? (static_cast<float>(stop - start) / disjoint.Frequency) * 1000.f : 0.f;
 
-        UINT64 time = stop - start;
+        if (valid && name_)
+            frame_profiler::i().gpu_zone(name_, issued_[set], ms);
 
-        return (static_cast<float>(time)/disjoint.Frequency) * 1000.f;
+        return true;
+    }
+
+    void profile_query::begin(ID3D11DeviceContext* context, uint64_t tag)
+    {
+        context_ = context;
+        ring_.begin(tag);
+    }
+
+    void profile_query::end()
+    {
+        ring_.end();
+    }
+
+    float profile_query::result()
+    {
+        end();
+        return latest();
+    }
+
+    float profile_query::latest()
+    {
+        if (context_)
+            ring_.poll();
+
+        return ring_.last().ms;
     }
 
     bool is_srgb(ID3D11RenderTargetView* rtv)
@@ -109,6 +160,113 @@ namespace dune
                f == DXGI_FORMAT_BC7_UNORM_SRGB;
     }
 
+    void read_texture(ID3D11DeviceContext* context, ID3D11Resource* resource, UINT texel_size, unsigned char* data)
+    {
+        ID3D11Device* device;
+        context->GetDevice(&device);
+
+        D3D11_RESOURCE_DIMENSION dim;
+        resource->GetType(&dim);
+
+        D3D11_MAPPED_SUBRESOURCE msr;
+
+        if (dim == D3D11_RESOURCE_DIMENSION_TEXTURE3D)
+        {
+            D3D11_TEXTURE3D_DESC desc;
+            static_cast<ID3D11Texture3D*>(resource)->GetDesc(&desc);
+
+            UINT mips = desc.MipLevels;
+
+            desc.MipLevels = 1;
+            desc.Usage = D3D11_USAGE_STAGING;
+            desc.BindFlags = 0;
+            desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+            desc.MiscFlags = 0;
+
+            ID3D11Texture3D* staging;
+            assert_hr(device->CreateTexture3D(&desc, nullptr, &staging));
+
+            context->CopySubresourceRegion(staging, 0, 0, 0, 0, resource, D3D11CalcSubresource(0, 0, mips), nullptr);
+
+            assert_hr(context->Map(staging, 0, D3D11_MAP_READ, 0, &msr));
+
+            const UINT row = desc.Width * texel_size;
+
+            for (UINT z = 0; z < desc.Depth; ++z)
+            for (UINT y = 0; y < desc.Height; ++y)
+            {
+                const unsigned char* src = static_cast<const unsigned char*>(msr.pData) + z * msr.DepthPitch + y * msr.RowPitch;
+                std::copy(src, src + row, data + (z * desc.Height + y) * row);
+            }
+
+            context->Unmap(staging, 0);
+            safe_release(staging);
+        }
+        else
+        {
+            D3D11_TEXTURE2D_DESC desc;
+            static_cast<ID3D11Texture2D*>(resource)->GetDesc(&desc);
+
+            UINT mips = desc.MipLevels;
+
+            desc.MipLevels = 1;
+            desc.Usage = D3D11_USAGE_STAGING;
+            desc.BindFlags = 0;
+            desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+            desc.MiscFlags = 0;
+
+            ID3D11Texture2D* staging;
+            assert_hr(device->CreateTexture2D(&desc, nullptr, &staging));
+
+            const UINT row = desc.Width * texel_size;
+
+            for (UINT a = 0; a < desc.ArraySize; ++a)
+            {
+                context->CopySubresourceRegion(staging, a, 0, 0, 0, resource, D3D11CalcSubresource(0, a, mips), nullptr);
+
+                assert_hr(context->Map(staging, a, D3D11_MAP_READ, 0, &msr));
+
+                for (UINT y = 0; y < desc.Height; ++y)
+                {
+                    const unsigned char* src = static_cast<const unsigned char*>(msr.pData) + y * msr.RowPitch;
+                    std::copy(src, src + row, data + (a * desc.Height + y) * row);
+                }
+
+                context->Unmap(staging, a);
+            }
+
+            safe_release(staging);
+        }
+
+        safe_release(device);
+    }
+
+    void write_texture(ID3D11DeviceContext* context, ID3D11Resource* resource, UINT texel_size, const unsigned char* data)
+    {
+        D3D11_RESOURCE_DIMENSION dim;
+        resource->GetType(&dim);
+
+        if (dim == D3D11_RESOURCE_DIMENSION_TEXTURE3D)
+        {
+            D3D11_TEXTURE3D_DESC desc;
+            static_cast<ID3D11Texture3D*>(resource)->GetDesc(&desc);
+
+            context->UpdateSubresource(resource, D3D11CalcSubresource(0, 0, desc.MipLevels), nullptr, data,
+                                       desc.Width * texel_size, desc.Width * desc.Height * texel_size);
+        }
+        else
+        {
+            D3D11_TEXTURE2D_DESC desc;
+            static_cast<ID3D11Texture2D*>(resource)->GetDesc(&desc);
+
+            const UINT slice = desc.Width * desc.Height * texel_size;
+
+            for (UINT a = 0; a < desc.ArraySize; ++a)
+                context->UpdateSubresource(resource, D3D11CalcSubresource(0, a, desc.MipLevels), nullptr, data + a * slice,
+                                           desc.Width * texel_size, slice);
+        }
+    }
+
     void set_viewport(ID3D11DeviceContext* context, size_t w, size_t h)
     {
         D3D11_VIEWPORT viewport;
@@ -12,6 +12,10 @@
 #include <D3D11.h>
 #include <DirectXMath.h>
 
+#include <vector>
+
+#include "profile_ring.h"
+
 namespace dune
 {
     /*!
@@ -19,34 +23,75 @@ namespace dune
      *
      * This class encapsulates ID3D11Query objects to capture the time spent
      * on completing a portion of a GPU command buffer.
+     *
+     * Queries are never waited for. Each measurement uses the next of a ring of query
+     * sets, which is read back once the GPU is done with it, usually a few frames later,
+     * see profile_ring. Results are therefore those of an earlier begin() and end() pair,
+     * and one profile_query should time only one pass.
+     *
+     * A named profile_query also reports its results as GPU zones to the frame_profiler.
      */
-    class profile_query
+    class profile_query : public query_source
     {
+    public:
+        /*! \brief The default number of query sets in flight. */
+        static const size_t NUM_SETS = 8;
+
+        /*! \brief The number of measurements stats() are computed from. */
+        static const size_t WINDOW = 64;
+
     protected:
-        ID3D11Query* frequency_;
-        ID3D11Query* start_;
-        ID3D11Query* stop_;
+        struct query_set
+        {
+            ID3D11Query* frequency;
+            ID3D11Query* start;
+            ID3D11Query* stop;
+        };
+
+        std::vector<query_set> sets_;
+        std::vector<uint64_t> issued_;
+        profile_ring ring_;
+        const char* name_;
 
         ID3D11DeviceContext* context_;
 
+    protected:
+        virtual void begin_query(size_t set);
+        virtual void end_query(size_t set);
+        virtual bool read_query(size_t set, float& ms, bool& valid);
+
     public:
         profile_query();
         virtual ~profile_query() {}
 
-        /*! \brief Create a profile_query object. */
-        void create(ID3D11Device* device);
+        /*!
+         * \brief Create a profile_query object.
+         *
+         * \param device The Direct3D device.
+         * \param name The name of the GPU zone in the frame_profiler, or nullptr. Must be a string literal.
+         * \param num_sets The number of query sets in flight.
+         */
+        void create(ID3D11Device* device, const char* name = nullptr, size_t num_sets = NUM_SETS);
 
         /*! \brief Destroy a profile_query object and free its resources. */
         void destroy();
 
-        /*! \brief Start a GPU time query. */
-        void begin(ID3D11DeviceContext* context);
+        /*! \brief Start a GPU time query, with a tag returned with its result in ring(). */
+        void begin(ID3D11DeviceContext* context, uint64_t tag = 0);
 
         /*! \brief Stop measuring time. */
         void end();
 
-        /*! \brief Stop measuring time and return the result in milliseconds. */
+        /*! \brief Stop measuring time and return the newest available result in milliseconds, without waiting. */
         float result();
+
+        /*! \brief Read back finished queries and return the newest available result in milliseconds. */
+        float latest();
+
+        /*! \brief Returns rolling statistics of the last results. */
+        profile_stats stats() const { return ring_.stats(); }
+
+        const profile_ring& ring() const { return ring_; }
     };
 
     template<typename T>
@@ -130,6 +175,21 @@ namespace dune
                     size_t num_rtvs,
                     FLOAT* clear_color);
 
+    /*!
+     * \brief Copy the top mip level of a texture array or volume texture into CPU memory.
+     *
+     * Each slice of a Texture2D array or Texture3D is copied through a staging texture.
+     *
+     * \param context A Direct3D context.
+     * \param resource A Texture2D or Texture3D.
+     * \param texel_size The size of one texel of the texture format in bytes.
+     * \param data width * height * depth * texel_size bytes, tightly packed.
+     */
+    void read_texture(ID3D11DeviceContext* context, ID3D11Resource* resource, UINT texel_size, unsigned char* data);
+
+    /*! \brief Upload tightly packed texels to the top mip level of a texture array or volume texture, see read_texture(). */
+    void write_texture(ID3D11DeviceContext* context, ID3D11Resource* resource, UINT texel_size, const unsigned char* data);
+
     /*! \brief Returns true of the DXGI_FORMAT descriptor is SRGB. */
     bool is_srgb(DXGI_FORMAT f);
 
@@ -40,6 +40,7 @@ namespace dune
         ps_overlay_(nullptr),
         ss_shadows_(),
         ss_lpv_(),
+        ss_volume_wrap_(),
         postprocessor_(nullptr),
         do_record_(false)
     {}
@@ -80,6 +81,7 @@ namespace dune
 
         ss_lpv_.to_ps(context, 1);
         ss_shadows_.to_ps(context, 2);
+        ss_volume_wrap_.to_ps(context, 3);
 
         context->GSSetShader(nullptr, nullptr, 0);
         context->PSSetShader(ps_deferred_, nullptr, 0);
@@ -126,6 +128,7 @@ namespace dune
     {
         ss_shadows_.destroy();
         ss_lpv_.destroy();
+        ss_volume_wrap_.destroy();
 
         safe_release(ps_deferred_);
         safe_release(ps_overlay_);
@@ -184,6 +187,12 @@ namespace dune
         sd.MaxAnisotropy = 1;
         ss_lpv_.create(device, sd);
 
+        // volumes stored toroidally, e.g. an SVO following the camera
+        sd.AddressU = D3D11_TEXTURE_ADDRESS_WRAP;
+        sd.AddressV = D3D11_TEXTURE_ADDRESS_WRAP;
+        sd.AddressW = D3D11_TEXTURE_ADDRESS_WRAP;
+        ss_volume_wrap_.create(device, sd);
+
         srvs_.resize(MAX_TEXTURE_SLOTS);
         std::fill_n(srvs_.begin(), MAX_TEXTURE_SLOTS, nullptr);
 
@@ -64,6 +64,7 @@ namespace dune
 
         sampler_state                   ss_shadows_;
         sampler_state                   ss_lpv_;
+        sampler_state                   ss_volume_wrap_;
 
         postprocessor*                  postprocessor_;
         bool                            do_record_;
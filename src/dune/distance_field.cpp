@@ -0,0 +1,163 @@
+/*
+ * Dune D3D library - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+#include "distance_field.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+#include "parallel_tools.h"
+
+namespace dune
+{
+    namespace detail
+    {
+        /*
+         * The 1D squared distance transform of f with n samples into d, using the lower envelope of the parabolas
+         * rooted at each sample. v and z are scratch memory of n and n + 1 elements.
+         */
+        void distance_transform_1d(const float* f, size_t n, float* d, int* v, float* z)
+        {
+            int k = 0;
+            v[0] = 0;
+            z[0] = -std::numeric_limits<float>::max();
+            z[1] = std::numeric_limits<float>::max();
+
+            for (int q = 1; q < static_cast<int>(n); ++q)
+            {
+                float s;
+
+                for (;;)
+                {
+                    const int p = v[k];
+                    s = ((f[q] + static_cast<float>(q * q)) - (f[p] + static_cast<float>(p * p))) / static_cast<float>(2 * (q - p));
+
+                    // z[0] is below any intersection, so this stops at k = 0
+                    if (s > z[k])
+                        break;
+
+                    --k;
+                }
+
+                ++k;
+                v[k] = q;
+                z[k] = s;
+                z[k + 1] = std::numeric_limits<float>::max();
+            }
+
+            k = 0;
+
+            for (int q = 0; q < static_cast<int>(n); ++q)
+            {
+                while (z[k + 1] < static_cast<float>(q))
+                    ++k;
+
+                const float dq = static_cast<float>(q - v[k]);
+                d[q] = dq * dq + f[v[k]];
+            }
+        }
+
+        // one pass along an axis over all lines of a volume of squared distances
+        void distance_transform_axis(std::vector<float>& volume, size_t r, size_t axis)
+        {
+            const size_t stride = axis == 0 ? 1 : (axis == 1 ? r : r * r);
+
+            parallel_for(0, r * r, [&](size_t first, size_t last)
+            {
+                std::vector<float> f(r), d(r), z(r + 1);
+                std::vector<int> v(r);
+
+                for (size_t line = first; line < last; ++line)
+                {
+                    // the two coordinates orthogonal to the axis
+                    const size_t a = line % r, b = line / r;
+
+                    size_t start;
+
+                    switch (axis)
+                    {
+                    case 0: start = (b * r + a) * r; break;
+                    case 1: start = b * r * r + a; break;
+                    default: start = b * r + a; break;
+                    }
+
+                    for (size_t i = 0; i < r; ++i)
+                        f[i] = volume[start + i * stride];
+
+                    distance_transform_1d(&f[0], r, &d[0], &v[0], &z[0]);
+
+                    for (size_t i = 0; i < r; ++i)
+                        volume[start + i * stride] = d[i];
+                }
+            });
+        }
+    }
+
+    distance_field::distance_field() :
+        resolution_(0),
+        distances_()
+    {
+    }
+
+    void distance_field::create(size_t resolution)
+    {
+        destroy();
+
+        resolution_ = resolution;
+        distances_.assign(resolution * resolution * resolution, static_cast<uint8_t>(MAX_DISTANCE));
+    }
+
+    void distance_field::destroy()
+    {
+        resolution_ = 0;
+
+        distances_.clear();
+        distances_.shrink_to_fit();
+    }
+
+    void distance_field::build(const std::vector<DirectX::XMFLOAT4>& voxels)
+    {
+        assert(voxels.size() == distances_.size());
+
+        const size_t r = resolution_;
+
+        // empty voxels start further away than any voxel of the volume, which keeps the parabolas finite
+        const float far = 3.f * r * r + static_cast<float>(MAX_DISTANCE) * MAX_DISTANCE + 1.f;
+
+        std::vector<float> squared(voxels.size());
+
+        parallel_for(0, voxels.size(), [&](size_t first, size_t last)
+        {
+            for (size_t i = first; i < last; ++i)
+                squared[i] = voxels[i].w > 0.f ? 0.f : far;
+        });
+
+        for (size_t axis = 0; axis < 3; ++axis)
+            detail::distance_transform_axis(squared, r, axis);
+
+        parallel_for(0, voxels.size(), [&](size_t first, size_t last)
+        {
+            for (size_t i = first; i < last; ++i)
+                distances_[i] = static_cast<uint8_t>(std::min(std::floor(std::sqrt(squared[i])), static_cast<float>(MAX_DISTANCE)));
+        });
+    }
+
+    float distance_field::clearance(const DirectX::XMFLOAT3& p) const
+    {
+        const float r = static_cast<float>(resolution_);
+
+        if (!(p.x >= 0.f && p.y >= 0.f && p.z >= 0.f && p.x < 1.f && p.y < 1.f && p.z < 1.f))
+            return 0.f;
+
+        const size_t m = resolution_ - 1;
+        const uint8_t d = distance(std::min(static_cast<size_t>(p.x * r), m), std::min(static_cast<size_t>(p.y * r), m), std::min(static_cast<size_t>(p.z * r), m));
+
+        // p is up to half a voxel diagonal from the center of its voxel, as is the box of an occupied voxel from its center
+        return std::max(static_cast<float>(d) - 1.7320508f, 0.f);
+    }
+}
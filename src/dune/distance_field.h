@@ -0,0 +1,76 @@
+/*
+ * Dune D3D library - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+/*! \file */
+
+#ifndef DUNE_DISTANCE_FIELD
+#define DUNE_DISTANCE_FIELD
+
+#include <cstdint>
+#include <vector>
+
+#include <DirectXMath.h>
+
+namespace dune
+{
+    /*!
+     * \brief The distance of every voxel of a volume to the closest occupied voxel.
+     *
+     * The distance field is computed with the separable exact Euclidean distance transform of
+     * [[Felzenszwalb and Huttenlocher 2012]](http://dx.doi.org/10.4086/toc.2012.v008a019): three passes of 1D
+     * transforms along x, y and z, where each pass processes all lines of the volume in parallel.
+     *
+     * Distances are measured between voxel centers, rounded down and clamped to MAX_DISTANCE, and stored in one byte
+     * per voxel, i.e. the layout of an R8_UINT texture. Occupied voxels have distance zero. Since the volumes of a
+     * sparse_voxel_octree only hold surfaces, the field is unsigned.
+     *
+     * A marcher at a position whose clearance() is larger than the reach of its next samples can skip ahead by the
+     * difference, since everything it would sample on the way is empty.
+     */
+    class distance_field
+    {
+    public:
+        /*! \brief The largest distance stored, in voxels. */
+        static const uint8_t MAX_DISTANCE = 255;
+
+    protected:
+        size_t                  resolution_;
+        std::vector<uint8_t>    distances_;
+
+    public:
+        distance_field();
+        virtual ~distance_field() {}
+
+        /*! \brief Create a field of resolution^3 voxels at distance MAX_DISTANCE. */
+        void create(size_t resolution);
+        void destroy();
+
+        size_t resolution() const { return resolution_; }
+
+        /*!
+         * \brief Compute the distance field of a volume.
+         *
+         * \param voxels resolution^3 voxels, x fastest, then y, then z. Voxels with an alpha larger than zero are occupied.
+         */
+        void build(const std::vector<DirectX::XMFLOAT4>& voxels);
+
+        /*! \brief Returns the distances, x fastest, then y, then z. */
+        const std::vector<uint8_t>& distances() const { return distances_; }
+
+        /*! \brief Returns the distance of a voxel to the closest occupied voxel. */
+        uint8_t distance(size_t x, size_t y, size_t z) const { return distances_[(z * resolution_ + y) * resolution_ + x]; }
+
+        /*!
+         * \brief Returns a lower bound of the distance from a position to the boxes of all occupied voxels.
+         *
+         * \param p A position in volume space, i.e. [0,1]^3.
+         * \return The clearance in voxels, or zero outside of the volume.
+         */
+        float clearance(const DirectX::XMFLOAT3& p) const;
+    };
+}
+
+#endif
@@ -13,32 +13,56 @@
 /// Direct3D helper library
 namespace dune {}
 
+#include "anisotropic_voxels.h"
 #include "assimp_mesh.h"
 #include "exception.h"
+#include "frame_profiler.h"
 #include "camera.h"
 #include "cbuffer.h"
 #include "common_tools.h"
 #include "composite_mesh.h"
+#include "cone_tracer.h"
+#include "constant_ring.h"
+#include "constant_upload.h"
 #include "deferred_renderer.h"
 #include "d3d_tools.h"
+#include "distance_field.h"
 #include "gbuffer.h"
+#include "ibl_tools.h"
 #include "light.h"
 #include "light_propagation_volume.h"
+#include "lpv_cascades.h"
+#include "lpv_grid.h"
+#include "geometry_volume.h"
+#include "gi_pipeline.h"
+#include "gi_snapshot.h"
 #include "logger.h"
 #include "math_tools.h"
 #include "mesh.h"
+#include "parallel_tools.h"
 #include "postprocess.h"
+#include "profile_ring.h"
+#include "propagation_schedule.h"
 #include "record_tools.h"
 #include "render_target.h"
 #include "sdk_mesh.h"
 #include "shader_resource.h"
+#include "sh_packing.h"
 #include "shader_tools.h"
 #include "sparse_voxel_octree.h"
+#include "state_cache.h"
+#include "state_filter.h"
 #include "serializer.h"
 #include "serializer_tools.h"
 #include "texture.h"
 #include "texture_cache.h"
+#include "tiled_volume.h"
 #include "unicode.h"
+#include "voxel_clipmap.h"
+#include "voxel_dag.h"
+#include "voxel_octree.h"
+#include "voxel_ownership.h"
+#include "voxelizer.h"
 
 #include "kinect_gbuffer.h"
 #include "tracker.h"
@@ -26,16 +26,18 @@ namespace dune
     {
     protected:
         tstring msg_;
+        std::string what_;
 
     public:
         exception(tstring msg)
         {
             msg_ = msg;
+            what_ = to_string(msg_);
         }
 
-        virtual const char* what() const
+        virtual const char* what() const throw()
         {
-            return to_string(msg_).c_str();
+            return what_.c_str();
         }
 
         /*! \brief Return exception message as tstring. */
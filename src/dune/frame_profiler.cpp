@@ -0,0 +1,333 @@
+/*
+ * Dune D3D library - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+#include "frame_profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <map>
+
+#include "exception.h"
+
+namespace dune
+{
+    namespace detail
+    {
+        // releases the buffer of a thread when it exits
+        struct profile_thread_slot
+        {
+            profile_thread* thread;
+
+            profile_thread_slot() : thread(nullptr) {}
+
+            ~profile_thread_slot()
+            {
+                if (thread)
+                    thread->in_use = false;
+            }
+        };
+
+        static thread_local profile_thread_slot current_thread;
+
+        inline void write_json_string(std::ostream& out, const char* s)
+        {
+            out << '"';
+
+            for (; *s; ++s)
+            {
+                if (*s == '"' || *s == '\\')
+                    out << '\\' << *s;
+                else if (static_cast<unsigned char>(*s) < 0x20)
+                    out << ' ';
+                else
+                    out << *s;
+            }
+
+            out << '"';
+        }
+    }
+
+    frame_profiler::frame_profiler() :
+        mutex_(),
+        threads_(),
+        enabled_(true)
+    {
+    }
+
+    frame_profiler& frame_profiler::i()
+    {
+        static frame_profiler instance;
+        return instance;
+    }
+
+    uint64_t frame_profiler::now()
+    {
+        static const auto epoch = std::chrono::steady_clock::now();
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count());
+    }
+
+    detail::profile_thread& frame_profiler::thread()
+    {
+        if (detail::current_thread.thread)
+            return *detail::current_thread.thread;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        detail::profile_thread* t = nullptr;
+
+        // reuse the buffer of a thread which exited
+        for (auto x = threads_.begin(); x != threads_.end() && !t; ++x)
+            if (!(*x)->in_use)
+                t = x->get();
+
+        if (!t)
+        {
+            threads_.push_back(std::unique_ptr<detail::profile_thread>(new detail::profile_thread()));
+
+            t = threads_.back().get();
+            t->id = static_cast<uint32_t>(threads_.size());
+            t->slots.reset(new detail::profile_slot[CAPACITY]);
+            t->written = 0;
+
+            for (size_t i = 0; i < CAPACITY; ++i)
+                t->slots[i].sequence = 0;
+        }
+
+        t->name = "Thread " + std::to_string(t->id);
+        t->depth = 0;
+        t->in_use = true;
+
+        detail::current_thread.thread = t;
+
+        return *t;
+    }
+
+    void frame_profiler::record(detail::profile_thread& t, const char* name, uint64_t start, uint64_t end, uint32_t depth, bool gpu)
+    {
+        const uint64_t n = t.written.load(std::memory_order_relaxed);
+
+        detail::profile_slot& slot = t.slots[n % CAPACITY];
+
+        // readers which see the slot in between drop it
+        slot.sequence.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        profile_event& e = slot.event;
+        e.name = name;
+        e.start = start;
+        e.duration = end > start ? end - start : 0;
+        e.thread = t.id;
+        e.depth = depth;
+        e.gpu = gpu;
+
+        slot.sequence.store(n + 1, std::memory_order_release);
+        t.written.store(n + 1, std::memory_order_release);
+    }
+
+    void frame_profiler::set_thread_name(const char* name)
+    {
+        detail::profile_thread& t = thread();
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        t.name = name;
+    }
+
+    uint32_t frame_profiler::enter()
+    {
+        return thread().depth++;
+    }
+
+    void frame_profiler::leave(const char* name, uint64_t start, uint32_t depth)
+    {
+        detail::profile_thread& t = thread();
+
+        t.depth = depth;
+
+        if (enabled_)
+            record(t, name, start, now(), depth, false);
+    }
+
+    void frame_profiler::gpu_zone(const char* name, uint64_t issued, float ms)
+    {
+        if (enabled_)
+            record(thread(), name, issued, issued + static_cast<uint64_t>(ms * 1e6f), 0, true);
+    }
+
+    std::vector<profile_event> frame_profiler::events()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        std::vector<profile_event> result;
+
+        for (auto x = threads_.begin(); x != threads_.end(); ++x)
+        {
+            const detail::profile_thread& t = **x;
+
+            const uint64_t last = t.written.load(std::memory_order_acquire);
+            const uint64_t first = last > CAPACITY ? last - CAPACITY : 0;
+
+            std::vector<profile_event> copy;
+            std::vector<uint64_t> numbers;
+
+            for (uint64_t n = first; n < last; ++n)
+            {
+                const detail::profile_slot& slot = t.slots[n % CAPACITY];
+
+                if (slot.sequence.load(std::memory_order_acquire) != n + 1)
+                    continue;
+
+                profile_event e = slot.event;
+
+                // the owner started to overwrite the slot while it was copied
+                std::atomic_thread_fence(std::memory_order_acquire);
+
+                if (slot.sequence.load(std::memory_order_relaxed) != n + 1)
+                    continue;
+
+                copy.push_back(e);
+                numbers.push_back(n);
+            }
+
+            // drop the events the owner overwrote in the meantime, including the slot it may be writing right now
+            std::atomic_thread_fence(std::memory_order_acquire);
+            const uint64_t now_written = t.written.load(std::memory_order_relaxed);
+            const uint64_t valid = now_written + 1 > CAPACITY ? now_written + 1 - CAPACITY : 0;
+
+            const size_t stale = std::lower_bound(numbers.begin(), numbers.end(), valid) - numbers.begin();
+            copy.erase(copy.begin(), copy.begin() + stale);
+
+            result.insert(result.end(), copy.begin(), copy.end());
+        }
+
+        std::stable_sort(result.begin(), result.end(), [](const profile_event& a, const profile_event& b)
+        {
+            return a.start < b.start;
+        });
+
+        return result;
+    }
+
+    std::vector<profile_zone_stats> frame_profiler::zone_stats()
+    {
+        std::vector<profile_event> all = events();
+
+        std::map<std::pair<std::string, bool>, profile_zone_stats> zones;
+
+        for (auto e = all.begin(); e != all.end(); ++e)
+        {
+            const float ms = e->duration / 1e6f;
+
+            auto z = zones.find(std::make_pair(std::string(e->name), e->gpu));
+
+            if (z == zones.end())
+            {
+                profile_zone_stats s = { e->name, e->gpu, 0, 0.f, 0.f, ms, ms };
+                z = zones.insert(std::make_pair(std::make_pair(s.name, s.gpu), s)).first;
+            }
+
+            profile_zone_stats& s = z->second;
+            ++s.count;
+            s.total += ms;
+            s.min = std::min(s.min, ms);
+            s.max = std::max(s.max, ms);
+        }
+
+        std::vector<profile_zone_stats> result;
+
+        for (auto z = zones.begin(); z != zones.end(); ++z)
+        {
+            z->second.average = z->second.total / z->second.count;
+            result.push_back(z->second);
+        }
+
+        std::sort(result.begin(), result.end(), [](const profile_zone_stats& a, const profile_zone_stats& b)
+        {
+            return a.total > b.total;
+        });
+
+        return result;
+    }
+
+    void frame_profiler::write_trace(std::ostream& out)
+    {
+        std::vector<profile_event> all = events();
+
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+        out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << GPU_THREAD << ",\"args\":{\"name\":\"GPU\"}}";
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+
+            for (auto x = threads_.begin(); x != threads_.end(); ++x)
+            {
+                out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << (*x)->id << ",\"args\":{\"name\":";
+                detail::write_json_string(out, (*x)->name.c_str());
+                out << "}}";
+            }
+        }
+
+        // the GPU runs zones one after another
+        uint64_t gpu_end = 0;
+
+        for (auto e = all.begin(); e != all.end(); ++e)
+        {
+            uint64_t start = e->start;
+
+            if (e->gpu)
+            {
+                start = std::max(start, gpu_end);
+                gpu_end = start + e->duration;
+            }
+
+            out << ",\n{\"name\":";
+            detail::write_json_string(out, e->name);
+            out << ",\"cat\":\"" << (e->gpu ? "gpu" : "cpu") << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << (e->gpu ? static_cast<uint32_t>(GPU_THREAD) : e->thread)
+                << ",\"ts\":" << start / 1000 << "." << (start / 100) % 10 << ",\"dur\":" << e->duration / 1000 << "." << (e->duration / 100) % 10
+                << ",\"args\":{\"depth\":" << e->depth << "}}";
+        }
+
+        out << "\n]}\n";
+    }
+
+    void frame_profiler::save_trace(const tstring& filename)
+    {
+        std::ofstream f(to_string(filename).c_str());
+
+        if (!f)
+            throw dune::exception(L"Cannot write trace " + filename);
+
+        write_trace(f);
+    }
+
+    profile_zone::profile_zone(const char* name) :
+        name_(nullptr),
+        start_(0),
+        depth_(0)
+    {
+        frame_profiler& p = frame_profiler::i();
+
+        if (p.enabled())
+        {
+            name_ = name;
+            depth_ = p.enter();
+        }
+
+        start_ = frame_profiler::now();
+    }
+
+    profile_zone::~profile_zone()
+    {
+        if (name_)
+            frame_profiler::i().leave(name_, start_, depth_);
+    }
+
+    float profile_zone::elapsed_ms() const
+    {
+        return (frame_profiler::now() - start_) / 1e6f;
+    }
+}
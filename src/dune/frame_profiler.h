@@ -0,0 +1,174 @@
+/*
+ * Dune D3D library - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+/*! \file */
+
+#ifndef DUNE_FRAME_PROFILER
+#define DUNE_FRAME_PROFILER
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "unicode.h"
+
+namespace dune
+{
+    /*! \brief A recorded zone of a frame_profiler. */
+    struct profile_event
+    {
+        const char* name;
+        uint64_t start;         //!< nanoseconds since frame_profiler::now() started counting
+        uint64_t duration;      //!< nanoseconds
+        uint32_t thread;        //!< the id of the recording thread
+        uint32_t depth;         //!< the number of enclosing zones of the same thread
+        bool gpu;               //!< true for GPU zones, whose start is the time they were issued
+    };
+
+    /*! \brief Statistics of all recorded zones of the same name, in milliseconds. */
+    struct profile_zone_stats
+    {
+        std::string name;
+        bool gpu;
+        size_t count;
+        float total;
+        float average;
+        float min;
+        float max;
+    };
+
+    namespace detail
+    {
+        /*!
+         * \brief One event of a ring and the number of the event it holds.
+         *
+         * sequence is the number of the event plus one once it is complete, and zero while the owner writes it.
+         */
+        struct profile_slot
+        {
+            std::atomic<uint64_t> sequence;
+            profile_event event;
+        };
+
+        /*!
+         * \brief The events of one thread.
+         *
+         * Only the owning thread writes, into a ring which overwrites the oldest events. written counts all events
+         * ever recorded, which lets a reader skip events that were overwritten while it copied them. The sequence of
+         * a slot tells a reader whether the copy it took is the event it expected, and whether it was torn by the owner.
+         */
+        struct profile_thread
+        {
+            uint32_t id;
+            std::string name;
+            std::unique_ptr<profile_slot[]> slots;
+            std::atomic<uint64_t> written;
+            std::atomic<bool> in_use;
+            uint32_t depth;
+        };
+    }
+
+    /*!
+     * \brief A timeline of the CPU and GPU zones of all threads.
+     *
+     * CPU zones are recorded with profile_zone (or DUNE_PROFILE_ZONE) and nest per thread. GPU zones are reported by
+     * named profile_query objects once their results are read back, and are shown on their own track, starting at the
+     * time they were issued or when the preceding GPU zone ended.
+     *
+     * Each thread records into its own ring buffer, so recording never locks. The buffer of a thread which exited is
+     * reused by the next new thread. Snapshots of all rings are taken with events(), zone_stats() or write_trace(),
+     * which writes the Chrome trace event format that can be loaded in chrome://tracing or Perfetto.
+     */
+    class frame_profiler
+    {
+    public:
+        /*! \brief The number of events kept per thread. */
+        static const size_t CAPACITY = 16384;
+
+        /*! \brief The thread id of the GPU track in write_trace(). */
+        static const uint32_t GPU_THREAD = 0;
+
+    protected:
+        std::mutex                                              mutex_;
+        std::vector<std::unique_ptr<detail::profile_thread>>    threads_;
+        std::atomic<bool>                                       enabled_;
+
+        frame_profiler();
+
+        detail::profile_thread& thread();
+        void record(detail::profile_thread& t, const char* name, uint64_t start, uint64_t end, uint32_t depth, bool gpu);
+
+    public:
+        /*! \brief The static instance of the frame_profiler. */
+        static frame_profiler& i();
+
+        /*! \brief Returns the time in nanoseconds since the first call. */
+        static uint64_t now();
+
+        //!@{
+        /*! \brief Get/set whether zones are recorded. Recording is enabled by default. */
+        bool enabled() const { return enabled_; }
+        void set_enabled(bool enabled) { enabled_ = enabled; }
+        //!@}
+
+        /*! \brief Set the name of the calling thread in the trace. */
+        void set_thread_name(const char* name);
+
+        /*! \brief Open a CPU zone on the calling thread and return its depth. */
+        uint32_t enter();
+
+        /*! \brief Close the innermost CPU zone of the calling thread, which started at start. */
+        void leave(const char* name, uint64_t start, uint32_t depth);
+
+        /*! \brief Record a GPU zone which was issued at the time issued and took ms milliseconds. */
+        void gpu_zone(const char* name, uint64_t issued, float ms);
+
+        /*! \brief Returns a copy of all events still in the buffers, ordered by start. */
+        std::vector<profile_event> events();
+
+        /*! \brief Returns statistics per zone name of all events still in the buffers, ordered by total time. */
+        std::vector<profile_zone_stats> zone_stats();
+
+        /*! \brief Write all events still in the buffers as Chrome trace event JSON. */
+        void write_trace(std::ostream& out);
+
+        /*! \brief Write a Chrome trace to a file. */
+        void save_trace(const tstring& filename);
+    };
+
+    /*!
+     * \brief A scoped CPU zone of the frame_profiler.
+     *
+     * The zone is recorded when the object goes out of scope. Names are not copied and must outlive the
+     * profiler, i.e. should be string literals.
+     */
+    class profile_zone
+    {
+    protected:
+        const char* name_;
+        uint64_t start_;
+        uint32_t depth_;
+
+    public:
+        explicit profile_zone(const char* name);
+        ~profile_zone();
+
+        /*! \brief Returns the milliseconds since the zone was opened, also if the profiler does not record. */
+        float elapsed_ms() const;
+    };
+}
+
+#define DUNE_PROFILE_JOIN_DETAIL(a, b) a##b
+#define DUNE_PROFILE_JOIN(a, b) DUNE_PROFILE_JOIN_DETAIL(a, b)
+
+/*! \brief Record the rest of the current scope as a CPU zone of the frame_profiler. */
+#define DUNE_PROFILE_ZONE(name) dune::profile_zone DUNE_PROFILE_JOIN(profile_zone_, __LINE__)(name)
+
+#endif
@@ -0,0 +1,276 @@
+/*
+ * Dune D3D library - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+#include "geometry_volume.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "math_tools.h"
+#include "parallel_tools.h"
+
+namespace dune
+{
+    namespace detail
+    {
+        // same order as offsets[] in lpv_propagate.hlsl
+        const int gv_offsets[6][3] =
+        {
+            { 0, 0, 1 },
+            { 1, 0, 0 },
+            { 0, 0,-1 },
+            {-1, 0, 0 },
+            { 0, 1, 0 },
+            { 0,-1, 0 },
+        };
+
+        // number of floats each transmittance array is padded with, see SH_PADDING in lpv_grid.cpp
+        const size_t GV_PADDING = 4;
+
+        // a surfel seen at a grazing angle covers a lot of surface, but its normal and depth are unreliable
+        const float MIN_SURFEL_COS = 0.25f;
+
+        // the position of a gbuffer texel reconstructed like gen_vpl() in lpv_inject.hlsl
+        inline DirectX::XMVECTOR texel_position(float u, float v, float linear_depth, DirectX::FXMMATRIX vp_inv, DirectX::FXMVECTOR eye)
+        {
+            DirectX::XMVECTOR dir = DirectX::XMVector4Transform(DirectX::XMVectorSet((u - 0.5f) * 2.f, (v - 0.5f) * -2.f, 1.f, 1.f), vp_inv);
+            return DirectX::XMVectorMultiplyAdd(DirectX::XMVector4Normalize(dir), DirectX::XMVectorReplicate(linear_depth), eye);
+        }
+    }
+
+    void generate_surfels(const rsm_data& buffer, const DirectX::XMFLOAT4X4& vp_inv, const DirectX::XMFLOAT3& eye, size_t stride, std::vector<surfel>& surfels)
+    {
+        stride = std::max<size_t>(stride, 1);
+
+        const size_t surfels_x = buffer.width / stride;
+        const size_t surfels_y = buffer.height / stride;
+
+        const DirectX::XMMATRIX m = DirectX::XMLoadFloat4x4(&vp_inv);
+        const DirectX::XMVECTOR e = DirectX::XMVectorSetW(DirectX::XMLoadFloat3(&eye), 1.f);
+
+        // footprint of one surfel in texture coordinates
+        const float du = 1.f / surfels_x;
+        const float dv = 1.f / surfels_y;
+
+        std::vector<std::vector<surfel>> rows(surfels_y);
+
+        parallel_for(0, surfels_y, [&](size_t first, size_t last)
+        {
+            for (size_t y = first; y < last; ++y)
+            for (size_t x = 0; x < surfels_x; ++x)
+            {
+                float u = (x + 0.5f) * du;
+                float v = (y + 0.5f) * dv;
+
+                size_t tx = std::min(buffer.width - 1, static_cast<size_t>(u * buffer.width));
+                size_t ty = std::min(buffer.height - 1, static_cast<size_t>(v * buffer.height));
+                size_t t = ty * buffer.width + tx;
+
+                float depth = buffer.lineardepth[t * 2];
+
+                if (depth < 0.0001f)
+                    continue;
+
+                unsigned int packed_normal = buffer.normals[t];
+
+                DirectX::XMVECTOR normal = DirectX::XMVector3Normalize(DirectX::XMVectorSet(
+                    (packed_normal & 0x3ff) / 1023.f * 2.f - 1.f,
+                    ((packed_normal >> 10) & 0x3ff) / 1023.f * 2.f - 1.f,
+                    ((packed_normal >> 20) & 0x3ff) / 1023.f * 2.f - 1.f,
+                    0.f));
+
+                DirectX::XMVECTOR p  = detail::texel_position(u, v, depth, m, e);
+                DirectX::XMVECTOR pu = detail::texel_position(u + du, v, depth, m, e);
+                DirectX::XMVECTOR pv = detail::texel_position(u, v + dv, depth, m, e);
+
+                // area of the footprint perpendicular to the view ray, projected onto the surface
+                float area = DirectX::XMVectorGetX(DirectX::XMVector3Length(DirectX::XMVector3Cross(DirectX::XMVectorSubtract(pu, p), DirectX::XMVectorSubtract(pv, p))));
+
+                DirectX::XMVECTOR to_eye = DirectX::XMVector3Normalize(DirectX::XMVectorSubtract(e, p));
+                float cos_theta = std::abs(DirectX::XMVectorGetX(DirectX::XMVector3Dot(to_eye, normal)));
+
+                surfel s;
+                DirectX::XMStoreFloat3(&s.position, p);
+                DirectX::XMStoreFloat3(&s.normal, normal);
+                s.area = area / std::max(cos_theta, detail::MIN_SURFEL_COS);
+
+                rows[y].push_back(s);
+            }
+        });
+
+        surfels.clear();
+
+        for (auto r = rows.begin(); r != rows.end(); ++r)
+            surfels.insert(surfels.end(), r->begin(), r->end());
+    }
+
+    geometry_volume::geometry_volume() :
+        width_(0),
+        height_(0),
+        depth_(0),
+        coeffs_(),
+        transmittance_(),
+        world_to_lpv_(),
+        normal_to_lpv_(),
+        face_area_(1.f)
+    {
+    }
+
+    void geometry_volume::create(size_t width, size_t height, size_t depth)
+    {
+        width_ = width;
+        height_ = height;
+        depth_ = depth;
+
+        for (size_t i = 0; i < 4; ++i)
+            coeffs_[i].assign((width + 1) * (height + 1) * (depth + 1), 0.f);
+
+        // nothing blocks until update() is called
+        for (size_t n = 0; n < 6; ++n)
+            transmittance_[n].assign(width * height * depth + detail::GV_PADDING, 1.f);
+
+        DirectX::XMStoreFloat4x4(&world_to_lpv_, DirectX::XMMatrixIdentity());
+        DirectX::XMStoreFloat4x4(&normal_to_lpv_, DirectX::XMMatrixIdentity());
+        face_area_ = 1.f;
+    }
+
+    void geometry_volume::destroy()
+    {
+        for (size_t i = 0; i < 4; ++i)
+            coeffs_[i].clear();
+
+        for (size_t n = 0; n < 6; ++n)
+            transmittance_[n].clear();
+
+        width_ = height_ = depth_ = 0;
+    }
+
+    void geometry_volume::clear()
+    {
+        for (size_t i = 0; i < 4; ++i)
+            std::fill(coeffs_[i].begin(), coeffs_[i].end(), 0.f);
+
+        for (size_t n = 0; n < 6; ++n)
+            std::fill(transmittance_[n].begin(), transmittance_[n].end(), 1.f);
+    }
+
+    void geometry_volume::set_model_matrix(const DirectX::XMFLOAT4X4& model, const DirectX::XMFLOAT3& lpv_min, const DirectX::XMFLOAT3& lpv_max)
+    {
+        DirectX::XMMATRIX model_inv = DirectX::XMMatrixInverse(nullptr, DirectX::XMLoadFloat4x4(&model));
+
+        DirectX::XMFLOAT3 d;
+        DirectX::XMStoreFloat3(&d, DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&lpv_max), DirectX::XMLoadFloat3(&lpv_min)));
+
+        DirectX::XMMATRIX scale = DirectX::XMMatrixScaling(1.f/d.x, 1.f/d.y, 1.f/d.z);
+        DirectX::XMMATRIX trans = DirectX::XMMatrixTranslation(-lpv_min.x, -lpv_min.y, -lpv_min.z);
+
+        DirectX::XMMATRIX to_lpv = model_inv * trans * scale;
+        DirectX::XMStoreFloat4x4(&world_to_lpv_, to_lpv);
+
+        // world space edge lengths of a cell
+        DirectX::XMMATRIX to_world = DirectX::XMMatrixInverse(nullptr, to_lpv);
+
+        // cells are rarely cubes in world space, so normals need the inverse transpose to stay perpendicular to their surface
+        DirectX::XMStoreFloat4x4(&normal_to_lpv_, DirectX::XMMatrixTranspose(to_world));
+
+        float cx = DirectX::XMVectorGetX(DirectX::XMVector3Length(DirectX::XMVector3TransformNormal(DirectX::XMVectorSet(1.f, 0.f, 0.f, 0.f), to_world))) / width_;
+        float cy = DirectX::XMVectorGetX(DirectX::XMVector3Length(DirectX::XMVector3TransformNormal(DirectX::XMVectorSet(0.f, 1.f, 0.f, 0.f), to_world))) / height_;
+        float cz = DirectX::XMVectorGetX(DirectX::XMVector3Length(DirectX::XMVector3TransformNormal(DirectX::XMVectorSet(0.f, 0.f, 1.f, 0.f), to_world))) / depth_;
+
+        face_area_ = (cx * cy + cy * cz + cx * cz) / 3.f;
+    }
+
+    void geometry_volume::inject(const std::vector<surfel>& surfels)
+    {
+        const DirectX::XMMATRIX to_lpv = DirectX::XMLoadFloat4x4(&world_to_lpv_);
+        const DirectX::XMMATRIX normal_to_lpv = DirectX::XMLoadFloat4x4(&normal_to_lpv_);
+        const DirectX::XMVECTOR dims = DirectX::XMVectorSet(static_cast<float>(width_), static_cast<float>(height_), static_cast<float>(depth_), 1.f);
+        const DirectX::XMVECTOR half = DirectX::XMVectorReplicate(0.5f);
+
+        for (auto s = surfels.begin(); s != surfels.end(); ++s)
+        {
+            DirectX::XMVECTOR ppos = DirectX::XMVector4Transform(DirectX::XMVectorSetW(DirectX::XMLoadFloat3(&s->position), 1.f), to_lpv);
+
+            // GV cells sit on the corners of LPV cells
+            DirectX::XMFLOAT3 corner;
+            DirectX::XMStoreFloat3(&corner, DirectX::XMVectorFloor(DirectX::XMVectorMultiplyAdd(ppos, dims, half)));
+
+            if (!(corner.x >= 0 && corner.y >= 0 && corner.z >= 0 && corner.x <= width_ && corner.y <= height_ && corner.z <= depth_))
+                continue;
+
+            DirectX::XMFLOAT3 n;
+            DirectX::XMStoreFloat3(&n, DirectX::XMVector3Normalize(DirectX::XMVector3TransformNormal(DirectX::XMLoadFloat3(&s->normal), normal_to_lpv)));
+
+            DirectX::XMFLOAT4 c = sh_clamped_cos_coeff(n.x, n.y, n.z);
+            float scale = s->area / face_area_;
+
+            size_t i = corner_index(static_cast<size_t>(corner.x), static_cast<size_t>(corner.y), static_cast<size_t>(corner.z));
+
+            coeffs_[0][i] += c.x * scale;
+            coeffs_[1][i] += c.y * scale;
+            coeffs_[2][i] += c.z * scale;
+            coeffs_[3][i] += c.w * scale;
+        }
+    }
+
+    void geometry_volume::update()
+    {
+        DirectX::XMFLOAT4 dir_sh[6];
+
+        for (size_t n = 0; n < 6; ++n)
+            dir_sh[n] = sh4(static_cast<float>(detail::gv_offsets[n][0]),
+                            static_cast<float>(detail::gv_offsets[n][1]),
+                            static_cast<float>(detail::gv_offsets[n][2]));
+
+        parallel_for(0, depth_, [&](size_t first, size_t last)
+        {
+            for (size_t z = first; z < last; ++z)
+            for (size_t y = 0; y < height_; ++y)
+            for (size_t x = 0; x < width_; ++x)
+            {
+                const size_t i = (z * height_ + y) * width_ + x;
+
+                for (size_t n = 0; n < 6; ++n)
+                {
+                    const int* o = detail::gv_offsets[n];
+
+                    // the four GV cells on the face shared with neighbor n
+                    size_t axis = o[0] != 0 ? 0 : (o[1] != 0 ? 1 : 2);
+                    size_t a = (axis + 1) % 3;
+                    size_t b = (axis + 2) % 3;
+
+                    size_t base[3] = { x, y, z };
+                    base[axis] += o[axis] > 0 ? 1 : 0;
+
+                    float occlusion = 0.f;
+
+                    for (size_t k = 0; k < 4; ++k)
+                    {
+                        size_t p[3] = { base[0], base[1], base[2] };
+                        p[a] += k & 1;
+                        p[b] += k >> 1;
+
+                        size_t ci = corner_index(p[0], p[1], p[2]);
+
+                        // blocking potential towards the neighbor, which is where the light comes from
+                        occlusion += coeffs_[0][ci] * dir_sh[n].x +
+                                     coeffs_[1][ci] * dir_sh[n].y +
+                                     coeffs_[2][ci] * dir_sh[n].z +
+                                     coeffs_[3][ci] * dir_sh[n].w;
+                    }
+
+                    transmittance_[n][i] = 1.f - std::min(std::max(occlusion * 0.25f, 0.f), 1.f);
+                }
+            }
+        });
+    }
+
+    DirectX::XMFLOAT4 geometry_volume::get(size_t x, size_t y, size_t z) const
+    {
+        size_t i = corner_index(x, y, z);
+        return DirectX::XMFLOAT4(coeffs_[0][i], coeffs_[1][i], coeffs_[2][i], coeffs_[3][i]);
+    }
+}
@@ -0,0 +1,105 @@
+/*
+ * Dune D3D library - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+/*! \file */
+
+#ifndef DUNE_GEOMETRY_VOLUME
+#define DUNE_GEOMETRY_VOLUME
+
+#include <vector>
+
+#include <DirectXMath.h>
+
+#include "lpv_grid.h"
+
+namespace dune
+{
+    /*! \brief A small oriented surface element. */
+    struct surfel
+    {
+        DirectX::XMFLOAT3 position;
+        DirectX::XMFLOAT3 normal;   //!< normalized
+        float area;                 //!< in world units
+    };
+
+    /*!
+     * \brief Generate surfels from a gbuffer.
+     *
+     * Works on any buffer with the RSM layout of rsm_data, i.e. an RSM or the gbuffer of a camera. The area of each
+     * surfel is the footprint of its texel on the surface.
+     *
+     * \param buffer The normals and linear depth of the gbuffer.
+     * \param vp_inv The inverse view projection matrix the gbuffer was rendered with.
+     * \param eye The position the gbuffer was rendered from.
+     * \param stride Generate one surfel every stride texels.
+     * \param surfels The generated surfels.
+     */
+    void generate_surfels(const rsm_data& buffer, const DirectX::XMFLOAT4X4& vp_inv, const DirectX::XMFLOAT3& eye, size_t stride, std::vector<surfel>& surfels);
+
+    /*!
+     * \brief A geometry volume (GV) for LPV occlusion.
+     *
+     * A geometry volume stores the blocking potential of surfaces as SH, as described in [[Kaplanyan and Dachsbacher 2010]](http://dl.acm.org/citation.cfm?id=1730804).
+     * Its cells are offset by half a cell from the LPV, i.e. they sit on the corners of LPV cells, so a GV of an LPV with
+     * w x h x d cells has (w+1) x (h+1) x (d+1) cells. Each surfel adds the clamped cosine lobe of its normal scaled by its
+     * area relative to a cell face to the closest GV cell.
+     *
+     * After injecting, update() computes the fraction of flux that passes each face of each LPV cell, which lpv_grid
+     * uses to attenuate propagation.
+     */
+    class geometry_volume
+    {
+    protected:
+        size_t                  width_, height_, depth_;
+
+        std::vector<float>      coeffs_[4];
+        std::vector<float>      transmittance_[6];
+
+        DirectX::XMFLOAT4X4     world_to_lpv_;
+        DirectX::XMFLOAT4X4     normal_to_lpv_;     //!< inverse transpose of world_to_lpv_
+        float                   face_area_;
+
+    protected:
+        size_t corner_index(size_t x, size_t y, size_t z) const { return (z * (height_ + 1) + y) * (width_ + 1) + x; }
+
+    public:
+        geometry_volume();
+        virtual ~geometry_volume() {}
+
+        /*! \brief Create a geometry volume for an LPV of width x height x depth cells. */
+        void create(size_t width, size_t height, size_t depth);
+        void destroy();
+
+        /*! \brief Remove all blocking potential. */
+        void clear();
+
+        size_t width() const  { return width_; }
+        size_t height() const { return height_; }
+        size_t depth() const  { return depth_; }
+
+        /*! \brief Set the transformation of the volume, which should be the same as the one of the LPV. */
+        void set_model_matrix(const DirectX::XMFLOAT4X4& model, const DirectX::XMFLOAT3& lpv_min, const DirectX::XMFLOAT3& lpv_max);
+
+        /*! \brief Add the blocking potential of surfels. Call update() afterwards. */
+        void inject(const std::vector<surfel>& surfels);
+
+        /*! \brief Recompute the transmittance of all LPV cell faces. */
+        void update();
+
+        /*! \brief Returns the blocking potential SH of the GV cell at an LPV cell corner. */
+        DirectX::XMFLOAT4 get(size_t x, size_t y, size_t z) const;
+
+        /*!
+         * \brief Returns the transmittance of flux from a neighbor into each LPV cell.
+         *
+         * \param neighbor The neighbor index in the order of offsets[] in lpv_propagate.hlsl.
+         * \return An array with one value in [0, 1] per LPV cell, padded like the arrays of an sh_volume.
+         */
+        const float* transmittance(size_t neighbor) const { return &transmittance_[neighbor][0]; }
+    };
+}
+
+#endif
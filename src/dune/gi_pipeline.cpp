@@ -0,0 +1,76 @@
+/*
+ * Dune D3D library - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+#include "gi_pipeline.h"
+
+#include <cassert>
+
+namespace dune
+{
+    gi_pipeline::gi_pipeline() :
+        stages_(),
+        runs_(),
+        changed_(0)
+    {
+        stats_.frames = 0;
+        stats_.changed = 0;
+    }
+
+    void gi_pipeline::destroy()
+    {
+        stages_.clear();
+        runs_.clear();
+        changed_ = 0;
+
+        stats_.frames = 0;
+        stats_.changed = 0;
+        stats_.ran.clear();
+        stats_.runs.clear();
+    }
+
+    size_t gi_pipeline::add_stage(const tstring& name, uint32_t inputs, const std::vector<size_t>& dependencies)
+    {
+        const size_t index = stages_.size();
+
+        for (auto d = dependencies.begin(); d != dependencies.end(); ++d)
+            assert(*d < index);
+
+        stage s = { name, inputs, dependencies };
+        stages_.push_back(s);
+
+        runs_.push_back(false);
+        stats_.runs.push_back(0);
+
+        return index;
+    }
+
+    void gi_pipeline::schedule()
+    {
+        ++stats_.frames;
+        stats_.changed = changed_;
+        stats_.ran.clear();
+
+        // dependencies come first, so one pass propagates runs downstream
+        for (size_t i = 0; i < stages_.size(); ++i)
+        {
+            // a stage which never ran has no results yet
+            bool run = stats_.runs[i] == 0 || (stages_[i].inputs & changed_) != 0;
+
+            for (auto d = stages_[i].dependencies.begin(); d != stages_[i].dependencies.end() && !run; ++d)
+                run = runs_[*d];
+
+            runs_[i] = run;
+
+            if (run)
+            {
+                stats_.ran.push_back(i);
+                ++stats_.runs[i];
+            }
+        }
+
+        changed_ = 0;
+    }
+}
@@ -0,0 +1,108 @@
+/*
+ * Dune D3D library - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+/*! \file */
+
+#ifndef DUNE_GI_PIPELINE
+#define DUNE_GI_PIPELINE
+
+#include <cstdint>
+#include <vector>
+
+#include "unicode.h"
+
+namespace dune
+{
+    /*! \brief The stages a gi_pipeline ran with the last schedule(). */
+    struct gi_pipeline_stats
+    {
+        /*! \brief The number of calls to schedule(). */
+        size_t frames;
+
+        /*! \brief The inputs which were invalidated before the last schedule(). */
+        uint32_t changed;
+
+        /*! \brief The stages which ran with the last schedule(), in the order they were added. */
+        std::vector<size_t> ran;
+
+        /*! \brief How often each stage ran since it was added. */
+        std::vector<size_t> runs;
+    };
+
+    /*!
+     * \brief A dependency graph of the stages of a GI solution.
+     *
+     * Rendering the RSM, voxelizing, injecting, filtering and propagating all depend on different inputs: a light
+     * change leaves the voxels as they are, a GI parameter which only scales the result in the deferred shader needs
+     * none of them, and a camera change never invalidates the GI volume. Each stage is added with the inputs it reads
+     * and the stages it consumes the results of. Changed inputs are collected with invalidate(), and schedule()
+     * decides once per frame which stages run: those with a changed input, and all stages depending on a stage that
+     * runs. Stages are added after the stages they depend on, so that is also the order they run in.
+     */
+    class gi_pipeline
+    {
+    public:
+        /*! \brief The inputs of GI stages. */
+        enum input
+        {
+            GEOMETRY        = 1 << 0,   //!< meshes were loaded or moved
+            WORLD           = 1 << 1,   //!< the world matrix of the scene or the bounding box of the GI volume
+            LIGHT           = 1 << 2,   //!< the parameters of the light
+            GI_PARAMETERS   = 1 << 3,   //!< the parameters of the GI volume
+            VOLUME_WINDOW   = 1 << 4,   //!< the window of a GI volume following the camera moved
+            ALL             = 0x1f
+        };
+
+    protected:
+        struct stage
+        {
+            tstring name;
+            uint32_t inputs;
+            std::vector<size_t> dependencies;
+        };
+
+        std::vector<stage>  stages_;
+        std::vector<bool>   runs_;
+        uint32_t            changed_;
+        gi_pipeline_stats   stats_;
+
+    public:
+        gi_pipeline();
+        virtual ~gi_pipeline() {}
+
+        /*! \brief Remove all stages. */
+        void destroy();
+
+        /*!
+         * \brief Add a stage.
+         *
+         * \param name The name of the stage for the stats.
+         * \param inputs The inputs the stage reads, a combination of input flags.
+         * \param dependencies Stages added before whose results this stage reads.
+         * \return The index of the stage. A new stage runs with the next schedule().
+         */
+        size_t add_stage(const tstring& name, uint32_t inputs, const std::vector<size_t>& dependencies = std::vector<size_t>());
+
+        size_t num_stages() const { return stages_.size(); }
+        const tstring& name(size_t stage) const { return stages_[stage].name; }
+
+        /*! \brief Mark inputs as changed, i.e. the stages reading them run with the next schedule(). */
+        void invalidate(uint32_t inputs) { changed_ |= inputs; }
+
+        /*! \brief Decide which stages run this frame and reset the changed inputs. */
+        void schedule();
+
+        /*! \brief Returns true if a stage runs this frame. */
+        bool runs(size_t stage) const { return runs_[stage]; }
+
+        /*! \brief Returns true if any stage runs this frame. */
+        bool busy() const { return !stats_.ran.empty(); }
+
+        const gi_pipeline_stats& stats() const { return stats_; }
+    };
+}
+
+#endif
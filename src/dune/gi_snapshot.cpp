@@ -0,0 +1,340 @@
+/*
+ * Dune D3D library - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+#include "gi_snapshot.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include "exception.h"
+
+namespace dune
+{
+    namespace detail
+    {
+        const char SNAPSHOT_MAGIC[4] = { 'D', 'G', 'I', 'S' };
+        const uint32_t SNAPSHOT_VERSION = 1;
+
+        const uint32_t SNAPSHOT_COMPRESSED = 1;
+
+        // largest volume a snapshot accepts, to reject garbage before allocating: the 256^3 half4 texels of an SVO
+        // volume, the largest the renderers create
+        const uint64_t SNAPSHOT_MAX_VOLUME_SIZE = 256ull * 256 * 256 * 8;
+
+        template<typename T>
+        void write_pod(std::ostream& os, const T& v)
+        {
+            os.write(reinterpret_cast<const char*>(&v), sizeof(T));
+        }
+
+        template<typename T>
+        bool read_pod(std::istream& is, T& v)
+        {
+            return static_cast<bool>(is.read(reinterpret_cast<char*>(&v), sizeof(T)));
+        }
+
+        inline uint16_t load_word(const unsigned char* p)
+        {
+            uint16_t w;
+            std::memcpy(&w, p, 2);
+            return w;
+        }
+
+        inline void store_word(std::vector<unsigned char>& v, uint16_t w)
+        {
+            unsigned char b[2];
+            std::memcpy(b, &w, 2);
+            v.insert(v.end(), b, b + 2);
+        }
+    }
+
+    uint64_t hash_bytes(const void* data, size_t size, uint64_t hash)
+    {
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash ^= p[i];
+            hash *= 1099511628211ull;
+        }
+
+        return hash;
+    }
+
+    void compress_zero_runs(const unsigned char* data, size_t size, std::vector<unsigned char>& compressed)
+    {
+        const size_t num_words = size / 2;
+        const size_t max_run = 0xffff;
+
+        compressed.clear();
+
+        size_t i = 0;
+
+        while (i < num_words)
+        {
+            size_t zeros = 0;
+
+            while (i + zeros < num_words && zeros < max_run && detail::load_word(data + (i + zeros) * 2) == 0)
+                ++zeros;
+
+            i += zeros;
+
+            // literals end at the next pair of zero words, a single zero is cheaper to keep
+            size_t literals = 0;
+
+            while (i + literals < num_words && literals < max_run)
+            {
+                if (detail::load_word(data + (i + literals) * 2) == 0 &&
+                    (i + literals + 1 >= num_words || detail::load_word(data + (i + literals + 1) * 2) == 0))
+                    break;
+
+                ++literals;
+            }
+
+            detail::store_word(compressed, static_cast<uint16_t>(zeros));
+            detail::store_word(compressed, static_cast<uint16_t>(literals));
+
+            compressed.insert(compressed.end(), data + i * 2, data + (i + literals) * 2);
+
+            i += literals;
+        }
+    }
+
+    bool decompress_zero_runs(const unsigned char* compressed, size_t compressed_size, unsigned char* data, size_t size)
+    {
+        size_t in = 0, out = 0;
+
+        while (in + 4 <= compressed_size)
+        {
+            size_t zeros = detail::load_word(compressed + in) * 2;
+            size_t literals = detail::load_word(compressed + in + 2) * 2;
+
+            in += 4;
+
+            if (out + zeros + literals > size || in + literals > compressed_size)
+                return false;
+
+            std::fill(data + out, data + out + zeros, 0);
+            out += zeros;
+
+            std::copy(compressed + in, compressed + in + literals, data + out);
+            out += literals;
+            in += literals;
+        }
+
+        return in == compressed_size && out == size;
+    }
+
+    gi_snapshot::gi_snapshot() :
+        key_(0),
+        volumes_()
+    {
+    }
+
+    void gi_snapshot::clear()
+    {
+        key_ = 0;
+        volumes_.clear();
+    }
+
+    snapshot_volume& gi_snapshot::add(const std::string& name, uint32_t width, uint32_t height, uint32_t depth, uint32_t texel_size)
+    {
+        snapshot_volume v;
+        v.name = name;
+        v.width = width;
+        v.height = height;
+        v.depth = depth;
+        v.texel_size = texel_size;
+        v.data.resize(static_cast<size_t>(width) * height * depth * texel_size);
+
+        volumes_.push_back(std::move(v));
+
+        return volumes_.back();
+    }
+
+    const snapshot_volume* gi_snapshot::find(const std::string& name) const
+    {
+        for (auto v = volumes_.begin(); v != volumes_.end(); ++v)
+            if (v->name == name)
+                return &*v;
+
+        return nullptr;
+    }
+
+    void gi_snapshot::write(std::ostream& os, bool compress) const
+    {
+        os.write(detail::SNAPSHOT_MAGIC, 4);
+        detail::write_pod(os, detail::SNAPSHOT_VERSION);
+        detail::write_pod(os, key_);
+        detail::write_pod(os, static_cast<uint32_t>(volumes_.size()));
+
+        std::vector<unsigned char> compressed;
+
+        for (auto v = volumes_.begin(); v != volumes_.end(); ++v)
+        {
+            detail::write_pod(os, static_cast<uint32_t>(v->name.size()));
+            os.write(v->name.data(), v->name.size());
+
+            detail::write_pod(os, v->width);
+            detail::write_pod(os, v->height);
+            detail::write_pod(os, v->depth);
+            detail::write_pod(os, v->texel_size);
+
+            const unsigned char* data = v->data.empty() ? nullptr : &v->data[0];
+            uint64_t stored_size = v->data.size();
+            uint32_t flags = 0;
+
+            // only keep the compressed version if it is actually smaller
+            if (compress && v->data.size() % 2 == 0 && !v->data.empty())
+            {
+                compress_zero_runs(data, v->data.size(), compressed);
+
+                if (compressed.size() < v->data.size())
+                {
+                    data = &compressed[0];
+                    stored_size = compressed.size();
+                    flags |= detail::SNAPSHOT_COMPRESSED;
+                }
+            }
+
+            detail::write_pod(os, flags);
+            detail::write_pod(os, stored_size);
+
+            if (stored_size > 0)
+                os.write(reinterpret_cast<const char*>(data), stored_size);
+        }
+    }
+
+    bool gi_snapshot::read(std::istream& is)
+    {
+        clear();
+
+        char magic[4];
+        uint32_t version, num_volumes;
+        uint64_t key;
+
+        if (!is.read(magic, 4) || !std::equal(magic, magic + 4, detail::SNAPSHOT_MAGIC))
+            return false;
+
+        if (!detail::read_pod(is, version) || version != detail::SNAPSHOT_VERSION)
+            return false;
+
+        if (!detail::read_pod(is, key) || !detail::read_pod(is, num_volumes))
+            return false;
+
+        std::vector<unsigned char> stored;
+
+        for (uint32_t i = 0; i < num_volumes; ++i)
+        {
+            uint32_t name_size, width, height, depth, texel_size, flags;
+            uint64_t stored_size;
+
+            if (!detail::read_pod(is, name_size) || name_size > 1024)
+            {
+                clear();
+                return false;
+            }
+
+            std::string name(name_size, ' ');
+
+            if (name_size > 0 && !is.read(&name[0], name_size))
+            {
+                clear();
+                return false;
+            }
+
+            if (!detail::read_pod(is, width) || !detail::read_pod(is, height) || !detail::read_pod(is, depth) ||
+                !detail::read_pod(is, texel_size) || !detail::read_pod(is, flags) || !detail::read_pod(is, stored_size))
+            {
+                clear();
+                return false;
+            }
+
+            uint64_t size = static_cast<uint64_t>(width) * height * depth * texel_size;
+
+            // write() only keeps a compressed volume which is smaller
+            if (size > detail::SNAPSHOT_MAX_VOLUME_SIZE || stored_size > size)
+            {
+                clear();
+                return false;
+            }
+
+            snapshot_volume& v = add(name, width, height, depth, texel_size);
+
+            bool ok = true;
+
+            if (flags & detail::SNAPSHOT_COMPRESSED)
+            {
+                stored.resize(static_cast<size_t>(stored_size));
+
+                ok = (stored_size == 0 || is.read(reinterpret_cast<char*>(&stored[0]), stored_size)) &&
+                     decompress_zero_runs(stored.empty() ? nullptr : &stored[0], stored.size(), v.data.empty() ? nullptr : &v.data[0], v.data.size());
+            }
+            else
+            {
+                ok = stored_size == size &&
+                     (size == 0 || is.read(reinterpret_cast<char*>(&v.data[0]), size));
+            }
+
+            if (!ok)
+            {
+                clear();
+                return false;
+            }
+        }
+
+        key_ = key;
+
+        return true;
+    }
+
+    void gi_snapshot::save(const tstring& filename, bool compress) const
+    {
+        // write next to the old snapshot and replace it only once the new one is complete
+        const std::string path = to_string(filename);
+        const std::string temp = path + ".tmp";
+
+        {
+            std::ofstream f(temp.c_str(), std::ios::binary);
+
+            if (!f)
+                throw dune::exception(L"Cannot write GI snapshot " + filename);
+
+            write(f, compress);
+            f.flush();
+
+            if (!f)
+            {
+                f.close();
+                std::remove(temp.c_str());
+                throw dune::exception(L"Cannot write GI snapshot " + filename);
+            }
+        }
+
+        std::remove(path.c_str());
+
+        if (std::rename(temp.c_str(), path.c_str()) != 0)
+        {
+            std::remove(temp.c_str());
+            throw dune::exception(L"Cannot write GI snapshot " + filename);
+        }
+    }
+
+    bool gi_snapshot::load(const tstring& filename)
+    {
+        std::ifstream f(to_string(filename).c_str(), std::ios::binary);
+
+        if (!f)
+        {
+            clear();
+            return false;
+        }
+
+        return read(f);
+    }
+}
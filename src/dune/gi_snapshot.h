@@ -0,0 +1,117 @@
+/*
+ * Dune D3D library - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+/*! \file */
+
+#ifndef DUNE_GI_SNAPSHOT
+#define DUNE_GI_SNAPSHOT
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "unicode.h"
+
+namespace dune
+{
+    /*! \brief The raw texels of one volume in a gi_snapshot. */
+    struct snapshot_volume
+    {
+        std::string name;
+        uint32_t width, height, depth;
+        uint32_t texel_size;                //!< in bytes
+        std::vector<unsigned char> data;    //!< tightly packed, x fastest, then y, then z
+    };
+
+    /*!
+     * \brief A snapshot of the volumes of a GI solution.
+     *
+     * A snapshot holds the raw texels of a number of volumes, usually half floats straight from the textures
+     * of a light_propagation_volume or sparse_voxel_octree, and a key which identifies the scene and lighting
+     * they were computed for. Snapshots of static lighting can be written to disk and loaded at the next start
+     * instead of recomputing the volumes.
+     *
+     * On disk, volumes can optionally be compressed with a run-length encoding of zero 16 bit words, which are
+     * the bulk of most GI volumes.
+     */
+    class gi_snapshot
+    {
+    protected:
+        uint64_t key_;
+        std::vector<snapshot_volume> volumes_;
+
+    public:
+        gi_snapshot();
+        virtual ~gi_snapshot() {}
+
+        //!@{
+        /*! \brief Get/set the key identifying the scene and lighting of the snapshot. */
+        uint64_t key() const { return key_; }
+        void set_key(uint64_t key) { key_ = key; }
+        //!@}
+
+        /*! \brief Remove all volumes. */
+        void clear();
+
+        /*!
+         * \brief Add a volume and return its texel storage.
+         *
+         * \param name A unique name of the volume.
+         * \param width The width of the volume in texels.
+         * \param height The height of the volume in texels.
+         * \param depth The depth of the volume in texels.
+         * \param texel_size The size of a texel in bytes.
+         * \return The volume, whose data is sized but not initialized.
+         */
+        snapshot_volume& add(const std::string& name, uint32_t width, uint32_t height, uint32_t depth, uint32_t texel_size);
+
+        /*! \brief Returns the volume with the given name, or nullptr if there is none. */
+        const snapshot_volume* find(const std::string& name) const;
+
+        size_t size() const { return volumes_.size(); }
+
+        /*! \brief Write the snapshot to a stream. */
+        void write(std::ostream& os, bool compress) const;
+
+        /*!
+         * \brief Read a snapshot from a stream.
+         *
+         * Volumes larger than an SVO of 256^3 half4 texels, the largest volume the renderers create, are rejected
+         * before they are allocated.
+         *
+         * \return False if the stream does not contain a valid snapshot, in which case the snapshot is empty.
+         */
+        bool read(std::istream& is);
+
+        //!@{
+        /*!
+         * \brief Write/read a snapshot to/from a binary file.
+         *
+         * save() writes into a temporary file first, which replaces filename once it was written completely.
+         * \throws exception The file can't be written.
+         */
+        void save(const tstring& filename, bool compress = true) const;
+        bool load(const tstring& filename);
+        //!@}
+    };
+
+    /*! \brief Combine the FNV-1a hash of size bytes with a previous hash. */
+    uint64_t hash_bytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ull);
+
+    //!@{
+    /*!
+     * \brief Compress/decompress a buffer of 16 bit words with a run-length encoding of zero words.
+     *
+     * The compressed stream is a sequence of pairs of 16 bit counts: a number of zero words and a number of
+     * literal words, which follow the pair.
+     */
+    void compress_zero_runs(const unsigned char* data, size_t size, std::vector<unsigned char>& compressed);
+    bool decompress_zero_runs(const unsigned char* compressed, size_t compressed_size, unsigned char* data, size_t size);
+    //!@}
+}
+
+#endif
@@ -0,0 +1,484 @@
+/*
+ * Dune D3D library - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+#include "ibl_tools.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <ctime>
+#include <fstream>
+
+#include <sys/stat.h>
+
+#include <DirectXPackedVector.h>
+
+#ifdef _MSC_VER
+#pragma warning(disable: 4996)
+#endif
+#define STBI_HEADER_FILE_ONLY
+#include "../ext/stb/stb_image.h"
+
+#include "common_tools.h"
+#include "exception.h"
+#include "frame_profiler.h"
+#include "math_tools.h"
+#include "parallel_tools.h"
+
+namespace dune
+{
+    namespace detail
+    {
+        // legacy D3DFMT_A16B16G16R16F, mapped to DXGI_FORMAT_R16G16B16A16_FLOAT by every DDS loader
+        const uint32_t DDS_FOURCC_RGBA16F = 113;
+
+        struct dds_pixelformat
+        {
+            uint32_t size, flags, fourcc, rgb_bit_count;
+            uint32_t r_mask, g_mask, b_mask, a_mask;
+        };
+
+        struct dds_header
+        {
+            uint32_t size, flags, height, width, pitch, depth, mip_map_count;
+            uint32_t reserved1[11];
+            dds_pixelformat ddspf;
+            uint32_t caps, caps2, caps3, caps4, reserved2;
+        };
+
+        struct ggx_sample
+        {
+            DirectX::XMFLOAT3 L;
+            float NoL;
+            float lod;
+        };
+
+        float D_ggx(float a, float NoH)
+        {
+            float d = a / (NoH*NoH * (a*a - 1.f) + 1.f);
+            return d*d / PI;
+        }
+
+        float G_smith(float a, float NoV, float NoL)
+        {
+            float k = a / 2.f;
+            return (NoV / (NoV * (1.f - k) + k)) * (NoL / (NoL * (1.f - k) + k));
+        }
+
+        // tangent space half vector, same as importance_sample_ggx() in importance.hlsl
+        DirectX::XMFLOAT3 importance_sample_ggx(const DirectX::XMFLOAT2& xi, float a)
+        {
+            float phi = 2.f * PI * xi.x;
+            float cos_theta = std::sqrt((1.f - xi.y) / (1.f + (a*a - 1.f) * xi.y));
+            float sin_theta = std::sqrt(1.f - cos_theta * cos_theta);
+
+            return DirectX::XMFLOAT3(sin_theta * std::cos(phi), sin_theta * std::sin(phi), cos_theta);
+        }
+
+        // same mapping as latlong() in importance.hlsl
+        DirectX::XMFLOAT3 latlong_to_dir(float u, float v)
+        {
+            float phi = 2.f * PI * u - PI/2.f;
+            float theta = PI * v;
+
+            return DirectX::XMFLOAT3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+        }
+
+        void dir_to_latlong(DirectX::FXMVECTOR d, float& u, float& v)
+        {
+            DirectX::XMFLOAT3 n;
+            DirectX::XMStoreFloat3(&n, DirectX::XMVector3Normalize(d));
+
+            u = (std::atan2(n.z, n.x) + PI/2.f) / (2.f * PI);
+            u -= std::floor(u);
+
+            v = std::acos(std::max(-1.f, std::min(1.f, n.y))) / PI;
+        }
+
+        // bilinear lookup, wrapping horizontally and clamping vertically
+        DirectX::XMVECTOR sample_bilinear(const float_image& img, float u, float v)
+        {
+            float x = u * img.width - 0.5f;
+            float y = v * img.height - 0.5f;
+
+            float fx = std::floor(x), fy = std::floor(y);
+            float tx = x - fx, ty = y - fy;
+
+            const int w = static_cast<int>(img.width);
+            const int h = static_cast<int>(img.height);
+
+            int x0 = (static_cast<int>(fx) % w + w) % w;
+            int x1 = (x0 + 1) % w;
+            int y0 = std::max(0, std::min(h - 1, static_cast<int>(fy)));
+            int y1 = std::max(0, std::min(h - 1, static_cast<int>(fy) + 1));
+
+            DirectX::XMVECTOR a = DirectX::XMVectorLerp(DirectX::XMLoadFloat4(&img(x0, y0)), DirectX::XMLoadFloat4(&img(x1, y0)), tx);
+            DirectX::XMVECTOR b = DirectX::XMVectorLerp(DirectX::XMLoadFloat4(&img(x0, y1)), DirectX::XMLoadFloat4(&img(x1, y1)), tx);
+
+            return DirectX::XMVectorLerp(a, b, ty);
+        }
+
+        DirectX::XMVECTOR sample_trilinear(const std::vector<float_image>& chain, float u, float v, float lod)
+        {
+            lod = std::max(0.f, std::min(lod, static_cast<float>(chain.size() - 1)));
+
+            size_t l0 = static_cast<size_t>(lod);
+            size_t l1 = std::min(l0 + 1, chain.size() - 1);
+
+            DirectX::XMVECTOR a = sample_bilinear(chain[l0], u, v);
+
+            if (l0 == l1)
+                return a;
+
+            return DirectX::XMVectorLerp(a, sample_bilinear(chain[l1], u, v), lod - l0);
+        }
+
+        // 2x2 box filtered mip chain of a latlong map down to a single row
+        void build_mip_chain(const float_image& env, std::vector<float_image>& chain)
+        {
+            chain.clear();
+            chain.push_back(env);
+
+            while (chain.back().width > 1 && chain.back().height > 1)
+            {
+                const float_image& src = chain.back();
+
+                float_image dst;
+                dst.create(src.width / 2, src.height / 2);
+
+                for (size_t y = 0; y < dst.height; ++y)
+                for (size_t x = 0; x < dst.width; ++x)
+                {
+                    DirectX::XMVECTOR s = DirectX::XMLoadFloat4(&src(x*2, y*2));
+                    s = DirectX::XMVectorAdd(s, DirectX::XMLoadFloat4(&src(x*2 + 1, y*2)));
+                    s = DirectX::XMVectorAdd(s, DirectX::XMLoadFloat4(&src(x*2, y*2 + 1)));
+                    s = DirectX::XMVectorAdd(s, DirectX::XMLoadFloat4(&src(x*2 + 1, y*2 + 1)));
+
+                    DirectX::XMStoreFloat4(&dst(x, y), DirectX::XMVectorScale(s, 0.25f));
+                }
+
+                chain.push_back(dst);
+            }
+        }
+
+        float luminance(DirectX::FXMVECTOR c)
+        {
+            return DirectX::XMVectorGetX(DirectX::XMVector3Dot(c, DirectX::XMVectorSet(0.2126f, 0.7152f, 0.0722f, 0.f)));
+        }
+
+        /*! \brief Returns the last modification time of a file, or zero if it doesn't exist. */
+        time_t file_time(const tstring& file)
+        {
+            struct stat s;
+            if (stat(to_string(file).c_str(), &s) != 0)
+                return 0;
+            return s.st_mtime;
+        }
+
+        /*! \brief Returns true if output is missing or older than source. */
+        bool is_stale(const tstring& output, const tstring& source)
+        {
+            time_t t = file_time(output);
+            return t == 0 || t < file_time(source);
+        }
+    }
+
+    void float_image::create(size_t w, size_t h)
+    {
+        width = w;
+        height = h;
+        texels.assign(w * h, DirectX::XMFLOAT4(0.f, 0.f, 0.f, 0.f));
+    }
+
+    void load_environment(const tstring& file, float_image& env)
+    {
+        int width, height, nc;
+
+        float* data = stbi_loadf(to_string(file).c_str(), &width, &height, &nc, 4);
+
+        if (!data)
+        {
+            tstring error = L"can't load";
+
+            if (stbi_failure_reason())
+                error = to_tstring(std::string(stbi_failure_reason()));
+
+            throw exception(tstring(L"stbi: ") + error);
+        }
+
+        env.create(width, height);
+        std::copy(data, data + width * height * 4, &env.texels[0].x);
+
+        stbi_image_free(data);
+    }
+
+    float prefilter_environment(const float_image& env, size_t width, size_t num_mips, size_t num_samples, std::vector<float_image>& mips)
+    {
+        std::vector<float_image> chain;
+        detail::build_mip_chain(env, chain);
+
+        // solid angle of a texel of the source map
+        const float omega_p = 4.f * PI / static_cast<float>(env.width * env.height);
+
+        std::vector<float> errors(num_mips, 0.f);
+
+        mips.resize(num_mips);
+
+        for (size_t m = 0; m < num_mips; ++m)
+        {
+            float_image& mip = mips[m];
+            mip.create(std::max<size_t>(width >> m, 1), std::max<size_t>((width/2) >> m, 1));
+
+            float roughness = num_mips > 1 ? static_cast<float>(m) / static_cast<float>(num_mips - 1) : 0.f;
+            float a = roughness * roughness;
+
+            // never sample finer than the output resolution
+            float min_lod = std::log2(static_cast<float>(env.width) / static_cast<float>(mip.width));
+
+            // with N = V = R the set of light directions in tangent space is the same for every texel,
+            // a second set with half the samples is used to estimate the error
+            std::vector<detail::ggx_sample> samples[2];
+
+            for (size_t n = 0; n < 2; ++n)
+            {
+                const size_t count = n == 0 ? num_samples : std::max<size_t>(num_samples / 2, 1);
+
+                for (size_t i = 0; i < count; ++i)
+                {
+                    DirectX::XMFLOAT3 H = detail::importance_sample_ggx(hammersley2d(static_cast<unsigned int>(i), static_cast<unsigned int>(count)), a);
+
+                    float NoH = H.z;
+
+                    detail::ggx_sample s;
+                    s.L = DirectX::XMFLOAT3(2.f * NoH * H.x, 2.f * NoH * H.y, 2.f * NoH * H.z - 1.f);
+                    s.NoL = std::max(s.L.z, 0.f);
+
+                    // filtered importance sampling, pdf = D * NoH / (4 * VoH) with VoH = NoH
+                    float pdf = detail::D_ggx(a, NoH) / 4.f;
+                    float omega_s = 1.f / (static_cast<float>(count) * pdf + 0.0001f);
+
+                    s.lod = (a == 0.f) ? min_lod : std::max(min_lod, 0.5f * std::log2(omega_s / omega_p) + 1.f);
+
+                    if (s.NoL > 0.f)
+                        samples[n].push_back(s);
+                }
+            }
+
+            std::vector<float> row_errors(mip.height, 0.f);
+
+            parallel_for(0, mip.height, [&](size_t first, size_t last)
+            {
+                for (size_t y = first; y < last; ++y)
+                for (size_t x = 0; x < mip.width; ++x)
+                {
+                    DirectX::XMFLOAT3 n = detail::latlong_to_dir((x + 0.5f) / mip.width, (y + 0.5f) / mip.height);
+
+                    DirectX::XMVECTOR N = DirectX::XMLoadFloat3(&n);
+                    DirectX::XMVECTOR up = std::abs(n.z) < 0.999f ? DirectX::XMVectorSet(0.f, 0.f, 1.f, 0.f) : DirectX::XMVectorSet(1.f, 0.f, 0.f, 0.f);
+                    DirectX::XMVECTOR tx = DirectX::XMVector3Normalize(DirectX::XMVector3Cross(up, N));
+                    DirectX::XMVECTOR ty = DirectX::XMVector3Cross(N, tx);
+
+                    DirectX::XMVECTOR result[2];
+
+                    for (size_t n = 0; n < 2; ++n)
+                    {
+                        DirectX::XMVECTOR sum = DirectX::XMVectorZero();
+                        float weight = 0.f;
+
+                        for (auto s = samples[n].begin(); s != samples[n].end(); ++s)
+                        {
+                            DirectX::XMVECTOR L = DirectX::XMVectorScale(tx, s->L.x);
+                            L = DirectX::XMVectorMultiplyAdd(ty, DirectX::XMVectorReplicate(s->L.y), L);
+                            L = DirectX::XMVectorMultiplyAdd(N, DirectX::XMVectorReplicate(s->L.z), L);
+
+                            float u, v;
+                            detail::dir_to_latlong(L, u, v);
+
+                            DirectX::XMVECTOR c = detail::sample_trilinear(chain, u, v, s->lod);
+
+                            sum = DirectX::XMVectorMultiplyAdd(c, DirectX::XMVectorReplicate(s->NoL), sum);
+                            weight += s->NoL;
+                        }
+
+                        result[n] = DirectX::XMVectorScale(sum, 1.f / std::max(weight, 0.0001f));
+                    }
+
+                    DirectX::XMStoreFloat4(&mip(x, y), DirectX::XMVectorSetW(result[0], 1.f));
+
+                    float diff = detail::luminance(DirectX::XMVectorAbs(DirectX::XMVectorSubtract(result[0], result[1])));
+                    row_errors[y] += diff / std::max(detail::luminance(result[0]), 0.0001f);
+                }
+            });
+
+            for (size_t y = 0; y < mip.height; ++y)
+                errors[m] += row_errors[y];
+
+            errors[m] /= static_cast<float>(mip.width * mip.height);
+        }
+
+        float error = 0.f;
+
+        for (size_t m = 0; m < num_mips; ++m)
+            error = std::max(error, errors[m]);
+
+        return error;
+    }
+
+    float integrate_brdf(size_t size, size_t num_samples, float_image& lut)
+    {
+        lut.create(size, size);
+
+        std::vector<float> row_errors(size, 0.f);
+
+        parallel_for(0, size, [&](size_t first, size_t last)
+        {
+            for (size_t y = first; y < last; ++y)
+            for (size_t x = 0; x < size; ++x)
+            {
+                float NoV = (x + 0.5f) / size;
+                float roughness = (y + 0.5f) / size;
+                float a = roughness * roughness;
+
+                // N = (0,0,1)
+                float Vx = std::sqrt(1.f - NoV * NoV);
+                float Vz = NoV;
+
+                // second integration with half the samples to estimate the error
+                float A[2] = { 0.f, 0.f };
+                float B[2] = { 0.f, 0.f };
+
+                for (size_t n = 0; n < 2; ++n)
+                {
+                    const size_t count = n == 0 ? num_samples : std::max<size_t>(num_samples / 2, 1);
+
+                    for (size_t i = 0; i < count; ++i)
+                    {
+                        DirectX::XMFLOAT3 H = detail::importance_sample_ggx(hammersley2d(static_cast<unsigned int>(i), static_cast<unsigned int>(count)), a);
+
+                        float VoH = Vx * H.x + Vz * H.z;
+                        float Lz = 2.f * VoH * H.z - Vz;
+
+                        float NoL = std::max(Lz, 0.f);
+                        float NoH = std::max(H.z, 0.f);
+                        VoH = std::max(VoH, 0.f);
+
+                        if (NoL > 0.f)
+                        {
+                            float G = detail::G_smith(a, NoV, NoL);
+                            float G_vis = G * VoH / (NoH * NoV);
+                            float Fc = std::pow(1.f - VoH, 5.f);
+
+                            A[n] += (1.f - Fc) * G_vis;
+                            B[n] += Fc * G_vis;
+                        }
+                    }
+
+                    A[n] /= count;
+                    B[n] /= count;
+                }
+
+                lut(x, y) = DirectX::XMFLOAT4(A[0], B[0], 0.f, 1.f);
+
+                float diff = std::abs(A[0] - A[1]) + std::abs(B[0] - B[1]);
+                row_errors[y] += diff / std::max(A[0] + B[0], 0.0001f);
+            }
+        });
+
+        float error = 0.f;
+
+        for (size_t y = 0; y < size; ++y)
+            error += row_errors[y];
+
+        return error / static_cast<float>(size * size);
+    }
+
+    void save_dds(const tstring& file, const std::vector<float_image>& mips)
+    {
+        if (mips.empty())
+            throw exception(L"dds: No data to save");
+
+        std::ofstream f(to_string(file).c_str(), std::ios::binary);
+
+        if (!f.good())
+            throw exception(L"dds: Can't write " + file);
+
+        detail::dds_header header;
+        std::fill(reinterpret_cast<char*>(&header), reinterpret_cast<char*>(&header) + sizeof(header), 0);
+
+        header.size = sizeof(detail::dds_header);
+        header.flags = 0x1007 | 0x8 | (mips.size() > 1 ? 0x20000 : 0);   // caps, height, width, pixelformat, pitch, mipmapcount
+        header.width = static_cast<uint32_t>(mips[0].width);
+        header.height = static_cast<uint32_t>(mips[0].height);
+        header.pitch = static_cast<uint32_t>(mips[0].width * 8);
+        header.mip_map_count = static_cast<uint32_t>(mips.size());
+        header.ddspf.size = sizeof(detail::dds_pixelformat);
+        header.ddspf.flags = 0x4;                                         // fourcc
+        header.ddspf.fourcc = detail::DDS_FOURCC_RGBA16F;
+        header.caps = 0x1000 | (mips.size() > 1 ? 0x400008 : 0);          // texture, complex | mipmap
+
+        const uint32_t magic = 0x20534444;
+
+        f.write(reinterpret_cast<const char*>(&magic), sizeof(magic));
+        f.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        std::vector<DirectX::PackedVector::HALF> data;
+
+        for (auto m = mips.begin(); m != mips.end(); ++m)
+        {
+            data.resize(m->texels.size() * 4);
+
+            DirectX::PackedVector::XMConvertFloatToHalfStream(&data[0], sizeof(DirectX::PackedVector::HALF),
+                &m->texels[0].x, sizeof(float), data.size());
+
+            f.write(reinterpret_cast<const char*>(&data[0]), data.size() * sizeof(DirectX::PackedVector::HALF));
+        }
+
+        if (!f.good())
+            throw exception(L"dds: Failed writing " + file);
+    }
+
+    ibl_bake_info bake_ibl(const tstring& env_file, const tstring& prefiltered_file, const tstring& brdf_file, bool force)
+    {
+        ibl_bake_info info = { 0.f, 0.f, 0.f, 0.f };
+
+        tstring prefiltered_path = make_absolute_path(prefiltered_file);
+        tstring brdf_path = make_absolute_path(brdf_file);
+        tstring env_path = make_absolute_path(env_file);
+
+        if (force || detail::is_stale(prefiltered_path, env_path))
+        {
+            profile_zone zone("Bake prefiltered environment");
+
+            float_image env;
+            load_environment(env_path, env);
+
+            std::vector<float_image> mips;
+            info.error_prefilter = prefilter_environment(env, 256, 6, 256, mips);
+
+            save_dds(prefiltered_path, mips);
+
+            info.time_prefilter = zone.elapsed_ms();
+
+            tclog << L"Baked: " << prefiltered_file << L" in " << info.time_prefilter << L"ms (error " << info.error_prefilter << L")" << std::endl;
+        }
+
+        if (force || detail::file_time(brdf_path) == 0)
+        {
+            profile_zone zone("Bake BRDF");
+
+            std::vector<float_image> lut(1);
+            info.error_brdf = integrate_brdf(64, 512, lut[0]);
+
+            save_dds(brdf_path, lut);
+
+            info.time_brdf = zone.elapsed_ms();
+
+            tclog << L"Baked: " << brdf_file << L" in " << info.time_brdf << L"ms (error " << info.error_brdf << L")" << std::endl;
+        }
+
+        return info;
+    }
+}
@@ -0,0 +1,97 @@
+/*
+ * Dune D3D library - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+/*! \file */
+
+#ifndef DUNE_IBL_TOOLS
+#define DUNE_IBL_TOOLS
+
+#include <vector>
+
+#include <DirectXMath.h>
+
+#include "unicode.h"
+
+namespace dune
+{
+    /*! \brief A linear floating point RGBA image used by the CPU bakers. */
+    struct float_image
+    {
+        size_t width, height;
+        std::vector<DirectX::XMFLOAT4> texels;
+
+        float_image() : width(0), height(0), texels() {}
+
+        void create(size_t w, size_t h);
+
+        DirectX::XMFLOAT4& operator()(size_t x, size_t y)             { return texels[y*width + x]; }
+        const DirectX::XMFLOAT4& operator()(size_t x, size_t y) const { return texels[y*width + x]; }
+    };
+
+    /*!
+     * \brief Timings and error estimates of an IBL bake.
+     *
+     * Times are wall clock milliseconds. The errors are the mean relative difference to an
+     * integration with half the number of samples, which is a cheap estimate of how far the
+     * Monte Carlo integration is from convergence.
+     */
+    struct ibl_bake_info
+    {
+        float time_prefilter;
+        float time_brdf;
+        float error_prefilter;
+        float error_brdf;
+    };
+
+    /*! \brief Load a latlong environment map into a linear float_image. LDR images are linearized with a gamma of 2.2. */
+    void load_environment(const tstring& file, float_image& env);
+
+    /*!
+     * \brief Prefilter a latlong environment map with a GGX lobe for each mip level.
+     *
+     * Computes the first sum of the split-sum approximation. Mip level i of the result is filtered
+     * for roughness i/(num_mips-1) with N = V = R, so the shader only needs a single fetch at
+     * lod = roughness * (num_mips-1). Samples are importance sampled and read from a box filtered
+     * mip chain of the source to keep the sample count low. Rows are distributed over all workers.
+     *
+     * \param env The latlong environment map in linear color space.
+     * \param width The width of the first output mip level. The height is width/2.
+     * \param num_mips The number of roughness levels to compute.
+     * \param num_samples The number of GGX samples per texel.
+     * \param mips The resulting mip chain.
+     * \return An estimate of the remaining relative error.
+     */
+    float prefilter_environment(const float_image& env, size_t width, size_t num_mips, size_t num_samples, std::vector<float_image>& mips);
+
+    /*!
+     * \brief Integrate the second sum of the split-sum approximation into a lookup table.
+     *
+     * The x-axis of the table is NoV, the y-axis roughness. The red channel holds the scale
+     * and the green channel the bias to F0, i.e. specular = prefiltered * (F0 * lut.r + lut.g).
+     *
+     * \return An estimate of the remaining relative error.
+     */
+    float integrate_brdf(size_t size, size_t num_samples, float_image& lut);
+
+    /*! \brief Save a mip chain as a DXGI_FORMAT_R16G16B16A16_FLOAT DDS file which can be loaded with load_texture(). */
+    void save_dds(const tstring& file, const std::vector<float_image>& mips);
+
+    /*!
+     * \brief Bake a prefiltered environment map and a BRDF lookup table for image based lighting.
+     *
+     * The prefiltered environment map is only baked if it is missing or older than env_file,
+     * the BRDF lookup table only if it is missing. Skipped bakes have a zero time in the
+     * returned ibl_bake_info. Relative paths are resolved against the executable location.
+     *
+     * \param env_file A latlong environment map.
+     * \param prefiltered_file The output file for the prefiltered environment map.
+     * \param brdf_file The output file for the BRDF lookup table.
+     * \param force Bake even if the output files already exist.
+     */
+    ibl_bake_info bake_ibl(const tstring& env_file, const tstring& prefiltered_file, const tstring& brdf_file, bool force = false);
+}
+
+#endif
@@ -6,13 +6,13 @@
 
 #include "light_propagation_volume.h"
 
+#include <cassert>
+
 #include "d3d_tools.h"
 #include "mesh.h"
 #include "unicode.h"
 #include "gbuffer.h"
 
-#define NUM_VPLS 1024
-
 namespace dune
 {
     struct lpv_vertex
@@ -41,11 +41,16 @@ namespace dune
         gs_propagate_(nullptr),
         ps_propagate_(nullptr),
         ps_normalize_(nullptr),
+        ps_pack_(nullptr),
+        vs_gv_inject_(nullptr),
+        ps_gv_inject_(nullptr),
         propagate_start_slot_(-1),
         inject_rsm_start_slot_(-1),
         lpv_volume_(nullptr),
         input_layout_(nullptr),
         volume_size_(0),
+        max_cascades_(1),
+        num_cascades_(1),
         lpv_r_(),
         lpv_g_(),
         lpv_b_(),
@@ -53,29 +58,51 @@ namespace dune
         lpv_accum_g_(),
         lpv_accum_b_(),
         lpv_inject_counter_(),
+        lpv_gv_(),
+        occlusion_(false),
+        lpv_history_r_(),
+        lpv_history_g_(),
+        lpv_history_b_(),
         iterations_rendered_(0),
+        amortized_(false),
+        history_valid_(false),
+        history_format_(SH_FORMAT_FP16),
+        history_created_(SH_FORMAT_FP16),
+        schedule_(),
+        lpv_parameters_slot_(-1),
         curr_(0),
         next_(0),
         cb_debug_(),
         cb_parameters_(),
         cb_propagation_(),
         cb_gi_parameters_(),
-        profiler_()
+        profiler_inject_(),
+        profiler_normalize_(),
+        profiler_propagate_(),
+        propagate_measured_(0)
     {
     }
 
-    void light_propagation_volume::create(ID3D11Device* device, UINT volume_size)
+    void light_propagation_volume::create(ID3D11Device* device, UINT volume_size, sh_format history_format, UINT max_cascades)
     {
+        assert(max_cascades > 0 && max_cascades <= MAX_CASCADES);
+
         volume_size_ = volume_size;
+        history_format_ = history_format;
+        max_cascades_ = max_cascades;
+        num_cascades_ = 1;
 
-        profiler_.create(device);
+        profiler_inject_.create(device, "LPV inject");
+        profiler_normalize_.create(device, "LPV normalize");
+        profiler_propagate_.create(device, "LPV propagate");
+        propagate_measured_ = 0;
 
         D3D11_TEXTURE2D_DESC desc;
         ZeroMemory(&desc, sizeof(desc));
         desc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_RENDER_TARGET;
         desc.Width = volume_size;
         desc.Height = volume_size;
-        desc.ArraySize = volume_size;
+        desc.ArraySize = volume_size * max_cascades;
         desc.Usage = D3D11_USAGE_DEFAULT;
         desc.Format = DXGI_FORMAT_R16G16B16A16_FLOAT;
         desc.MipLevels = 1;
@@ -94,16 +121,20 @@ namespace dune
         lpv_accum_g_.create(device, desc);
         lpv_accum_b_.create(device, desc);
 
+        lpv_gv_.create(device, desc);
+
+        create_history(device);
+
         // create normalization volume that keeps track of the number of lights in each cell
         desc.Format = DXGI_FORMAT_R16_FLOAT;
 
         lpv_inject_counter_.create(device, desc);
 
-        // create grid geometry
-        UINT num_vertices = 6 * volume_size_;
+        // create grid geometry, one quad for each slice of all cascades
+        UINT num_vertices = 6 * volume_size_ * max_cascades_;
         std::vector<lpv_vertex> data(num_vertices);
 
-        for(size_t d = 0; d < volume_size_; ++d)
+        for(size_t d = 0; d < volume_size_ * max_cascades_; ++d)
         {
             data[d*6+0].init(DirectX::XMFLOAT3(-1.0f, -1.0f, 0.0f), DirectX::XMFLOAT3(0.0f, 1.0f, static_cast<float>(d)));
             data[d*6+1].init(DirectX::XMFLOAT3(-1.0f, 1.0f,  0.0f), DirectX::XMFLOAT3(0.0f, 0.0f, static_cast<float>(d)));
@@ -173,6 +204,63 @@ namespace dune
         iterations_rendered_ = 0;
     }
 
+    void light_propagation_volume::create_history(ID3D11Device* device)
+    {
+        lpv_history_r_.destroy();
+        lpv_history_g_.destroy();
+        lpv_history_b_.destroy();
+
+        D3D11_TEXTURE2D_DESC desc;
+        ZeroMemory(&desc, sizeof(desc));
+        desc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_RENDER_TARGET;
+        desc.Width = volume_size_;
+        desc.Height = volume_size_;
+        desc.ArraySize = volume_size_ * max_cascades_;
+        desc.Usage = D3D11_USAGE_DEFAULT;
+        desc.Format = DXGI_FORMAT_R16G16B16A16_FLOAT;
+        desc.MipLevels = 1;
+        desc.SampleDesc.Count = 1;
+        desc.SampleDesc.Quality = 0;
+
+        // the history volumes are only written by CopyResource() or pack_history()
+        switch (history_format_)
+        {
+        case SH_FORMAT_SHARED_EXPONENT:
+            desc.Format = DXGI_FORMAT_R11G11B10_FLOAT;
+            lpv_history_r_.create(device, desc);
+
+            desc.Format = DXGI_FORMAT_R8G8B8A8_SNORM;
+            lpv_history_g_.create(device, desc);
+            break;
+
+        case SH_FORMAT_YCOCG:
+            lpv_history_r_.create(device, desc);
+
+            desc.Format = DXGI_FORMAT_R8G8B8A8_SNORM;
+            lpv_history_g_.create(device, desc);
+            lpv_history_b_.create(device, desc);
+            break;
+
+        default:
+            lpv_history_r_.create(device, desc);
+            lpv_history_g_.create(device, desc);
+            lpv_history_b_.create(device, desc);
+            break;
+        }
+
+        history_created_ = history_format_;
+        history_valid_ = false;
+    }
+
+    void light_propagation_volume::set_history_format(sh_format format)
+    {
+        if (format == history_format_)
+            return;
+
+        history_format_ = format;
+        history_valid_ = false;
+    }
+
     void light_propagation_volume::set_model_matrix(ID3D11DeviceContext* context, const DirectX::XMFLOAT4X4& model, const DirectX::XMFLOAT3& lpv_min, const DirectX::XMFLOAT3& lpv_max, UINT lpv_parameters_slot)
     {
         DirectX::XMMATRIX model_inv = DirectX::XMMatrixInverse(nullptr, DirectX::XMLoadFloat4x4(&model));
@@ -195,13 +283,45 @@ namespace dune
                 world_to_lpv);
 
             cb->lpv_size = volume_size_;
+            cb->history_format = history_format_;
+            cb->num_cascades = 1;
+            cb->world_to_cascade[0] = cb->world_to_lpv;
         }
         cb_parameters_.to_vs(context, lpv_parameters_slot);
         cb_parameters_.to_ps(context, lpv_parameters_slot);
+
+        num_cascades_ = 1;
+        lpv_parameters_slot_ = lpv_parameters_slot;
+    }
+
+    void light_propagation_volume::set_cascades(ID3D11DeviceContext* context, const lpv_cascades& cascades, UINT lpv_parameters_slot)
+    {
+        assert(cascades.num_cascades() > 0 && cascades.num_cascades() <= max_cascades_);
+        assert(cascades.size() == volume_size_);
+
+        num_cascades_ = static_cast<UINT>(cascades.num_cascades());
+        world_to_lpv_ = cascades.cascade(0).world_to_lpv;
+
+        auto cb = &cb_parameters_.data();
+        {
+            cb->world_to_lpv = world_to_lpv_;
+            cb->lpv_size = volume_size_;
+            cb->history_format = history_format_;
+            cb->num_cascades = num_cascades_;
+
+            for (UINT i = 0; i < num_cascades_; ++i)
+                cb->world_to_cascade[i] = cascades.cascade(i).world_to_lpv;
+        }
+        cb_parameters_.to_vs(context, lpv_parameters_slot);
+        cb_parameters_.to_ps(context, lpv_parameters_slot);
+
+        lpv_parameters_slot_ = lpv_parameters_slot;
     }
 
     void light_propagation_volume::destroy()
     {
+        state_.destroy();
+
         for (size_t i = 0; i < 2; ++i)
         {
             lpv_r_[i].destroy();
@@ -213,7 +333,12 @@ namespace dune
         lpv_accum_g_.destroy();
         lpv_accum_b_.destroy();
 
+        lpv_history_r_.destroy();
+        lpv_history_g_.destroy();
+        lpv_history_b_.destroy();
+
         lpv_inject_counter_.destroy();
+        lpv_gv_.destroy();
 
         cb_parameters_.destroy();
         cb_debug_.destroy();
@@ -236,10 +361,16 @@ namespace dune
         safe_release(ps_propagate_);
 
         safe_release(ps_normalize_);
+        safe_release(ps_pack_);
+
+        safe_release(vs_gv_inject_);
+        safe_release(ps_gv_inject_);
 
         ss_vplfilter_.destroy();
 
-        profiler_.destroy();
+        profiler_inject_.destroy();
+        profiler_normalize_.destroy();
+        profiler_propagate_.destroy();
 
         propagate_start_slot_ = -1;
         inject_rsm_start_slot_ = -1;
@@ -255,10 +386,11 @@ namespace dune
     {
         dune::set_viewport(context, volume_size_, volume_size_);
 
-        profiler_.begin(context);
+        profiler_inject_.begin(context);
 
-        // TODO: this should be rsm->size() * rsm->size()!
-        unsigned int num_vpls = static_cast<unsigned int>(NUM_VPLS*NUM_VPLS);
+        // one VPL per RSM texel
+        DirectX::XMFLOAT2 rsm_size = rsm[L"colors"]->size();
+        unsigned int num_vpls = static_cast<unsigned int>(rsm_size.x * rsm_size.y);
 
         rsm.to_vs(context, inject_rsm_start_slot_);
 
@@ -296,6 +428,20 @@ namespace dune
 
         context->Draw(num_vpls, 0);
 
+        // the geometry volume is built from the same RSM, and stays empty without occlusion
+        ID3D11RenderTargetView* gv_views[] = { lpv_gv_.rtv() };
+        dune::clear_rtvs(context, gv_views, 1, clear_color);
+
+        if (occlusion_ && vs_gv_inject_ && ps_gv_inject_)
+        {
+            context->OMSetRenderTargets(1, gv_views, nullptr);
+
+            context->VSSetShader(vs_gv_inject_, nullptr, 0);
+            context->PSSetShader(ps_gv_inject_, nullptr, 0);
+
+            context->Draw(num_vpls, 0);
+        }
+
         // clear and done
         ID3D11RenderTargetView* null_views[] = { nullptr, nullptr, nullptr, nullptr };
         context->OMSetRenderTargets(4, null_views, nullptr);
@@ -303,7 +449,7 @@ namespace dune
         ID3D11ShaderResourceView* null_views1[] = { nullptr, nullptr, nullptr };
         context->VSSetShaderResources(inject_rsm_start_slot_, 3, null_views1);
 
-        time_inject_ = profiler_.result();
+        profiler_inject_.end();
     }
 
     void light_propagation_volume::normalize(ID3D11DeviceContext* context)
@@ -347,7 +493,7 @@ namespace dune
 
         context->PSSetShaderResources(propagate_start_slot_, 4, sr_lpv);
 
-        context->Draw(6 * volume_size_, 0);
+        context->Draw(6 * volume_size_ * num_cascades_, 0);
 
         // clear and done
         ID3D11RenderTargetView* rt_null_views[] = { nullptr, nullptr, nullptr };
@@ -357,7 +503,35 @@ namespace dune
         context->PSSetShaderResources(propagate_start_slot_, 4, sr_null_views);
     }
 
-    void light_propagation_volume::propagate(ID3D11DeviceContext* context)
+    void light_propagation_volume::begin_propagation(ID3D11DeviceContext* context)
+    {
+        state_.begin(context);
+
+        UINT stride = sizeof(lpv_vertex);
+        UINT offset = 0;
+
+        state_.set_input_layout(input_layout_);
+        state_.set_vertex_buffers(0, 1, &lpv_volume_, &stride, &offset);
+        state_.set_index_buffer(nullptr, DXGI_FORMAT_R32_UINT, 0);
+        state_.set_topology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+        FLOAT factors[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+        state_.set_blend_state(bs_propagate_, factors, 0xffffffff);
+
+        state_.set_vs(vs_propagate_);
+        state_.set_gs(gs_propagate_);
+        state_.set_ps(ps_propagate_);
+
+        // the propagation shader keeps neighbors within the cascade of a slice
+        if (lpv_parameters_slot_ >= 0)
+            cb_parameters_.bind(state_, STAGE_PS, lpv_parameters_slot_);
+
+        // the geometry volume follows the three volumes read by each iteration
+        ID3D11ShaderResourceView* sr_gv[] = { lpv_gv_.srv() };
+        state_.set_resources(STAGE_PS, propagate_start_slot_ + 3, 1, sr_gv);
+    }
+
+    void light_propagation_volume::propagate(state_cache& state)
     {
         swap_buffers();
 
@@ -372,9 +546,13 @@ namespace dune
         };
 
         static float clear_color[4] = {0.0f, 0.0f, 0.0f, 0.0f};
-        dune::clear_rtvs(context, lpv_views, 3, clear_color);
+        dune::clear_rtvs(state.context(), lpv_views, 3, clear_color);
+
+        // the volumes read by the last iteration are written now
+        ID3D11ShaderResourceView* sr_null_views[] = { nullptr, nullptr, nullptr };
+        state.set_resources(STAGE_PS, propagate_start_slot_, 3, sr_null_views);
 
-        context->OMSetRenderTargets(6, lpv_views, nullptr);
+        state.set_render_targets(6, lpv_views, nullptr);
 
         ID3D11ShaderResourceView* sr_lpv[] =
         {
@@ -383,13 +561,65 @@ namespace dune
             lpv_b_[curr_].srv()
         };
 
-        context->PSSetShaderResources(propagate_start_slot_, 3, sr_lpv);
+        state.set_resources(STAGE_PS, propagate_start_slot_, 3, sr_lpv);
 
-        context->Draw(6 * volume_size_, 0);
+        state.context()->Draw(6 * volume_size_ * num_cascades_, 0);
+    }
 
+    void light_propagation_volume::end_propagation()
+    {
         // clear and done
         ID3D11RenderTargetView* rt_null_views[] = { nullptr, nullptr, nullptr, nullptr, nullptr, nullptr };
-        context->OMSetRenderTargets(6, rt_null_views, nullptr);
+        state_.set_render_targets(6, rt_null_views, nullptr);
+
+        ID3D11ShaderResourceView* sr_null_views[] = { nullptr, nullptr, nullptr, nullptr };
+        state_.set_resources(STAGE_PS, propagate_start_slot_, 4, sr_null_views);
+    }
+
+    void light_propagation_volume::pack_history(ID3D11DeviceContext* context)
+    {
+        // unused history volumes have no view and are left unbound
+        ID3D11RenderTargetView* lpv_views[] =
+        {
+            lpv_history_r_.rtv(),
+            lpv_history_g_.rtv(),
+            lpv_history_b_.rtv(),
+        };
+
+        context->OMSetRenderTargets(3, lpv_views, nullptr);
+
+        FLOAT factors[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+        context->OMSetBlendState(nullptr, factors, 0xffffffff);
+
+        UINT stride = sizeof(lpv_vertex);
+        UINT offset = 0;
+
+        context->IASetInputLayout(input_layout_);
+        context->IASetVertexBuffers(0, 1, &lpv_volume_, &stride, &offset);
+        context->IASetIndexBuffer(nullptr, DXGI_FORMAT_R32_UINT,0);
+        context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+        context->VSSetShader(vs_propagate_, nullptr, 0);
+        context->GSSetShader(gs_propagate_, nullptr, 0);
+        context->PSSetShader(ps_pack_, nullptr, 0);
+
+        ID3D11ShaderResourceView* sr_lpv[] =
+        {
+            lpv_accum_r_.srv(),
+            lpv_accum_g_.srv(),
+            lpv_accum_b_.srv()
+        };
+
+        context->PSSetShaderResources(propagate_start_slot_, 3, sr_lpv);
+
+        if (lpv_parameters_slot_ >= 0)
+            cb_parameters_.to_ps(context, lpv_parameters_slot_);
+
+        context->Draw(6 * volume_size_ * num_cascades_, 0);
+
+        // clear and done
+        ID3D11RenderTargetView* rt_null_views[] = { nullptr, nullptr, nullptr };
+        context->OMSetRenderTargets(3, rt_null_views, nullptr);
 
         ID3D11ShaderResourceView* sr_null_views[] = { nullptr, nullptr, nullptr };
         context->PSSetShaderResources(propagate_start_slot_, 3, sr_null_views);
@@ -409,46 +639,75 @@ namespace dune
         }
     }
 
-    void light_propagation_volume::propagate(ID3D11DeviceContext* context, size_t num_iterations)
+    void light_propagation_volume::history_to_ps(ID3D11DeviceContext* context, UINT slot)
     {
-        if (num_iterations == 0)
-            return;
+        ID3D11ShaderResourceView* views[] = { lpv_history_r_.srv(), lpv_history_g_.srv(), lpv_history_b_.srv() };
+        context->PSSetShaderResources(slot, 3, views);
 
-        static float clear_color[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        if (lpv_parameters_slot_ < 0)
+            return;
 
-        ID3D11RenderTargetView* lpv_accum_views[] =
+        auto cb = &cb_parameters_.data();
         {
-            lpv_accum_r_.rtv(),
-            lpv_accum_g_.rtv(),
-            lpv_accum_b_.rtv(),
-        };
+            cb->history_weight = (history_valid_ && amortized_) ? 1.f - schedule_.progress() : 0.f;
+        }
+        cb_parameters_.to_vs(context, lpv_parameters_slot_);
+        cb_parameters_.to_ps(context, lpv_parameters_slot_);
+    }
 
-        dune::clear_rtvs(context, lpv_accum_views, 3, clear_color);
+    void light_propagation_volume::propagate(ID3D11DeviceContext* context, size_t num_iterations)
+    {
+        propagate(context, 0, num_iterations);
+    }
 
-        UINT stride = sizeof(lpv_vertex);
-        UINT offset = 0;
+    void light_propagation_volume::propagate(ID3D11DeviceContext* context, size_t first_iteration, size_t num_iterations)
+    {
+        if (num_iterations == 0)
+            return;
 
-        context->IASetInputLayout(input_layout_);
-        context->IASetVertexBuffers(0, 1, &lpv_volume_, &stride, &offset);
-        context->IASetIndexBuffer(nullptr, DXGI_FORMAT_R32_UINT,0);
-        context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+        // a new propagation starts with an empty accumulation volume
+        if (first_iteration == 0)
+        {
+            static float clear_color[4] = {0.0f, 0.0f, 0.0f, 0.0f};
 
-        FLOAT factors[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
-        context->OMSetBlendState(bs_propagate_, factors, 0xffffffff);
+            ID3D11RenderTargetView* lpv_accum_views[] =
+            {
+                lpv_accum_r_.rtv(),
+                lpv_accum_g_.rtv(),
+                lpv_accum_b_.rtv(),
+            };
 
-        context->VSSetShader(vs_propagate_, nullptr, 0);
-        context->GSSetShader(gs_propagate_, nullptr, 0);
-        context->PSSetShader(ps_propagate_, nullptr, 0);
+            dune::clear_rtvs(context, lpv_accum_views, 3, clear_color);
+        }
 
-        for (UINT i = 0; i < num_iterations; ++i)
+        begin_propagation(context);
+
+        for (size_t i = first_iteration; i < first_iteration + num_iterations; ++i)
         {
             auto c = &cb_propagation_.data();
             {
-                c->iteration = i;
+                c->iteration = static_cast<UINT>(i);
             }
-            cb_propagation_.to_ps(context, 13);
+            cb_propagation_.bind(state_, STAGE_PS, 13);
+
+            propagate(state_);
+        }
+
+        end_propagation();
+    }
 
-            propagate(context);
+    void light_propagation_volume::update_timings()
+    {
+        time_inject_ = profiler_inject_.latest();
+        time_normalize_ = profiler_normalize_.latest();
+        time_propagate_ = profiler_propagate_.latest();
+
+        const profile_ring& ring = profiler_propagate_.ring();
+
+        if (ring.completed() != propagate_measured_)
+        {
+            schedule_.measured(static_cast<size_t>(ring.last().tag), ring.last().ms);
+            propagate_measured_ = ring.completed();
         }
     }
 
@@ -456,13 +715,133 @@ namespace dune
     {
         dune::set_viewport(context, volume_size_, volume_size_);
 
-        profiler_.begin(context);
+        profiler_normalize_.begin(context);
         normalize(context);
-        time_normalize_ = profiler_.result();
+        profiler_normalize_.end();
+
+        if (amortized_)
+        {
+            schedule_.restart(iterations_rendered_);
+            render_amortized(context);
+            return;
+        }
 
-        profiler_.begin(context);
+        profiler_propagate_.begin(context, iterations_rendered_);
         propagate(context, iterations_rendered_);
-        time_propagate_ = profiler_.result();
+        profiler_propagate_.end();
+    }
+
+    bool light_propagation_volume::render_amortized(ID3D11DeviceContext* context)
+    {
+        // refresh the per-iteration estimate before sizing the batch
+        update_timings();
+
+        size_t n = schedule_.next_batch();
+
+        if (n == 0)
+            return false;
+
+        dune::set_viewport(context, volume_size_, volume_size_);
+
+        profiler_propagate_.begin(context, n);
+        propagate(context, schedule_.done(), n);
+        profiler_propagate_.end();
+
+        schedule_.completed(n);
+
+        if (!schedule_.converged())
+            return false;
+
+        update_history(context);
+
+        return true;
+    }
+
+    void light_propagation_volume::update_history(ID3D11DeviceContext* context)
+    {
+        if (history_created_ != history_format_)
+        {
+            ID3D11Device* device = nullptr;
+            context->GetDevice(&device);
+            create_history(device);
+            safe_release(device);
+        }
+
+        if (history_format_ == SH_FORMAT_FP16)
+        {
+            context->CopyResource(lpv_history_r_.resource(), lpv_accum_r_.resource());
+            context->CopyResource(lpv_history_g_.resource(), lpv_accum_g_.resource());
+            context->CopyResource(lpv_history_b_.resource(), lpv_accum_b_.resource());
+        }
+        else
+        {
+            pack_history(context);
+        }
+
+        history_valid_ = true;
+    }
+
+    void light_propagation_volume::output_volumes(render_target* volumes[3])
+    {
+        // same choice as to_ps()
+        if (iterations_rendered_ > 0)
+        {
+            volumes[0] = &lpv_accum_r_;
+            volumes[1] = &lpv_accum_g_;
+            volumes[2] = &lpv_accum_b_;
+        }
+        else
+        {
+            volumes[0] = &lpv_r_[next_];
+            volumes[1] = &lpv_g_[next_];
+            volumes[2] = &lpv_b_[next_];
+        }
+    }
+
+    void light_propagation_volume::save_snapshot(ID3D11DeviceContext* context, gi_snapshot& snapshot)
+    {
+        const char* names[] = { "lpv.r", "lpv.g", "lpv.b" };
+
+        render_target* volumes[3];
+        output_volumes(volumes);
+
+        for (size_t i = 0; i < 3; ++i)
+        {
+            // R16G16B16A16_FLOAT
+            snapshot_volume& v = snapshot.add(names[i], volume_size_, volume_size_, volume_size_ * max_cascades_, 8);
+            read_texture(context, volumes[i]->resource(), 8, &v.data[0]);
+        }
+    }
+
+    bool light_propagation_volume::load_snapshot(ID3D11DeviceContext* context, const gi_snapshot& snapshot)
+    {
+        const char* names[] = { "lpv.r", "lpv.g", "lpv.b" };
+        const snapshot_volume* sv[3];
+
+        for (size_t i = 0; i < 3; ++i)
+        {
+            sv[i] = snapshot.find(names[i]);
+
+            if (!sv[i] || sv[i]->width != volume_size_ || sv[i]->height != volume_size_ ||
+                sv[i]->depth != volume_size_ * max_cascades_ || sv[i]->texel_size != 8)
+                return false;
+        }
+
+        render_target* volumes[3];
+        output_volumes(volumes);
+
+        for (size_t i = 0; i < 3; ++i)
+            write_texture(context, volumes[i]->resource(), 8, &sv[i]->data[0]);
+
+        schedule_.restart(0);
+
+        if (amortized_ && iterations_rendered_ > 0)
+        {
+            dune::set_viewport(context, volume_size_, volume_size_);
+            update_history(context);
+        }
+
+        return true;
     }
 
     void light_propagation_volume::set_inject_shader(ID3D11VertexShader* vs, ID3D11GeometryShader* gs, ID3D11PixelShader* ps, ID3D11PixelShader* ps_normalize, UINT inject_rsm_start_slot)
@@ -496,6 +875,17 @@ namespace dune
                                             input_binary->GetBufferSize(), &input_layout_));
     }
 
+    void light_propagation_volume::set_pack_shader(ID3D11PixelShader* ps)
+    {
+        exchange(&ps_pack_, ps);
+    }
+
+    void light_propagation_volume::set_geometry_inject_shader(ID3D11VertexShader* vs, ID3D11PixelShader* ps)
+    {
+        exchange(&vs_gv_inject_, vs);
+        exchange(&ps_gv_inject_, ps);
+    }
+
     void light_propagation_volume::visualize(ID3D11DeviceContext* context, d3d_mesh* node, UINT debug_info_slot)
     {
         if (!node)
@@ -543,9 +933,10 @@ namespace dune
 
         dune::set_viewport(context, volume_size_, volume_size_);
 
-        profiler_.begin(context);
+        profiler_inject_.begin(context);
 
-        unsigned int num_vpls = static_cast<unsigned int>(NUM_VPLS*NUM_VPLS);
+        DirectX::XMFLOAT2 rsm_size = rsm[L"colors"]->size();
+        unsigned int num_vpls = static_cast<unsigned int>(rsm_size.x * rsm_size.y);
 
         rsm.to_vs(context, inject_rsm_start_slot_);
 
@@ -604,7 +995,7 @@ namespace dune
 
         negative_ = !negative_;
 
-        time_inject_ = profiler_.result();
+        profiler_inject_.end();
     }
 
     void delta_light_propagation_volume::propagate_direct(ID3D11DeviceContext* context, size_t num_iterations)
@@ -621,20 +1012,7 @@ namespace dune
             lpv_accum_b_.rtv(),
         };
 
-        UINT stride = sizeof(lpv_vertex);
-        UINT offset = 0;
-
-        context->IASetInputLayout(input_layout_);
-        context->IASetVertexBuffers(0, 1, &lpv_volume_, &stride, &offset);
-        context->IASetIndexBuffer(nullptr, DXGI_FORMAT_R32_UINT,0);
-        context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-
-        FLOAT factors[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
-        context->OMSetBlendState(bs_propagate_, factors, 0xffffffff);
-
-        context->VSSetShader(vs_propagate_, nullptr, 0);
-        context->GSSetShader(gs_propagate_, nullptr, 0);
-        context->PSSetShader(ps_propagate_, nullptr, 0);
+        begin_propagation(context);
 
         for (UINT i = 0; i < num_iterations; ++i)
         {
@@ -642,15 +1020,17 @@ namespace dune
             {
                 c->iteration = i;
             }
-            cb_propagation_.to_ps(context, 13);
+            cb_propagation_.bind(state_, STAGE_PS, 13);
 
-            propagate(context);
+            propagate(state_);
         }
+
+        end_propagation();
     }
 
-    void delta_light_propagation_volume::create(ID3D11Device* device, UINT volume_size)
+    void delta_light_propagation_volume::create(ID3D11Device* device, UINT volume_size, sh_format history_format, UINT max_cascades)
     {
-        light_propagation_volume::create(device, volume_size);
+        light_propagation_volume::create(device, volume_size, history_format, max_cascades);
 
         D3D11_BLEND_DESC bld;
         ZeroMemory(&bld, sizeof(D3D11_BLEND_DESC));
@@ -699,13 +1079,13 @@ namespace dune
     {
         dune::set_viewport(context, volume_size_, volume_size_);
 
-        profiler_.begin(context);
+        profiler_normalize_.begin(context);
         normalize(context);
-        time_normalize_ = profiler_.result();
+        profiler_normalize_.end();
 
-        profiler_.begin(context);
+        profiler_propagate_.begin(context, num_iterations);
         propagate_direct(context, num_iterations);
-        time_propagate_ = profiler_.result();
+        profiler_propagate_.end();
 
         to_ps(context, lpv_out_start_slot);
     }
@@ -714,12 +1094,12 @@ namespace dune
     {
         dune::set_viewport(context, volume_size_, volume_size_);
 
-        profiler_.begin(context);
+        profiler_normalize_.begin(context);
         normalize(context);
-        time_normalize_ = profiler_.result();
+        profiler_normalize_.end();
 
-        profiler_.begin(context);
+        profiler_propagate_.begin(context, iterations_rendered_);
         propagate(context, iterations_rendered_);
-        time_propagate_ = profiler_.result();
+        profiler_propagate_.end();
     }
 }
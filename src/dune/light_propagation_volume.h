@@ -15,6 +15,11 @@
 #include "shader_resource.h"
 #include "cbuffer.h"
 #include "d3d_tools.h"
+#include "lpv_cascades.h"
+#include "propagation_schedule.h"
+#include "sh_packing.h"
+#include "state_cache.h"
+#include "gi_snapshot.h"
 
 namespace dune
 {
@@ -35,6 +40,9 @@ namespace dune
     class light_propagation_volume : public shader_resource
     {
     public:
+        /*! \brief The largest number of cascades, same as LPV_MAX_CASCADES in lpv_parameters.hlsl. */
+        static const UINT MAX_CASCADES = 4;
+
         float time_inject_;
         float time_propagate_;
         float time_normalize_;
@@ -62,6 +70,10 @@ namespace dune
         ID3D11PixelShader*      ps_propagate_;
 
         ID3D11PixelShader*      ps_normalize_;
+        ID3D11PixelShader*      ps_pack_;
+
+        ID3D11VertexShader*     vs_gv_inject_;
+        ID3D11PixelShader*      ps_gv_inject_;
 
         INT                     propagate_start_slot_;
         INT                     inject_rsm_start_slot_;
@@ -69,6 +81,8 @@ namespace dune
         ID3D11Buffer*           lpv_volume_;
         ID3D11InputLayout*      input_layout_;
         UINT                    volume_size_;
+        UINT                    max_cascades_;      //!< the cascades the volumes were created with
+        UINT                    num_cascades_;      //!< the cascades placed by set_model_matrix() or set_cascades()
 
         render_target           lpv_r_[2];
         render_target           lpv_g_[2];
@@ -80,8 +94,22 @@ namespace dune
 
         render_target           lpv_inject_counter_;
 
+        render_target           lpv_gv_;            //!< blocking potential on the lower corners of each cell
+        bool                    occlusion_;
+
+        render_target           lpv_history_r_;
+        render_target           lpv_history_g_;
+        render_target           lpv_history_b_;
+
         size_t                  iterations_rendered_;
 
+        bool                    amortized_;
+        bool                    history_valid_;
+        sh_format               history_format_;
+        sh_format               history_created_;   //!< the format the history volumes were created with
+        propagation_schedule    schedule_;
+        INT                     lpv_parameters_slot_;
+
         unsigned int            curr_;
         unsigned int            next_;
 
@@ -99,7 +127,10 @@ namespace dune
         {
             DirectX::XMFLOAT4X4 world_to_lpv;
             UINT lpv_size;
-            DirectX::XMFLOAT3 pad;
+            FLOAT history_weight;
+            UINT history_format;
+            UINT num_cascades;
+            DirectX::XMFLOAT4X4 world_to_cascade[MAX_CASCADES];
         };
 
         cbuffer<cbs_parameters> cb_parameters_;
@@ -115,22 +146,72 @@ namespace dune
         typedef cbuffer<param> cb_gi_parameters;
         cb_gi_parameters cb_gi_parameters_;
 
-        dune::profile_query profiler_;
+        dune::profile_query profiler_inject_;
+        dune::profile_query profiler_normalize_;
+        dune::profile_query profiler_propagate_;
+        size_t              propagate_measured_;
+
+        state_cache         state_;
 
     protected:
         void swap_buffers();
 
         void normalize(ID3D11DeviceContext* context);
-        void propagate(ID3D11DeviceContext* context);
+
+        /*! \brief Bind the state of all propagation iterations to state_. */
+        void begin_propagation(ID3D11DeviceContext* context);
+
+        /*! \brief Run one propagation iteration between begin_propagation() and end_propagation(). */
+        void propagate(state_cache& state);
+
+        /*! \brief Unbind the volumes of the last propagation iteration. */
+        void end_propagation();
+
         void propagate(ID3D11DeviceContext* context, size_t num_iterations);
+        void propagate(ID3D11DeviceContext* context, size_t first_iteration, size_t num_iterations);
+        void create_history(ID3D11Device* device);
+        void pack_history(ID3D11DeviceContext* context);
+        void update_history(ID3D11DeviceContext* context);
+
+        void output_volumes(render_target* volumes[3]);
 
     public:
         light_propagation_volume();
         virtual ~light_propagation_volume() {}
 
-        virtual void create(ID3D11Device* device, UINT volume_size);
+        /*!
+         * \brief Create all volumes of the LPV.
+         *
+         * All volumes which are rendered to store half floats, because injection and propagation need to blend signed values.
+         * The history volumes of amortized propagation are only written once propagation converged, so they can be stored
+         * in a packed format instead. D3D11 cannot render to RGB9E5, so SH_FORMAT_SHARED_EXPONENT stores the DC in R11G11B10
+         * instead. Packed formats need set_pack_shader().
+         *
+         * Cascades are stacked along the array index of each volume, cascade c starts at slice c * volume_size.
+         *
+         * \param device The Direct3D device.
+         * \param volume_size The number of cells along each axis.
+         * \param history_format The storage format of the history volumes.
+         * \param max_cascades The largest number of cascades set_cascades() can place, at most MAX_CASCADES.
+         */
+        virtual void create(ID3D11Device* device, UINT volume_size, sh_format history_format = SH_FORMAT_FP16, UINT max_cascades = 1);
         virtual void destroy();
 
+        /*!
+         * \brief Set time_inject_, time_normalize_ and time_propagate_ to the newest GPU timings.
+         *
+         * The timings lag a few frames behind. Propagation timings are tagged with their number of iterations,
+         * and each new one also updates the per-iteration estimate of the amortized propagation schedule.
+         */
+        void update_timings();
+
+        //!@{
+        /*! \brief Returns rolling statistics of the GPU timings of injection, normalization and propagation. */
+        profile_stats stats_inject() const    { return profiler_inject_.stats(); }
+        profile_stats stats_normalize() const { return profiler_normalize_.stats(); }
+        profile_stats stats_propagate() const { return profiler_propagate_.stats(); }
+        //!@}
+
         //!@{
         /*! \brief Return local cbuffer parameters. */
         cb_gi_parameters& parameters() { return cb_gi_parameters_; }
@@ -173,11 +254,48 @@ namespace dune
          */
         void set_propagate_shader(ID3D11Device* device, ID3D11VertexShader* vs, ID3D11GeometryShader* gs, ID3D11PixelShader* ps, ID3DBlob* input_binary, UINT propagate_start_slot);
 
+        /*!
+         * \brief Set the pixel shader which packs the converged accumulation volumes into the history volumes.
+         *
+         * The shader reads the accumulation volumes from the propagation start slot and runs with the
+         * propagation vertex and geometry shader.
+         */
+        void set_pack_shader(ID3D11PixelShader* ps);
+
+        /*!
+         * \brief Set the shaders which inject the geometry volume (GV) used for occlusion.
+         *
+         * The shaders run with the injection geometry shader and read the same RSM as the VPL injection. Each
+         * RSM texel adds the blocking potential of a surfel to the corner of an LPV cell, like dune::geometry_volume
+         * does on the CPU. Propagation reads the GV at the slot following the three LPV volumes.
+         *
+         * \param vs The GV injection vertex shader.
+         * \param ps The GV injection pixel shader.
+         */
+        void set_geometry_inject_shader(ID3D11VertexShader* vs, ID3D11PixelShader* ps);
+
+        //!@{
+        /*! \brief Enable/disable the occlusion of propagated light by the geometry volume, applied with the next injection. */
+        bool occlusion() const { return occlusion_; }
+        void set_occlusion(bool o) { occlusion_ = o; }
+        //!@}
+
+        /*! \brief Returns the storage format of the history volumes. */
+        sh_format history_format() const { return history_format_; }
+
+        /*!
+         * \brief Change the storage format of the history volumes.
+         *
+         * The current history is dropped, and the history volumes are created again in the new format the
+         * next time propagation converges. The new format reaches the shaders with set_model_matrix().
+         */
+        void set_history_format(sh_format format);
+
         /*!
          * \brief Inject VPLs from an RSM into the LPV.
          *
          * Injects VPLs generated from the parameter rsm into the LPV. The exact method to generate VPLs is implementation-dependent,
-         * but the behavior can be overwritten.
+         * but the behavior can be overwritten. One VPL is generated for each texel of the colors target of rsm.
          *
          * \param context A Direc3D context.
          * \param rsm A reflective shadow map with colors, normals and lineardepth.
@@ -185,25 +303,103 @@ namespace dune
          */
         virtual void inject(ID3D11DeviceContext* context, gbuffer& rsm, bool clear);
 
-        /*! \brief Run the normalization and propagation of the LPV. */
+        /*!
+         * \brief Run the normalization and propagation of the LPV.
+         *
+         * If amortized propagation is enabled, this only runs the first batch of iterations allowed by schedule().
+         */
         void render(ID3D11DeviceContext* context);
 
+        /*!
+         * \brief Continue amortized propagation.
+         *
+         * Runs the iterations schedule() allows for this frame. Once all iterations have been run, the
+         * accumulation volume is copied to the history volume, which is shown while the next injection
+         * is propagated.
+         *
+         * \param context A Direct3D context.
+         * \return True if propagation converged with this call.
+         */
+        bool render_amortized(ID3D11DeviceContext* context);
+
         //!@{
         /*! \brief Get/set the number of propagation steps for the LPV. */
         size_t num_propagations() const { return iterations_rendered_; }
         void set_num_propagations(size_t n) { iterations_rendered_ = n; }
         //!@}
 
+        //!@{
+        /*!
+         * \brief Enable/disable amortized propagation.
+         *
+         * Instead of running all propagation steps right after an injection, they are spread over several frames
+         * with render_amortized(). Until propagation converges, the result in progress is blended with the last
+         * converged result.
+         */
+        bool amortized() const { return amortized_; }
+        void set_amortized(bool a) { amortized_ = a; }
+        //!@}
+
+        //!@{
+        /*! \brief Returns the schedule of amortized propagation, which holds the per-frame budget. */
+        propagation_schedule& schedule() { return schedule_; }
+        const propagation_schedule& schedule() const { return schedule_; }
+        //!@}
+
         /*! \brief A rendering function to visualize the LPV with colored cubes for each voxel. */
         void visualize(ID3D11DeviceContext* context, d3d_mesh* node, UINT debug_info_slot);
 
         //!@{
-        /*! \brief Set/get the world -> LPV matrix, which transforms world coordinates to LPV volume coordinates. */
+        /*!
+         * \brief Set/get the world -> LPV matrix, which transforms world coordinates to LPV volume coordinates.
+         *
+         * This places a single cascade and replaces the placement of set_cascades().
+         */
         void set_model_matrix(ID3D11DeviceContext* context, const DirectX::XMFLOAT4X4& model, const DirectX::XMFLOAT3& lpv_min, const DirectX::XMFLOAT3& lpv_max, UINT lpv_parameters_slot);
         const DirectX::XMFLOAT4X4& world_to_lpv() const { return world_to_lpv_; }
         //!@}
 
+        /*!
+         * \brief Place one cascade of the LPV on each cascade of an lpv_cascades.
+         *
+         * VPLs are injected into the finest cascade containing them, and each cascade is propagated on its own.
+         * world_to_lpv() returns the matrix of the finest cascade afterwards.
+         *
+         * \param context A Direct3D context.
+         * \param cascades Cascades with the same size as this LPV, and at most as many as it was created with.
+         * \param lpv_parameters_slot The slot the LPV parameters are bound to.
+         */
+        void set_cascades(ID3D11DeviceContext* context, const lpv_cascades& cascades, UINT lpv_parameters_slot);
+
+        /*! \brief Returns the number of cascades placed by set_model_matrix() or set_cascades(). */
+        UINT num_cascades() const { return num_cascades_; }
+
         virtual void to_ps(ID3D11DeviceContext* context, UINT slot);
+
+        /*!
+         * \brief Bind the last converged result and update the weight it is blended with.
+         *
+         * \param context A Direct3D context.
+         * \param slot The first of three slots for the red, green and blue history volumes.
+         */
+        void history_to_ps(ID3D11DeviceContext* context, UINT slot);
+
+        /*!
+         * \brief Store the volumes bound by to_ps() as "lpv.r", "lpv.g" and "lpv.b" in a snapshot.
+         *
+         * The volumes are read back from the GPU, so this should only be called once propagation finished.
+         */
+        void save_snapshot(ID3D11DeviceContext* context, gi_snapshot& snapshot);
+
+        /*!
+         * \brief Upload the volumes of a snapshot written by save_snapshot() instead of injecting and propagating.
+         *
+         * The propagation schedule counts as converged afterwards, and the history volumes of amortized propagation
+         * are updated as well.
+         *
+         * \return False if the snapshot has no volumes matching the size of this LPV, in which case nothing is changed.
+         */
+        bool load_snapshot(ID3D11DeviceContext* context, const gi_snapshot& snapshot);
     };
 
     /*!
@@ -244,7 +440,7 @@ namespace dune
         delta_light_propagation_volume();
         virtual ~delta_light_propagation_volume() {}
 
-        virtual void create(ID3D11Device* device, UINT volume_size);
+        virtual void create(ID3D11Device* device, UINT volume_size, sh_format history_format = SH_FORMAT_FP16, UINT max_cascades = 1);
         virtual void destroy();
 
         /*! \brief Additionally to the regular indirect injection shader, this will set the direct injection pixel shader. */
@@ -0,0 +1,161 @@
+/*
+ * Dune D3D library - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+#include "lpv_cascades.h"
+
+#include <cmath>
+
+namespace dune
+{
+    bool lpv_cascade::contains(const DirectX::XMFLOAT3& p, float margin) const
+    {
+        const float m = margin * cell_size;
+
+        return p.x >= origin.x + m && p.x < origin.x + extent - m &&
+               p.y >= origin.y + m && p.y < origin.y + extent - m &&
+               p.z >= origin.z + m && p.z < origin.z + extent - m;
+    }
+
+    lpv_cascades::lpv_cascades() :
+        cascades_(),
+        grids_(),
+        bins_(),
+        size_(0),
+        margin_(1.f)
+    {
+    }
+
+    void lpv_cascades::create(size_t num_cascades, size_t size, float extent, bool grids)
+    {
+        size_ = size;
+
+        cascades_.resize(num_cascades);
+        grids_.resize(grids ? num_cascades : 0);
+        bins_.resize(num_cascades);
+
+        for (size_t i = 0; i < num_cascades; ++i)
+        {
+            cascades_[i].extent = extent * static_cast<float>(1 << i);
+            cascades_[i].cell_size = cascades_[i].extent / size;
+        }
+
+        for (auto g = grids_.begin(); g != grids_.end(); ++g)
+            g->create(size, size, size);
+
+        for (size_t i = 0; i < num_cascades; ++i)
+            place(i, DirectX::XMFLOAT3(0, 0, 0));
+    }
+
+    void lpv_cascades::destroy()
+    {
+        for (auto g = grids_.begin(); g != grids_.end(); ++g)
+            g->destroy();
+
+        cascades_.clear();
+        grids_.clear();
+        bins_.clear();
+
+        size_ = 0;
+    }
+
+    void lpv_cascades::place(size_t i, const DirectX::XMFLOAT3& center)
+    {
+        lpv_cascade& c = cascades_[i];
+
+        // snap the minimum corner to the cell grid of this cascade
+        const float half = static_cast<float>(size_ / 2);
+
+        c.cell_offset.x = static_cast<int>(std::floor(center.x / c.cell_size) - half);
+        c.cell_offset.y = static_cast<int>(std::floor(center.y / c.cell_size) - half);
+        c.cell_offset.z = static_cast<int>(std::floor(center.z / c.cell_size) - half);
+
+        c.origin.x = c.cell_offset.x * c.cell_size;
+        c.origin.y = c.cell_offset.y * c.cell_size;
+        c.origin.z = c.cell_offset.z * c.cell_size;
+
+        // same as lpv_grid::set_model_matrix() with an identity model matrix
+        DirectX::XMMATRIX trans = DirectX::XMMatrixTranslation(-c.origin.x, -c.origin.y, -c.origin.z);
+        DirectX::XMMATRIX scale = DirectX::XMMatrixScaling(1.f / c.extent, 1.f / c.extent, 1.f / c.extent);
+        DirectX::XMStoreFloat4x4(&c.world_to_lpv, trans * scale);
+
+        if (i < grids_.size())
+        {
+            DirectX::XMFLOAT3 lpv_min, lpv_max;
+            bounds(i, lpv_min, lpv_max);
+
+            DirectX::XMFLOAT4X4 model;
+            DirectX::XMStoreFloat4x4(&model, DirectX::XMMatrixIdentity());
+
+            grids_[i].set_model_matrix(model, lpv_min, lpv_max);
+        }
+    }
+
+    void lpv_cascades::bounds(size_t i, DirectX::XMFLOAT3& lpv_min, DirectX::XMFLOAT3& lpv_max) const
+    {
+        const lpv_cascade& c = cascades_[i];
+
+        lpv_min = c.origin;
+        lpv_max = DirectX::XMFLOAT3(c.origin.x + c.extent, c.origin.y + c.extent, c.origin.z + c.extent);
+    }
+
+    bool lpv_cascades::update(const DirectX::XMFLOAT3& center)
+    {
+        bool moved = false;
+
+        for (size_t i = 0; i < cascades_.size(); ++i)
+        {
+            DirectX::XMINT3 old = cascades_[i].cell_offset;
+
+            place(i, center);
+
+            const DirectX::XMINT3& now = cascades_[i].cell_offset;
+            moved |= old.x != now.x || old.y != now.y || old.z != now.z;
+        }
+
+        return moved;
+    }
+
+    size_t lpv_cascades::select(const DirectX::XMFLOAT3& p) const
+    {
+        for (size_t i = 0; i < cascades_.size(); ++i)
+            if (cascades_[i].contains(p, margin_))
+                return i;
+
+        // fall back to the coarsest cascade without margin
+        if (!cascades_.empty() && cascades_.back().contains(p))
+            return cascades_.size() - 1;
+
+        return cascades_.size();
+    }
+
+    void lpv_cascades::bin(const std::vector<vpl>& vpls)
+    {
+        for (auto b = bins_.begin(); b != bins_.end(); ++b)
+            b->clear();
+
+        for (auto v = vpls.begin(); v != vpls.end(); ++v)
+        {
+            size_t i = select(v->position);
+
+            if (i < bins_.size())
+                bins_[i].push_back(*v);
+        }
+    }
+
+    void lpv_cascades::inject(const std::vector<vpl>& vpls)
+    {
+        bin(vpls);
+
+        for (size_t i = 0; i < grids_.size(); ++i)
+            grids_[i].inject(bins_[i]);
+    }
+
+    void lpv_cascades::render()
+    {
+        for (auto g = grids_.begin(); g != grids_.end(); ++g)
+            g->render();
+    }
+}
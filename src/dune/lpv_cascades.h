@@ -0,0 +1,123 @@
+/*
+ * Dune D3D library - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+/*! \file */
+
+#ifndef DUNE_LPV_CASCADES
+#define DUNE_LPV_CASCADES
+
+#include <vector>
+
+#include <DirectXMath.h>
+
+#include "lpv_grid.h"
+
+namespace dune
+{
+    /*!
+     * \brief Placement of one cascade of a cascaded LPV.
+     *
+     * A cascade is an axis aligned cube in world space. Its origin is the minimum corner and is
+     * always a multiple of the cell size, so that moving the center does not make injected
+     * light swim.
+     */
+    struct lpv_cascade
+    {
+        DirectX::XMFLOAT3   origin;
+        float               extent;
+        float               cell_size;
+        DirectX::XMINT3     cell_offset;    //!< origin in units of cell_size
+        DirectX::XMFLOAT4X4 world_to_lpv;
+
+        /*! \brief Returns true if p lies inside the cascade and at least margin cells away from its border. */
+        bool contains(const DirectX::XMFLOAT3& p, float margin = 0.f) const;
+    };
+
+    /*!
+     * \brief Nested Light Propagation Volumes centered on a point, usually the camera.
+     *
+     * Cascade 0 is the finest, each following cascade doubles the extent and cell size of its
+     * predecessor while keeping the same number of cells. Every cascade can own an lpv_grid. VPLs
+     * are binned into the finest cascade which contains them, and each cascade is normalized
+     * and propagated on its own. Without grids, the cascades only place a GPU LPV with
+     * light_propagation_volume::set_cascades().
+     */
+    class lpv_cascades
+    {
+    protected:
+        std::vector<lpv_cascade>    cascades_;
+        std::vector<lpv_grid>       grids_;         //!< empty if created without grids
+        std::vector<std::vector<vpl>> bins_;
+
+        size_t                      size_;
+        float                       margin_;
+
+    protected:
+        void place(size_t i, const DirectX::XMFLOAT3& center);
+
+    public:
+        lpv_cascades();
+        virtual ~lpv_cascades() {}
+
+        /*!
+         * \brief Create num_cascades cascades of size^3 cells each.
+         *
+         * \param num_cascades The number of cascades.
+         * \param size The number of cells along each axis of a cascade.
+         * \param extent The world space extent of the finest cascade.
+         * \param grids If false, no lpv_grid is created and inject() and render() do nothing.
+         */
+        void create(size_t num_cascades, size_t size, float extent, bool grids = true);
+        void destroy();
+
+        size_t num_cascades() const { return cascades_.size(); }
+        size_t size() const { return size_; }
+
+        const lpv_cascade& cascade(size_t i) const { return cascades_[i]; }
+
+        lpv_grid& grid(size_t i) { return grids_[i]; }
+        const lpv_grid& grid(size_t i) const { return grids_[i]; }
+
+        /*! \brief Returns the world space bounds of cascade i. */
+        void bounds(size_t i, DirectX::XMFLOAT3& lpv_min, DirectX::XMFLOAT3& lpv_max) const;
+
+        /*!
+         * \brief Center all cascades on a point.
+         *
+         * Each cascade snaps its origin to its own cell size.
+         *
+         * \return True if any cascade moved, in which case light has to be re-injected.
+         */
+        bool update(const DirectX::XMFLOAT3& center);
+
+        //!@{
+        /*!
+         * \brief Get/set the margin in cells a position needs to keep from the border of a cascade to be binned into it.
+         *
+         * The default of one cell leaves room for the half cell shift along the VPL normal during injection.
+         */
+        float margin() const { return margin_; }
+        void set_margin(float m) { margin_ = m; }
+        //!@}
+
+        /*! \brief Returns the index of the finest cascade containing p, or num_cascades() if there is none. */
+        size_t select(const DirectX::XMFLOAT3& p) const;
+
+        /*! \brief Sort VPLs into per-cascade bins with select(). */
+        void bin(const std::vector<vpl>& vpls);
+
+        /*! \brief Returns the VPLs binned into cascade i by the last call to bin(). */
+        const std::vector<vpl>& binned(size_t i) const { return bins_[i]; }
+
+        /*! \brief Bin VPLs and inject each bin into its cascade. */
+        void inject(const std::vector<vpl>& vpls);
+
+        /*! \brief Normalize and propagate every cascade. */
+        void render();
+    };
+}
+
+#endif
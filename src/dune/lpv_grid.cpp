@@ -0,0 +1,837 @@
+/*
+ * Dune D3D library - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+#include "lpv_grid.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "frame_profiler.h"
+#include "geometry_volume.h"
+#include "math_tools.h"
+#include "parallel_tools.h"
+
+namespace dune
+{
+    namespace detail
+    {
+        // number of floats each SH array is padded with
+        const size_t SH_PADDING = 4;
+
+        // six neighbors times five visible faces
+        const size_t NUM_LPV_TRANSFERS = 30;
+
+        // edge length of the bricks propagation skips if they are dark
+        const size_t BRICK_SIZE = 4;
+
+        // same order as offsets[] in lpv_propagate.hlsl
+        const int lpv_offsets[6][3] =
+        {
+            { 0, 0, 1 },
+            { 1, 0, 0 },
+            { 0, 0,-1 },
+            {-1, 0, 0 },
+            { 0, 1, 0 },
+            { 0,-1, 0 },
+        };
+
+        // the transfer of one neighbor onto one face of the receiving cell
+        struct lpv_transfer
+        {
+            size_t neighbor;
+            float dir_sh[4];        // solid_angle * sh4(dir)
+            float face_coeffs[4];   // sh_clamped_cos_coeff(face)
+        };
+
+        // all neighbor/face pairs with a non-zero solid angle, five per neighbor
+        std::vector<lpv_transfer> build_lpv_transfers()
+        {
+            std::vector<lpv_transfer> transfers;
+
+            for (size_t n = 0; n < 6; ++n)
+            for (size_t f = 0; f < 6; ++f)
+            {
+                float dx = lpv_offsets[f][0] * 0.5f - lpv_offsets[n][0];
+                float dy = lpv_offsets[f][1] * 0.5f - lpv_offsets[n][1];
+                float dz = lpv_offsets[f][2] * 0.5f - lpv_offsets[n][2];
+
+                float len = std::sqrt(dx*dx + dy*dy + dz*dz);
+
+                if (len <= 0.5f)
+                    continue;
+
+                float solid_angle = len >= 1.5f ? 22.95668f/(4*180.0f) : 24.26083f/(4*180.0f);
+
+                DirectX::XMFLOAT4 d = sh4(dx/len, dy/len, dz/len);
+                DirectX::XMFLOAT4 c = sh_clamped_cos_coeff(static_cast<float>(lpv_offsets[f][0]),
+                                                           static_cast<float>(lpv_offsets[f][1]),
+                                                           static_cast<float>(lpv_offsets[f][2]));
+
+                lpv_transfer t;
+                t.neighbor = n;
+                t.dir_sh[0] = solid_angle * d.x; t.dir_sh[1] = solid_angle * d.y; t.dir_sh[2] = solid_angle * d.z; t.dir_sh[3] = solid_angle * d.w;
+                t.face_coeffs[0] = c.x; t.face_coeffs[1] = c.y; t.face_coeffs[2] = c.z; t.face_coeffs[3] = c.w;
+
+                transfers.push_back(t);
+            }
+
+            assert(transfers.size() == NUM_LPV_TRANSFERS);
+
+            return transfers;
+        }
+
+        // built once, the initialization of a local static is thread-safe
+        const std::vector<lpv_transfer>& lpv_transfers()
+        {
+            static const std::vector<lpv_transfer> transfers = build_lpv_transfers();
+            return transfers;
+        }
+
+        inline DirectX::XMVECTOR load4(const float* p)
+        {
+            return DirectX::XMLoadFloat4(reinterpret_cast<const DirectX::XMFLOAT4*>(p));
+        }
+
+        inline void store4(float* p, DirectX::FXMVECTOR v, size_t n)
+        {
+            if (n == 4)
+            {
+                DirectX::XMStoreFloat4(reinterpret_cast<DirectX::XMFLOAT4*>(p), v);
+            }
+            else
+            {
+                DirectX::XMFLOAT4 t;
+                DirectX::XMStoreFloat4(&t, v);
+                std::copy(&t.x, &t.x + n, p);
+            }
+        }
+
+        // mark every brick in which any of the arrays has a non-zero value
+        void mark_bricks(size_t w, size_t h, size_t d, const float* const* arrays, size_t num_arrays, std::vector<unsigned char>& bricks)
+        {
+            const size_t bx = (w + BRICK_SIZE - 1) / BRICK_SIZE;
+            const size_t by = (h + BRICK_SIZE - 1) / BRICK_SIZE;
+            const size_t bz = (d + BRICK_SIZE - 1) / BRICK_SIZE;
+
+            bricks.assign(bx * by * bz, 0);
+
+            parallel_for(0, bz, [&](size_t first, size_t last)
+            {
+                for (size_t z = first * BRICK_SIZE; z < std::min(d, last * BRICK_SIZE); ++z)
+                for (size_t y = 0; y < h; ++y)
+                for (size_t x = 0; x < w; ++x)
+                {
+                    const size_t i = (z * h + y) * w + x;
+                    unsigned char& b = bricks[((z / BRICK_SIZE) * by + y / BRICK_SIZE) * bx + x / BRICK_SIZE];
+
+                    for (size_t a = 0; a < num_arrays && !b; ++a)
+                        b = arrays[a][i] != 0.f;
+                }
+            });
+        }
+
+        // grow a brick mask by its six direct neighbors
+        void dilate_bricks(size_t bx, size_t by, size_t bz, const std::vector<unsigned char>& src, std::vector<unsigned char>& dst)
+        {
+            dst.assign(src.size(), 0);
+
+            for (size_t z = 0; z < bz; ++z)
+            for (size_t y = 0; y < by; ++y)
+            for (size_t x = 0; x < bx; ++x)
+            {
+                const size_t i = (z * by + y) * bx + x;
+
+                dst[i] = src[i] ||
+                    (x > 0      && src[i - 1])       || (x + 1 < bx && src[i + 1]) ||
+                    (y > 0      && src[i - bx])      || (y + 1 < by && src[i + bx]) ||
+                    (z > 0      && src[i - bx * by]) || (z + 1 < bz && src[i + bx * by]);
+            }
+        }
+    }
+
+    void sh_volume::create(size_t w, size_t h, size_t d)
+    {
+        width = w;
+        height = h;
+        depth = d;
+
+        for (size_t i = 0; i < 12; ++i)
+            coeffs[i].assign(size() + detail::SH_PADDING, 0.f);
+    }
+
+    void sh_volume::clear()
+    {
+        for (size_t i = 0; i < 12; ++i)
+            std::fill(coeffs[i].begin(), coeffs[i].end(), 0.f);
+    }
+
+    DirectX::XMFLOAT4 sh_volume::get(size_t ch, size_t x, size_t y, size_t z) const
+    {
+        size_t i = index(x, y, z);
+        return DirectX::XMFLOAT4(data(ch, 0)[i], data(ch, 1)[i], data(ch, 2)[i], data(ch, 3)[i]);
+    }
+
+    void sh_volume::set(size_t ch, size_t x, size_t y, size_t z, const DirectX::XMFLOAT4& sh)
+    {
+        size_t i = index(x, y, z);
+        data(ch, 0)[i] = sh.x;
+        data(ch, 1)[i] = sh.y;
+        data(ch, 2)[i] = sh.z;
+        data(ch, 3)[i] = sh.w;
+    }
+
+    lpv_grid::lpv_grid() :
+        time_inject_(0),
+        time_normalize_(0),
+        time_propagate_(0),
+        lpv_(),
+        lpv_accum_(),
+        lpv_inject_counter_(),
+        scatter_(),
+        scatter_counter_(),
+        world_to_lpv_(),
+        bricks_(),
+        active_(),
+        bricks_x_(0),
+        bricks_y_(0),
+        bricks_z_(0),
+        sparse_(true),
+        cells_updated_(0),
+        lpv_history_(),
+        history_valid_(false),
+        schedule_(),
+        gv_(nullptr),
+        iterations_rendered_(0),
+        flux_amplifier_(1.f),
+        delta_(false),
+        curr_(0),
+        next_(0)
+    {
+    }
+
+    void lpv_grid::create(size_t width, size_t height, size_t depth, bool delta)
+    {
+        for (size_t i = 0; i < 2; ++i)
+            lpv_[i].create(width, height, depth);
+
+        lpv_accum_.create(width, height, depth);
+        lpv_history_.create(width, height, depth);
+        history_valid_ = false;
+        lpv_inject_counter_.assign(width * height * depth, 0.f);
+
+        bricks_x_ = (width + detail::BRICK_SIZE - 1) / detail::BRICK_SIZE;
+        bricks_y_ = (height + detail::BRICK_SIZE - 1) / detail::BRICK_SIZE;
+        bricks_z_ = (depth + detail::BRICK_SIZE - 1) / detail::BRICK_SIZE;
+
+        for (size_t i = 0; i < 2; ++i)
+            bricks_[i].assign(bricks_x_ * bricks_y_ * bricks_z_, 0);
+
+        active_.assign(bricks_x_ * bricks_y_ * bricks_z_, 0);
+
+        delta_ = delta;
+
+        DirectX::XMStoreFloat4x4(&world_to_lpv_, DirectX::XMMatrixIdentity());
+
+        curr_ = 0;
+        next_ = 1;
+
+        iterations_rendered_ = 0;
+    }
+
+    void lpv_grid::destroy()
+    {
+        for (size_t i = 0; i < 2; ++i)
+            lpv_[i] = sh_volume();
+
+        lpv_accum_ = sh_volume();
+        lpv_history_ = sh_volume();
+        history_valid_ = false;
+        lpv_inject_counter_.clear();
+
+        scatter_.clear();
+        scatter_counter_.clear();
+
+        for (size_t i = 0; i < 2; ++i)
+            bricks_[i].clear();
+
+        active_.clear();
+        bricks_x_ = bricks_y_ = bricks_z_ = 0;
+
+        curr_ = next_ = 0;
+    }
+
+    void lpv_grid::clear()
+    {
+        for (size_t i = 0; i < 2; ++i)
+            lpv_[i].clear();
+
+        lpv_accum_.clear();
+        std::fill(lpv_inject_counter_.begin(), lpv_inject_counter_.end(), 0.f);
+
+        for (size_t i = 0; i < 2; ++i)
+            std::fill(bricks_[i].begin(), bricks_[i].end(), 0);
+    }
+
+    void lpv_grid::update_bricks()
+    {
+        const sh_volume& v = lpv_[next_];
+
+        const float* arrays[12];
+
+        for (size_t c = 0; c < 12; ++c)
+            arrays[c] = &v.coeffs[c][0];
+
+        detail::mark_bricks(v.width, v.height, v.depth, arrays, 12, bricks_[next_]);
+    }
+
+    size_t lpv_grid::num_lit_bricks() const
+    {
+        return std::count(bricks_[next_].begin(), bricks_[next_].end(), 1);
+    }
+
+    void lpv_grid::swap_buffers()
+    {
+        std::swap(curr_, next_);
+    }
+
+    const sh_volume& lpv_grid::result() const
+    {
+        if (iterations_rendered_ > 0)
+            return lpv_accum_;
+        else
+            return lpv_[next_];
+    }
+
+    void lpv_grid::set_model_matrix(const DirectX::XMFLOAT4X4& model, const DirectX::XMFLOAT3& lpv_min, const DirectX::XMFLOAT3& lpv_max)
+    {
+        DirectX::XMMATRIX model_inv = DirectX::XMMatrixInverse(nullptr, DirectX::XMLoadFloat4x4(&model));
+
+        DirectX::XMFLOAT3 d;
+        DirectX::XMStoreFloat3(&d, DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&lpv_max), DirectX::XMLoadFloat3(&lpv_min)));
+
+        DirectX::XMMATRIX scale = DirectX::XMMatrixScaling(1.f/d.x, 1.f/d.y, 1.f/d.z);
+        DirectX::XMMATRIX trans = DirectX::XMMatrixTranslation(-lpv_min.x, -lpv_min.y, -lpv_min.z);
+
+        DirectX::XMStoreFloat4x4(&world_to_lpv_, model_inv * trans * scale);
+    }
+
+    void generate_vpls(const rsm_data& rsm, const DirectX::XMFLOAT4X4& light_vp_inv, const DirectX::XMFLOAT3& light_pos, size_t stride, std::vector<vpl>& vpls)
+    {
+        stride = std::max<size_t>(stride, 1);
+
+        const size_t vpls_x = rsm.width / stride;
+        const size_t vpls_y = rsm.height / stride;
+
+        const DirectX::XMMATRIX vp_inv = DirectX::XMLoadFloat4x4(&light_vp_inv);
+        const DirectX::XMVECTOR light = DirectX::XMVectorSetW(DirectX::XMLoadFloat3(&light_pos), 1.f);
+
+        // rows are generated in parallel and concatenated in order afterwards
+        std::vector<std::vector<vpl>> rows(vpls_y);
+
+        parallel_for(0, vpls_y, [&](size_t first, size_t last)
+        {
+            for (size_t y = first; y < last; ++y)
+            for (size_t x = 0; x < vpls_x; ++x)
+            {
+                // gen_vpl() with a point sampler
+                float u = (x + 0.5f) / vpls_x;
+                float v = (y + 0.5f) / vpls_y;
+
+                size_t tx = std::min(rsm.width - 1, static_cast<size_t>(u * rsm.width));
+                size_t ty = std::min(rsm.height - 1, static_cast<size_t>(v * rsm.height));
+                size_t t = ty * rsm.width + tx;
+
+                float vdepth = rsm.lineardepth[t * 2];
+
+                if (vdepth < 0.0001f)
+                    continue;
+
+                unsigned int packed_normal = rsm.normals[t];
+
+                DirectX::XMVECTOR normal = DirectX::XMVectorSet(
+                    (packed_normal & 0x3ff) / 1023.f * 2.f - 1.f,
+                    ((packed_normal >> 10) & 0x3ff) / 1023.f * 2.f - 1.f,
+                    ((packed_normal >> 20) & 0x3ff) / 1023.f * 2.f - 1.f,
+                    0.f);
+
+                DirectX::XMVECTOR dir = DirectX::XMVector4Transform(DirectX::XMVectorSet((u - 0.5f) * 2.f, (v - 0.5f) * -2.f, 1.f, 1.f), vp_inv);
+                DirectX::XMVECTOR position = DirectX::XMVectorMultiplyAdd(DirectX::XMVector4Normalize(dir), DirectX::XMVectorReplicate(vdepth), light);
+
+                // kill injects with wrong normals
+                DirectX::XMVECTOR to_light = DirectX::XMVector3Normalize(DirectX::XMVectorSubtract(light, position));
+                float cos_theta = DirectX::XMVectorGetX(DirectX::XMVector3Dot(to_light, normal));
+
+                if (cos_theta < 0)
+                    continue;
+
+                const DirectX::PackedVector::HALF* c = &rsm.colors[t * 4];
+                float flux = std::min(cos_theta, 1.f) / PI;
+
+                vpl p;
+                DirectX::XMStoreFloat3(&p.position, position);
+                DirectX::XMStoreFloat3(&p.normal, DirectX::XMVector3Normalize(normal));
+                p.flux = DirectX::XMFLOAT3(DirectX::PackedVector::XMConvertHalfToFloat(c[0]) * flux,
+                                           DirectX::PackedVector::XMConvertHalfToFloat(c[1]) * flux,
+                                           DirectX::PackedVector::XMConvertHalfToFloat(c[2]) * flux);
+
+                rows[y].push_back(p);
+            }
+        });
+
+        vpls.clear();
+
+        for (auto r = rows.begin(); r != rows.end(); ++r)
+            vpls.insert(vpls.end(), r->begin(), r->end());
+    }
+
+    void lpv_grid::inject(const rsm_data& rsm, const DirectX::XMFLOAT4X4& light_vp_inv, const DirectX::XMFLOAT3& light_pos, size_t stride)
+    {
+        profile_zone zone("CPU LPV inject RSM");
+
+        std::vector<vpl> vpls;
+        generate_vpls(rsm, light_vp_inv, light_pos, stride, vpls);
+
+        inject(vpls);
+
+        time_inject_ = zone.elapsed_ms();
+    }
+
+    void lpv_grid::inject(const std::vector<vpl>& vpls)
+    {
+        profile_zone zone("CPU LPV inject");
+
+        const size_t w = width();
+        const size_t h = height();
+        const size_t d = depth();
+
+        if (scatter_.size() != num_workers() || scatter_[0].size() != lpv_accum_.size())
+        {
+            scatter_.resize(num_workers());
+            scatter_counter_.resize(num_workers());
+
+            for (size_t i = 0; i < scatter_.size(); ++i)
+            {
+                scatter_[i].create(w, h, d);
+                scatter_counter_[i].assign(w * h * d, 0.f);
+            }
+        }
+
+        const DirectX::XMMATRIX to_lpv = DirectX::XMLoadFloat4x4(&world_to_lpv_);
+        const DirectX::XMVECTOR dims = DirectX::XMVectorSet(static_cast<float>(w), static_cast<float>(h), static_cast<float>(d), 1.f);
+        const DirectX::XMVECTOR half_cell = DirectX::XMVectorDivide(DirectX::XMVectorReplicate(0.5f), dims);
+
+        std::vector<char> used(scatter_.size(), 0);
+
+        parallel_for_dynamic(0, vpls.size(), 4096, [&](size_t worker, size_t first, size_t last)
+        {
+            sh_volume& target = scatter_[worker];
+            std::vector<float>& counter = scatter_counter_[worker];
+
+            used[worker] = 1;
+
+            for (size_t v = first; v < last; ++v)
+            {
+                const vpl& p = vpls[v];
+
+                DirectX::XMVECTOR normal = DirectX::XMLoadFloat3(&p.normal);
+
+                // shift by half a cell size into direction of normal
+                DirectX::XMVECTOR pnor = DirectX::XMVector4Normalize(DirectX::XMVector4Transform(normal, to_lpv));
+                DirectX::XMVECTOR ppos = DirectX::XMVector4Transform(DirectX::XMVectorSetW(DirectX::XMLoadFloat3(&p.position), 1.f), to_lpv);
+                ppos = DirectX::XMVectorMultiplyAdd(pnor, half_cell, ppos);
+
+                DirectX::XMFLOAT3 cell;
+                DirectX::XMStoreFloat3(&cell, DirectX::XMVectorFloor(DirectX::XMVectorMultiply(ppos, dims)));
+
+                if (!(cell.x >= 0 && cell.y >= 0 && cell.z >= 0 && cell.x < w && cell.y < h && cell.z < d))
+                    continue;
+
+                DirectX::XMFLOAT4 coeffs = sh_clamped_cos_coeff(p.normal.x, p.normal.y, p.normal.z);
+
+                size_t i = target.index(static_cast<size_t>(cell.x), static_cast<size_t>(cell.y), static_cast<size_t>(cell.z));
+
+                const float* flux = &p.flux.x;
+
+                for (size_t ch = 0; ch < 3; ++ch)
+                {
+                    target.data(ch, 0)[i] += flux[ch] * coeffs.x;
+                    target.data(ch, 1)[i] += flux[ch] * coeffs.y;
+                    target.data(ch, 2)[i] += flux[ch] * coeffs.z;
+                    target.data(ch, 3)[i] += flux[ch] * coeffs.w;
+                }
+
+                counter[i] += 1.f;
+            }
+        });
+
+        // sum up and reset all worker volumes
+        sh_volume& dst = lpv_[next_];
+        const size_t slice = w * h;
+
+        parallel_for(0, d, [&](size_t first, size_t last)
+        {
+            const size_t b = first * slice;
+            const size_t e = last * slice;
+
+            for (size_t c = 0; c < 12; ++c)
+                std::fill(&dst.coeffs[c][0] + b, &dst.coeffs[c][0] + e, 0.f);
+
+            std::fill(&lpv_inject_counter_[0] + b, &lpv_inject_counter_[0] + e, 0.f);
+
+            for (size_t s = 0; s < scatter_.size(); ++s)
+            {
+                if (!used[s])
+                    continue;
+
+                for (size_t c = 0; c < 12; ++c)
+                {
+                    float* src = &scatter_[s].coeffs[c][0];
+
+                    for (size_t i = b; i < e; ++i)
+                        dst.coeffs[c][i] += src[i];
+
+                    std::fill(src + b, src + e, 0.f);
+                }
+
+                float* src = &scatter_counter_[s][0];
+
+                for (size_t i = b; i < e; ++i)
+                    lpv_inject_counter_[i] += src[i];
+
+                std::fill(src + b, src + e, 0.f);
+            }
+        });
+
+        // every cell which received a VPL starts out lit
+        const float* counter = &lpv_inject_counter_[0];
+        detail::mark_bricks(w, h, d, &counter, 1, bricks_[next_]);
+
+        time_inject_ = zone.elapsed_ms();
+    }
+
+    void lpv_grid::normalize()
+    {
+        profile_zone zone("CPU LPV normalize");
+
+        swap_buffers();
+
+        const sh_volume& src = lpv_[curr_];
+        sh_volume& dst = lpv_[next_];
+
+        const size_t slice = src.width * src.height;
+
+        parallel_for(0, src.depth, [&](size_t first, size_t last)
+        {
+            for (size_t i = first * slice; i < last * slice; ++i)
+            {
+                float num_lights = std::abs(lpv_inject_counter_[i]);
+                float scale = num_lights > 0 ? 1.f / num_lights : 1.f;
+
+                for (size_t c = 0; c < 12; ++c)
+                    dst.coeffs[c][i] = src.coeffs[c][i] * scale;
+            }
+        });
+
+        // scaling keeps dark cells dark
+        bricks_[next_] = bricks_[curr_];
+
+        time_normalize_ = zone.elapsed_ms();
+    }
+
+    void lpv_grid::propagate_step(size_t iteration)
+    {
+        swap_buffers();
+
+        const sh_volume& src = lpv_[curr_];
+        sh_volume& dst = lpv_[next_];
+
+        const size_t w = src.width;
+        const size_t h = src.height;
+        const size_t d = src.depth;
+
+        const std::vector<detail::lpv_transfer>& transfers = detail::lpv_transfers();
+
+        const DirectX::XMVECTOR famp = DirectX::XMVectorReplicate(flux_amplifier_);
+        const DirectX::XMVECTOR zero = DirectX::XMVectorZero();
+
+        // splat the amplified transfer weights once per step, the clamped cosine lobe of an
+        // axis aligned face only has two non-zero coefficients. This lives on the stack because
+        // std::vector does not guarantee the alignment of XMVECTOR.
+        struct transfer_weights
+        {
+            size_t neighbor;
+            DirectX::XMVECTOR dir_sh[4];
+            DirectX::XMVECTOR face_dc;
+            DirectX::XMVECTOR face_axis;
+            size_t axis;
+        };
+
+        transfer_weights weights[detail::NUM_LPV_TRANSFERS];
+
+        for (size_t i = 0; i < detail::NUM_LPV_TRANSFERS; ++i)
+        {
+            const detail::lpv_transfer& t = transfers[i];
+
+            weights[i].neighbor = t.neighbor;
+
+            for (size_t k = 0; k < 4; ++k)
+                weights[i].dir_sh[k] = DirectX::XMVectorReplicate(t.dir_sh[k] * flux_amplifier_);
+
+            weights[i].axis = 1;
+
+            for (size_t k = 1; k < 4; ++k)
+                if (t.face_coeffs[k] != 0.f)
+                    weights[i].axis = k;
+
+            weights[i].face_dc = DirectX::XMVectorReplicate(t.face_coeffs[0]);
+            weights[i].face_axis = DirectX::XMVectorReplicate(t.face_coeffs[weights[i].axis]);
+        }
+
+        // Like ps_lpv_propagate(), the first iteration also adds the amplified flux at the position
+        // of the last neighbor read, which is the cell at y-1 and not the cell itself.
+        const bool add_last_neighbor = !delta_ && iteration == 0;
+
+        // light travels at most one cell, so only bricks next to lit bricks can receive any
+        if (sparse_)
+            detail::dilate_bricks(bricks_x_, bricks_y_, bricks_z_, bricks_[curr_], active_);
+        else
+            std::fill(active_.begin(), active_.end(), 1);
+
+        const std::vector<unsigned char>& stale = bricks_[next_];
+        std::vector<unsigned char> lit(active_.size(), 0);
+
+        std::vector<size_t> cells_updated(bricks_z_, 0);
+
+        const DirectX::XMVECTOR lane = DirectX::XMVectorSet(0.f, 1.f, 2.f, 3.f);
+
+        // one task per layer of bricks, so that no brick is shared between workers
+        parallel_for(0, bricks_z_, [&](size_t first, size_t last)
+        {
+            // zero padded copies of the current row for the x-neighbors and a zero row for the volume border
+            std::vector<float> row(12 * (w + 2 + detail::SH_PADDING), 0.f);
+            std::vector<float> zero_row(w + detail::SH_PADDING, 0.f);
+
+            const size_t row_stride = w + 2 + detail::SH_PADDING;
+
+            for (size_t bz = first; bz < last; ++bz)
+            for (size_t z = bz * detail::BRICK_SIZE; z < std::min(d, (bz + 1) * detail::BRICK_SIZE); ++z)
+            for (size_t y = 0; y < h; ++y)
+            {
+                const size_t row_start = src.index(0, y, z);
+                const size_t brick_row = (bz * bricks_y_ + y / detail::BRICK_SIZE) * bricks_x_;
+
+                bool any_active = false;
+
+                for (size_t bx = 0; bx < bricks_x_; ++bx)
+                    any_active |= active_[brick_row + bx] != 0;
+
+                if (any_active)
+                {
+                    for (size_t c = 0; c < 12; ++c)
+                        std::copy(&src.coeffs[c][row_start], &src.coeffs[c][row_start] + w, &row[c * row_stride + 1]);
+                }
+
+                // pointers to the first cell of each neighbor row for all 12 coefficient arrays
+                const float* neighbors[6][12];
+                const float* transmittance[6] = {};
+
+                for (size_t n = 0; n < 6; ++n)
+                {
+                    const int* o = detail::lpv_offsets[n];
+
+                    int ny = static_cast<int>(y) + o[1];
+                    int nz = static_cast<int>(z) + o[2];
+
+                    for (size_t c = 0; c < 12; ++c)
+                    {
+                        if (o[0] != 0)
+                            neighbors[n][c] = &row[c * row_stride + 1 + o[0]];
+                        else if (ny < 0 || ny >= static_cast<int>(h) || nz < 0 || nz >= static_cast<int>(d))
+                            neighbors[n][c] = &zero_row[0];
+                        else
+                            neighbors[n][c] = &src.coeffs[c][src.index(0, ny, nz)];
+                    }
+
+                    if (gv_)
+                        transmittance[n] = gv_->transmittance(n) + row_start;
+                }
+
+                for (size_t x = 0; x < w; x += 4)
+                {
+                    const size_t count = std::min<size_t>(4, w - x);
+                    const size_t brick = brick_row + x / detail::BRICK_SIZE;
+                    const size_t i = row_start + x;
+
+                    if (!active_[brick])
+                    {
+                        // clear what the step before the last one left in here
+                        if (stale[brick])
+                            for (size_t c = 0; c < 12; ++c)
+                                detail::store4(&dst.coeffs[c][i], zero, count);
+
+                        continue;
+                    }
+
+                    DirectX::XMVECTOR new_sh[12];
+                    DirectX::XMVECTOR old_sh[12];
+
+                    for (size_t c = 0; c < 12; ++c)
+                    {
+                        new_sh[c] = zero;
+                        old_sh[c] = zero;
+                    }
+
+                    size_t loaded = 6;
+                    DirectX::XMVECTOR pass = DirectX::XMVectorReplicate(1.f);
+
+                    for (const transfer_weights* t = weights; t != weights + detail::NUM_LPV_TRANSFERS; ++t)
+                    {
+                        if (t->neighbor != loaded)
+                        {
+                            for (size_t c = 0; c < 12; ++c)
+                                old_sh[c] = detail::load4(neighbors[t->neighbor][c] + x);
+
+                            // flux from this neighbor is attenuated by geometry on the shared face
+                            if (gv_)
+                                pass = detail::load4(transmittance[t->neighbor] + x);
+
+                            loaded = t->neighbor;
+                        }
+
+                        for (size_t ch = 0; ch < 3; ++ch)
+                        {
+                            const DirectX::XMVECTOR* sh = &old_sh[ch * 4];
+
+                            DirectX::XMVECTOR r = DirectX::XMVectorMultiply(sh[0], t->dir_sh[0]);
+                            r = DirectX::XMVectorMultiplyAdd(sh[1], t->dir_sh[1], r);
+                            r = DirectX::XMVectorMultiplyAdd(sh[2], t->dir_sh[2], r);
+                            r = DirectX::XMVectorMultiplyAdd(sh[3], t->dir_sh[3], r);
+
+                            if (!delta_)
+                                r = DirectX::XMVectorMax(r, zero);
+
+                            if (gv_)
+                                r = DirectX::XMVectorMultiply(r, pass);
+
+                            new_sh[ch * 4] = DirectX::XMVectorMultiplyAdd(r, t->face_dc, new_sh[ch * 4]);
+                            new_sh[ch * 4 + t->axis] = DirectX::XMVectorMultiplyAdd(r, t->face_axis, new_sh[ch * 4 + t->axis]);
+                        }
+                    }
+
+                    // old_sh still holds the last neighbor
+                    if (add_last_neighbor)
+                        for (size_t c = 0; c < 12; ++c)
+                            new_sh[c] = DirectX::XMVectorMultiplyAdd(old_sh[c], famp, new_sh[c]);
+
+                    // lanes past the end of the row read the next row and must not mark the brick
+                    DirectX::XMVECTOR nonzero = zero;
+
+                    for (size_t c = 0; c < 12; ++c)
+                    {
+                        detail::store4(&dst.coeffs[c][i], new_sh[c], count);
+
+                        DirectX::XMVECTOR acc = DirectX::XMVectorAdd(detail::load4(&lpv_accum_.coeffs[c][i]), new_sh[c]);
+                        detail::store4(&lpv_accum_.coeffs[c][i], acc, count);
+
+                        nonzero = DirectX::XMVectorOrInt(nonzero, DirectX::XMVectorNotEqual(new_sh[c], zero));
+                    }
+
+                    nonzero = DirectX::XMVectorAndInt(nonzero, DirectX::XMVectorLess(lane, DirectX::XMVectorReplicate(static_cast<float>(count))));
+
+                    if (!DirectX::XMVector4EqualInt(nonzero, zero))
+                        lit[brick] = 1;
+
+                    cells_updated[bz] += count;
+                }
+            }
+        });
+
+        bricks_[next_].swap(lit);
+
+        for (auto c = cells_updated.begin(); c != cells_updated.end(); ++c)
+            cells_updated_ += *c;
+    }
+
+    void lpv_grid::propagate(size_t num_iterations)
+    {
+        if (num_iterations == 0)
+            return;
+
+        profile_zone zone("CPU LPV propagate");
+
+        lpv_accum_.clear();
+
+        cells_updated_ = 0;
+
+        for (size_t i = 0; i < num_iterations; ++i)
+            propagate_step(i);
+
+        time_propagate_ = zone.elapsed_ms();
+    }
+
+    void lpv_grid::render()
+    {
+        normalize();
+        propagate(iterations_rendered_);
+    }
+
+    void lpv_grid::begin_amortized()
+    {
+        normalize();
+
+        lpv_accum_.clear();
+        cells_updated_ = 0;
+
+        schedule_.restart(iterations_rendered_);
+    }
+
+    bool lpv_grid::render_amortized()
+    {
+        size_t n = schedule_.next_batch();
+
+        if (n == 0)
+            return false;
+
+        profile_zone zone("CPU LPV propagate");
+
+        for (size_t i = 0; i < n; ++i)
+            propagate_step(schedule_.done() + i);
+
+        time_propagate_ = zone.elapsed_ms();
+
+        schedule_.completed(n, time_propagate_);
+
+        if (!schedule_.converged())
+            return false;
+
+        lpv_history_ = lpv_accum_;
+        history_valid_ = true;
+
+        return true;
+    }
+
+    float lpv_grid::history_weight() const
+    {
+        if (!history_valid_ || schedule_.converged())
+            return 0.f;
+
+        return 1.f - schedule_.progress();
+    }
+
+    void lpv_grid::blend(sh_volume& out) const
+    {
+        const sh_volume& current = result();
+        const float t = history_weight();
+
+        if (out.size() != current.size())
+            out.create(current.width, current.height, current.depth);
+
+        for (size_t c = 0; c < 12; ++c)
+        for (size_t i = 0; i < current.size(); ++i)
+            out.coeffs[c][i] = current.coeffs[c][i] + (lpv_history_.coeffs[c][i] - current.coeffs[c][i]) * t;
+    }
+}
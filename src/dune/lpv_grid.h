@@ -0,0 +1,310 @@
+/*
+ * Dune D3D library - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+/*! \file */
+
+#ifndef DUNE_LPV_GRID
+#define DUNE_LPV_GRID
+
+#include <vector>
+
+#include <DirectXMath.h>
+#include <DirectXPackedVector.h>
+
+#include "propagation_schedule.h"
+
+namespace dune
+{
+    class geometry_volume;
+}
+
+namespace dune
+{
+    /*!
+     * \brief A volume of spherical harmonics coefficients stored as structure of arrays.
+     *
+     * Each color channel and each of the four SH coefficients lives in its own contiguous
+     * float array, so that neighboring cells of one coefficient can be processed with SIMD.
+     * Every array is padded by a few floats so that four cells can always be loaded at once.
+     * Cells are addressed like a Texture2DArray of the GPU version: x is the column, y the row
+     * and z the slice.
+     */
+    struct sh_volume
+    {
+        size_t width, height, depth;
+        std::vector<float> coeffs[12];
+
+        sh_volume() : width(0), height(0), depth(0) {}
+
+        void create(size_t w, size_t h, size_t d);
+        void clear();
+
+        size_t size() const { return width * height * depth; }
+        size_t index(size_t x, size_t y, size_t z) const { return (z * height + y) * width + x; }
+
+        //!@{
+        /*! \brief Return the array of coefficient c for color channel ch (0 = red, 1 = green, 2 = blue). */
+        float* data(size_t ch, size_t c)             { return &coeffs[ch*4 + c][0]; }
+        const float* data(size_t ch, size_t c) const { return &coeffs[ch*4 + c][0]; }
+        //!@}
+
+        //!@{
+        /*! \brief Get/set the four SH coefficients of color channel ch in one cell. */
+        DirectX::XMFLOAT4 get(size_t ch, size_t x, size_t y, size_t z) const;
+        void set(size_t ch, size_t x, size_t y, size_t z, const DirectX::XMFLOAT4& sh);
+        //!@}
+    };
+
+    /*!
+     * \brief Pointers to the CPU copy of a Reflective Shadow Map.
+     *
+     * The layout is the one of a cached render_target of an RSM gbuffer as it is created by
+     * common_renderer: colors are DXGI_FORMAT_R16G16B16A16_FLOAT, normals DXGI_FORMAT_R10G10B10A2_UNORM
+     * and the linear depth is DXGI_FORMAT_R32G32_FLOAT, of which only the first channel is read.
+     */
+    struct rsm_data
+    {
+        size_t width, height;
+
+        const DirectX::PackedVector::HALF*  colors;
+        const unsigned int*                 normals;
+        const float*                        lineardepth;
+
+        rsm_data() : width(0), height(0), colors(nullptr), normals(nullptr), lineardepth(nullptr) {}
+    };
+
+    /*! \brief A virtual point light generated from an RSM texel. */
+    struct vpl
+    {
+        DirectX::XMFLOAT3 position;
+        DirectX::XMFLOAT3 normal;   //!< normalized
+        DirectX::XMFLOAT3 flux;     //!< color / PI * cosine to the light
+    };
+
+    /*!
+     * \brief Generate VPLs from an RSM like gen_vpl() and vs_lpv_inject().
+     *
+     * Invalid VPLs and VPLs facing away from the light are skipped.
+     *
+     * \param rsm The RSM to generate VPLs from.
+     * \param light_vp_inv The inverse view projection matrix of the light that rendered the RSM.
+     * \param light_pos The position of that light.
+     * \param stride Generate one VPL every stride texels, i.e. (width/stride) * (height/stride) VPLs at most.
+     * \param vpls The generated VPLs.
+     */
+    void generate_vpls(const rsm_data& rsm, const DirectX::XMFLOAT4X4& light_vp_inv, const DirectX::XMFLOAT3& light_pos, size_t stride, std::vector<vpl>& vpls);
+
+    /*!
+     * \brief A CPU Light Propagation Volume.
+     *
+     * This is a reference implementation of the normalization and propagation steps of
+     * light_propagation_volume. It follows lpv_normalize.hlsl and lpv_propagate.hlsl: radiance is
+     * gathered from the six neighbors of a cell by projecting their SH onto the five visible faces
+     * of the cell, and each iteration is added to an accumulation volume.
+     *
+     * Cells of a row are processed four at a time with XMVECTOR, slabs of slices are distributed
+     * over all workers. Volumes of any size are supported. Dark regions are skipped during
+     * propagation, see set_sparse(). Flux can be blocked by scene geometry, see set_geometry().
+     */
+    class lpv_grid
+    {
+    public:
+        float time_inject_;
+        float time_normalize_;
+        float time_propagate_;
+
+    protected:
+        sh_volume               lpv_[2];
+        sh_volume               lpv_accum_;
+
+        std::vector<float>      lpv_inject_counter_;
+
+        // private injection targets of each worker
+        std::vector<sh_volume>          scatter_;
+        std::vector<std::vector<float>> scatter_counter_;
+
+        DirectX::XMFLOAT4X4     world_to_lpv_;
+
+        // cells are grouped into bricks of 4^3, a brick is lit if any of its cells holds flux
+        std::vector<unsigned char> bricks_[2];
+        std::vector<unsigned char> active_;
+        size_t                  bricks_x_, bricks_y_, bricks_z_;
+        bool                    sparse_;
+        size_t                  cells_updated_;
+
+        // last converged result and schedule of amortized propagation
+        sh_volume               lpv_history_;
+        bool                    history_valid_;
+        propagation_schedule    schedule_;
+
+        const geometry_volume*  gv_;
+
+        size_t                  iterations_rendered_;
+        float                   flux_amplifier_;
+        bool                    delta_;
+
+        unsigned int            curr_;
+        unsigned int            next_;
+
+    protected:
+        void swap_buffers();
+
+        void propagate_step(size_t iteration);
+
+    public:
+        lpv_grid();
+        virtual ~lpv_grid() {}
+
+        /*!
+         * \brief Create a grid of width x height x depth cells.
+         *
+         * \param delta If true, propagation follows ps_delta_lpv_propagate(), i.e. negative flux is not clamped.
+         */
+        void create(size_t width, size_t height, size_t depth, bool delta = false);
+        void destroy();
+
+        /*! \brief Clear all volumes and the inject counter. */
+        void clear();
+
+        size_t width() const  { return lpv_accum_.width; }
+        size_t height() const { return lpv_accum_.height; }
+        size_t depth() const  { return lpv_accum_.depth; }
+
+        //!@{
+        /*!
+         * \brief The volume injections are written to, and the number of injects each of its cells received.
+         *
+         * Call update_bricks() after writing into the volume directly.
+         */
+        sh_volume& injected()                       { return lpv_[next_]; }
+        std::vector<float>& inject_counter()        { return lpv_inject_counter_; }
+        //!@}
+
+        /*! \brief Recompute which bricks of the injected volume are lit. */
+        void update_bricks();
+
+        /*! \brief Returns the number of lit bricks in the volume written last. */
+        size_t num_lit_bricks() const;
+
+        //!@{
+        /*!
+         * \brief Enable/disable sparse propagation.
+         *
+         * Light travels at most one cell per iteration, so a propagation step only needs to update
+         * bricks which are lit or next to a lit brick. The lit bricks start out as the injection footprint and
+         * grow with each step. Results are identical to dense propagation.
+         *
+         * This only applies to the CPU grid, light_propagation_volume always propagates every slice.
+         */
+        bool sparse() const { return sparse_; }
+        void set_sparse(bool s) { sparse_ = s; }
+        //!@}
+
+        //!@{
+        /*!
+         * \brief Get/set the geometry volume which attenuates propagation, or nullptr for none.
+         *
+         * The geometry volume needs to have the same size and transformation as the grid and is not owned by it.
+         */
+        const geometry_volume* geometry() const { return gv_; }
+        void set_geometry(const geometry_volume* gv) { gv_ = gv; }
+        //!@}
+
+        /*! \brief Returns the number of cells updated by the last call to propagate(). */
+        size_t cells_updated() const { return cells_updated_; }
+
+        /*!
+         * \brief Set the transformation of the volume.
+         *
+         * Computes the same world_to_lpv matrix as light_propagation_volume::set_model_matrix().
+         *
+         * \param model The model matrix of the volume.
+         * \param lpv_min The minimum corner of the volume in model space.
+         * \param lpv_max The maximum corner of the volume in model space.
+         */
+        void set_model_matrix(const DirectX::XMFLOAT4X4& model, const DirectX::XMFLOAT3& lpv_min, const DirectX::XMFLOAT3& lpv_max);
+
+        const DirectX::XMFLOAT4X4& world_to_lpv() const { return world_to_lpv_; }
+
+        /*!
+         * \brief Inject VPLs from an RSM into the LPV.
+         *
+         * Generates VPLs with generate_vpls() and injects them.
+         *
+         * \param rsm The RSM to generate VPLs from.
+         * \param light_vp_inv The inverse view projection matrix of the light that rendered the RSM.
+         * \param light_pos The position of that light.
+         * \param stride Generate one VPL every stride texels, i.e. (width/stride) * (height/stride) VPLs in total.
+         */
+        void inject(const rsm_data& rsm, const DirectX::XMFLOAT4X4& light_vp_inv, const DirectX::XMFLOAT3& light_pos, size_t stride = 1);
+
+        /*!
+         * \brief Inject VPLs into the LPV.
+         *
+         * Clears the injected volume and the inject counter and injects VPLs like vs_lpv_inject()
+         * and ps_lpv_inject(). Workers scatter into private volumes, which are summed up afterwards.
+         * VPLs outside of the volume are skipped.
+         */
+        void inject(const std::vector<vpl>& vpls);
+
+        /*! \brief Divide each injected cell by the number of injects it received. */
+        void normalize();
+
+        /*! \brief Clear the accumulation volume and run num_iterations propagation steps. */
+        void propagate(size_t num_iterations);
+
+        /*! \brief Run the normalization and propagation of the LPV. */
+        void render();
+
+        /*!
+         * \brief Normalize and restart amortized propagation.
+         *
+         * Call this after each injection instead of render(), then call render_amortized() once per frame.
+         */
+        void begin_amortized();
+
+        /*!
+         * \brief Run the propagation iterations schedule() allows for this frame.
+         *
+         * Once all iterations have been run, the accumulation volume is copied to the history volume.
+         *
+         * \return True if propagation converged with this call.
+         */
+        bool render_amortized();
+
+        //!@{
+        /*! \brief Returns the schedule of amortized propagation, which holds the per-frame budget. */
+        propagation_schedule& schedule() { return schedule_; }
+        const propagation_schedule& schedule() const { return schedule_; }
+        //!@}
+
+        /*! \brief Returns the last converged accumulation volume. */
+        const sh_volume& history() const { return lpv_history_; }
+
+        /*! \brief Returns the weight of history() when blending it with the result in progress. */
+        float history_weight() const;
+
+        /*! \brief Blend history() and result() with history_weight(). */
+        void blend(sh_volume& out) const;
+
+        //!@{
+        /*! \brief Get/set the number of propagation steps for the LPV. */
+        size_t num_propagations() const { return iterations_rendered_; }
+        void set_num_propagations(size_t n) { iterations_rendered_ = n; }
+        //!@}
+
+        //!@{
+        /*! \brief Get/set the flux amplifier, which is the lpv_flux_amplifier parameter of the GPU version. */
+        float flux_amplifier() const { return flux_amplifier_; }
+        void set_flux_amplifier(float f) { flux_amplifier_ = f; }
+        //!@}
+
+        /*! \brief Returns the volume light_propagation_volume::to_ps() would bind after render(). */
+        const sh_volume& result() const;
+    };
+}
+
+#endif
@@ -31,6 +31,18 @@ namespace dune
         return DirectX::XMFLOAT2(float(i) / float(N), detail::radiacal_inverse_vdc(i));
     }
 
+    DirectX::XMFLOAT4 sh4(float x, float y, float z)
+    {
+        return DirectX::XMFLOAT4(0.282094792f, -0.4886025119f * y, 0.4886025119f * z, -0.4886025119f * x);
+    }
+
+    DirectX::XMFLOAT4 sh_clamped_cos_coeff(float x, float y, float z)
+    {
+        DirectX::XMFLOAT4 v = sh4(x, y, z);
+        const float d = (2.f * PI) / 3.f;
+        return DirectX::XMFLOAT4(PI * v.x, d * v.y, d * v.z, d * v.w);
+    }
+
     float halton(int index, int base)
     {
         float result = 0;
@@ -9,6 +9,8 @@
 #ifndef DUNE_MATH_TOOLS
 #define DUNE_MATH_TOOLS
 
+#include <cstdint>
+
 #include <DirectXMath.h>
 
 namespace dune
@@ -24,6 +26,55 @@ namespace dune
 
     DirectX::XMMATRIX make_projection(float z_near, float z_far);
 
+    /*! \brief Project a direction onto the first two bands of spherical harmonics, like sh4() in tools.hlsl. */
+    DirectX::XMFLOAT4 sh4(float x, float y, float z);
+
+    /*! \brief Returns the first two SH bands of a clamped cosine lobe around a direction, like sh_clamped_cos_coeff() in tools.hlsl. */
+    DirectX::XMFLOAT4 sh_clamped_cos_coeff(float x, float y, float z);
+
+    /*! \brief Spread the lower 21 bits of v so that two zero bits follow each bit. */
+    inline uint64_t morton_split(uint32_t v)
+    {
+        uint64_t x = v & 0x1fffff;
+        x = (x | x << 32) & 0x1f00000000ffffull;
+        x = (x | x << 16) & 0x1f0000ff0000ffull;
+        x = (x | x << 8)  & 0x100f00f00f00f00full;
+        x = (x | x << 4)  & 0x10c30c30c30c30c3ull;
+        x = (x | x << 2)  & 0x1249249249249249ull;
+        return x;
+    }
+
+    /*! \brief Inverse of morton_split(). */
+    inline uint32_t morton_compact(uint64_t x)
+    {
+        x &= 0x1249249249249249ull;
+        x = (x | x >> 2)  & 0x10c30c30c30c30c3ull;
+        x = (x | x >> 4)  & 0x100f00f00f00f00full;
+        x = (x | x >> 8)  & 0x1f0000ff0000ffull;
+        x = (x | x >> 16) & 0x1f00000000ffffull;
+        x = (x | x >> 32) & 0x1fffff;
+        return static_cast<uint32_t>(x);
+    }
+
+    /*!
+     * \brief Returns the Morton code (Z-order curve index) of a 3D coordinate with up to 21 bits per axis.
+     *
+     * The lowest three bits of the code are the lowest bits of x, y and z, in that order, so code & 7 is the
+     * octant of a coordinate inside its parent 2x2x2 block.
+     */
+    inline uint64_t morton_encode(uint32_t x, uint32_t y, uint32_t z)
+    {
+        return morton_split(x) | morton_split(y) << 1 | morton_split(z) << 2;
+    }
+
+    /*! \brief Returns the coordinate of a Morton code created with morton_encode(). */
+    inline void morton_decode(uint64_t code, uint32_t& x, uint32_t& y, uint32_t& z)
+    {
+        x = morton_compact(code);
+        y = morton_compact(code >> 1);
+        z = morton_compact(code >> 2);
+    }
+
     /*! \brief Approximate functions namespace. */
     namespace approx
     {
@@ -0,0 +1,28 @@
+/*
+ * Dune D3D library - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+#include "parallel_tools.h"
+
+namespace dune
+{
+    namespace detail
+    {
+        static size_t num_workers = 0;
+    }
+
+    size_t num_workers()
+    {
+        if (detail::num_workers == 0)
+            detail::num_workers = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+
+        return detail::num_workers;
+    }
+
+    void set_num_workers(size_t n)
+    {
+        detail::num_workers = n;
+    }
+}
@@ -0,0 +1,143 @@
+/*
+ * Dune D3D library - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+/*! \file */
+
+#ifndef DUNE_PARALLEL_TOOLS
+#define DUNE_PARALLEL_TOOLS
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace dune
+{
+    /*! \brief Returns the number of worker threads used by the CPU tools. */
+    size_t num_workers();
+
+    /*! \brief Set the number of worker threads used by the CPU tools. Zero resets to the number of hardware threads. */
+    void set_num_workers(size_t n);
+
+    /*!
+     * \brief Split the range [begin, end) into one contiguous slab per worker and run them in parallel.
+     *
+     * The function f is called as f(first, last) for each slab. The calling thread processes
+     * the first slab itself and only returns once all slabs are done.
+     */
+    template<typename F>
+    void parallel_for(size_t begin, size_t end, F f)
+    {
+        if (end <= begin)
+            return;
+
+        const size_t n = end - begin;
+        const size_t workers = std::min(num_workers(), n);
+        const size_t slab = (n + workers - 1) / workers;
+
+        std::vector<std::thread> threads;
+
+        for (size_t w = 1; w < workers; ++w)
+        {
+            size_t first = begin + w * slab;
+            size_t last = std::min(end, first + slab);
+
+            if (first < last)
+                threads.push_back(std::thread([&f, first, last]() { f(first, last); }));
+        }
+
+        f(begin, std::min(end, begin + slab));
+
+        for (auto t = threads.begin(); t != threads.end(); ++t)
+            t->join();
+    }
+
+    /*!
+     * \brief Process the range [begin, end) in chunks of size grain which are handed out dynamically to all workers.
+     *
+     * The function f is called as f(worker, first, last), where worker is a stable index smaller
+     * than num_workers(). Use this for uneven workloads or when every worker needs private scratch memory.
+     */
+    template<typename F>
+    void parallel_for_dynamic(size_t begin, size_t end, size_t grain, F f)
+    {
+        if (end <= begin)
+            return;
+
+        grain = std::max<size_t>(grain, 1);
+
+        const size_t workers = std::min(num_workers(), (end - begin + grain - 1) / grain);
+
+        std::atomic<size_t> next(begin);
+
+        auto work = [&](size_t worker)
+        {
+            for (;;)
+            {
+                size_t first = next.fetch_add(grain);
+
+                if (first >= end)
+                    break;
+
+                f(worker, first, std::min(end, first + grain));
+            }
+        };
+
+        std::vector<std::thread> threads;
+
+        for (size_t w = 1; w < workers; ++w)
+            threads.push_back(std::thread(work, w));
+
+        work(0);
+
+        for (auto t = threads.begin(); t != threads.end(); ++t)
+            t->join();
+    }
+
+    /*!
+     * \brief Sort the range [begin, end) with all workers.
+     *
+     * Each worker sorts one slab, after which pairs of neighboring slabs are merged in parallel until one is
+     * left. Like std::sort(), the sort is not stable.
+     */
+    template<typename It, typename Less>
+    void parallel_sort(It begin, It end, Less less)
+    {
+        const size_t n = static_cast<size_t>(end - begin);
+
+        if (n < 2)
+            return;
+
+        const size_t workers = std::min(num_workers(), std::max<size_t>(1, n / 4096));
+        const size_t slab = (n + workers - 1) / workers;
+
+        parallel_for(0, workers, [&](size_t first, size_t last)
+        {
+            for (size_t w = first; w < last; ++w)
+                std::sort(begin + std::min(n, w * slab), begin + std::min(n, (w + 1) * slab), less);
+        });
+
+        for (size_t width = slab; width < n; width *= 2)
+        {
+            const size_t merges = (n + 2 * width - 1) / (2 * width);
+
+            parallel_for(0, merges, [&](size_t first, size_t last)
+            {
+                for (size_t m = first; m < last; ++m)
+                {
+                    size_t lo = m * 2 * width;
+                    size_t mid = std::min(n, lo + width);
+                    size_t hi = std::min(n, lo + 2 * width);
+
+                    if (mid < hi)
+                        std::inplace_merge(begin + lo, begin + mid, begin + hi, less);
+                }
+            });
+        }
+    }
+}
+
+#endif
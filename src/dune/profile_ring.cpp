@@ -0,0 +1,156 @@
+/*
+ * Dune D3D library - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+#include "profile_ring.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace dune
+{
+    namespace detail
+    {
+        // nearest-rank percentile of sorted samples
+        inline float percentile(const std::vector<float>& sorted, float p)
+        {
+            size_t rank = static_cast<size_t>(std::ceil(p * sorted.size()));
+            return sorted[std::min(std::max<size_t>(rank, 1), sorted.size()) - 1];
+        }
+    }
+
+    profile_ring::profile_ring() :
+        source_(nullptr),
+        tags_(),
+        first_(0),
+        in_flight_(0),
+        open_(false),
+        window_(),
+        window_next_(0),
+        window_count_(0),
+        completed_(0),
+        dropped_(0),
+        invalid_(0)
+    {
+        last_.ms = 0.f;
+        last_.tag = 0;
+    }
+
+    void profile_ring::create(query_source* source, size_t sets, size_t window)
+    {
+        destroy();
+
+        assert(sets > 0 && window > 0);
+
+        source_ = source;
+        tags_.assign(sets, 0);
+        window_.assign(window, 0.f);
+    }
+
+    void profile_ring::destroy()
+    {
+        source_ = nullptr;
+        tags_.clear();
+        first_ = 0;
+        in_flight_ = 0;
+        open_ = false;
+
+        window_.clear();
+        window_next_ = 0;
+        window_count_ = 0;
+
+        last_.ms = 0.f;
+        last_.tag = 0;
+        completed_ = 0;
+        dropped_ = 0;
+        invalid_ = 0;
+    }
+
+    void profile_ring::begin(uint64_t tag)
+    {
+        assert(!open_);
+
+        poll();
+
+        if (!source_ || in_flight_ == tags_.size())
+        {
+            ++dropped_;
+            return;
+        }
+
+        const size_t set = (first_ + in_flight_) % tags_.size();
+
+        tags_[set] = tag;
+        source_->begin_query(set);
+
+        open_ = true;
+    }
+
+    void profile_ring::end()
+    {
+        if (!open_)
+            return;
+
+        source_->end_query((first_ + in_flight_) % tags_.size());
+
+        ++in_flight_;
+        open_ = false;
+    }
+
+    void profile_ring::poll()
+    {
+        // sets complete in the order they were issued
+        while (in_flight_ > 0)
+        {
+            float ms;
+            bool valid;
+
+            if (!source_->read_query(first_, ms, valid))
+                break;
+
+            if (valid)
+            {
+                last_.ms = ms;
+                last_.tag = tags_[first_];
+                ++completed_;
+
+                window_[window_next_] = ms;
+                window_next_ = (window_next_ + 1) % window_.size();
+                window_count_ = std::min(window_count_ + 1, window_.size());
+            }
+            else
+                ++invalid_;
+
+            first_ = (first_ + 1) % tags_.size();
+            --in_flight_;
+        }
+    }
+
+    profile_stats profile_ring::stats() const
+    {
+        profile_stats s = { window_count_, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f };
+
+        if (window_count_ == 0)
+            return s;
+
+        std::vector<float> sorted(window_.begin(), window_.begin() + window_count_);
+        std::sort(sorted.begin(), sorted.end());
+
+        double sum = 0;
+
+        for (auto x = sorted.begin(); x != sorted.end(); ++x)
+            sum += *x;
+
+        s.average = static_cast<float>(sum / sorted.size());
+        s.min = sorted.front();
+        s.max = sorted.back();
+        s.p50 = detail::percentile(sorted, 0.50f);
+        s.p95 = detail::percentile(sorted, 0.95f);
+        s.p99 = detail::percentile(sorted, 0.99f);
+
+        return s;
+    }
+}
@@ -0,0 +1,137 @@
+/*
+ * Dune D3D library - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+/*! \file */
+
+#ifndef DUNE_PROFILE_RING
+#define DUNE_PROFILE_RING
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace dune
+{
+    /*! \brief Rolling statistics of the last measurements of a profile_ring, in milliseconds. */
+    struct profile_stats
+    {
+        size_t samples;     //!< the number of measurements in the window
+        float average;
+        float min;
+        float max;
+        float p50;
+        float p95;
+        float p99;
+    };
+
+    /*! \brief A completed measurement of a profile_ring. */
+    struct profile_sample
+    {
+        float ms;
+        uint64_t tag;       //!< the tag passed to profile_ring::begin()
+    };
+
+    /*!
+     * \brief A set of timer queries, e.g. the D3D11 timestamp queries of a profile_query.
+     *
+     * Sets are addressed by index and reused in order, so an implementation only needs to keep one set of
+     * queries per index. This is the interface a profile_ring drives, which lets the ring be tested with a fake.
+     */
+    class query_source
+    {
+    public:
+        virtual ~query_source() {}
+
+        /*! \brief Start measuring time with a set. */
+        virtual void begin_query(size_t set) = 0;
+
+        /*! \brief Stop measuring time with a set. */
+        virtual void end_query(size_t set) = 0;
+
+        /*!
+         * \brief Read the time of a set, without waiting for it.
+         *
+         * \param set The set to read.
+         * \param ms The measured time in milliseconds.
+         * \param valid False if the measurement is unreliable, e.g. because the GPU clock changed.
+         * \return False if the result is not available yet.
+         */
+        virtual bool read_query(size_t set, float& ms, bool& valid) = 0;
+    };
+
+    /*!
+     * \brief A ring of query sets which are read back without blocking.
+     *
+     * Reading a timer query right after issuing it waits for the GPU to finish everything before it, which
+     * serializes CPU and GPU. Instead, each begin() and end() pair uses the next free set of a ring, and sets are
+     * only read once the GPU is done with them, usually a few frames later. If all sets are still in flight,
+     * the measurement is dropped rather than waited for.
+     *
+     * Completed measurements are kept in a window for rolling statistics.
+     */
+    class profile_ring
+    {
+    protected:
+        query_source*           source_;
+
+        std::vector<uint64_t>   tags_;
+        size_t                  first_;
+        size_t                  in_flight_;
+        bool                    open_;
+
+        std::vector<float>      window_;
+        size_t                  window_next_;
+        size_t                  window_count_;
+
+        profile_sample          last_;
+        size_t                  completed_;
+        size_t                  dropped_;
+        size_t                  invalid_;
+
+    public:
+        profile_ring();
+        virtual ~profile_ring() {}
+
+        /*!
+         * \brief Create a ring.
+         *
+         * \param source The queries to drive, which must outlive the ring.
+         * \param sets The number of query sets of the source, i.e. the number of measurements in flight.
+         * \param window The number of measurements for stats().
+         */
+        void create(query_source* source, size_t sets, size_t window);
+        void destroy();
+
+        /*! \brief Start a measurement with the next free set, or drop it if there is none. */
+        void begin(uint64_t tag = 0);
+
+        /*! \brief Stop the measurement started with begin(). */
+        void end();
+
+        /*! \brief Read back all sets which are done, oldest first. */
+        void poll();
+
+        /*! \brief Returns the newest completed measurement, which is zero before the first one. */
+        const profile_sample& last() const { return last_; }
+
+        /*! \brief Returns the number of completed measurements. */
+        size_t completed() const { return completed_; }
+
+        /*! \brief Returns the number of measurements dropped because all sets were in flight. */
+        size_t dropped() const { return dropped_; }
+
+        /*! \brief Returns the number of measurements discarded because the source marked them invalid. */
+        size_t invalid() const { return invalid_; }
+
+        /*! \brief Returns the number of sets in flight. */
+        size_t in_flight() const { return in_flight_; }
+
+        /*! \brief Returns statistics of the measurements in the window. */
+        profile_stats stats() const;
+    };
+}
+
+#endif
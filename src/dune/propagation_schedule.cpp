@@ -0,0 +1,84 @@
+/*
+ * Dune D3D library - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+#include "propagation_schedule.h"
+
+#include <algorithm>
+
+namespace dune
+{
+    propagation_schedule::propagation_schedule() :
+        total_(0),
+        done_(0),
+        budget_iterations_(0),
+        budget_ms_(0),
+        ms_per_iteration_(0)
+    {
+    }
+
+    void propagation_schedule::restart(size_t total)
+    {
+        total_ = total;
+        done_ = 0;
+    }
+
+    size_t propagation_schedule::next_batch() const
+    {
+        if (converged())
+            return 0;
+
+        size_t n = total_ - done_;
+
+        if (budget_iterations_ > 0)
+            n = std::min(n, budget_iterations_);
+
+        if (budget_ms_ > 0)
+        {
+            // probe with a single iteration until there is an estimate
+            size_t fit = 1;
+
+            if (ms_per_iteration_ > 0)
+                fit = std::max<size_t>(1, static_cast<size_t>(budget_ms_ / ms_per_iteration_));
+
+            n = std::min(n, fit);
+        }
+
+        return n;
+    }
+
+    void propagation_schedule::completed(size_t iterations)
+    {
+        done_ = std::min(total_, done_ + iterations);
+    }
+
+    void propagation_schedule::measured(size_t iterations, float ms)
+    {
+        if (iterations == 0)
+            return;
+
+        float per_iteration = ms / iterations;
+
+        // exponential moving average, but react immediately if iterations got more expensive
+        if (ms_per_iteration_ <= 0 || per_iteration > ms_per_iteration_)
+            ms_per_iteration_ = per_iteration;
+        else
+            ms_per_iteration_ = 0.9f * ms_per_iteration_ + 0.1f * per_iteration;
+    }
+
+    void propagation_schedule::completed(size_t iterations, float ms)
+    {
+        completed(iterations);
+        measured(iterations, ms);
+    }
+
+    float propagation_schedule::progress() const
+    {
+        if (converged())
+            return 1.f;
+
+        return static_cast<float>(done_) / total_;
+    }
+}
@@ -0,0 +1,86 @@
+/*
+ * Dune D3D library - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+/*! \file */
+
+#ifndef DUNE_PROPAGATION_SCHEDULE
+#define DUNE_PROPAGATION_SCHEDULE
+
+#include <cstddef>
+
+namespace dune
+{
+    /*!
+     * \brief Spreads the propagation iterations of an LPV over several frames.
+     *
+     * After each injection the schedule is restarted with the total number of iterations. Every
+     * frame next_batch() returns how many iterations fit into the per-frame budget, which is
+     * either a fixed number of iterations, a time in milliseconds or both. Time budgets are
+     * converted to iterations with a running estimate of the cost of one iteration, which is
+     * fed back through measured(). GPU timings arrive a few frames late, so progress and cost
+     * are reported separately. At least one iteration is run each frame, so propagation
+     * always converges.
+     *
+     * While the schedule has not converged, progress() can be used to blend the last converged
+     * result with the one in progress.
+     */
+    class propagation_schedule
+    {
+    protected:
+        size_t total_;
+        size_t done_;
+
+        size_t budget_iterations_;
+        float budget_ms_;
+
+        float ms_per_iteration_;
+
+    public:
+        propagation_schedule();
+        virtual ~propagation_schedule() {}
+
+        /*! \brief Start over with a total number of iterations. */
+        void restart(size_t total);
+
+        /*! \brief Returns the number of iterations to run this frame, which is zero once converged. */
+        size_t next_batch() const;
+
+        /*! \brief Report that a batch of iterations has been run. */
+        void completed(size_t iterations);
+
+        /*! \brief Report that a batch of iterations, not necessarily the last one, took ms milliseconds. */
+        void measured(size_t iterations, float ms);
+
+        /*! \brief Report that a batch of iterations has been run in ms milliseconds. */
+        void completed(size_t iterations, float ms);
+
+        size_t total() const { return total_; }
+        size_t done() const { return done_; }
+
+        /*! \brief Returns true if all iterations have been run. */
+        bool converged() const { return done_ >= total_; }
+
+        /*! \brief Returns the fraction of iterations already run, 1 if converged. */
+        float progress() const;
+
+        //!@{
+        /*! \brief Get/set the maximum number of iterations per frame. Zero means no limit. */
+        size_t budget_iterations() const { return budget_iterations_; }
+        void set_budget_iterations(size_t n) { budget_iterations_ = n; }
+        //!@}
+
+        //!@{
+        /*! \brief Get/set the maximum time in milliseconds spent propagating per frame. Zero means no limit. */
+        float budget_ms() const { return budget_ms_; }
+        void set_budget_ms(float ms) { budget_ms_ = ms; }
+        //!@}
+
+        /*! \brief Returns the current estimate of the time one iteration takes, or zero if nothing has been measured yet. */
+        float ms_per_iteration() const { return ms_per_iteration_; }
+    };
+}
+
+#endif
@@ -6,8 +6,14 @@
 
 #include "serializer.h"
 
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iterator>
+
 #include <boost/property_tree/xml_parser.hpp>
-#include <boost/property_tree/json_parser.hpp>
 
 #ifdef UNICODE
 typedef boost::property_tree::wptree tptree;
@@ -21,45 +27,734 @@ namespace dune
 {
     namespace detail
     {
-        void to_properties(tstring path, const tptree& pt, std::map<tstring, tstring>& properties)
+        typedef serializer::char_type char_type;
+
+        inline uint64_t hash_key(const char_type* key, size_t length)
+        {
+            // FNV-1a
+            uint64_t h = 14695981039346656037ull;
+
+            for (size_t i = 0; i < length; ++i)
+            {
+                h ^= static_cast<uint64_t>(key[i]);
+                h *= 1099511628211ull;
+            }
+
+            return h;
+        }
+
+        inline bool is_space(char_type c)
+        {
+            return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+        }
+
+        inline double parse_double(const wchar_t* s, wchar_t** end) { return std::wcstod(s, end); }
+        inline double parse_double(const char* s, char** end)       { return std::strtod(s, end); }
+        inline float parse_float(const wchar_t* s, wchar_t** end)   { return std::wcstof(s, end); }
+        inline float parse_float(const char* s, char** end)         { return std::strtof(s, end); }
+
+        // a number which takes up all of [b, e)
+        inline bool parse_number(const char_type* b, const char_type* e, double& number, float& single)
+        {
+            char_type* end;
+
+            if (b == e || is_space(*b))
+                return false;
+
+            number = parse_double(b, &end);
+
+            if (end != e)
+                return false;
+
+            single = parse_float(b, &end);
+            return true;
+        }
+
+        inline bool parse_integer(const char_type* b, const char_type* e, int64_t& integer)
         {
-            for (const auto& i : pt)
+            const char_type* c = b;
+
+            if (c != e && (*c == '-' || *c == '+'))
+                ++c;
+
+            if (c == e)
+                return false;
+
+            integer = 0;
+
+            for (; c != e; ++c)
+            {
+                if (*c < '0' || *c > '9' || integer > (INT64_MAX - 9) / 10)
+                    return false;
+
+                integer = integer * 10 + (*c - '0');
+            }
+
+            if (*b == '-')
+                integer = -integer;
+
+            return true;
+        }
+
+        // three numbers separated by spaces or commas
+        inline bool parse_vector(const char_type* b, const char_type* e, float* vector)
+        {
+            const char_type* c = b;
+
+            for (size_t i = 0; i < 3; ++i)
+            {
+                while (c != e && (is_space(*c) || (i > 0 && *c == ',')))
+                    ++c;
+
+                if (c == e || is_space(*c))
+                    return false;
+
+                char_type* end;
+                vector[i] = parse_float(c, &end);
+
+                if (end == c || end > e)
+                    return false;
+
+                c = end;
+            }
+
+            while (c != e && is_space(*c))
+                ++c;
+
+            return c == e;
+        }
+
+        // reads UTF-8 or ASCII text byte by byte, like the narrow streams of boost::property_tree
+        inline tstring widen(const char* b, const char* e)
+        {
+            tstring s;
+            s.reserve(e - b);
+
+            for (; b != e; ++b)
+                s.push_back(static_cast<char_type>(static_cast<unsigned char>(*b)));
+
+            return s;
+        }
+
+        /*!
+         * \brief A single pass reader of XML and JSON which reports leaves with their dotted path.
+         *
+         * The keys of XML files follow boost::property_tree: attributes are stored under <xmlattr>, comments under
+         * <xmlcomment>, and the text of an element is only kept if it has no children.
+         */
+        class settings_reader
+        {
+        protected:
+            const char* c_;
+            const char* end_;
+            std::string path_;
+            std::function<void(const std::string&, const std::string&)> leaf_;
+
+            void fail(const char* what)
+            {
+                throw dune::exception(L"Couldn't parse settings: " + widen(what, what + std::strlen(what)));
+            }
+
+            bool starts_with(const char* s) const
+            {
+                const size_t n = std::strlen(s);
+                return static_cast<size_t>(end_ - c_) >= n && std::memcmp(c_, s, n) == 0;
+            }
+
+            void skip_past(const char* s)
+            {
+                const size_t n = std::strlen(s);
+                const char* found = std::search(c_, end_, s, s + n);
+
+                if (found == end_)
+                    fail(s);
+
+                c_ = found + n;
+            }
+
+            void skip_space()
+            {
+                while (c_ != end_ && is_space(*c_))
+                    ++c_;
+            }
+
+            size_t push(const std::string& name)
+            {
+                const size_t length = path_.size();
+
+                if (!path_.empty())
+                    path_ += '.';
+
+                path_ += name;
+                return length;
+            }
+
+            void pop(size_t length)
+            {
+                path_.resize(length);
+            }
+
+            void emit(const std::string& name, const std::string& text)
+            {
+                const size_t length = push(name);
+                leaf_(path_, text);
+                pop(length);
+            }
+
+            // decode entities of [b, e) and append them to out
+            void append_xml_text(const char* b, const char* e, std::string& out)
+            {
+                while (b != e)
+                {
+                    const char* amp = std::find(b, e, '&');
+                    out.append(b, amp);
+
+                    if (amp == e)
+                        break;
+
+                    const char* semi = std::find(amp, e, ';');
+
+                    if (semi == e)
+                        fail("&");
+
+                    std::string entity(amp + 1, semi);
+
+                    if (entity == "lt")        out += '<';
+                    else if (entity == "gt")   out += '>';
+                    else if (entity == "amp")  out += '&';
+                    else if (entity == "quot") out += '"';
+                    else if (entity == "apos") out += '\'';
+                    else if (!entity.empty() && entity[0] == '#')
+                    {
+                        const unsigned long code = entity.size() > 1 && entity[1] == 'x' ?
+                            std::strtoul(entity.c_str() + 2, nullptr, 16) :
+                            std::strtoul(entity.c_str() + 1, nullptr, 10);
+
+                        append_utf8(code, out);
+                    }
+                    else
+                        fail("&");
+
+                    b = semi + 1;
+                }
+            }
+
+            static void append_utf8(unsigned long code, std::string& out)
+            {
+                if (code < 0x80)
+                    out += static_cast<char>(code);
+                else if (code < 0x800)
+                {
+                    out += static_cast<char>(0xC0 | (code >> 6));
+                    out += static_cast<char>(0x80 | (code & 0x3F));
+                }
+                else if (code < 0x10000)
+                {
+                    out += static_cast<char>(0xE0 | (code >> 12));
+                    out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                    out += static_cast<char>(0x80 | (code & 0x3F));
+                }
+                else
+                {
+                    out += static_cast<char>(0xF0 | (code >> 18));
+                    out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+                    out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                    out += static_cast<char>(0x80 | (code & 0x3F));
+                }
+            }
+
+            std::string xml_name()
+            {
+                const char* b = c_;
+
+                while (c_ != end_ && !is_space(*c_) && *c_ != '/' && *c_ != '>' && *c_ != '=')
+                    ++c_;
+
+                if (b == c_)
+                    fail("<");
+
+                return std::string(b, c_);
+            }
+
+            // the children of the current element up to its end tag, returns true if there were any
+            bool xml_content(std::string& text)
+            {
+                bool children = false;
+
+                while (c_ != end_)
+                {
+                    const char* b = c_;
+                    c_ = std::find(c_, end_, '<');
+
+                    // text which isn't just indentation
+                    if (std::find_if(b, c_, [](char c) { return !is_space(c); }) != c_)
+                        append_xml_text(b, c_, text);
+
+                    if (c_ == end_)
+                        break;
+
+                    if (starts_with("</"))
+                    {
+                        skip_past(">");
+                        return children;
+                    }
+                    else if (starts_with("<!--"))
+                    {
+                        c_ += 4;
+                        const char* comment = c_;
+                        skip_past("-->");
+
+                        emit("<xmlcomment>", std::string(comment, c_ - 3));
+                        children = true;
+                    }
+                    else if (starts_with("<![CDATA["))
+                    {
+                        c_ += 9;
+                        const char* data = c_;
+                        skip_past("]]>");
+
+                        text.append(data, c_ - 3);
+                    }
+                    else if (starts_with("<?") || starts_with("<!"))
+                        skip_past(">");
+                    else
+                    {
+                        ++c_;
+                        xml_element();
+                        children = true;
+                    }
+                }
+
+                if (!path_.empty())
+                    fail("</");
+
+                return children;
+            }
+
+            void xml_element()
+            {
+                const size_t length = push(xml_name());
+
+                bool attributes = false;
+
+                for (;;)
+                {
+                    skip_space();
+
+                    if (c_ == end_)
+                        fail(">");
+
+                    if (*c_ == '/' || *c_ == '>')
+                        break;
+
+                    const std::string name = xml_name();
+
+                    skip_space();
+
+                    if (c_ == end_ || *c_ != '=')
+                        fail("=");
+
+                    ++c_;
+                    skip_space();
+
+                    if (c_ == end_ || (*c_ != '"' && *c_ != '\''))
+                        fail("\"");
+
+                    const char quote = *c_++;
+                    const char* b = c_;
+                    c_ = std::find(c_, end_, quote);
+
+                    if (c_ == end_)
+                        fail("\"");
+
+                    std::string value;
+                    append_xml_text(b, c_++, value);
+
+                    emit("<xmlattr>." + name, value);
+                    attributes = true;
+                }
+
+                std::string text;
+                bool children = attributes;
+
+                if (*c_ == '/')
+                    skip_past(">");
+                else
+                {
+                    ++c_;
+                    children = xml_content(text) || children;
+                }
+
+                if (!children)
+                    leaf_(path_, text);
+
+                pop(length);
+            }
+
+            std::string json_string()
             {
-                tstring subpath = path;
+                std::string s;
+
+                ++c_;
+
+                while (c_ != end_ && *c_ != '"')
+                {
+                    if (*c_ != '\\')
+                    {
+                        s += *c_++;
+                        continue;
+                    }
+
+                    if (++c_ == end_)
+                        break;
+
+                    switch (*c_++)
+                    {
+                    case 'b': s += '\b'; break;
+                    case 'f': s += '\f'; break;
+                    case 'n': s += '\n'; break;
+                    case 'r': s += '\r'; break;
+                    case 't': s += '\t'; break;
+                    case 'u':
+                        if (end_ - c_ < 4)
+                            fail("\\u");
+
+                        append_utf8(std::strtoul(std::string(c_, c_ + 4).c_str(), nullptr, 16), s);
+                        c_ += 4;
+                        break;
+                    default: s += c_[-1]; break;
+                    }
+                }
+
+                if (c_ == end_)
+                    fail("\"");
+
+                ++c_;
+                return s;
+            }
 
-                if (subpath != L"")
-                    subpath += L".";
+            void json_value()
+            {
+                skip_space();
 
-                subpath += i.first;
+                if (c_ == end_)
+                    fail("value");
 
-                if (!i.second.empty())
+                if (*c_ == '{' || *c_ == '[')
                 {
-                    to_properties(subpath, i.second, properties);
+                    const bool object = *c_ == '{';
+                    const char close = object ? '}' : ']';
+
+                    ++c_;
+                    skip_space();
+
+                    if (c_ != end_ && *c_ == close)
+                    {
+                        ++c_;
+                        leaf_(path_, std::string());
+                        return;
+                    }
+
+                    for (size_t index = 0; ; ++index)
+                    {
+                        std::string name;
+
+                        if (object)
+                        {
+                            skip_space();
+
+                            if (c_ == end_ || *c_ != '"')
+                                fail("\"");
+
+                            name = json_string();
+                            skip_space();
+
+                            if (c_ == end_ || *c_ != ':')
+                                fail(":");
+
+                            ++c_;
+                        }
+                        else
+                            name = std::to_string(index);
+
+                        const size_t length = push(name);
+                        json_value();
+                        pop(length);
+
+                        skip_space();
+
+                        if (c_ != end_ && *c_ == ',')
+                            ++c_;
+                        else if (c_ != end_ && *c_ == close)
+                        {
+                            ++c_;
+                            return;
+                        }
+                        else
+                            fail(object ? "}" : "]");
+                    }
                 }
+                else if (*c_ == '"')
+                    leaf_(path_, json_string());
                 else
-                    properties[subpath] = i.second.data();
+                {
+                    // numbers, true, false and null are kept as they are written
+                    const char* b = c_;
+
+                    while (c_ != end_ && !is_space(*c_) && *c_ != ',' && *c_ != '}' && *c_ != ']')
+                        ++c_;
+
+                    leaf_(path_, std::string(b, c_));
+                }
             }
+
+        public:
+            settings_reader(const char* begin, const char* end, const std::function<void(const std::string&, const std::string&)>& leaf) :
+                c_(begin),
+                end_(end),
+                path_(),
+                leaf_(leaf)
+            {
+            }
+
+            void read()
+            {
+                // skip a byte order mark
+                if (starts_with("\xEF\xBB\xBF"))
+                    c_ += 3;
+
+                skip_space();
+
+                if (c_ != end_ && (*c_ == '{' || *c_ == '['))
+                {
+                    json_value();
+                    skip_space();
+
+                    if (c_ != end_)
+                        fail("end of file");
+                }
+                else
+                {
+                    std::string text;
+                    xml_content(text);
+                }
+            }
+        };
+    }
+
+    const serializer::value* serializer::find(const char_type* key, size_t length) const
+    {
+        if (table_.empty())
+            return nullptr;
+
+        const size_t mask = table_.size() - 1;
+
+        for (size_t i = static_cast<size_t>(detail::hash_key(key, length)) & mask; table_[i] != 0; i = (i + 1) & mask)
+        {
+            const value& v = values_[table_[i] - 1];
+
+            if (v.key.size() == length && std::char_traits<char_type>::compare(v.key.data(), key, length) == 0)
+                return &v;
         }
 
-        void from_properties(const std::map<tstring, tstring>& properties, tptree& pt)
+        return nullptr;
+    }
+
+    const serializer::value& serializer::at(const char_type* key) const
+    {
+        const value* v = find(key, std::char_traits<char_type>::length(key));
+
+        if (!v)
+            throw dune::exception(tstring(L"Unknown key: ") + key);
+
+        v->read = true;
+        return *v;
+    }
+
+    void serializer::assign(const tstring& key, const tstring& text)
+    {
+        value* v = const_cast<value*>(find(key.data(), key.size()));
+
+        if (!v)
         {
-            for (const auto& i : properties)
-                pt.add(i.first, i.second);
+            // keep the table at most half full
+            if ((values_.size() + 1) * 2 > table_.size())
+            {
+                std::vector<uint32_t> table(std::max<size_t>(64, table_.size() * 2), 0);
+                const size_t mask = table.size() - 1;
+
+                for (size_t n = 0; n < values_.size(); ++n)
+                {
+                    size_t i = static_cast<size_t>(detail::hash_key(values_[n].key.data(), values_[n].key.size())) & mask;
+
+                    while (table[i] != 0)
+                        i = (i + 1) & mask;
+
+                    table[i] = static_cast<uint32_t>(n + 1);
+                }
+
+                table_.swap(table);
+            }
+
+            const size_t mask = table_.size() - 1;
+            size_t i = static_cast<size_t>(detail::hash_key(key.data(), key.size())) & mask;
+
+            while (table_[i] != 0)
+                i = (i + 1) & mask;
+
+            values_.push_back(value());
+            table_[i] = static_cast<uint32_t>(values_.size());
+
+            v = &values_.back();
+            v->key = key;
+        }
+
+        v->text = text;
+        v->type = VALUE_STRING;
+        v->number = 0;
+        v->integer = 0;
+        v->single = 0;
+        v->vector[0] = v->vector[1] = v->vector[2] = 0;
+        v->read = false;
+
+        const char_type* b = text.c_str();
+        const char_type* e = b + text.size();
+
+        while (b != e && detail::is_space(*b))
+            ++b;
+
+        while (e != b && detail::is_space(e[-1]))
+            --e;
+
+        const tstring::size_type n = e - b;
+
+        if (n == 4 && std::char_traits<char_type>::compare(b, L"true", 4) == 0)
+        {
+            v->type = VALUE_BOOL;
+            v->number = 1;
+        }
+        else if (n == 5 && std::char_traits<char_type>::compare(b, L"false", 5) == 0)
+            v->type = VALUE_BOOL;
+        else if (detail::parse_integer(b, e, v->integer))
+        {
+            v->type = VALUE_INT;
+            v->number = static_cast<double>(v->integer);
+            v->single = static_cast<float>(v->integer);
+        }
+        else if (detail::parse_number(b, e, v->number, v->single))
+            v->type = VALUE_FLOAT;
+        else if (detail::parse_vector(b, e, v->vector))
+            v->type = VALUE_VECTOR3;
+    }
+
+    bool serializer::convert(const value& v, tstring& result)
+    {
+        result = v.text;
+        return true;
+    }
+
+    void serializer::get_vector(const char_type* key, DirectX::XMFLOAT3& result) const
+    {
+        const size_t length = std::char_traits<char_type>::length(key);
+        const value* v = find(key, length);
+
+        if (v && v->type == VALUE_VECTOR3)
+        {
+            v->read = true;
+            result = DirectX::XMFLOAT3(v->vector[0], v->vector[1], v->vector[2]);
+            return;
+        }
+
+        // key.x, key.y and key.z (or r, g, b or the elements of an array), in a buffer on the stack to avoid allocations
+        char_type subkey[256];
+
+        if (!v && length + 3 <= sizeof(subkey) / sizeof(char_type))
+        {
+            std::char_traits<char_type>::copy(subkey, key, length);
+            subkey[length] = '.';
+            subkey[length + 2] = 0;
+
+            static const char_type* const names[] = { L"xyz", L"rgb", L"012" };
+
+            for (size_t n = 0; n < 3; ++n)
+            {
+                const value* c[3];
+
+                for (size_t i = 0; i < 3; ++i)
+                {
+                    subkey[length + 1] = names[n][i];
+                    c[i] = find(subkey, length + 2);
+                }
+
+                if (c[0] && c[1] && c[2] && convert(*c[0], result.x) && convert(*c[1], result.y) && convert(*c[2], result.z))
+                {
+                    c[0]->read = c[1]->read = c[2]->read = true;
+                    return;
+                }
+            }
         }
+
+        if (!v)
+            throw dune::exception(tstring(L"Unknown key: ") + key);
+
+        throw dune::exception(tstring(L"Can't convert value of key: ") + key);
+    }
+
+    std::map<tstring, tstring> serializer::properties() const
+    {
+        std::map<tstring, tstring> properties;
+
+        for (auto v = values_.begin(); v != values_.end(); ++v)
+            properties[v->key] = v->text;
+
+        return properties;
+    }
+
+    std::vector<tstring> serializer::unread() const
+    {
+        std::vector<tstring> keys;
+
+        for (auto v = values_.begin(); v != values_.end(); ++v)
+            if (!v->read)
+                keys.push_back(v->key);
+
+        return keys;
     }
 
     void serializer::load(const tstring& filename)
     {
-        tptree pt;
-        boost::property_tree::read_xml(dune::to_string(filename), pt);
+        std::ifstream is(to_string(filename).c_str(), std::ios::binary);
+
+        if (!is)
+            throw dune::exception(L"Couldn't open " + filename);
+
+        std::vector<char> buffer((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+
+        const char* begin = buffer.data();
 
-        detail::to_properties(L"", pt, properties_);
+        detail::settings_reader reader(begin, begin + buffer.size(), [this](const std::string& key, const std::string& text)
+        {
+            assign(detail::widen(key.data(), key.data() + key.size()), detail::widen(text.data(), text.data() + text.size()));
+        });
+
+        try
+        {
+            reader.read();
+        }
+        catch (dune::exception& e)
+        {
+            throw dune::exception(e.msg() + L" in " + filename);
+        }
     }
 
     void serializer::save(const tstring& filename)
     {
         tptree pt;
-        detail::from_properties(properties_, pt);
+
+        const std::map<tstring, tstring> sorted = properties();
+
+        for (const auto& i : sorted)
+            pt.add(i.first, i.second);
 
         txml_writer_settings settings(L'\t', 1);
         boost::property_tree::write_xml(dune::to_string(filename), pt, std::locale(), settings);
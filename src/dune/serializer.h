@@ -11,8 +11,11 @@
 
 #include "exception.h"
 
-#include <boost/any.hpp>
+#include <DirectXMath.h>
+#include <cstdint>
 #include <map>
+#include <type_traits>
+#include <vector>
 
 #include "unicode.h"
 
@@ -37,42 +40,132 @@ namespace dune
      *
      * The serializer is used to save information about Dune objects into
      * files. This enables loading program configurations.
+     *
+     * Files are parsed in one pass, and each value is converted once into a
+     * float, int, bool, vector3 or string when it is loaded or put. Keys are
+     * kept in a hash table, so that get() neither allocates nor parses.
+     * Keys which were loaded but never read with get() are returned by unread(),
+     * which points out misspelled or obsolete settings.
      */
     class serializer
     {
+    public:
+        typedef tstring::value_type char_type;
+
+        /*! \brief The type a value was recognized as. */
+        enum value_type
+        {
+            VALUE_STRING,
+            VALUE_BOOL,
+            VALUE_INT,
+            VALUE_FLOAT,
+            VALUE_VECTOR3
+        };
+
     protected:
-        std::map<tstring, tstring> properties_;
+        struct value
+        {
+            tstring key;
+            tstring text;           //!< the value as it appears in the file
+            value_type type;
+            double number;          //!< the value of a bool, int or float
+            int64_t integer;        //!< the value of an int
+            float single;           //!< the value of a float, parsed as float
+            float vector[3];
+            mutable bool read;
+        };
+
+        std::vector<value> values_;
+        std::vector<uint32_t> table_;
+
+        const value* find(const char_type* key, size_t length) const;
+        const value& at(const char_type* key) const;
+        void assign(const tstring& key, const tstring& text);
+
+        template<typename T>
+        static typename std::enable_if<std::is_arithmetic<T>::value, bool>::type convert(const value& v, T& result)
+        {
+            if (v.type == VALUE_INT && std::is_integral<T>::value)
+                result = static_cast<T>(v.integer);
+            else if (v.type == VALUE_FLOAT && std::is_same<T, float>::value)
+                result = static_cast<T>(v.single);
+            else if (v.type == VALUE_BOOL || v.type == VALUE_INT || v.type == VALUE_FLOAT)
+                result = static_cast<T>(v.number);
+            else
+                return false;
+
+            return true;
+        }
+
+        template<typename T>
+        static typename std::enable_if<!std::is_arithmetic<T>::value, bool>::type convert(const value& v, T& result)
+        {
+            tstringstream ss(v.text);
+            ss >> std::boolalpha >> result;
+            return !ss.fail();
+        }
+
+        static bool convert(const value& v, tstring& result);
+
+        /*! \brief Read a vector from one value, or from the sub-keys x, y, z or r, g, b or 0, 1, 2. */
+        void get_vector(const char_type* key, DirectX::XMFLOAT3& result) const;
 
     public:
+        /*! \brief Returns all key-value pairs as strings, sorted by key. */
+        std::map<tstring, tstring> properties() const;
+
+        /*! \brief Returns the number of key-value pairs. */
+        size_t size() const { return values_.size(); }
+
+        /*! \brief Returns the keys which were never read with get(), in the order they were loaded. */
+        std::vector<tstring> unread() const;
+
+        /*! \brief Returns the type a value was recognized as. \throws exception The key does not exist. */
+        value_type type(const char_type* key) const { return at(key).type; }
+
         /*! \brief Save the current key-value's into a file specified by filename. */
         void save(const tstring& filename);
 
-        /*! \brief Load key-value pairs from a file specified by filename. */
+        /*!
+         * \brief Load key-value pairs from a file specified by filename.
+         *
+         * The file can be XML or JSON, which is told apart by its first character. Elements of
+         * JSON arrays are stored under their index, e.g. path.0.x.
+         *
+         * \throws exception The file can't be opened or parsed.
+         */
         void load(const tstring& filename);
 
         /*!
          * \brief Get a value from a specified key.
          *
-         * Fetch a value from the storage and return it as type T.
+         * Fetch a value from the storage and return it as type T. Numbers and bools
+         * convert into each other, and DirectX::XMFLOAT3 can be read from a value
+         * of three numbers or from the sub-keys key.x, key.y and key.z (or r, g, b, or
+         * the elements of a JSON array).
          *
          * \tparam T The type of the parameter.
          * \param key The key specifying the value.
          * \return The requested value.
-         * \throws exception The key does not exist.
+         * \throws exception The key does not exist or its value can't be converted to T.
          */
         template<typename T>
-        T get(const tstring& key) const
+        T get(const char_type* key) const
         {
-            auto i = properties_.find(key);
+            const value& v = at(key);
+
+            T result;
 
-            if (i == properties_.end())
-                throw dune::exception(L"Unknown key: " + key);
+            if (!convert(v, result))
+                throw dune::exception(tstring(L"Can't convert value of key: ") + key);
 
-            T value;
-            tstringstream ss(i->second);
+            return result;
+        }
 
-            ss >> std::boolalpha >> value;
-            return value;
+        template<typename T>
+        T get(const tstring& key) const
+        {
+            return get<T>(key.c_str());
         }
 
         /*!
@@ -90,11 +183,10 @@ namespace dune
         {
             tstringstream ss;
             ss << value;
-            properties_[key] = ss.str();
+            assign(key, ss.str());
         }
 
-        // Special case for type BOOL
-        template<>
+        // Special case for type BOOL, as an overload since member templates can't be specialized in class scope
         void put(const tstring& key, const BOOL& value)
         {
             tstringstream ss;
@@ -107,9 +199,17 @@ namespace dune
             else
                 ss << value;
 
-            properties_[key] = ss.str();
+            assign(key, ss.str());
         }
     };
+
+    template<>
+    inline DirectX::XMFLOAT3 serializer::get<DirectX::XMFLOAT3>(const char_type* key) const
+    {
+        DirectX::XMFLOAT3 result;
+        get_vector(key, result);
+        return result;
+    }
 }
 
 #endif
@@ -6,10 +6,13 @@
 
 #include "serializer_tools.h"
 
+#include <fstream>
+
 #include "camera.h"
 #include "light.h"
 #include "light_propagation_volume.h"
 #include "sparse_voxel_octree.h"
+#include "gi_snapshot.h"
 
 namespace dune
 {
@@ -36,17 +39,11 @@ namespace dune
     {
         try
         {
-            float px = s.get<float>(L"camera.pos.x");
-            float py = s.get<float>(L"camera.pos.y");
-            float pz = s.get<float>(L"camera.pos.z");
-
-            DirectX::XMVECTOR eye = { px, py, pz, 1.f };
-
-            float vx = s.get<float>(L"camera.lookat.x");
-            float vy = s.get<float>(L"camera.lookat.y");
-            float vz = s.get<float>(L"camera.lookat.z");
+            auto p = s.get<DirectX::XMFLOAT3>(L"camera.pos");
+            DirectX::XMVECTOR eye = { p.x, p.y, p.z, 1.f };
 
-            DirectX::XMVECTOR V = { vx, vy, vz, 1.f };
+            auto v = s.get<DirectX::XMFLOAT3>(L"camera.lookat");
+            DirectX::XMVECTOR V = { v.x, v.y, v.z, 1.f };
 
             c.SetViewParams(eye, V);
         }
@@ -84,20 +81,13 @@ namespace dune
         {
             auto& p = l.parameters().data();
             {
-                p.position.x   = s.get<float>(L"light.position.x");
-                p.position.y   = s.get<float>(L"light.position.y");
-                p.position.z   = s.get<float>(L"light.position.z");
-                p.position.w   = 1.f;
-
-                p.direction.x  = s.get<float>(L"light.direction.x");
-                p.direction.y  = s.get<float>(L"light.direction.y");
-                p.direction.z  = s.get<float>(L"light.direction.z");
-                p.direction.w  = 0.f;
-
-                p.flux.x       = s.get<float>(L"light.flux.r");
-                p.flux.y       = s.get<float>(L"light.flux.g");
-                p.flux.z       = s.get<float>(L"light.flux.b");
-                p.flux.w       = 0.f;
+                auto position  = s.get<DirectX::XMFLOAT3>(L"light.position");
+                auto direction = s.get<DirectX::XMFLOAT3>(L"light.direction");
+                auto flux      = s.get<DirectX::XMFLOAT3>(L"light.flux");
+
+                p.position     = DirectX::XMFLOAT4(position.x, position.y, position.z, 1.f);
+                p.direction    = DirectX::XMFLOAT4(direction.x, direction.y, direction.z, 0.f);
+                p.flux         = DirectX::XMFLOAT4(flux.x, flux.y, flux.z, 0.f);
             }
         }
         catch (dune::exception& e)
@@ -118,6 +108,14 @@ namespace dune
             s.put(L"gi.lpv.num_propagations",   lpv.num_propagations());
         }
 
+        {
+            s.put(L"gi.lpv.amortized",          static_cast<BOOL>(lpv.amortized()));
+            s.put(L"gi.lpv.budget_iterations",  lpv.schedule().budget_iterations());
+            s.put(L"gi.lpv.budget_ms",          lpv.schedule().budget_ms());
+            s.put(L"gi.lpv.history_format",     static_cast<int>(lpv.history_format()));
+            s.put(L"gi.lpv.occlusion",          static_cast<BOOL>(lpv.occlusion()));
+        }
+
         return s;
     }
 
@@ -139,6 +137,29 @@ namespace dune
             tcerr << "Couldn't load LPV parameters: " << e.msg() << std::endl;
         }
 
+        // older settings files don't have amortized propagation
+        try
+        {
+            lpv.set_amortized(s.get<bool>(L"gi.lpv.amortized"));
+            lpv.schedule().set_budget_iterations(s.get<size_t>(L"gi.lpv.budget_iterations"));
+            lpv.schedule().set_budget_ms(s.get<float>(L"gi.lpv.budget_ms"));
+            lpv.set_history_format(static_cast<sh_format>(s.get<int>(L"gi.lpv.history_format")));
+        }
+        catch (dune::exception& e)
+        {
+            tcerr << "Couldn't load LPV amortized propagation: " << e.msg() << std::endl;
+        }
+
+        // nor occlusion
+        try
+        {
+            lpv.set_occlusion(s.get<bool>(L"gi.lpv.occlusion"));
+        }
+        catch (dune::exception& e)
+        {
+            tcerr << "Couldn't load LPV occlusion: " << e.msg() << std::endl;
+        }
+
         return s;
     }
 
@@ -172,4 +193,38 @@ namespace dune
 
         return s;
     }
+
+    uint64_t gi_snapshot_key(const std::vector<tstring>& scene_files, const serializer& s)
+    {
+        uint64_t key = hash_bytes(nullptr, 0);
+
+        std::vector<char> buffer(1 << 16);
+
+        for (auto f = scene_files.begin(); f != scene_files.end(); ++f)
+        {
+            key = hash_bytes(f->data(), f->size() * sizeof(tstring::value_type), key);
+
+            std::ifstream is(to_string(*f).c_str(), std::ios::binary);
+
+            while (is)
+            {
+                is.read(&buffer[0], buffer.size());
+                key = hash_bytes(&buffer[0], static_cast<size_t>(is.gcount()), key);
+            }
+        }
+
+        // only parameters which change the GI solution, std::map iterates in a stable order
+        const std::map<tstring, tstring> properties = s.properties();
+
+        for (auto p = properties.begin(); p != properties.end(); ++p)
+        {
+            if (p->first.compare(0, 6, L"light.") != 0 && p->first.compare(0, 3, L"gi.") != 0)
+                continue;
+
+            key = hash_bytes(p->first.data(), p->first.size() * sizeof(tstring::value_type), key);
+            key = hash_bytes(p->second.data(), p->second.size() * sizeof(tstring::value_type), key);
+        }
+
+        return key;
+    }
 }
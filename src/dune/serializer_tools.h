@@ -9,6 +9,9 @@
 #ifndef DUNE_SERIALIZER_TOOLS
 #define DUNE_SERIALIZER_TOOLS
 
+#include <cstdint>
+#include <vector>
+
 #include "serializer.h"
 
 namespace dune
@@ -44,6 +47,18 @@ namespace dune
     serializer& operator<<(serializer& s, const sparse_voxel_octree& svo);
     const serializer& operator>>(const serializer& s, sparse_voxel_octree& svo);
     //!@}
+
+    /*!
+     * \brief Compute the key of a gi_snapshot.
+     *
+     * The key is a hash of the contents of all scene files and of all "light." and "gi." parameters
+     * of a serializer, so a snapshot is only reused for the same geometry and lighting.
+     *
+     * \param scene_files The files the scene was loaded from. Files which cannot be opened only contribute their name.
+     * \param s A serializer which already contains the light and GI parameters.
+     * \return The key.
+     */
+    uint64_t gi_snapshot_key(const std::vector<tstring>& scene_files, const serializer& s);
 }
 
 #endif
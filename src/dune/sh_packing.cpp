@@ -0,0 +1,321 @@
+/*
+ * Dune D3D library - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+#include "sh_packing.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+#include <DirectXPackedVector.h>
+
+#include "math_tools.h"
+#include "parallel_tools.h"
+
+namespace dune
+{
+    namespace detail
+    {
+        // largest band 1 coefficient relative to the DC of luma that can be stored
+        const float SH_DIRECTION_RANGE = 2.f;
+
+        // largest chroma coefficient relative to the DC of luma that can be stored
+        const float SH_CHROMA_RANGE = 4.f;
+
+        // DC of luma below which a cell is treated as black
+        const float SH_MIN_LUMA = 1e-8f;
+
+        struct sh_cell
+        {
+            float c[3][4];
+        };
+
+        inline sh_cell load_cell(const sh_volume& v, size_t i)
+        {
+            sh_cell cell = {};
+
+            for (size_t ch = 0; ch < 3; ++ch)
+            for (size_t k = 0; k < 4; ++k)
+                cell.c[ch][k] = v.data(ch, k)[i];
+
+            return cell;
+        }
+
+        inline void store_cell(sh_volume& v, size_t i, const sh_cell& cell)
+        {
+            for (size_t ch = 0; ch < 3; ++ch)
+            for (size_t k = 0; k < 4; ++k)
+                v.data(ch, k)[i] = cell.c[ch][k];
+        }
+
+        inline void to_ycocg(const float rgb[3], float& y, float& co, float& cg)
+        {
+            y  =  0.25f * rgb[0] + 0.5f * rgb[1] + 0.25f * rgb[2];
+            co =  0.5f  * rgb[0]                 - 0.5f  * rgb[2];
+            cg = -0.25f * rgb[0] + 0.5f * rgb[1] - 0.25f * rgb[2];
+        }
+
+        inline void from_ycocg(float y, float co, float cg, float rgb[3])
+        {
+            rgb[0] = y + co - cg;
+            rgb[1] = y + cg;
+            rgb[2] = y - co - cg;
+        }
+
+        void encode_fp16(const sh_cell& cell, unsigned char* dst)
+        {
+            DirectX::PackedVector::HALF h[12];
+
+            for (size_t ch = 0; ch < 3; ++ch)
+            for (size_t k = 0; k < 4; ++k)
+                h[ch * 4 + k] = DirectX::PackedVector::XMConvertFloatToHalf(cell.c[ch][k]);
+
+            std::memcpy(dst, h, sizeof(h));
+        }
+
+        void decode_fp16(const unsigned char* src, sh_cell& cell)
+        {
+            DirectX::PackedVector::HALF h[12];
+            std::memcpy(h, src, sizeof(h));
+
+            for (size_t ch = 0; ch < 3; ++ch)
+            for (size_t k = 0; k < 4; ++k)
+                cell.c[ch][k] = DirectX::PackedVector::XMConvertHalfToFloat(h[ch * 4 + k]);
+        }
+
+        void encode_shared_exponent(const sh_cell& cell, unsigned char* dst)
+        {
+            DirectX::PackedVector::XMFLOAT3SE dc;
+            DirectX::PackedVector::XMStoreFloat3SE(&dc, DirectX::XMVectorSet(cell.c[0][0], cell.c[1][0], cell.c[2][0], 0.f));
+
+            // the direction of luma is shared by all channels
+            float luma[4];
+
+            for (size_t k = 0; k < 4; ++k)
+            {
+                float rgb[3] = { cell.c[0][k], cell.c[1][k], cell.c[2][k] };
+                float co, cg;
+                to_ycocg(rgb, luma[k], co, cg);
+            }
+
+            float s = luma[0] > SH_MIN_LUMA ? 1.f / (luma[0] * SH_DIRECTION_RANGE) : 0.f;
+
+            DirectX::PackedVector::XMBYTEN4 dir;
+            DirectX::PackedVector::XMStoreByteN4(&dir, DirectX::XMVectorSet(luma[1] * s, luma[2] * s, luma[3] * s, 0.f));
+
+            std::memcpy(dst, &dc, 4);
+            std::memcpy(dst + 4, &dir, 4);
+        }
+
+        void decode_shared_exponent(const unsigned char* src, sh_cell& cell)
+        {
+            DirectX::PackedVector::XMFLOAT3SE dc;
+            DirectX::PackedVector::XMBYTEN4 dir;
+
+            std::memcpy(&dc, src, 4);
+            std::memcpy(&dir, src + 4, 4);
+
+            DirectX::XMFLOAT3 rgb;
+            DirectX::XMStoreFloat3(&rgb, DirectX::PackedVector::XMLoadFloat3SE(&dc));
+
+            DirectX::XMFLOAT4 d;
+            DirectX::XMStoreFloat4(&d, DirectX::XMVectorScale(DirectX::PackedVector::XMLoadByteN4(&dir), SH_DIRECTION_RANGE));
+
+            const float* c = &rgb.x;
+
+            for (size_t ch = 0; ch < 3; ++ch)
+            {
+                cell.c[ch][0] = c[ch];
+                cell.c[ch][1] = c[ch] * d.x;
+                cell.c[ch][2] = c[ch] * d.y;
+                cell.c[ch][3] = c[ch] * d.z;
+            }
+        }
+
+        void encode_ycocg(const sh_cell& cell, unsigned char* dst)
+        {
+            float y[4], co[4], cg[4];
+
+            for (size_t k = 0; k < 4; ++k)
+            {
+                float rgb[3] = { cell.c[0][k], cell.c[1][k], cell.c[2][k] };
+                to_ycocg(rgb, y[k], co[k], cg[k]);
+            }
+
+            DirectX::PackedVector::HALF h[4];
+
+            for (size_t k = 0; k < 4; ++k)
+                h[k] = DirectX::PackedVector::XMConvertFloatToHalf(y[k]);
+
+            float s = y[0] > SH_MIN_LUMA ? 1.f / (y[0] * SH_CHROMA_RANGE) : 0.f;
+
+            DirectX::PackedVector::XMBYTEN4 pco, pcg;
+            DirectX::PackedVector::XMStoreByteN4(&pco, DirectX::XMVectorScale(DirectX::XMVectorSet(co[0], co[1], co[2], co[3]), s));
+            DirectX::PackedVector::XMStoreByteN4(&pcg, DirectX::XMVectorScale(DirectX::XMVectorSet(cg[0], cg[1], cg[2], cg[3]), s));
+
+            std::memcpy(dst, h, 8);
+            std::memcpy(dst + 8, &pco, 4);
+            std::memcpy(dst + 12, &pcg, 4);
+        }
+
+        void decode_ycocg(const unsigned char* src, sh_cell& cell)
+        {
+            DirectX::PackedVector::HALF h[4];
+            DirectX::PackedVector::XMBYTEN4 pco, pcg;
+
+            std::memcpy(h, src, 8);
+            std::memcpy(&pco, src + 8, 4);
+            std::memcpy(&pcg, src + 12, 4);
+
+            float y[4];
+
+            for (size_t k = 0; k < 4; ++k)
+                y[k] = DirectX::PackedVector::XMConvertHalfToFloat(h[k]);
+
+            const float s = std::max(y[0], 0.f) * SH_CHROMA_RANGE;
+
+            DirectX::XMFLOAT4 co, cg;
+            DirectX::XMStoreFloat4(&co, DirectX::XMVectorScale(DirectX::PackedVector::XMLoadByteN4(&pco), s));
+            DirectX::XMStoreFloat4(&cg, DirectX::XMVectorScale(DirectX::PackedVector::XMLoadByteN4(&pcg), s));
+
+            const float* pco_f = &co.x;
+            const float* pcg_f = &cg.x;
+
+            for (size_t k = 0; k < 4; ++k)
+            {
+                float rgb[3];
+                from_ycocg(y[k], pco_f[k], pcg_f[k], rgb);
+
+                for (size_t ch = 0; ch < 3; ++ch)
+                    cell.c[ch][k] = rgb[ch];
+            }
+        }
+    }
+
+    size_t sh_format_size(sh_format format)
+    {
+        switch (format)
+        {
+        case SH_FORMAT_FP16:            return 24;
+        case SH_FORMAT_SHARED_EXPONENT: return 8;
+        case SH_FORMAT_YCOCG:           return 16;
+        }
+
+        assert(false);
+        return 0;
+    }
+
+    void encode_sh(const sh_volume& src, sh_format format, std::vector<unsigned char>& dst)
+    {
+        const size_t stride = sh_format_size(format);
+        const size_t slice = src.width * src.height;
+
+        dst.resize(src.size() * stride);
+
+        parallel_for(0, src.depth, [&](size_t first, size_t last)
+        {
+            for (size_t i = first * slice; i < last * slice; ++i)
+            {
+                detail::sh_cell cell = detail::load_cell(src, i);
+                unsigned char* p = &dst[i * stride];
+
+                switch (format)
+                {
+                case SH_FORMAT_FP16:            detail::encode_fp16(cell, p); break;
+                case SH_FORMAT_SHARED_EXPONENT: detail::encode_shared_exponent(cell, p); break;
+                case SH_FORMAT_YCOCG:           detail::encode_ycocg(cell, p); break;
+                }
+            }
+        });
+    }
+
+    void decode_sh(const std::vector<unsigned char>& src, sh_format format, sh_volume& dst)
+    {
+        const size_t stride = sh_format_size(format);
+        const size_t slice = dst.width * dst.height;
+
+        assert(src.size() == dst.size() * stride);
+
+        parallel_for(0, dst.depth, [&](size_t first, size_t last)
+        {
+            for (size_t i = first * slice; i < last * slice; ++i)
+            {
+                detail::sh_cell cell = {};
+                const unsigned char* p = &src[i * stride];
+
+                switch (format)
+                {
+                case SH_FORMAT_FP16:            detail::decode_fp16(p, cell); break;
+                case SH_FORMAT_SHARED_EXPONENT: detail::decode_shared_exponent(p, cell); break;
+                case SH_FORMAT_YCOCG:           detail::decode_ycocg(p, cell); break;
+                }
+
+                detail::store_cell(dst, i, cell);
+            }
+        });
+    }
+
+    sh_error measure_sh_error(const sh_volume& reference, const sh_volume& decoded)
+    {
+        assert(reference.size() == decoded.size());
+
+        DirectX::XMFLOAT4 axes[6];
+
+        for (size_t a = 0; a < 6; ++a)
+        {
+            float n[3] = { 0, 0, 0 };
+            n[a / 2] = a % 2 ? -1.f : 1.f;
+            axes[a] = sh_clamped_cos_coeff(n[0], n[1], n[2]);
+        }
+
+        double max_abs = 0, sum_sq = 0, ref_sq = 0, irr_sq = 0, irr_ref_sq = 0;
+
+        for (size_t i = 0; i < reference.size(); ++i)
+        {
+            detail::sh_cell r = detail::load_cell(reference, i);
+            detail::sh_cell d = detail::load_cell(decoded, i);
+
+            for (size_t ch = 0; ch < 3; ++ch)
+            {
+                for (size_t k = 0; k < 4; ++k)
+                {
+                    double e = d.c[ch][k] - r.c[ch][k];
+
+                    max_abs = std::max(max_abs, std::abs(e));
+                    sum_sq += e * e;
+                    ref_sq += static_cast<double>(r.c[ch][k]) * r.c[ch][k];
+                }
+
+                for (size_t a = 0; a < 6; ++a)
+                {
+                    const float* n = &axes[a].x;
+
+                    double er = 0, ed = 0;
+
+                    for (size_t k = 0; k < 4; ++k)
+                    {
+                        er += r.c[ch][k] * n[k];
+                        ed += d.c[ch][k] * n[k];
+                    }
+
+                    irr_sq += (ed - er) * (ed - er);
+                    irr_ref_sq += er * er;
+                }
+            }
+        }
+
+        const double n = static_cast<double>(reference.size() * 12);
+
+        sh_error err;
+        err.max_abs = static_cast<float>(max_abs);
+        err.rms = static_cast<float>(std::sqrt(sum_sq / n));
+        err.relative_rms = ref_sq > 0 ? static_cast<float>(std::sqrt(sum_sq / ref_sq)) : 0.f;
+        err.irradiance_rms = irr_ref_sq > 0 ? static_cast<float>(std::sqrt(irr_sq / irr_ref_sq)) : 0.f;
+
+        return err;
+    }
+}
@@ -0,0 +1,71 @@
+/*
+ * Dune D3D library - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+/*! \file */
+
+#ifndef DUNE_SH_PACKING
+#define DUNE_SH_PACKING
+
+#include <vector>
+
+#include "lpv_grid.h"
+
+namespace dune
+{
+    /*!
+     * \brief Storage formats for the RGB SH of an LPV cell.
+     *
+     * - SH_FORMAT_FP16: all 12 coefficients as half floats, 24 bytes per cell. This is the
+     *   format of the volumes of light_propagation_volume.
+     * - SH_FORMAT_SHARED_EXPONENT: the DC of each channel as RGB with a shared exponent (RGB9E5),
+     *   and one direction for all channels, which is the band 1 of the luma SH divided by its DC,
+     *   as four signed bytes. 8 bytes per cell. Color can only vary by magnitude over direction,
+     *   and negative DC is lost.
+     * - SH_FORMAT_YCOCG: the SH of luma as half floats, the SH of Co and Cg relative to the DC of
+     *   luma as four signed bytes each. 16 bytes per cell.
+     */
+    enum sh_format
+    {
+        SH_FORMAT_FP16,
+        SH_FORMAT_SHARED_EXPONENT,
+        SH_FORMAT_YCOCG
+    };
+
+    /*! \brief Returns the number of bytes a format needs per cell. */
+    size_t sh_format_size(sh_format format);
+
+    /*!
+     * \brief Encode the SH of all cells of a volume.
+     *
+     * \param src The volume to encode.
+     * \param format The format to encode to.
+     * \param dst The encoded cells, sh_format_size(format) bytes each in the same order as sh_volume::index().
+     */
+    void encode_sh(const sh_volume& src, sh_format format, std::vector<unsigned char>& dst);
+
+    /*!
+     * \brief Decode a volume encoded with encode_sh().
+     *
+     * \param src The encoded cells.
+     * \param format The format of src.
+     * \param dst The decoded volume, which needs to have been created with the size of the encoded one.
+     */
+    void decode_sh(const std::vector<unsigned char>& src, sh_format format, sh_volume& dst);
+
+    /*! \brief Differences between a reference volume and a decoded one. */
+    struct sh_error
+    {
+        float max_abs;          //!< the largest absolute difference of any coefficient
+        float rms;              //!< root mean square difference of all coefficients
+        float relative_rms;     //!< rms divided by the root mean square of the reference
+        float irradiance_rms;   //!< rms difference of irradiance along the six axes, relative to the rms irradiance of the reference
+    };
+
+    /*! \brief Compare a decoded volume against a reference of the same size. */
+    sh_error measure_sh_error(const sh_volume& reference, const sh_volume& decoded);
+}
+
+#endif
@@ -11,6 +11,10 @@
 #include "unicode.h"
 #include "gbuffer.h"
 #include "light.h"
+#include "d3d_tools.h"
+#include "voxel_clipmap.h"
+
+#include <cassert>
 
 namespace dune
 {
@@ -25,6 +29,7 @@ namespace dune
         inject_rsm_rho_start_slot_(-1),
         v_normal_(nullptr),
         v_rho_(nullptr),
+        v_emissive_(nullptr),
         srv_v_normal_(nullptr),
         srv_v_rho_(nullptr),
         uav_v_normal_(nullptr),
@@ -35,7 +40,10 @@ namespace dune
         svo_min_(),
         svo_max_(),
         cb_parameters_(),
-        profiler_(),
+        parameters_slot_(0),
+        profiler_voxelize_(),
+        profiler_inject_(),
+        profiler_mip_(),
         cb_gi_parameters_(),
         last_bound_(0),
         time_voxelize_(0),
@@ -46,7 +54,10 @@ namespace dune
 
     void sparse_voxel_octree::create(ID3D11Device* device, UINT volume_size)
     {
-        profiler_.create(device);
+        // voxelize() is timed once per mesh
+        profiler_voxelize_.create(device, "SVO voxelize", 4 * profile_query::NUM_SETS);
+        profiler_inject_.create(device, "SVO inject");
+        profiler_mip_.create(device, "SVO filter");
 
         volume_size_ = volume_size;
         UINT voxel_count = volume_size_ * volume_size_ * volume_size_;
@@ -67,6 +78,13 @@ namespace dune
         assert_hr(device->CreateTexture3D(&desc, nullptr, &v_normal_));
         assert_hr(device->CreateTexture3D(&desc, nullptr, &v_rho_));
 
+        // copy of the top mip level of v_rho_ after voxelization
+        desc.BindFlags = 0;
+        desc.MiscFlags = 0;
+        desc.MipLevels = 1;
+
+        assert_hr(device->CreateTexture3D(&desc, nullptr, &v_emissive_));
+
         // create unordered access view for volume(s)
         D3D11_UNORDERED_ACCESS_VIEW_DESC uav_desc;
         ZeroMemory(&uav_desc, sizeof(uav_desc));
@@ -156,15 +174,80 @@ namespace dune
 
             DirectX::XMStoreFloat4(&cb->bb_min, v_svo_min);
             DirectX::XMStoreFloat4(&cb->bb_max, v_svo_max);
+
+            // the window is the whole volume
+            DirectX::XMStoreFloat4x4(&cb->world_to_window,
+                world_to_svo);
+
+            for (size_t a = 0; a < 3; ++a)
+            {
+                cb->window_texel[a] = 0;
+                cb->region_min[a] = 0;
+                cb->region_max[a] = volume_size_;
+            }
+
+            cb->toroidal = FALSE;
+        }
+
+        parameters_slot_ = svo_parameters_slot;
+
+        cb_parameters_.to_vs(context, svo_parameters_slot);
+        cb_parameters_.to_gs(context, svo_parameters_slot);
+        cb_parameters_.to_ps(context, svo_parameters_slot);
+    }
+
+    void sparse_voxel_octree::set_clipmap(ID3D11DeviceContext* context, const voxel_clipmap& clipmap, size_t level, UINT svo_parameters_slot)
+    {
+        assert(clipmap.resolution() == volume_size_);
+
+        world_to_svo_ = clipmap.world_to_svo(level);
+        clipmap.bounds(level, svo_min_, svo_max_);
+
+        auto cb = &cb_parameters_.data();
+        {
+            cb->world_to_svo = world_to_svo_;
+            cb->bb_min = DirectX::XMFLOAT4(svo_min_.x, svo_min_.y, svo_min_.z, 1.f);
+            cb->bb_max = DirectX::XMFLOAT4(svo_max_.x, svo_max_.y, svo_max_.z, 1.f);
+            cb->world_to_window = clipmap.world_to_window(level);
+
+            for (size_t a = 0; a < 3; ++a)
+            {
+                cb->window_texel[a] = clipmap.texel(clipmap.origin(level)[a]);
+                cb->region_min[a] = 0;
+                cb->region_max[a] = volume_size_;
+            }
+
+            cb->toroidal = TRUE;
         }
+
+        parameters_slot_ = svo_parameters_slot;
+
         cb_parameters_.to_vs(context, svo_parameters_slot);
         cb_parameters_.to_gs(context, svo_parameters_slot);
         cb_parameters_.to_ps(context, svo_parameters_slot);
     }
 
+    void sparse_voxel_octree::set_voxelize_region(ID3D11DeviceContext* context, const voxel_box& window_voxels)
+    {
+        auto cb = &cb_parameters_.data();
+        {
+            for (size_t a = 0; a < 3; ++a)
+            {
+                cb->region_min[a] = window_voxels.min[a];
+                cb->region_max[a] = window_voxels.max[a];
+            }
+        }
+
+        cb_parameters_.to_vs(context, parameters_slot_);
+        cb_parameters_.to_gs(context, parameters_slot_);
+        cb_parameters_.to_ps(context, parameters_slot_);
+    }
+
     void sparse_voxel_octree::destroy()
     {
-        profiler_.destroy();
+        profiler_voxelize_.destroy();
+        profiler_inject_.destroy();
+        profiler_mip_.destroy();
 
         cb_parameters_.destroy();
         cb_gi_parameters_.destroy();
@@ -187,6 +270,7 @@ namespace dune
 
         safe_release(v_normal_);
         safe_release(v_rho_);
+        safe_release(v_emissive_);
 
         safe_release(no_culling_);
 
@@ -197,7 +281,7 @@ namespace dune
 
     void sparse_voxel_octree::inject(ID3D11DeviceContext* context, directional_light& light)
     {
-        profiler_.begin(context);
+        profiler_inject_.begin(context);
 
         float clear_color[] = { 0.0f, 0.0f, 0.0f, 0.0f };
 
@@ -236,17 +320,90 @@ namespace dune
         ID3D11UnorderedAccessView* clear_uavs[] = { nullptr };
         context->OMSetRenderTargetsAndUnorderedAccessViews(0, nullptr, nullptr, 1, 1, clear_uavs, nullptr);
 
-        time_inject_ = profiler_.result();
+        profiler_inject_.end();
     }
 
     void sparse_voxel_octree::filter(ID3D11DeviceContext* context)
     {
-        profiler_.begin(context);
+        profiler_mip_.begin(context);
 
         context->GenerateMips(srv_v_normal_);
         context->GenerateMips(srv_v_rho_);
 
-        time_mip_ = profiler_.result();
+        profiler_mip_.end();
+    }
+
+    void sparse_voxel_octree::update_timings()
+    {
+        time_voxelize_ = profiler_voxelize_.latest();
+        time_inject_ = profiler_inject_.latest();
+        time_mip_ = profiler_mip_.latest();
+    }
+
+    void sparse_voxel_octree::clear(ID3D11DeviceContext* context, const std::vector<voxel_box>& regions)
+    {
+        std::vector<BYTE> zeros;
+
+        for (auto r = regions.begin(); r != regions.end(); ++r)
+        {
+            UINT w = r->max[0] - r->min[0], h = r->max[1] - r->min[1], d = r->max[2] - r->min[2];
+
+            if (w == volume_size_ && h == volume_size_ && d == volume_size_)
+            {
+                float clear[4] = { 0.f, 0.f, 0.f, 0.f };
+                context->ClearUnorderedAccessViewFloat(uav_v_normal_, clear);
+                context->ClearUnorderedAccessViewFloat(uav_v_rho_, clear);
+                continue;
+            }
+
+            // R16G16B16A16_FLOAT
+            const UINT texel_size = 8;
+
+            if (zeros.size() < w * h * d * texel_size)
+                zeros.resize(w * h * d * texel_size, 0);
+
+            D3D11_BOX box = { r->min[0], r->min[1], r->min[2], r->max[0], r->max[1], r->max[2] };
+
+            context->UpdateSubresource(v_normal_, 0, &box, &zeros[0], w * texel_size, w * h * texel_size);
+            context->UpdateSubresource(v_rho_, 0, &box, &zeros[0], w * texel_size, w * h * texel_size);
+        }
+    }
+
+    void sparse_voxel_octree::store_emissive(ID3D11DeviceContext* context)
+    {
+        context->CopySubresourceRegion(v_emissive_, 0, 0, 0, 0, v_rho_, 0, nullptr);
+    }
+
+    void sparse_voxel_octree::restore_emissive(ID3D11DeviceContext* context)
+    {
+        context->CopySubresourceRegion(v_rho_, 0, 0, 0, 0, v_emissive_, 0, nullptr);
+    }
+
+    void sparse_voxel_octree::save_snapshot(ID3D11DeviceContext* context, gi_snapshot& snapshot)
+    {
+        // R16G16B16A16_FLOAT
+        snapshot_volume& normal = snapshot.add("svo.normal", volume_size_, volume_size_, volume_size_, 8);
+        read_texture(context, v_normal_, 8, &normal.data[0]);
+
+        snapshot_volume& rho = snapshot.add("svo.rho", volume_size_, volume_size_, volume_size_, 8);
+        read_texture(context, v_rho_, 8, &rho.data[0]);
+    }
+
+    bool sparse_voxel_octree::load_snapshot(ID3D11DeviceContext* context, const gi_snapshot& snapshot)
+    {
+        const snapshot_volume* normal = snapshot.find("svo.normal");
+        const snapshot_volume* rho = snapshot.find("svo.rho");
+
+        for (const snapshot_volume* v : { normal, rho })
+            if (!v || v->width != volume_size_ || v->height != volume_size_ || v->depth != volume_size_ || v->texel_size != 8)
+                return false;
+
+        write_texture(context, v_normal_, 8, &normal->data[0]);
+        write_texture(context, v_rho_, 8, &rho->data[0]);
+
+        filter(context);
+
+        return true;
     }
 
     void sparse_voxel_octree::clear_ps(ID3D11DeviceContext* context)
@@ -285,7 +442,7 @@ namespace dune
     {
         clear_ps(context);
 
-        profiler_.begin(context);
+        profiler_voxelize_.begin(context);
 
         dune::set_viewport(context, volume_size_, volume_size_);
 
@@ -316,7 +473,7 @@ namespace dune
         ID3D11UnorderedAccessView* clear_uavs[] = { nullptr, nullptr };
         context->OMSetRenderTargetsAndUnorderedAccessViews(0, nullptr, nullptr, 1, 2, clear_uavs, nullptr);
 
-        time_voxelize_ = profiler_.result();
+        profiler_voxelize_.end();
     }
 
     delta_sparse_voxel_octree::delta_sparse_voxel_octree() :
@@ -338,7 +495,7 @@ namespace dune
 
     void delta_sparse_voxel_octree::inject(ID3D11DeviceContext* context, differential_directional_light& light)
     {
-        profiler_.begin(context);
+        profiler_inject_.begin(context);
 
         float clear_color[] = { 0.0f, 0.0f, 0.0f, 0.0f };
 
@@ -379,7 +536,7 @@ namespace dune
         ID3D11UnorderedAccessView* clear_uavs[] = { nullptr, nullptr };
         context->OMSetRenderTargetsAndUnorderedAccessViews(0, nullptr, nullptr, 1, 2, clear_uavs, nullptr);
 
-        time_inject_ = profiler_.result();
+        profiler_inject_.end();
     }
 
     void delta_sparse_voxel_octree::clear_ps(ID3D11DeviceContext* context)
@@ -396,7 +553,7 @@ namespace dune
 
         last_bound_ = volume_start_slot;
 
-        profiler_.begin(context);
+        profiler_mip_.begin(context);
 
         context->GenerateMips(srv_v_normal_);
         context->PSSetShaderResources(normal_slot, 1, &srv_v_normal_);
@@ -407,7 +564,7 @@ namespace dune
         context->GenerateMips(srv_v_delta_);
         context->PSSetShaderResources(delta_slot, 1, &srv_v_delta_);
 
-        time_mip_ = profiler_.result();
+        profiler_mip_.end();
     }
 
     void delta_sparse_voxel_octree::create(ID3D11Device* device, UINT volume_size)
@@ -13,10 +13,13 @@
 
 #include "cbuffer.h"
 #include "shader_resource.h"
+#include "gi_snapshot.h"
+#include "voxel_ownership.h"
 
 namespace dune
 {
     struct d3d_mesh;
+    class voxel_clipmap;
     class gilga_mesh;
     class directional_light;
     class differential_directional_light;
@@ -65,6 +68,7 @@ namespace dune
 
         ID3D11Texture3D*            v_normal_;
         ID3D11Texture3D*            v_rho_;
+        ID3D11Texture3D*            v_emissive_;
 
         ID3D11ShaderResourceView*   srv_v_normal_;
         ID3D11ShaderResourceView*   srv_v_rho_;
@@ -84,11 +88,21 @@ namespace dune
             DirectX::XMFLOAT4X4 world_to_svo;
             DirectX::XMFLOAT4   bb_min;
             DirectX::XMFLOAT4   bb_max;
+            DirectX::XMFLOAT4X4 world_to_window;
+            UINT                window_texel[3];
+            BOOL                toroidal;
+            UINT                region_min[3];
+            UINT                pad0;
+            UINT                region_max[3];
+            UINT                pad1;
         };
 
         cbuffer<cbs_parameters> cb_parameters_;
+        UINT                    parameters_slot_;
 
-        dune::profile_query profiler_;
+        dune::profile_query profiler_voxelize_;
+        dune::profile_query profiler_inject_;
+        dune::profile_query profiler_mip_;
 
         typedef cbuffer<param> cb_gi_parameters;
         cb_gi_parameters cb_gi_parameters_;
@@ -116,6 +130,16 @@ namespace dune
         virtual void create(ID3D11Device* device, UINT volume_size);
         virtual void destroy();
 
+        /*! \brief Set time_voxelize_, time_inject_ and time_mip_ to the newest GPU timings, which lag a few frames behind. */
+        void update_timings();
+
+        //!@{
+        /*! \brief Returns rolling statistics of the GPU timings of voxelization, injection and filtering. */
+        profile_stats stats_voxelize() const { return profiler_voxelize_.stats(); }
+        profile_stats stats_inject() const   { return profiler_inject_.stats(); }
+        profile_stats stats_mip() const      { return profiler_mip_.stats(); }
+        //!@}
+
         /*!
          * \brief Set the complete voxelization shader.
          *
@@ -144,6 +168,25 @@ namespace dune
         /*! \brief Voxelize a mesh into a volume with normals and an occupied marker. If clear is true, the volume is cleared before voxelization. */
         void voxelize(ID3D11DeviceContext* context, gilga_mesh& mesh, bool clear = true);
 
+        /*!
+         * \brief Clear boxes of voxels in the top mip level of both volumes.
+         *
+         * Together with voxel_ownership, this replaces the full clear of voxelize() when only some meshes changed.
+         */
+        void clear(ID3D11DeviceContext* context, const std::vector<voxel_box>& regions);
+
+        //!@{
+        /*!
+         * \brief Keep/restore a copy of the radiance volume.
+         *
+         * Voxelization writes emissive voxels into the radiance volume, which inject() then overwrites. Storing the
+         * volume after voxelization allows to remove the last injection without voxelizing again if only the
+         * light changed.
+         */
+        void store_emissive(ID3D11DeviceContext* context);
+        void restore_emissive(ID3D11DeviceContext* context);
+        //!@}
+
         /*! \brief Inject a bounce from directional_light into the SVO. */
         virtual void inject(ID3D11DeviceContext* context, directional_light& light);
 
@@ -156,7 +199,34 @@ namespace dune
         const DirectX::XMFLOAT4X4& world_to_svo() const { return world_to_svo_; }
         //!@}
 
+        /*!
+         * \brief Place the SVO on the window of a level of a camera clipmap instead of set_model_matrix().
+         *
+         * The volume stores the window toroidally, so a voxel keeps its texel while the window slides, and cone
+         * tracing samples with a wrapping sampler. Only the regions() of the clipmap have to be cleared and
+         * voxelized, see set_voxelize_region(). Mip levels near the border of the window mix voxels of both ends.
+         *
+         * \param context A Direct3D context.
+         * \param clipmap A clipmap with the resolution of this SVO.
+         * \param level The level of the clipmap to store.
+         * \param svo_parameters_slot The slot of the SVO parameters.
+         */
+        void set_clipmap(ID3D11DeviceContext* context, const voxel_clipmap& clipmap, size_t level, UINT svo_parameters_slot);
+
+        /*! \brief Restrict voxelize() to a box of voxels of the window, e.g. a clipmap region minus the origin of its level. */
+        void set_voxelize_region(ID3D11DeviceContext* context, const voxel_box& window_voxels);
+
         virtual void to_ps(ID3D11DeviceContext* context, UINT volume_start_slot);
+
+        /*! \brief Store the top mip level of the normal and radiance volumes as "svo.normal" and "svo.rho" in a snapshot. */
+        void save_snapshot(ID3D11DeviceContext* context, gi_snapshot& snapshot);
+
+        /*!
+         * \brief Upload the volumes of a snapshot written by save_snapshot() instead of voxelizing and injecting, and filter them.
+         *
+         * \return False if the snapshot has no volumes matching the size of this SVO, in which case nothing is changed.
+         */
+        bool load_snapshot(ID3D11DeviceContext* context, const gi_snapshot& snapshot);
     };
 
     /*!
@@ -0,0 +1,287 @@
+/*
+ * Dune D3D library - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+#include "state_cache.h"
+
+#include <cstring>
+
+#include "d3d_tools.h"
+
+namespace dune
+{
+    namespace detail
+    {
+        inline uint32_t float_bits(FLOAT f)
+        {
+            uint32_t bits;
+            std::memcpy(&bits, &f, sizeof(bits));
+            return bits;
+        }
+
+        // the bindings of a range of slots, which D3D limits to 128
+        struct slot_bindings
+        {
+            state_binding b[D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT];
+
+            template<typename T>
+            slot_bindings(UINT num, T* const* objects)
+            {
+                for (UINT i = 0; i < num; ++i)
+                    b[i] = make_binding(objects ? objects[i] : nullptr);
+            }
+        };
+    }
+
+    state_cache::state_cache() :
+        context_(nullptr),
+        context1_(nullptr),
+        filter_(),
+        issued_(0),
+        dropped_(0)
+    {
+    }
+
+    bool state_cache::count(bool issue)
+    {
+        state_counters& counters = state_stats();
+
+        if (issue)
+        {
+            ++issued_;
+            ++counters.issued;
+        }
+        else
+        {
+            ++dropped_;
+            ++counters.dropped;
+        }
+
+        return issue;
+    }
+
+    void state_cache::begin(ID3D11DeviceContext* context)
+    {
+        if (context != context_)
+        {
+            safe_release(context1_);
+            context_ = context;
+        }
+
+        filter_.invalidate();
+    }
+
+    void state_cache::invalidate()
+    {
+        filter_.invalidate();
+    }
+
+    void state_cache::destroy()
+    {
+        safe_release(context1_);
+        context_ = nullptr;
+
+        filter_.invalidate();
+        issued_ = 0;
+        dropped_ = 0;
+    }
+
+    void state_cache::set_vs(ID3D11VertexShader* vs)
+    {
+        if (count(filter_.set(state_filter::VS, make_binding(vs))))
+            context_->VSSetShader(vs, nullptr, 0);
+    }
+
+    void state_cache::set_gs(ID3D11GeometryShader* gs)
+    {
+        if (count(filter_.set(state_filter::GS, make_binding(gs))))
+            context_->GSSetShader(gs, nullptr, 0);
+    }
+
+    void state_cache::set_ps(ID3D11PixelShader* ps)
+    {
+        if (count(filter_.set(state_filter::PS, make_binding(ps))))
+            context_->PSSetShader(ps, nullptr, 0);
+    }
+
+    void state_cache::set_cs(ID3D11ComputeShader* cs)
+    {
+        if (count(filter_.set(state_filter::CS, make_binding(cs))))
+            context_->CSSetShader(cs, nullptr, 0);
+    }
+
+    void state_cache::set_resources(shader_stage stage, UINT start_slot, UINT num_views, ID3D11ShaderResourceView* const* views)
+    {
+        detail::slot_bindings bindings(num_views, views);
+
+        size_t first, changed;
+
+        if (!count(filter_.set(state_filter::slots_of(state_filter::RESOURCES, stage), start_slot, num_views, bindings.b, first, changed)))
+            return;
+
+        UINT s = static_cast<UINT>(first), n = static_cast<UINT>(changed);
+        ID3D11ShaderResourceView* const* v = views + (s - start_slot);
+
+        switch (stage)
+        {
+        case STAGE_VS: context_->VSSetShaderResources(s, n, v); break;
+        case STAGE_GS: context_->GSSetShaderResources(s, n, v); break;
+        case STAGE_PS: context_->PSSetShaderResources(s, n, v); break;
+        case STAGE_CS: context_->CSSetShaderResources(s, n, v); break;
+        default: break;
+        }
+    }
+
+    void state_cache::set_constants(shader_stage stage, UINT start_slot, UINT num_buffers, ID3D11Buffer* const* buffers)
+    {
+        detail::slot_bindings bindings(num_buffers, buffers);
+
+        size_t first, changed;
+
+        if (!count(filter_.set(state_filter::slots_of(state_filter::CONSTANTS, stage), start_slot, num_buffers, bindings.b, first, changed)))
+            return;
+
+        UINT s = static_cast<UINT>(first), n = static_cast<UINT>(changed);
+        ID3D11Buffer* const* b = buffers + (s - start_slot);
+
+        switch (stage)
+        {
+        case STAGE_VS: context_->VSSetConstantBuffers(s, n, b); break;
+        case STAGE_GS: context_->GSSetConstantBuffers(s, n, b); break;
+        case STAGE_PS: context_->PSSetConstantBuffers(s, n, b); break;
+        case STAGE_CS: context_->CSSetConstantBuffers(s, n, b); break;
+        default: break;
+        }
+    }
+
+    void state_cache::set_constants(shader_stage stage, UINT slot, ID3D11Buffer* buffer, UINT first_constant, UINT num_constants)
+    {
+        if (!context1_ && FAILED(context_->QueryInterface(__uuidof(ID3D11DeviceContext1), reinterpret_cast<void**>(&context1_))))
+        {
+            context1_ = nullptr;
+            return;
+        }
+
+        // a range is bound with the same buffer as a whole one, so its arguments tell them apart
+        state_binding binding = make_binding(buffer, first_constant, num_constants);
+
+        size_t first, changed;
+
+        if (!count(filter_.set(state_filter::slots_of(state_filter::CONSTANTS, stage), slot, 1, &binding, first, changed)))
+            return;
+
+        switch (stage)
+        {
+        case STAGE_VS: context1_->VSSetConstantBuffers1(slot, 1, &buffer, &first_constant, &num_constants); break;
+        case STAGE_GS: context1_->GSSetConstantBuffers1(slot, 1, &buffer, &first_constant, &num_constants); break;
+        case STAGE_PS: context1_->PSSetConstantBuffers1(slot, 1, &buffer, &first_constant, &num_constants); break;
+        case STAGE_CS: context1_->CSSetConstantBuffers1(slot, 1, &buffer, &first_constant, &num_constants); break;
+        default: break;
+        }
+    }
+
+    void state_cache::set_samplers(shader_stage stage, UINT start_slot, UINT num_samplers, ID3D11SamplerState* const* samplers)
+    {
+        detail::slot_bindings bindings(num_samplers, samplers);
+
+        size_t first, changed;
+
+        if (!count(filter_.set(state_filter::slots_of(state_filter::SAMPLERS, stage), start_slot, num_samplers, bindings.b, first, changed)))
+            return;
+
+        UINT s = static_cast<UINT>(first), n = static_cast<UINT>(changed);
+        ID3D11SamplerState* const* v = samplers + (s - start_slot);
+
+        switch (stage)
+        {
+        case STAGE_VS: context_->VSSetSamplers(s, n, v); break;
+        case STAGE_GS: context_->GSSetSamplers(s, n, v); break;
+        case STAGE_PS: context_->PSSetSamplers(s, n, v); break;
+        case STAGE_CS: context_->CSSetSamplers(s, n, v); break;
+        default: break;
+        }
+    }
+
+    void state_cache::set_render_targets(UINT num_views, ID3D11RenderTargetView* const* views, ID3D11DepthStencilView* dsv)
+    {
+        // OMSetRenderTargets() unbinds all slots after num_views
+        state_binding bindings[D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT];
+
+        for (UINT i = 0; i < D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT; ++i)
+            bindings[i] = make_binding(i < num_views && views ? views[i] : nullptr);
+
+        size_t first, changed;
+
+        const bool targets = filter_.set(state_filter::RENDER_TARGETS, 0, D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT, bindings, first, changed);
+        const bool depth = filter_.set(state_filter::DEPTH_STENCIL_VIEW, make_binding(dsv));
+
+        if (!count(targets || depth))
+            return;
+
+        context_->OMSetRenderTargets(num_views, views, dsv);
+
+        for (size_t s = 0; s < NUM_STAGES; ++s)
+            filter_.invalidate(state_filter::slots_of(state_filter::RESOURCES, static_cast<shader_stage>(s)));
+    }
+
+    void state_cache::set_blend_state(ID3D11BlendState* state, const FLOAT* factors, UINT sample_mask)
+    {
+        state_binding binding = make_binding(state);
+
+        for (size_t i = 0; i < 4; ++i)
+            binding.args[i] = detail::float_bits(factors ? factors[i] : 1.f);
+
+        binding.args[4] = sample_mask;
+
+        if (count(filter_.set(state_filter::BLEND, binding)))
+            context_->OMSetBlendState(state, factors, sample_mask);
+    }
+
+    void state_cache::set_rasterizer_state(ID3D11RasterizerState* state)
+    {
+        if (count(filter_.set(state_filter::RASTERIZER, make_binding(state))))
+            context_->RSSetState(state);
+    }
+
+    void state_cache::set_depth_stencil_state(ID3D11DepthStencilState* state, UINT stencil_ref)
+    {
+        if (count(filter_.set(state_filter::DEPTH_STENCIL, make_binding(state, stencil_ref))))
+            context_->OMSetDepthStencilState(state, stencil_ref);
+    }
+
+    void state_cache::set_input_layout(ID3D11InputLayout* layout)
+    {
+        if (count(filter_.set(state_filter::INPUT_LAYOUT, make_binding(layout))))
+            context_->IASetInputLayout(layout);
+    }
+
+    void state_cache::set_topology(D3D11_PRIMITIVE_TOPOLOGY topology)
+    {
+        if (count(filter_.set(state_filter::TOPOLOGY, make_binding(nullptr, static_cast<uint32_t>(topology)))))
+            context_->IASetPrimitiveTopology(topology);
+    }
+
+    void state_cache::set_vertex_buffers(UINT start_slot, UINT num_buffers, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets)
+    {
+        state_binding bindings[D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT];
+
+        for (UINT i = 0; i < num_buffers; ++i)
+            bindings[i] = make_binding(buffers[i], strides[i], offsets[i]);
+
+        size_t first, changed;
+
+        if (!count(filter_.set(state_filter::VERTEX_BUFFERS, start_slot, num_buffers, bindings, first, changed)))
+            return;
+
+        const size_t skip = first - start_slot;
+        context_->IASetVertexBuffers(static_cast<UINT>(first), static_cast<UINT>(changed), buffers + skip, strides + skip, offsets + skip);
+    }
+
+    void state_cache::set_index_buffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset)
+    {
+        if (count(filter_.set(state_filter::INDEX_BUFFER, make_binding(buffer, static_cast<uint32_t>(format), offset))))
+            context_->IASetIndexBuffer(buffer, format, offset);
+    }
+}
@@ -0,0 +1,111 @@
+/*
+ * Dune D3D library - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+/*! \file */
+
+#ifndef DUNE_STATE_CACHE
+#define DUNE_STATE_CACHE
+
+#include <D3D11.h>
+#include <d3d11_1.h>
+
+#include "state_filter.h"
+
+namespace dune
+{
+    /*!
+     * \brief A wrapper of an ID3D11DeviceContext which drops redundant state changes.
+     *
+     * All state changes made through a state_cache are compared with a state_filter of what was bound before, and
+     * only changes are passed on to the context. A state_cache is used for a stretch of rendering which binds the
+     * same state over and over, e.g. the meshes of a composite_mesh or the iterations of a propagation:
+     *
+     * - begin() starts using a context and forgets all bindings, because the state of the context is unknown.
+     * - Everything in between should go through the cache. If the context is used directly, e.g. to bind unordered
+     *   access views, call invalidate() afterwards.
+     *
+     * Binding render targets makes D3D unbind shader resources of the same resources, so the cache forgets the
+     * shader resources of all stages whenever it changes the render targets.
+     *
+     * The number of issued and dropped state changes is counted per cache and in state_stats().
+     */
+    class state_cache
+    {
+    protected:
+        ID3D11DeviceContext*    context_;
+        ID3D11DeviceContext1*   context1_;
+        state_filter            filter_;
+        size_t                  issued_;
+        size_t                  dropped_;
+
+        bool count(bool issue);
+
+    public:
+        state_cache();
+        virtual ~state_cache() {}
+
+        /*! \brief Start using a context and forget everything bound before. */
+        void begin(ID3D11DeviceContext* context);
+
+        /*! \brief Forget everything bound before, e.g. after the context was used directly. */
+        void invalidate();
+
+        /*! \brief Release the context. */
+        void destroy();
+
+        /*! \brief Returns the context passed to begin(). */
+        ID3D11DeviceContext* context() const { return context_; }
+
+        /*! \brief Returns the number of state changes passed on to the context. */
+        size_t issued() const { return issued_; }
+
+        /*! \brief Returns the number of redundant state changes which were dropped. */
+        size_t dropped() const { return dropped_; }
+
+        //!@{
+        /*! \brief Set the shader of a stage. */
+        void set_vs(ID3D11VertexShader* vs);
+        void set_gs(ID3D11GeometryShader* gs);
+        void set_ps(ID3D11PixelShader* ps);
+        void set_cs(ID3D11ComputeShader* cs);
+        //!@}
+
+        /*! \brief Set shader resources of a stage, see ID3D11DeviceContext::PSSetShaderResources(). */
+        void set_resources(shader_stage stage, UINT start_slot, UINT num_views, ID3D11ShaderResourceView* const* views);
+
+        /*! \brief Set constant buffers of a stage, see ID3D11DeviceContext::PSSetConstantBuffers(). */
+        void set_constants(shader_stage stage, UINT start_slot, UINT num_buffers, ID3D11Buffer* const* buffers);
+
+        /*!
+         * \brief Set a range of a constant buffer, see ID3D11DeviceContext1::PSSetConstantBuffers1().
+         *
+         * This needs D3D11.1, e.g. for a constant_ring, and does nothing on older runtimes.
+         */
+        void set_constants(shader_stage stage, UINT slot, ID3D11Buffer* buffer, UINT first_constant, UINT num_constants);
+
+        /*! \brief Set samplers of a stage, see ID3D11DeviceContext::PSSetSamplers(). */
+        void set_samplers(shader_stage stage, UINT start_slot, UINT num_samplers, ID3D11SamplerState* const* samplers);
+
+        /*! \brief Set render targets and a depth stencil view, see ID3D11DeviceContext::OMSetRenderTargets(). */
+        void set_render_targets(UINT num_views, ID3D11RenderTargetView* const* views, ID3D11DepthStencilView* dsv);
+
+        /*! \brief Set a blend state, with nullptr factors meaning a factor of one. */
+        void set_blend_state(ID3D11BlendState* state, const FLOAT* factors, UINT sample_mask);
+
+        void set_rasterizer_state(ID3D11RasterizerState* state);
+        void set_depth_stencil_state(ID3D11DepthStencilState* state, UINT stencil_ref);
+
+        void set_input_layout(ID3D11InputLayout* layout);
+        void set_topology(D3D11_PRIMITIVE_TOPOLOGY topology);
+
+        /*! \brief Set vertex buffers, see ID3D11DeviceContext::IASetVertexBuffers(). */
+        void set_vertex_buffers(UINT start_slot, UINT num_buffers, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets);
+
+        void set_index_buffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset);
+    };
+}
+
+#endif
@@ -0,0 +1,157 @@
+/*
+ * Dune D3D library - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+#include "state_filter.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace dune
+{
+    namespace detail
+    {
+        inline bool equal(const state_binding& a, const state_binding& b)
+        {
+            return a.object == b.object && std::equal(a.args, a.args + 5, b.args);
+        }
+    }
+
+    state_counters& state_stats()
+    {
+        static state_counters counters = { 0, 0 };
+        return counters;
+    }
+
+    state_counters reset_state_stats()
+    {
+        state_counters& counters = state_stats();
+        state_counters before = counters;
+
+        counters.issued = 0;
+        counters.dropped = 0;
+
+        return before;
+    }
+
+    state_filter::state_filter() :
+        next_generation_(0)
+    {
+        for (size_t s = 0; s < NUM_STATES; ++s)
+            states_[s].generation = 0;
+
+        for (size_t s = 0; s < NUM_SLOTS; ++s)
+            slots_[s].resize(size(static_cast<slots>(s)));
+
+        invalidate();
+    }
+
+    size_t state_filter::size(slots array)
+    {
+        // the slot counts of D3D11
+        if (array < CONSTANTS)
+            return 128;
+        else if (array < SAMPLERS)
+            return 14;
+        else if (array < VERTEX_BUFFERS)
+            return 16;
+        else if (array == VERTEX_BUFFERS)
+            return 32;
+        else
+            return 8;
+    }
+
+    uint32_t state_filter::next_generation()
+    {
+        if (++next_generation_ == 0)
+        {
+            // all generations were used up and old entries could match again, so forget everything
+            for (size_t s = 0; s < NUM_STATES; ++s)
+            {
+                states_[s].generation = 0;
+                state_generation_[s] = 1;
+            }
+
+            for (size_t s = 0; s < NUM_SLOTS; ++s)
+            {
+                for (auto e = slots_[s].begin(); e != slots_[s].end(); ++e)
+                    e->generation = 0;
+
+                slot_generation_[s] = 1;
+            }
+
+            next_generation_ = 2;
+        }
+
+        return next_generation_;
+    }
+
+    void state_filter::invalidate()
+    {
+        const uint32_t generation = next_generation();
+
+        for (size_t s = 0; s < NUM_STATES; ++s)
+            state_generation_[s] = generation;
+
+        for (size_t s = 0; s < NUM_SLOTS; ++s)
+            slot_generation_[s] = generation;
+    }
+
+    void state_filter::invalidate(slots array)
+    {
+        slot_generation_[array] = next_generation();
+    }
+
+    bool state_filter::update(entry& e, uint32_t generation, const state_binding& binding)
+    {
+        if (e.generation == generation && detail::equal(e.binding, binding))
+            return false;
+
+        e.binding = binding;
+        e.generation = generation;
+
+        return true;
+    }
+
+    bool state_filter::set(state s, const state_binding& binding)
+    {
+        return update(states_[s], state_generation_[s], binding);
+    }
+
+    bool state_filter::set(slots array, size_t start, size_t count, const state_binding* bindings, size_t& first, size_t& changed)
+    {
+        std::vector<entry>& shadow = slots_[array];
+
+        first = start;
+        changed = count;
+
+        if (start + count > shadow.size())
+        {
+            assert(false);
+            return true;
+        }
+
+        const uint32_t generation = slot_generation_[array];
+
+        size_t lo = count, hi = 0;
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (update(shadow[start + i], generation, bindings[i]))
+            {
+                lo = std::min(lo, i);
+                hi = i + 1;
+            }
+        }
+
+        if (lo == count)
+            return false;
+
+        first = start + lo;
+        changed = hi - lo;
+
+        return true;
+    }
+}
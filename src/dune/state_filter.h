@@ -0,0 +1,159 @@
+/*
+ * Dune D3D library - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+/*! \file */
+
+#ifndef DUNE_STATE_FILTER
+#define DUNE_STATE_FILTER
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace dune
+{
+    /*!
+     * \brief Counters of the state changes of all state_cache objects.
+     *
+     * The counters are not synchronized and should only be touched by the rendering thread.
+     */
+    struct state_counters
+    {
+        size_t issued;      //!< the number of state changes passed on to a context
+        size_t dropped;     //!< the number of state changes dropped because they bound what was bound already
+    };
+
+    /*! \brief Returns the counters of all state changes since the last reset_state_stats(). */
+    state_counters& state_stats();
+
+    /*! \brief Reset the state counters, e.g. once per frame, and return their values before the reset. */
+    state_counters reset_state_stats();
+
+    /*! \brief The programmable stages a state_cache tracks. */
+    enum shader_stage
+    {
+        STAGE_VS,
+        STAGE_GS,
+        STAGE_PS,
+        STAGE_CS,
+        NUM_STAGES
+    };
+
+    /*!
+     * \brief An object bound to the pipeline together with the arguments of its binding.
+     *
+     * The arguments are e.g. the stride and offset of a vertex buffer or the blend factors and sample mask
+     * of a blend state. Unused arguments are zero.
+     */
+    struct state_binding
+    {
+        const void* object;
+        uint32_t args[5];
+    };
+
+    /*! \brief Returns a state_binding of an object with up to two arguments. */
+    inline state_binding make_binding(const void* object, uint32_t a = 0, uint32_t b = 0)
+    {
+        state_binding binding = { object, { a, b, 0, 0, 0 } };
+        return binding;
+    }
+
+    /*!
+     * \brief A shadow copy of the bindings of a pipeline which detects redundant state changes.
+     *
+     * Each single state (e.g. a shader) and each slot of a slot array (e.g. the shader resources of a stage) keeps
+     * the binding it was last set to. set() compares a new binding with it and returns whether the state change has
+     * to be passed on. For slot arrays it also narrows the range down to the slots which actually change.
+     *
+     * A state_filter starts out knowing nothing, so the first change of every state is passed on. invalidate()
+     * forgets everything, e.g. after someone else used the context. This only bumps a generation counter and is
+     * cheap enough to be done for every draw.
+     *
+     * This class knows nothing about D3D and is driven by a state_cache.
+     */
+    class state_filter
+    {
+    public:
+        /*! \brief Single states. */
+        enum state
+        {
+            VS,
+            GS,
+            PS,
+            CS,
+            INPUT_LAYOUT,
+            TOPOLOGY,
+            INDEX_BUFFER,
+            BLEND,
+            RASTERIZER,
+            DEPTH_STENCIL,
+            DEPTH_STENCIL_VIEW,
+            NUM_STATES
+        };
+
+        /*! \brief Slot arrays, with one array of resources, constant buffers and samplers per shader_stage. */
+        enum slots
+        {
+            RESOURCES       = 0,
+            CONSTANTS       = RESOURCES + NUM_STAGES,
+            SAMPLERS        = CONSTANTS + NUM_STAGES,
+            VERTEX_BUFFERS  = SAMPLERS + NUM_STAGES,
+            RENDER_TARGETS,
+            NUM_SLOTS
+        };
+
+    protected:
+        struct entry
+        {
+            state_binding binding;
+            uint32_t generation;    //!< the binding is known if this matches the generation of its state or slot array
+        };
+
+        entry                   states_[NUM_STATES];
+        std::vector<entry>      slots_[NUM_SLOTS];
+
+        uint32_t                state_generation_[NUM_STATES];
+        uint32_t                slot_generation_[NUM_SLOTS];
+        uint32_t                next_generation_;
+
+        uint32_t next_generation();
+        bool update(entry& e, uint32_t generation, const state_binding& binding);
+
+    public:
+        state_filter();
+        virtual ~state_filter() {}
+
+        /*! \brief Returns the number of slots of a slot array. */
+        static size_t size(slots array);
+
+        /*! \brief Returns the slot array s of a shader_stage, e.g. slots_of(RESOURCES, STAGE_PS). */
+        static slots slots_of(slots s, shader_stage stage) { return static_cast<slots>(s + stage); }
+
+        /*! \brief Forget all bindings. */
+        void invalidate();
+
+        /*! \brief Forget the bindings of a slot array. */
+        void invalidate(slots array);
+
+        /*! \brief Set a single state. Returns false if it is bound already. */
+        bool set(state s, const state_binding& binding);
+
+        /*!
+         * \brief Set a range of a slot array.
+         *
+         * \param array The slot array.
+         * \param start The first slot to set.
+         * \param count The number of slots to set.
+         * \param bindings count bindings for the slots start to start + count - 1.
+         * \param first The first slot of the range which changed.
+         * \param changed The number of slots of the range which changed.
+         * \return False if all slots are bound already.
+         */
+        bool set(slots array, size_t start, size_t count, const state_binding* bindings, size_t& first, size_t& changed);
+    };
+}
+
+#endif
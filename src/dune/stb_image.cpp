@@ -0,0 +1,12 @@
+/*
+ * Dune D3D library - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+// the implementation of stb_image, which is shared by the texture loaders and the CPU tools
+
+#ifdef _MSC_VER
+#pragma warning(disable: 4996)
+#endif
+#include "../ext/stb/stb_image.h"
@@ -6,6 +6,8 @@
 
 #include "summed_area_tables.h"
 
+#include <cmath>
+
 namespace dune
 {
     inline float summed_area_table::sum(int ax, int ay, int bx, int by, int cx, int cy, int dx, int dy) const
@@ -71,13 +73,13 @@ namespace dune
     {
         DirectX::XMFLOAT2 c;
 
-        sat_region A;
+        sat_region A = {};
 
         split_w(A);
-        c.x = static_cast<FLOAT>(A.x_ + (A.w_-1));
+        c.x = static_cast<float>(A.x_ + (A.w_-1));
 
         split_h(A);
-        c.y = static_cast<FLOAT>(A.y_ + (A.h_-1));
+        c.y = static_cast<float>(A.y_ + (A.h_-1));
 
         return c;
     }
@@ -102,7 +104,7 @@ namespace dune
         split(B, n-1, regions);
     }
 
-    void median_cut(const BYTE* rgba, size_t width, size_t height, size_t n, std::vector<sat_region>& regions, summed_area_table& img)
+    void median_cut(const unsigned char* rgba, size_t width, size_t height, size_t n, std::vector<sat_region>& regions, summed_area_table& img)
     {
         img.create_lum(rgba, width, height, 4);
 
@@ -116,7 +118,7 @@ namespace dune
         split(r, n, regions);
     }
 
-    void median_cut(const BYTE* rgba, size_t width, size_t height, size_t n, std::vector<environment_light>& lights)
+    void median_cut(const unsigned char* rgba, size_t width, size_t height, size_t n, std::vector<environment_light>& lights)
     {
         std::vector<sat_region> regions;
         regions.clear();
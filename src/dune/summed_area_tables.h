@@ -12,7 +12,6 @@
 #include <cassert>
 #include <vector>
 
-#include <D3D11.h>
 #include <DirectXMath.h>
 
 namespace dune
@@ -41,7 +40,7 @@ namespace dune
 
     public:
         //template<typename T>
-        void create_lum(const BYTE* rgb, size_t width, size_t height, int nc)
+        void create_lum(const unsigned char* rgb, size_t width, size_t height, int nc)
         {
             assert(nc > 2);
 
@@ -98,8 +97,8 @@ namespace dune
         DirectX::XMFLOAT2 centroid() const;
     };
 
-    void median_cut(const BYTE* rgba, size_t width, size_t height, size_t n, std::vector<sat_region>& regions, summed_area_table& img);
-    void median_cut(const BYTE* rgba, size_t width, size_t height, size_t n, std::vector<environment_light>& lights);
+    void median_cut(const unsigned char* rgba, size_t width, size_t height, size_t n, std::vector<sat_region>& regions, summed_area_table& img);
+    void median_cut(const unsigned char* rgba, size_t width, size_t height, size_t n, std::vector<environment_light>& lights);
 }
 
 #endif
@@ -12,6 +12,7 @@
 #include "d3d_tools.h"
 
 #pragma warning(disable: 4996)
+#define STBI_HEADER_FILE_ONLY
 #include "../ext/stb/stb_image.h"
 #include "../ext/dds/DDSTextureLoader.h"
 
@@ -19,6 +20,7 @@
 #include "unicode.h"
 #include "exception.h"
 #include "common_tools.h"
+#include "frame_profiler.h"
 
 namespace dune
 {
@@ -261,6 +263,8 @@ namespace dune
         if (srv(filename) != 0)
             return;
 
+        DUNE_PROFILE_ZONE("Load texture");
+
         // load texture
         ID3D11ShaderResourceView* srv;
         detail::texture_from_file(device, make_absolute_path(filename).c_str(), &srv);
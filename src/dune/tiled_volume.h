@@ -0,0 +1,314 @@
+/*
+ * Dune D3D library - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+/*! \file */
+
+#ifndef DUNE_TILED_VOLUME
+#define DUNE_TILED_VOLUME
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+#include "math_tools.h"
+#include "parallel_tools.h"
+
+namespace dune
+{
+    /*! \brief The order in which the texels of a tiled_volume are stored. */
+    enum volume_layout
+    {
+        /*! \brief x fastest, then y, then z, like a Texture3D upload. */
+        LAYOUT_LINEAR,
+        /*! \brief The Z-order curve of morton_encode(). */
+        LAYOUT_MORTON,
+        /*! \brief Bricks of 8^3 texels in linear order, each brick stored linearly. */
+        LAYOUT_BRICKED
+    };
+
+    /*!
+     * \brief A cubic CPU volume with a selectable memory layout.
+     *
+     * Propagation, filtering and cone marching read the 3D neighbourhood of a texel. In linear order, neighbours
+     * along y and z are a row or a slice apart, so a kernel touches many cache lines and pages per texel. The
+     * Morton and bricked layouts keep texels which are close in 3D close in memory. In Morton order, the 2x2x2
+     * children of a texel are even stored consecutively.
+     *
+     * Texels are addressed with a cursor, which steps to neighbours without recomputing the full index: by
+     * adding a stride in linear order and inside a brick, and with dilated integer arithmetic in Morton order.
+     * from_linear() and to_linear() convert for uploads with write_texture() and readbacks with read_texture().
+     *
+     * The resolution must be a power of two for the Morton layout, and a power of two of at least 8 for the
+     * bricked layout.
+     */
+    template<typename T>
+    class tiled_volume
+    {
+    public:
+        /*! \brief The edge length of a brick in the bricked layout. */
+        static const uint32_t BRICK_SIZE = 8;
+
+        /*!
+         * \brief A position in a tiled_volume.
+         *
+         * A cursor caches the index of its texel. Neighbours must be inside the volume, which is checked with
+         * has_neighbour().
+         */
+        class cursor
+        {
+            friend class tiled_volume;
+
+        protected:
+            const tiled_volume* volume_;
+            uint32_t            pos_[3];
+            size_t              index_;
+
+        public:
+            cursor() : volume_(nullptr), index_(0) { pos_[0] = pos_[1] = pos_[2] = 0; }
+
+            uint32_t x() const { return pos_[0]; }
+            uint32_t y() const { return pos_[1]; }
+            uint32_t z() const { return pos_[2]; }
+
+            /*! \brief Returns the index of the texel in tiled_volume::data(). */
+            size_t index() const { return index_; }
+
+            /*! \brief Returns true if the neighbour one texel away along an axis (0 to 2) in a direction (-1 or 1) is inside the volume. */
+            bool has_neighbour(size_t axis, int dir) const
+            {
+                return dir > 0 ? pos_[axis] + 1 < volume_->resolution_ : pos_[axis] > 0;
+            }
+
+            /*! \brief Returns the index of the neighbour one texel away along an axis (0 to 2) in a direction (-1 or 1). */
+            size_t neighbour(size_t axis, int dir) const
+            {
+                return volume_->step(index_, pos_[axis], axis, dir);
+            }
+
+            /*! \brief Move to the neighbour one texel away along an axis (0 to 2) in a direction (-1 or 1). */
+            void step(size_t axis, int dir)
+            {
+                index_ = neighbour(axis, dir);
+                pos_[axis] += dir;
+            }
+        };
+
+    protected:
+        volume_layout       layout_;
+        uint32_t            resolution_;
+        uint32_t            brick_shift_;
+        std::vector<T>      data_;
+
+        size_t step(size_t index, uint32_t pos, size_t axis, int dir) const
+        {
+            switch (layout_)
+            {
+            case LAYOUT_MORTON:
+            {
+                // add or subtract one to the bits of one axis only
+                const uint64_t mask = 0x1249249249249249ull << axis;
+                const uint64_t code = static_cast<uint64_t>(index);
+                const uint64_t moved = dir > 0 ? ((code | ~mask) + 1) & mask : ((code & mask) - 1) & mask;
+                return static_cast<size_t>(moved | (code & ~mask));
+            }
+
+            case LAYOUT_BRICKED:
+            {
+                const size_t local = static_cast<size_t>(1) << (3 * axis);
+                const uint32_t p = pos & (BRICK_SIZE - 1);
+
+                if (dir > 0 ? p < BRICK_SIZE - 1 : p > 0)
+                    return dir > 0 ? index + local : index - local;
+
+                // cross into the neighbouring brick, at the opposite border
+                const size_t brick = static_cast<size_t>(BRICK_SIZE * BRICK_SIZE * BRICK_SIZE) << (brick_shift_ * axis);
+
+                return dir > 0 ? index + brick - (BRICK_SIZE - 1) * local : index - brick + (BRICK_SIZE - 1) * local;
+            }
+
+            default:
+            {
+                size_t stride = 1;
+                for (size_t a = 0; a < axis; ++a)
+                    stride *= resolution_;
+
+                return dir > 0 ? index + stride : index - stride;
+            }
+            }
+        }
+
+    public:
+        tiled_volume() :
+            layout_(LAYOUT_LINEAR),
+            resolution_(0),
+            brick_shift_(0)
+        {
+        }
+
+        virtual ~tiled_volume() {}
+
+        /*!
+         * \brief Create a volume.
+         *
+         * \param resolution The number of texels along each axis.
+         * \param layout The order of the texels in memory.
+         * \param value The value all texels are initialized with.
+         */
+        void create(uint32_t resolution, volume_layout layout, const T& value = T())
+        {
+            assert(layout == LAYOUT_LINEAR || (resolution & (resolution - 1)) == 0);
+            assert(layout != LAYOUT_BRICKED || resolution >= BRICK_SIZE);
+
+            layout_ = layout;
+            resolution_ = resolution;
+            brick_shift_ = 0;
+
+            if (layout == LAYOUT_BRICKED)
+                while ((BRICK_SIZE << brick_shift_) < resolution)
+                    ++brick_shift_;
+
+            data_.assign(static_cast<size_t>(resolution) * resolution * resolution, value);
+        }
+
+        void destroy()
+        {
+            resolution_ = 0;
+            brick_shift_ = 0;
+
+            data_.clear();
+            data_.shrink_to_fit();
+        }
+
+        volume_layout layout() const { return layout_; }
+        uint32_t resolution() const { return resolution_; }
+
+        //!@{
+        /*! \brief Returns the texels in the order of layout(). */
+        std::vector<T>& data() { return data_; }
+        const std::vector<T>& data() const { return data_; }
+        //!@}
+
+        /*! \brief Returns the index of the texel at a coordinate in data(). */
+        size_t index(uint32_t x, uint32_t y, uint32_t z) const
+        {
+            switch (layout_)
+            {
+            case LAYOUT_MORTON:
+                return static_cast<size_t>(morton_encode(x, y, z));
+
+            case LAYOUT_BRICKED:
+            {
+                const uint32_t m = BRICK_SIZE - 1;
+                size_t brick = (((static_cast<size_t>(z >> 3) << brick_shift_) | (y >> 3)) << brick_shift_) | (x >> 3);
+                return brick << 9 | (z & m) << 6 | (y & m) << 3 | (x & m);
+            }
+
+            default:
+                return (static_cast<size_t>(z) * resolution_ + y) * resolution_ + x;
+            }
+        }
+
+        /*! \brief Returns the coordinate of an index in data(). */
+        void coordinate(size_t index, uint32_t& x, uint32_t& y, uint32_t& z) const
+        {
+            switch (layout_)
+            {
+            case LAYOUT_MORTON:
+                morton_decode(index, x, y, z);
+                break;
+
+            case LAYOUT_BRICKED:
+            {
+                const size_t m = BRICK_SIZE - 1, bm = (static_cast<size_t>(1) << brick_shift_) - 1;
+                size_t brick = index >> 9;
+
+                x = static_cast<uint32_t>((brick & bm) << 3 | (index & m));
+                y = static_cast<uint32_t>((brick >> brick_shift_ & bm) << 3 | (index >> 3 & m));
+                z = static_cast<uint32_t>((brick >> 2 * brick_shift_) << 3 | (index >> 6 & m));
+                break;
+            }
+
+            default:
+                x = static_cast<uint32_t>(index % resolution_);
+                y = static_cast<uint32_t>(index / resolution_ % resolution_);
+                z = static_cast<uint32_t>(index / resolution_ / resolution_);
+            }
+        }
+
+        //!@{
+        /*! \brief Returns a cursor at a coordinate or an index in data(). */
+        cursor at(uint32_t x, uint32_t y, uint32_t z) const
+        {
+            cursor c;
+            c.volume_ = this;
+            c.pos_[0] = x;
+            c.pos_[1] = y;
+            c.pos_[2] = z;
+            c.index_ = index(x, y, z);
+            return c;
+        }
+
+        cursor at(size_t i) const
+        {
+            cursor c;
+            c.volume_ = this;
+            c.index_ = i;
+            coordinate(i, c.pos_[0], c.pos_[1], c.pos_[2]);
+            return c;
+        }
+        //!@}
+
+        //!@{
+        /*! \brief Returns the texel at a coordinate. */
+        T& operator()(uint32_t x, uint32_t y, uint32_t z) { return data_[index(x, y, z)]; }
+        const T& operator()(uint32_t x, uint32_t y, uint32_t z) const { return data_[index(x, y, z)]; }
+        //!@}
+
+        //!@{
+        /*! \brief Returns the texel of a cursor. */
+        T& operator[](const cursor& c) { return data_[c.index()]; }
+        const T& operator[](const cursor& c) const { return data_[c.index()]; }
+        //!@}
+
+        /*! \brief Copy texels in linear order, x fastest, then y, then z, into this volume. */
+        void from_linear(const std::vector<T>& src)
+        {
+            assert(src.size() == data_.size());
+
+            parallel_for(0, resolution_, [&](size_t first, size_t last)
+            {
+                for (uint32_t z = static_cast<uint32_t>(first); z < last; ++z)
+                for (uint32_t y = 0; y < resolution_; ++y)
+                {
+                    size_t row = (static_cast<size_t>(z) * resolution_ + y) * resolution_;
+
+                    for (uint32_t x = 0; x < resolution_; ++x)
+                        data_[index(x, y, z)] = src[row + x];
+                }
+            });
+        }
+
+        /*! \brief Copy the texels of this volume in linear order, x fastest, then y, then z. */
+        void to_linear(std::vector<T>& dst) const
+        {
+            dst.resize(data_.size());
+
+            parallel_for(0, resolution_, [&](size_t first, size_t last)
+            {
+                for (uint32_t z = static_cast<uint32_t>(first); z < last; ++z)
+                for (uint32_t y = 0; y < resolution_; ++y)
+                {
+                    size_t row = (static_cast<size_t>(z) * resolution_ + y) * resolution_;
+
+                    for (uint32_t x = 0; x < resolution_; ++x)
+                        dst[row + x] = data_[index(x, y, z)];
+                }
+            });
+        }
+    };
+}
+
+#endif
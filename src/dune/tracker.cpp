@@ -12,6 +12,7 @@
 
 #include "exception.h"
 #include "common_tools.h"
+#include "frame_profiler.h"
 
 namespace dune
 {
@@ -374,13 +375,11 @@ namespace dune
 
     void tracker::track_frame(render_target& frame)
     {
-        int64 start = cvGetTickCount();
+        profile_zone zone("Track frame");
 
         detail::detect(frame, cam_intrinsic_, cam_distortion_, patterns_, detected_);
 
-        int64 end = cvGetTickCount();
-
-        time_track_ = static_cast<float>(end - start) / static_cast<float>(cvGetTickFrequency() * 1000);
+        time_track_ = zone.elapsed_ms();
     }
 
     size_t tracker::load_pattern(const tstring& filename)
@@ -0,0 +1,245 @@
+/*
+ * Dune D3D library - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+#include "voxel_clipmap.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+namespace dune
+{
+    namespace detail
+    {
+        inline size_t region_voxels(const clipmap_region& r)
+        {
+            return static_cast<size_t>(r.max[0] - r.min[0]) * static_cast<size_t>(r.max[1] - r.min[1]) * static_cast<size_t>(r.max[2] - r.min[2]);
+        }
+    }
+
+    voxel_clipmap::voxel_clipmap() :
+        resolution_(0),
+        voxel_size_(1.f),
+        budget_(0)
+    {
+        std::memset(&stats_, 0, sizeof(stats_));
+    }
+
+    void voxel_clipmap::create(size_t levels, uint32_t resolution, float voxel_size)
+    {
+        destroy();
+
+        assert(resolution > 0 && resolution % 2 == 0);
+
+        resolution_ = resolution;
+        voxel_size_ = voxel_size;
+
+        level_state empty;
+        std::memset(&empty, 0, sizeof(empty));
+
+        levels_.assign(levels, empty);
+    }
+
+    void voxel_clipmap::destroy()
+    {
+        resolution_ = 0;
+
+        levels_.clear();
+        regions_.clear();
+
+        std::memset(&stats_, 0, sizeof(stats_));
+    }
+
+    void voxel_clipmap::invalidate()
+    {
+        for (auto l = levels_.begin(); l != levels_.end(); ++l)
+            l->valid = false;
+    }
+
+    void voxel_clipmap::exposed_slabs(size_t level, const int32_t old_origin[3], const int32_t new_origin[3], std::vector<clipmap_region>& slabs) const
+    {
+        const int32_t r = static_cast<int32_t>(resolution_);
+
+        // the part of the new window along the axes already handled which was exposed there, so slabs don't overlap
+        int32_t lo[3], hi[3];
+
+        for (size_t a = 0; a < 3; ++a)
+        {
+            lo[a] = new_origin[a];
+            hi[a] = new_origin[a] + r;
+        }
+
+        for (size_t a = 0; a < 3; ++a)
+        {
+            const int32_t o = old_origin[a], n = new_origin[a];
+
+            if (o == n)
+                continue;
+
+            clipmap_region slab;
+            slab.level = level;
+
+            for (size_t b = 0; b < 3; ++b)
+            {
+                slab.min[b] = lo[b];
+                slab.max[b] = hi[b];
+            }
+
+            // the voxels of the new window beyond the old one along this axis
+            slab.min[a] = n > o ? o + r : n;
+            slab.max[a] = n > o ? n + r : o;
+
+            slabs.push_back(slab);
+
+            // the remaining slabs only cover the overlap along this axis
+            lo[a] = std::max(o, n);
+            hi[a] = std::min(o, n) + r;
+        }
+    }
+
+    void voxel_clipmap::update(const DirectX::XMFLOAT3& camera_pos)
+    {
+        regions_.clear();
+        std::memset(&stats_, 0, sizeof(stats_));
+
+        const int32_t r = static_cast<int32_t>(resolution_);
+        const float camera[3] = { camera_pos.x, camera_pos.y, camera_pos.z };
+
+        std::vector<clipmap_region> slabs;
+
+        bool coarser_moved = false;
+
+        for (size_t l = 0; l < levels_.size(); ++l)
+        {
+            level_state& s = levels_[l];
+
+            // snap to the voxels of the next coarser level
+            const float snap = 2.f * voxel_size(l);
+
+            int32_t origin[3];
+
+            for (size_t a = 0; a < 3; ++a)
+                origin[a] = static_cast<int32_t>(std::floor(camera[a] / snap)) * 2 - r / 2;
+
+            if (s.valid && std::memcmp(origin, s.origin, sizeof(origin)) == 0)
+                continue;
+
+            slabs.clear();
+
+            bool full = !s.valid;
+
+            for (size_t a = 0; a < 3; ++a)
+                full = full || std::abs(origin[a] - s.origin[a]) >= r;
+
+            if (full)
+            {
+                clipmap_region all = { l, { origin[0], origin[1], origin[2] }, { origin[0] + r, origin[1] + r, origin[2] + r } };
+                slabs.push_back(all);
+            }
+            else
+                exposed_slabs(l, s.origin, origin, slabs);
+
+            size_t voxels = 0;
+
+            for (auto slab = slabs.begin(); slab != slabs.end(); ++slab)
+                voxels += detail::region_voxels(*slab);
+
+            // finer levels come first, coarser ones wait for an update with enough budget, but one always moves so none starves
+            if (budget_ > 0 && l > 0 && coarser_moved && stats_.voxels + voxels > budget_)
+            {
+                ++stats_.levels_deferred;
+                continue;
+            }
+
+            coarser_moved = coarser_moved || l > 0;
+
+            regions_.insert(regions_.end(), slabs.begin(), slabs.end());
+
+            std::memcpy(s.origin, origin, sizeof(origin));
+            s.valid = true;
+
+            ++stats_.levels_moved;
+            stats_.voxels += voxels;
+            stats_.voxels_full += static_cast<size_t>(resolution_) * resolution_ * resolution_;
+        }
+    }
+
+    void voxel_clipmap::bounds(size_t level, DirectX::XMFLOAT3& bb_min, DirectX::XMFLOAT3& bb_max) const
+    {
+        const float vs = voxel_size(level);
+        const int32_t* o = levels_[level].origin;
+        const int32_t r = static_cast<int32_t>(resolution_);
+
+        bb_min = DirectX::XMFLOAT3(o[0] * vs, o[1] * vs, o[2] * vs);
+        bb_max = DirectX::XMFLOAT3((o[0] + r) * vs, (o[1] + r) * vs, (o[2] + r) * vs);
+    }
+
+    DirectX::XMFLOAT4X4 voxel_clipmap::world_to_svo(size_t level) const
+    {
+        const float s = 1.f / (voxel_size(level) * static_cast<float>(resolution_));
+
+        DirectX::XMFLOAT4X4 m;
+        DirectX::XMStoreFloat4x4(&m, DirectX::XMMatrixScaling(s, s, s));
+        return m;
+    }
+
+    DirectX::XMFLOAT4X4 voxel_clipmap::world_to_window(size_t level) const
+    {
+        DirectX::XMFLOAT3 bb_min, bb_max;
+        bounds(level, bb_min, bb_max);
+
+        const float s = 1.f / (voxel_size(level) * static_cast<float>(resolution_));
+
+        DirectX::XMFLOAT4X4 m;
+        DirectX::XMStoreFloat4x4(&m, DirectX::XMMatrixTranslation(-bb_min.x, -bb_min.y, -bb_min.z) * DirectX::XMMatrixScaling(s, s, s));
+        return m;
+    }
+
+    void voxel_clipmap::texture_boxes(const clipmap_region& region, std::vector<voxel_box>& boxes) const
+    {
+        // up to two ranges of texels per axis
+        uint32_t ranges[3][2][2];
+        size_t num_ranges[3];
+
+        for (size_t a = 0; a < 3; ++a)
+        {
+            const uint32_t first = texel(region.min[a]);
+            const uint32_t length = static_cast<uint32_t>(region.max[a] - region.min[a]);
+
+            assert(length <= resolution_);
+
+            if (first + length <= resolution_)
+            {
+                ranges[a][0][0] = first;
+                ranges[a][0][1] = first + length;
+                num_ranges[a] = 1;
+            }
+            else
+            {
+                ranges[a][0][0] = first;
+                ranges[a][0][1] = resolution_;
+                ranges[a][1][0] = 0;
+                ranges[a][1][1] = first + length - resolution_;
+                num_ranges[a] = 2;
+            }
+        }
+
+        for (size_t z = 0; z < num_ranges[2]; ++z)
+        for (size_t y = 0; y < num_ranges[1]; ++y)
+        for (size_t x = 0; x < num_ranges[0]; ++x)
+        {
+            voxel_box box =
+            {
+                { ranges[0][x][0], ranges[1][y][0], ranges[2][z][0] },
+                { ranges[0][x][1], ranges[1][y][1], ranges[2][z][1] }
+            };
+
+            boxes.push_back(box);
+        }
+    }
+}
@@ -0,0 +1,147 @@
+/*
+ * Dune D3D library - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+/*! \file */
+
+#ifndef DUNE_VOXEL_CLIPMAP
+#define DUNE_VOXEL_CLIPMAP
+
+#include <cstdint>
+#include <vector>
+
+#include <DirectXMath.h>
+
+#include "voxel_ownership.h"
+
+namespace dune
+{
+    /*! \brief A box [min, max) of voxels of a clipmap level to revoxelize, in voxel coordinates of the level, i.e. world / voxel_size. */
+    struct clipmap_region
+    {
+        size_t  level;
+        int32_t min[3];
+        int32_t max[3];
+    };
+
+    /*! \brief Counters of the work of the last voxel_clipmap::update(). */
+    struct clipmap_stats
+    {
+        size_t levels_moved;
+        size_t levels_deferred;
+        size_t voxels;
+
+        /*! \brief The number of voxels a revoxelization of all moved levels would have touched. */
+        size_t voxels_full;
+    };
+
+    /*!
+     * \brief The placement of a camera-centered voxel clipmap.
+     *
+     * A single volume stretched over the bounding box of a large scene has huge voxels. A clipmap instead has several
+     * levels of resolution^3 voxels each, where the voxels of level i are 2^i times the size of level 0. All levels
+     * are centered on the camera, so detail is highest where the camera is.
+     *
+     * Levels are addressed toroidally: the voxel at voxel coordinate v of a level is stored at texel v mod resolution,
+     * so the texture coordinate of a world position is simply world / (voxel_size * resolution), sampled with a
+     * wrapping sampler. When the camera moves, a level only slides its window. The voxels which stay inside keep their
+     * texels, and only the slabs of newly exposed voxels have to be cleared and voxelized, which update() returns
+     * as regions(). texture_boxes() splits them at the wrap-around into boxes of texels.
+     *
+     * Windows snap to multiples of two voxels, i.e. to the voxels of the next coarser level, so the levels nest.
+     * With a budget, finer levels are updated first and a coarser level which doesn't fit keeps its old window
+     * until a later update(). At least one coarser level moves per update(), so a pending level is eventually served.
+     */
+    class voxel_clipmap
+    {
+    protected:
+        struct level_state
+        {
+            int32_t origin[3];
+            bool    valid;
+        };
+
+        uint32_t                        resolution_;
+        float                           voxel_size_;
+        size_t                          budget_;
+
+        std::vector<level_state>        levels_;
+        std::vector<clipmap_region>     regions_;
+        clipmap_stats                   stats_;
+
+    protected:
+        void exposed_slabs(size_t level, const int32_t old_origin[3], const int32_t new_origin[3], std::vector<clipmap_region>& slabs) const;
+
+    public:
+        voxel_clipmap();
+        virtual ~voxel_clipmap() {}
+
+        /*!
+         * \brief Create a clipmap.
+         *
+         * \param levels The number of levels.
+         * \param resolution The number of voxels along each axis of a level, an even number.
+         * \param voxel_size The edge length of a voxel of level 0 in world units.
+         */
+        void create(size_t levels, uint32_t resolution, float voxel_size);
+        void destroy();
+
+        size_t num_levels() const { return levels_.size(); }
+        uint32_t resolution() const { return resolution_; }
+
+        /*! \brief Returns the edge length of a voxel of a level in world units. */
+        float voxel_size(size_t level) const { return voxel_size_ * static_cast<float>(1u << level); }
+
+        /*!
+         * \brief Set the maximum number of voxels update() schedules, where zero is unlimited.
+         *
+         * Level 0 and the finest coarser level which moves are always updated, so the budget may be exceeded.
+         */
+        void set_budget(size_t voxels) { budget_ = voxels; }
+
+        /*! \brief Revoxelize all levels in the next update(). */
+        void invalidate();
+
+        /*! \brief Center all levels on a camera and compute the regions to revoxelize. */
+        void update(const DirectX::XMFLOAT3& camera_pos);
+
+        /*! \brief Returns the regions to clear and voxelize after the last update(), finest level first. */
+        const std::vector<clipmap_region>& regions() const { return regions_; }
+
+        const clipmap_stats& stats() const { return stats_; }
+
+        /*! \brief Returns true if a level has been voxelized, i.e. it wasn't deferred since its creation or invalidate(). */
+        bool valid(size_t level) const { return levels_[level].valid; }
+
+        /*! \brief Returns the voxel coordinates of the first voxel of the window of a level. */
+        const int32_t* origin(size_t level) const { return levels_[level].origin; }
+
+        /*! \brief Returns the world space bounding box of the window of a level. */
+        void bounds(size_t level, DirectX::XMFLOAT3& bb_min, DirectX::XMFLOAT3& bb_max) const;
+
+        /*!
+         * \brief Returns the transformation of a level from world space to toroidal texture coordinates.
+         *
+         * This is the world_to_svo of a level, with the convention of sparse_voxel_octree::world_to_svo(). It is only
+         * valid inside bounds(), and texture coordinates must wrap.
+         */
+        DirectX::XMFLOAT4X4 world_to_svo(size_t level) const;
+
+        /*! \brief Returns the transformation of a level from world space to [0, 1] over its window, which voxelization renders with. */
+        DirectX::XMFLOAT4X4 world_to_window(size_t level) const;
+
+        /*! \brief Returns the texel a voxel coordinate is stored at along an axis. */
+        uint32_t texel(int32_t v) const
+        {
+            const int32_t r = static_cast<int32_t>(resolution_);
+            return static_cast<uint32_t>(((v % r) + r) % r);
+        }
+
+        /*! \brief Split a region at the wrap-around of the toroidal addressing into up to eight boxes of texels. */
+        void texture_boxes(const clipmap_region& region, std::vector<voxel_box>& boxes) const;
+    };
+}
+
+#endif
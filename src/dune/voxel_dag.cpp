@@ -0,0 +1,436 @@
+/*
+ * Dune D3D library - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+#include "voxel_dag.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <utility>
+
+#include "parallel_tools.h"
+
+namespace dune
+{
+    namespace detail
+    {
+        // a node of one level during merging: its child mask and the merged ids of its children
+        struct dag_key
+        {
+            uint32_t mask;
+            uint32_t children[8];
+        };
+
+        inline uint32_t popcount8(uint32_t mask)
+        {
+            mask = (mask & 0x55) + ((mask >> 1) & 0x55);
+            mask = (mask & 0x33) + ((mask >> 2) & 0x33);
+            return (mask & 0x0f) + (mask >> 4);
+        }
+
+        // FNV-1a over the words of a key
+        inline uint64_t hash_key(const dag_key& k)
+        {
+            uint64_t h = 14695981039346656037ull;
+
+            h = (h ^ k.mask) * 1099511628211ull;
+
+            for (size_t i = 0; i < 8; ++i)
+                h = (h ^ k.children[i]) * 1099511628211ull;
+
+            return h;
+        }
+    }
+
+    voxel_dag::voxel_dag() :
+        resolution_(0),
+        levels_(0),
+        nodes_(),
+        num_nodes_(0),
+        num_octree_nodes_(0),
+        palette_(),
+        attributes_(),
+        mip_offsets_(),
+        index_bits_(1)
+    {
+    }
+
+    void voxel_dag::create(const voxel_octree& svo)
+    {
+        destroy();
+
+        resolution_ = svo.resolution();
+        levels_ = svo.num_mips();
+
+        const std::vector<voxel_octree::node>& tree = svo.nodes();
+
+        if (levels_ == 0 || svo.num_voxels() == 0)
+        {
+            nodes_.assign(1, 0);
+            num_nodes_ = 1;
+            mip_offsets_.assign(levels_ + 1, 0);
+            return;
+        }
+
+        // the occupied nodes of each depth in depth-first order, their child masks and the index of their first child
+        std::vector<std::vector<uint32_t>> octree_nodes(levels_);
+        std::vector<std::vector<uint8_t>> masks(levels_);
+        std::vector<std::vector<uint32_t>> first_child(levels_);
+
+        octree_nodes[0].assign(1, 0);
+
+        for (size_t d = 0; d < levels_; ++d)
+        {
+            const std::vector<uint32_t>& level = octree_nodes[d];
+
+            masks[d].resize(level.size());
+            first_child[d].resize(level.size() + 1);
+
+            parallel_for(0, level.size(), [&](size_t first, size_t last)
+            {
+                for (size_t i = first; i < last; ++i)
+                {
+                    const voxel_octree::node& n = tree[level[i]];
+
+                    uint8_t mask = 0;
+
+                    for (uint32_t o = 0; o < 8; ++o)
+                    {
+                        // the lowest nodes have no children, only the voxels of mip 0 in their bricks
+                        bool occupied = n.children != 0 ? tree[n.children + o].brick != voxel_octree::EMPTY : svo.load(n.brick, o).normal.w > 0.f;
+
+                        if (occupied)
+                            mask |= static_cast<uint8_t>(1 << o);
+                    }
+
+                    masks[d][i] = mask;
+                }
+            });
+
+            first_child[d][0] = 0;
+
+            for (size_t i = 0; i < level.size(); ++i)
+                first_child[d][i + 1] = first_child[d][i] + detail::popcount8(masks[d][i]);
+
+            if (d + 1 == levels_)
+                break;
+
+            std::vector<uint32_t>& children = octree_nodes[d + 1];
+            children.resize(first_child[d].back());
+
+            parallel_for(0, level.size(), [&](size_t first, size_t last)
+            {
+                for (size_t i = first; i < last; ++i)
+                {
+                    uint32_t c = first_child[d][i];
+
+                    for (uint32_t o = 0; o < 8; ++o)
+                        if (masks[d][i] & (1 << o))
+                            children[c++] = tree[level[i]].children + o;
+                }
+            });
+        }
+
+        // merge bottom-up: the id of each node in its level, and one representative octree node per id
+        std::vector<std::vector<uint32_t>> ids(levels_);
+        std::vector<std::vector<uint32_t>> unique(levels_);
+
+        for (size_t d = levels_; d-- > 0;)
+        {
+            const size_t n = octree_nodes[d].size();
+
+            std::vector<detail::dag_key> keys(n);
+            std::vector<std::pair<uint64_t, uint32_t>> order(n);
+
+            parallel_for(0, n, [&](size_t first, size_t last)
+            {
+                for (size_t i = first; i < last; ++i)
+                {
+                    detail::dag_key& k = keys[i];
+                    k.mask = masks[d][i];
+
+                    uint32_t c = first_child[d][i];
+
+                    for (uint32_t o = 0; o < 8; ++o)
+                        k.children[o] = (k.mask & (1 << o)) && d + 1 < levels_ ? ids[d + 1][c++] : voxel_octree::EMPTY;
+
+                    order[i] = std::make_pair(detail::hash_key(k), static_cast<uint32_t>(i));
+                }
+            });
+
+            // equal keys have equal hashes, ties are broken by the key so that equal keys end up next to each other
+            parallel_sort(order.begin(), order.end(), [&](const std::pair<uint64_t, uint32_t>& a, const std::pair<uint64_t, uint32_t>& b)
+            {
+                if (a.first != b.first)
+                    return a.first < b.first;
+
+                return std::memcmp(&keys[a.second], &keys[b.second], sizeof(detail::dag_key)) < 0;
+            });
+
+            ids[d].resize(n);
+
+            for (size_t i = 0; i < n; ++i)
+            {
+                const uint32_t node = order[i].second;
+
+                if (i == 0 || order[i].first != order[i - 1].first || std::memcmp(&keys[node], &keys[order[i - 1].second], sizeof(detail::dag_key)) != 0)
+                    unique[d].push_back(node);
+
+                ids[d][node] = static_cast<uint32_t>(unique[d].size() - 1);
+            }
+        }
+
+        // the number of voxels of each unique subtree at depths 2 and below, depth 1 being the child mask
+        std::vector<std::vector<uint32_t>> counts(levels_);
+
+        for (size_t d = levels_; d-- > 0;)
+        {
+            const size_t height = levels_ - d;
+
+            counts[d].resize(unique[d].size() * (height - 1));
+
+            if (height == 1)
+                continue;
+
+            parallel_for(0, unique[d].size(), [&](size_t first, size_t last)
+            {
+                for (size_t u = first; u < last; ++u)
+                {
+                    const uint32_t node = unique[d][u];
+                    uint32_t* out = &counts[d][u * (height - 1)];
+
+                    std::fill(out, out + height - 1, 0);
+
+                    for (uint32_t c = first_child[d][node]; c < first_child[d][node + 1]; ++c)
+                    {
+                        const uint32_t child = ids[d + 1][c];
+
+                        out[0] += detail::popcount8(masks[d + 1][unique[d + 1][child]]);
+
+                        for (size_t k = 1; k + 1 < height; ++k)
+                            out[k] += counts[d + 1][child * (height - 2) + k - 1];
+                    }
+                }
+            });
+        }
+
+        // pool offsets of the unique nodes, root first
+        std::vector<std::vector<uint32_t>> offsets(levels_);
+        size_t pool_size = 0;
+
+        for (size_t d = 0; d < levels_; ++d)
+        {
+            const size_t height = levels_ - d;
+
+            offsets[d].resize(unique[d].size());
+
+            for (size_t u = 0; u < unique[d].size(); ++u)
+            {
+                offsets[d][u] = static_cast<uint32_t>(pool_size);
+                pool_size += height + (height > 1 ? detail::popcount8(masks[d][unique[d][u]]) : 0);
+            }
+
+            num_nodes_ += unique[d].size();
+            num_octree_nodes_ += octree_nodes[d].size();
+        }
+
+        nodes_.resize(pool_size);
+
+        for (size_t d = 0; d < levels_; ++d)
+        {
+            const size_t height = levels_ - d;
+
+            parallel_for(0, unique[d].size(), [&](size_t first, size_t last)
+            {
+                for (size_t u = first; u < last; ++u)
+                {
+                    const uint32_t node = unique[d][u];
+                    uint32_t* out = &nodes_[offsets[d][u]];
+
+                    *out++ = masks[d][node];
+
+                    if (height == 1)
+                        continue;
+
+                    out = std::copy(counts[d].begin() + u * (height - 1), counts[d].begin() + (u + 1) * (height - 1), out);
+
+                    for (uint32_t c = first_child[d][node]; c < first_child[d][node + 1]; ++c)
+                        *out++ = offsets[d + 1][ids[d + 1][c]];
+                }
+            });
+        }
+
+        // the voxels of mip m are the children of the nodes at depth levels_ - m - 1, in depth-first order
+        mip_offsets_.assign(levels_ + 1, 0);
+
+        for (size_t m = 0; m < levels_; ++m)
+            mip_offsets_[m + 1] = mip_offsets_[m] + first_child[levels_ - m - 1].back();
+
+        std::vector<palette_voxel> values(mip_offsets_[levels_]);
+
+        for (size_t m = 0; m < levels_; ++m)
+        {
+            const size_t d = levels_ - m - 1;
+
+            parallel_for(0, octree_nodes[d].size(), [&](size_t first, size_t last)
+            {
+                for (size_t i = first; i < last; ++i)
+                {
+                    size_t v = mip_offsets_[m] + first_child[d][i];
+
+                    for (uint32_t o = 0; o < 8; ++o)
+                    {
+                        if (!(masks[d][i] & (1 << o)))
+                            continue;
+
+                        const voxel x = svo.load(tree[octree_nodes[d][i]].brick, o);
+
+                        palette_voxel& p = values[v++];
+                        DirectX::PackedVector::XMStoreHalf4(&p.normal, DirectX::XMLoadFloat4(&x.normal));
+                        DirectX::PackedVector::XMStoreHalf4(&p.color, DirectX::XMLoadFloat4(&x.color));
+                    }
+                }
+            });
+        }
+
+        auto less = [](const palette_voxel& a, const palette_voxel& b)
+        {
+            return std::memcmp(&a, &b, sizeof(palette_voxel)) < 0;
+        };
+
+        palette_ = values;
+        parallel_sort(palette_.begin(), palette_.end(), less);
+
+        palette_.erase(std::unique(palette_.begin(), palette_.end(), [](const palette_voxel& a, const palette_voxel& b)
+        {
+            return std::memcmp(&a, &b, sizeof(palette_voxel)) == 0;
+        }), palette_.end());
+
+        palette_.shrink_to_fit();
+
+        while ((static_cast<size_t>(1) << index_bits_) < palette_.size())
+            ++index_bits_;
+
+        std::vector<uint32_t> indices(values.size());
+
+        parallel_for(0, values.size(), [&](size_t first, size_t last)
+        {
+            for (size_t i = first; i < last; ++i)
+                indices[i] = static_cast<uint32_t>(std::lower_bound(palette_.begin(), palette_.end(), values[i], less) - palette_.begin());
+        });
+
+        attributes_.assign((indices.size() * index_bits_ + 63) / 64, 0);
+
+        for (size_t i = 0; i < indices.size(); ++i)
+        {
+            const size_t bit = i * index_bits_, word = bit / 64, shift = bit % 64;
+
+            attributes_[word] |= static_cast<uint64_t>(indices[i]) << shift;
+
+            if (shift + index_bits_ > 64)
+                attributes_[word + 1] |= static_cast<uint64_t>(indices[i]) >> (64 - shift);
+        }
+    }
+
+    void voxel_dag::destroy()
+    {
+        resolution_ = 0;
+        levels_ = 0;
+        num_nodes_ = 0;
+        num_octree_nodes_ = 0;
+        index_bits_ = 1;
+
+        nodes_.clear();
+        nodes_.shrink_to_fit();
+        palette_.clear();
+        palette_.shrink_to_fit();
+        attributes_.clear();
+        attributes_.shrink_to_fit();
+        mip_offsets_.clear();
+    }
+
+    size_t voxel_dag::memory() const
+    {
+        return node_memory() + palette_.size() * sizeof(palette_voxel) + attributes_.size() * sizeof(uint64_t);
+    }
+
+    size_t voxel_dag::subtree_voxels(uint32_t node, size_t depth) const
+    {
+        return depth == 1 ? detail::popcount8(nodes_[node]) : nodes_[node + depth - 1];
+    }
+
+    uint32_t voxel_dag::palette_index(size_t i) const
+    {
+        const size_t bit = i * index_bits_, word = bit / 64, shift = bit % 64;
+
+        uint64_t bits = attributes_[word] >> shift;
+
+        if (shift + index_bits_ > 64)
+            bits |= attributes_[word + 1] << (64 - shift);
+
+        return static_cast<uint32_t>(bits & ((static_cast<uint64_t>(1) << index_bits_) - 1));
+    }
+
+    bool voxel_dag::lookup(size_t mip, uint32_t x, uint32_t y, uint32_t z, voxel& v) const
+    {
+        v.normal = DirectX::XMFLOAT4(0.f, 0.f, 0.f, 0.f);
+        v.color = DirectX::XMFLOAT4(0.f, 0.f, 0.f, 0.f);
+
+        if (mip >= levels_)
+            return false;
+
+        const size_t bits = levels_ - mip;
+
+        if ((x | y | z) >> bits)
+            return false;
+
+        uint32_t n = 0;
+
+        // the number of voxels of mip before this one in depth-first order
+        size_t rank = 0;
+
+        for (size_t l = 0; l < bits; ++l)
+        {
+            const size_t b = bits - 1 - l;
+            const uint32_t octant = ((x >> b) & 1) | ((y >> b) & 1) << 1 | ((z >> b) & 1) << 2;
+
+            const uint32_t mask = nodes_[n];
+
+            if (!(mask & (1 << octant)))
+                return false;
+
+            const uint32_t before = mask & ((1 << octant) - 1);
+
+            if (l + 1 == bits)
+            {
+                rank += detail::popcount8(before);
+                break;
+            }
+
+            // children follow the mask and the counts of depth 2 to the height of the node
+            const uint32_t* children = &nodes_[n + levels_ - l];
+
+            const uint32_t skipped = detail::popcount8(before);
+
+            for (uint32_t c = 0; c < skipped; ++c)
+                rank += subtree_voxels(children[c], bits - l - 1);
+
+            n = children[skipped];
+        }
+
+        const palette_voxel& p = palette_[palette_index(mip_offsets_[mip] + rank)];
+
+        DirectX::XMStoreFloat4(&v.normal, DirectX::PackedVector::XMLoadHalf4(&p.normal));
+        DirectX::XMStoreFloat4(&v.color, DirectX::PackedVector::XMLoadHalf4(&p.color));
+
+        return v.normal.w > 0.f;
+    }
+
+    voxel voxel_dag::sample(const DirectX::XMFLOAT3& p, float mip) const
+    {
+        return detail::sample_mips(*this, p, mip);
+    }
+}
@@ -0,0 +1,104 @@
+/*
+ * Dune D3D library - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+/*! \file */
+
+#ifndef DUNE_VOXEL_DAG
+#define DUNE_VOXEL_DAG
+
+#include <cstdint>
+#include <vector>
+
+#include <DirectXMath.h>
+#include <DirectXPackedVector.h>
+
+#include "voxel_octree.h"
+
+namespace dune
+{
+    /*!
+     * \brief A sparse voxel DAG compressed from a static voxel_octree.
+     *
+     * A sparse voxel octree still stores identical subtrees many times, for instance those of a repeated wall or
+     * floor tile. Following [[Kampe et al. 2013]](http://dx.doi.org/10.1145/2461912.2462024), the geometry of the
+     * tree is turned into a directed acyclic graph by merging identical subtrees bottom-up: all nodes of a level are
+     * hashed by their child mask and the ids of their already merged children, sorted by hash in parallel, and equal
+     * nodes become one.
+     *
+     * Merged subtrees may have different voxel values, so values are stored apart from the geometry as in
+     * Dado et al. 2016, "Geometry and Attribute Compression for Voxel Scenes": the distinct voxels of all mips form
+     * a palette, and each mip has a stream of palette indices, bit packed and ordered like a depth-first traversal
+     * of the tree. A node stores how many voxels its subtree has at each depth, which lookup() sums over the skipped siblings to
+     * find the index of a voxel in its stream.
+     *
+     * Nodes are packed into one pool of 32 bit words: the child mask, the voxel counts of the subtree at depth 2 and
+     * below (depth 1 is the child mask), and the pool offsets of the children. The lowest nodes are just a mask of
+     * 2x2x2 voxels of mip 0. Values are taken as is, so lookup() and sample() return exactly what they return on
+     * the voxel_octree the DAG was built from.
+     */
+    class voxel_dag
+    {
+    protected:
+        struct palette_voxel
+        {
+            DirectX::PackedVector::XMHALF4 normal;
+            DirectX::PackedVector::XMHALF4 color;
+        };
+
+        size_t                      resolution_;
+        size_t                      levels_;
+
+        std::vector<uint32_t>       nodes_;
+        size_t                      num_nodes_;
+        size_t                      num_octree_nodes_;
+
+        std::vector<palette_voxel>  palette_;
+        std::vector<uint64_t>       attributes_;
+        std::vector<size_t>         mip_offsets_;
+        size_t                      index_bits_;
+
+    protected:
+        size_t subtree_voxels(uint32_t node, size_t depth) const;
+        uint32_t palette_index(size_t i) const;
+
+    public:
+        voxel_dag();
+        virtual ~voxel_dag() {}
+
+        /*! \brief Compress a tree. */
+        void create(const voxel_octree& svo);
+        void destroy();
+
+        /*! \brief Returns the number of voxels along each axis at mip 0. */
+        size_t resolution() const { return resolution_; }
+
+        /*! \brief Returns the number of mip levels, from resolution() down to 2x2x2. */
+        size_t num_mips() const { return levels_; }
+
+        /*! \brief Returns the number of nodes after merging. */
+        size_t num_nodes() const { return num_nodes_; }
+
+        /*! \brief Returns the number of occupied nodes of the voxel_octree the DAG was built from. */
+        size_t num_octree_nodes() const { return num_octree_nodes_; }
+
+        /*! \brief Returns the number of distinct voxels. */
+        size_t palette_size() const { return palette_.size(); }
+
+        /*! \brief Returns the number of bytes of the node pool. */
+        size_t node_memory() const { return nodes_.size() * sizeof(uint32_t); }
+
+        /*! \brief Returns the number of bytes of the node pool, the palette and the palette indices. */
+        size_t memory() const;
+
+        /*! \brief Fetch a voxel by traversing the DAG, see voxel_octree::lookup(). */
+        bool lookup(size_t mip, uint32_t x, uint32_t y, uint32_t z, voxel& v) const;
+
+        /*! \brief Trilinearly sample the DAG at a position, interpolating between mip levels, see voxel_octree::sample(). */
+        voxel sample(const DirectX::XMFLOAT3& p, float mip) const;
+    };
+}
+
+#endif
@@ -0,0 +1,346 @@
+/*
+ * Dune D3D library - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+#include "voxel_octree.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <utility>
+
+#include "math_tools.h"
+#include "parallel_tools.h"
+
+namespace dune
+{
+    namespace detail
+    {
+        // one level of the tree during construction, sorted by Morton code
+        struct octree_level
+        {
+            std::vector<uint64_t> codes;
+            std::vector<voxel> values;
+            std::vector<uint32_t> parents;  // index of the parent in the level above
+            std::vector<voxel> bricks;      // 2x2x2 values of the level below per entry
+        };
+
+        inline voxel empty_voxel()
+        {
+            voxel v;
+            v.normal = DirectX::XMFLOAT4(0.f, 0.f, 0.f, 0.f);
+            v.color = DirectX::XMFLOAT4(0.f, 0.f, 0.f, 0.f);
+            return v;
+        }
+
+        inline DirectX::PackedVector::XMHALF4 to_half4(const DirectX::XMFLOAT4& v)
+        {
+            DirectX::PackedVector::XMHALF4 h;
+            h.x = DirectX::PackedVector::XMConvertFloatToHalf(v.x);
+            h.y = DirectX::PackedVector::XMConvertFloatToHalf(v.y);
+            h.z = DirectX::PackedVector::XMConvertFloatToHalf(v.z);
+            h.w = DirectX::PackedVector::XMConvertFloatToHalf(v.w);
+            return h;
+        }
+
+        inline DirectX::XMFLOAT4 from_half4(const DirectX::PackedVector::XMHALF4& h)
+        {
+            return DirectX::XMFLOAT4(DirectX::PackedVector::XMConvertHalfToFloat(h.x),
+                                     DirectX::PackedVector::XMConvertHalfToFloat(h.y),
+                                     DirectX::PackedVector::XMConvertHalfToFloat(h.z),
+                                     DirectX::PackedVector::XMConvertHalfToFloat(h.w));
+        }
+
+        // indices of the first element of each run of equal codes >> shift
+        void find_runs(const std::vector<uint64_t>& codes, size_t shift, std::vector<size_t>& starts)
+        {
+            starts.clear();
+
+            for (size_t i = 0; i < codes.size(); ++i)
+                if (i == 0 || (codes[i] >> shift) != (codes[i - 1] >> shift))
+                    starts.push_back(i);
+
+            starts.push_back(codes.size());
+        }
+    }
+
+    voxel_octree::voxel_octree() :
+        resolution_(0),
+        levels_(0),
+        nodes_(),
+        bricks_(),
+        num_fragments_(0),
+        num_voxels_(0)
+    {
+    }
+
+    void voxel_octree::create(size_t resolution, const std::vector<voxel_fragment>& fragments)
+    {
+        destroy();
+
+        assert(resolution >= 2 && (resolution & (resolution - 1)) == 0 && resolution <= (1 << 21));
+
+        resolution_ = resolution;
+
+        while ((static_cast<size_t>(1) << levels_) < resolution_)
+            ++levels_;
+
+        const size_t depth = levels_;
+
+        // sort fragments by Morton code, invalid ones go to the end
+        const uint64_t invalid = ~0ull;
+
+        std::vector<std::pair<uint64_t, uint32_t>> keys(fragments.size());
+
+        parallel_for(0, fragments.size(), [&](size_t first, size_t last)
+        {
+            for (size_t i = first; i < last; ++i)
+            {
+                const voxel_fragment& f = fragments[i];
+
+                bool inside = f.x < resolution_ && f.y < resolution_ && f.z < resolution_;
+
+                keys[i].first = inside ? morton_encode(f.x, f.y, f.z) : invalid;
+                keys[i].second = static_cast<uint32_t>(i);
+            }
+        });
+
+        parallel_sort(keys.begin(), keys.end(), [](const std::pair<uint64_t, uint32_t>& a, const std::pair<uint64_t, uint32_t>& b)
+        {
+            return a.first < b.first;
+        });
+
+        while (!keys.empty() && keys.back().first == invalid)
+            keys.pop_back();
+
+        num_fragments_ = keys.size();
+
+        std::vector<detail::octree_level> levels(depth + 1);
+        std::vector<size_t> starts;
+
+        // the finest level is the average of all fragments in each voxel
+        {
+            detail::octree_level& leaves = levels[depth];
+
+            starts.clear();
+
+            for (size_t i = 0; i < keys.size(); ++i)
+                if (i == 0 || keys[i].first != keys[i - 1].first)
+                    starts.push_back(i);
+
+            starts.push_back(keys.size());
+
+            const size_t n = starts.size() - 1;
+
+            leaves.codes.resize(n);
+            leaves.values.resize(n);
+
+            parallel_for(0, n, [&](size_t first, size_t last)
+            {
+                for (size_t v = first; v < last; ++v)
+                {
+                    DirectX::XMVECTOR normal = DirectX::XMVectorZero();
+                    DirectX::XMVECTOR albedo = DirectX::XMVectorZero();
+
+                    for (size_t i = starts[v]; i < starts[v + 1]; ++i)
+                    {
+                        const voxel_fragment& f = fragments[keys[i].second];
+                        normal = DirectX::XMVectorAdd(normal, DirectX::XMLoadFloat3(&f.normal));
+                        albedo = DirectX::XMVectorAdd(albedo, DirectX::XMLoadFloat3(&f.albedo));
+                    }
+
+                    float inv_count = 1.f / (starts[v + 1] - starts[v]);
+
+                    // opposing fragments may cancel out, which leaves a zero normal
+                    if (DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(normal)) > 1e-12f)
+                        normal = DirectX::XMVector3Normalize(normal);
+
+                    voxel& out = leaves.values[v];
+                    DirectX::XMStoreFloat4(&out.normal, DirectX::XMVectorSetW(normal, 1.f));
+                    DirectX::XMStoreFloat4(&out.color, DirectX::XMVectorSetW(DirectX::XMVectorScale(albedo, inv_count), 0.f));
+
+                    leaves.codes[v] = keys[starts[v]].first;
+                }
+            });
+        }
+
+        keys.clear();
+        keys.shrink_to_fit();
+
+        // reduce each level of nodes from the one below
+        for (size_t l = depth; l-- > 0;)
+        {
+            detail::octree_level& child = levels[l + 1];
+            detail::octree_level& parent = levels[l];
+
+            detail::find_runs(child.codes, 3, starts);
+
+            const size_t n = starts.size() - 1;
+
+            parent.codes.resize(n);
+            parent.values.resize(n);
+            parent.bricks.assign(n * 8, detail::empty_voxel());
+            child.parents.resize(child.codes.size());
+
+            parallel_for(0, n, [&](size_t first, size_t last)
+            {
+                for (size_t p = first; p < last; ++p)
+                {
+                    DirectX::XMVECTOR normal = DirectX::XMVectorZero();
+                    DirectX::XMVECTOR color = DirectX::XMVectorZero();
+
+                    for (size_t c = starts[p]; c < starts[p + 1]; ++c)
+                    {
+                        const voxel& v = child.values[c];
+
+                        parent.bricks[p * 8 + (child.codes[c] & 7)] = v;
+                        child.parents[c] = static_cast<uint32_t>(p);
+
+                        normal = DirectX::XMVectorAdd(normal, DirectX::XMLoadFloat4(&v.normal));
+                        color = DirectX::XMVectorAdd(color, DirectX::XMLoadFloat4(&v.color));
+                    }
+
+                    // box filter, empty octants count as zero
+                    DirectX::XMStoreFloat4(&parent.values[p].normal, DirectX::XMVectorScale(normal, 0.125f));
+                    DirectX::XMStoreFloat4(&parent.values[p].color, DirectX::XMVectorScale(color, 0.125f));
+
+                    parent.codes[p] = child.codes[starts[p]] >> 3;
+                }
+            });
+
+            // values of the finest level are only needed in the bricks of their parents
+            child.values.clear();
+            child.values.shrink_to_fit();
+        }
+
+        num_voxels_ = levels[depth].codes.size();
+
+        if (num_voxels_ == 0)
+        {
+            node root = { 0, EMPTY };
+            nodes_.assign(1, root);
+            return;
+        }
+
+        // nodes of level l + 1 are stored in tiles of eight siblings after those of level l
+        std::vector<size_t> tile_base(depth + 1, 0), brick_base(depth + 1, 0);
+
+        tile_base[1] = 1;
+
+        for (size_t l = 1; l < depth; ++l)
+            tile_base[l + 1] = tile_base[l] + 8 * levels[l - 1].codes.size();
+
+        for (size_t l = 1; l < depth; ++l)
+            brick_base[l] = brick_base[l - 1] + levels[l - 1].codes.size();
+
+        const size_t num_nodes = depth > 1 ? tile_base[depth - 1] + 8 * levels[depth - 2].codes.size() : 1;
+        const size_t num_bricks = brick_base[depth - 1] + levels[depth - 1].codes.size();
+
+        node empty = { 0, EMPTY };
+        nodes_.assign(num_nodes, empty);
+        bricks_.resize(num_bricks * 8);
+
+        for (size_t l = 0; l < depth; ++l)
+        {
+            const detail::octree_level& level = levels[l];
+
+            parallel_for(0, level.codes.size(), [&](size_t first, size_t last)
+            {
+                for (size_t i = first; i < last; ++i)
+                {
+                    size_t index = l == 0 ? 0 : tile_base[l] + level.parents[i] * 8 + (level.codes[i] & 7);
+
+                    node& n = nodes_[index];
+                    n.brick = static_cast<uint32_t>(brick_base[l] + i);
+                    n.children = l + 1 < depth ? static_cast<uint32_t>(tile_base[l + 1] + i * 8) : 0;
+
+                    for (size_t o = 0; o < 8; ++o)
+                    {
+                        brick_voxel& b = bricks_[n.brick * 8 + o];
+                        b.normal = detail::to_half4(level.bricks[i * 8 + o].normal);
+                        b.color = detail::to_half4(level.bricks[i * 8 + o].color);
+                    }
+                }
+            });
+        }
+    }
+
+    void voxel_octree::destroy()
+    {
+        resolution_ = 0;
+        levels_ = 0;
+        num_fragments_ = 0;
+        num_voxels_ = 0;
+
+        nodes_.clear();
+        nodes_.shrink_to_fit();
+        bricks_.clear();
+        bricks_.shrink_to_fit();
+    }
+
+    size_t voxel_octree::memory() const
+    {
+        return nodes_.size() * sizeof(node) + bricks_.size() * sizeof(brick_voxel);
+    }
+
+    size_t voxel_octree::dense_memory(size_t resolution)
+    {
+        size_t texels = 0;
+
+        for (size_t r = resolution; r > 0; r /= 2)
+            texels += r * r * r;
+
+        // v_normal_ and v_rho_
+        return texels * 2 * 8;
+    }
+
+    voxel voxel_octree::load(uint32_t brick, uint32_t octant) const
+    {
+        const brick_voxel& b = bricks_[brick * 8 + octant];
+
+        voxel v;
+        v.normal = detail::from_half4(b.normal);
+        v.color = detail::from_half4(b.color);
+        return v;
+    }
+
+    bool voxel_octree::lookup(size_t mip, uint32_t x, uint32_t y, uint32_t z, voxel& v) const
+    {
+        v = detail::empty_voxel();
+
+        if (mip >= levels_)
+            return false;
+
+        const size_t bits = levels_ - mip;
+
+        if ((x | y | z) >> bits)
+            return false;
+
+        uint32_t n = 0;
+
+        for (size_t l = 0; l + 1 < bits; ++l)
+        {
+            const size_t b = bits - 1 - l;
+            const uint32_t octant = ((x >> b) & 1) | ((y >> b) & 1) << 1 | ((z >> b) & 1) << 2;
+
+            if (nodes_[n].children == 0)
+                return false;
+
+            n = nodes_[n].children + octant;
+        }
+
+        if (nodes_[n].brick == EMPTY)
+            return false;
+
+        v = load(nodes_[n].brick, (x & 1) | (y & 1) << 1 | (z & 1) << 2);
+
+        return v.normal.w > 0.f;
+    }
+
+    voxel voxel_octree::sample(const DirectX::XMFLOAT3& p, float mip) const
+    {
+        return detail::sample_mips(*this, p, mip);
+    }
+}
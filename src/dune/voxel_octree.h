@@ -0,0 +1,210 @@
+/*
+ * Dune D3D library - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+/*! \file */
+
+#ifndef DUNE_VOXEL_OCTREE
+#define DUNE_VOXEL_OCTREE
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include <DirectXMath.h>
+#include <DirectXPackedVector.h>
+
+namespace dune
+{
+    /*! \brief A surface sample which falls into one voxel of the finest level of a voxel_octree. */
+    struct voxel_fragment
+    {
+        uint32_t x, y, z;           //!< voxel coordinates at the finest level
+        DirectX::XMFLOAT3 normal;   //!< normalized
+        DirectX::XMFLOAT3 albedo;
+    };
+
+    /*! \brief The value of a voxel_octree voxel, at any level. */
+    struct voxel
+    {
+        DirectX::XMFLOAT4 normal;   //!< average normal and occlusion, i.e. the fraction of occupied voxels
+        DirectX::XMFLOAT4 color;    //!< average albedo, alpha is unused
+    };
+
+    /*!
+     * \brief A sparse voxel octree built on the CPU.
+     *
+     * Unlike sparse_voxel_octree, which is a dense volume with mip maps, only occupied regions are stored.
+     * The tree is built from voxel fragments: fragments are sorted by Morton code, fragments in the same
+     * voxel are averaged, and each level of nodes is then reduced from the level below in parallel.
+     *
+     * Nodes live in a node pool in tiles of eight siblings, so a node only stores the index of its first
+     * child and the index of its brick. A brick holds the 2x2x2 voxels of the octants of its node, i.e.
+     * the bricks of the lowest level of nodes hold the fragments and bricks further up hold mip maps
+     * reduced with a box filter, the same GenerateMips() applies to the volumes of sparse_voxel_octree.
+     * Voxels are stored as half floats, 16 bytes each like the two RGBA16F volumes on the GPU.
+     *
+     * lookup() and sample() mirror Load() and SampleLevel() on the volumes in vct_tools.hlsl, where
+     * mip 0 is the finest level and empty regions return zero.
+     */
+    class voxel_octree
+    {
+    public:
+        /*! \brief A node of the node pool. */
+        struct node
+        {
+            uint32_t children;  //!< index of the first of eight child nodes, 0 if there are none
+            uint32_t brick;     //!< index of the brick, EMPTY for an empty node
+        };
+
+        static const uint32_t EMPTY = 0xffffffff;
+
+    protected:
+        struct brick_voxel
+        {
+            DirectX::PackedVector::XMHALF4 normal;
+            DirectX::PackedVector::XMHALF4 color;
+        };
+
+        size_t                      resolution_;
+        size_t                      levels_;
+
+        std::vector<node>           nodes_;
+        std::vector<brick_voxel>    bricks_;
+
+        size_t                      num_fragments_;
+        size_t                      num_voxels_;
+
+    public:
+        voxel_octree();
+        virtual ~voxel_octree() {}
+
+        /*!
+         * \brief Build the tree from fragments.
+         *
+         * \param resolution The number of voxels along each axis at the finest level, a power of two of at least 2.
+         * \param fragments Fragments with coordinates smaller than resolution, others are skipped.
+         */
+        void create(size_t resolution, const std::vector<voxel_fragment>& fragments);
+        void destroy();
+
+        /*! \brief Returns the number of voxels along each axis at mip 0. */
+        size_t resolution() const { return resolution_; }
+
+        /*! \brief Returns the number of mip levels, from resolution() down to 2x2x2. */
+        size_t num_mips() const { return levels_; }
+
+        /*! \brief Returns the number of fragments the tree was built from. */
+        size_t num_fragments() const { return num_fragments_; }
+
+        /*! \brief Returns the number of occupied voxels at mip 0. */
+        size_t num_voxels() const { return num_voxels_; }
+
+        const std::vector<node>& nodes() const { return nodes_; }
+        size_t num_bricks() const { return bricks_.size() / 8; }
+
+        /*! \brief Returns the voxel of an octant of a brick, i.e. of a child of the node of the brick. */
+        voxel load(uint32_t brick, uint32_t octant) const;
+
+        /*! \brief Returns the number of bytes of the node and brick pools. */
+        size_t memory() const;
+
+        /*! \brief Returns the number of bytes of two dense RGBA16F volumes with a full mip chain, like sparse_voxel_octree. */
+        static size_t dense_memory(size_t resolution);
+
+        /*!
+         * \brief Fetch a voxel by traversing the tree.
+         *
+         * \param mip The mip level, where 0 is the finest.
+         * \param x, y, z Voxel coordinates at the resolution of mip.
+         * \param v The voxel, which is zero if it is empty or outside of the tree.
+         * \return False if the voxel is empty.
+         */
+        bool lookup(size_t mip, uint32_t x, uint32_t y, uint32_t z, voxel& v) const;
+
+        /*!
+         * \brief Trilinearly sample the tree at a position, interpolating between mip levels.
+         *
+         * \param p A position in [0,1]^3.
+         * \param mip A fractional mip level, clamped to the range of the tree.
+         * \return The filtered voxel, with zero for empty space.
+         */
+        voxel sample(const DirectX::XMFLOAT3& p, float mip) const;
+    };
+
+    namespace detail
+    {
+        /*!
+         * \brief Trilinearly sample a tree at a position, interpolating between mip levels.
+         *
+         * Tree is anything with the resolution(), num_mips() and lookup() of a voxel_octree, see voxel_octree::sample().
+         */
+        template<typename Tree>
+        voxel sample_mips(const Tree& tree, const DirectX::XMFLOAT3& p, float mip)
+        {
+            voxel result;
+            result.normal = DirectX::XMFLOAT4(0.f, 0.f, 0.f, 0.f);
+            result.color = DirectX::XMFLOAT4(0.f, 0.f, 0.f, 0.f);
+
+            const size_t levels = tree.num_mips();
+
+            if (levels == 0)
+                return result;
+
+            mip = std::min(std::max(mip, 0.f), static_cast<float>(levels - 1));
+
+            const size_t m0 = static_cast<size_t>(mip);
+            const size_t m1 = std::min(m0 + 1, levels - 1);
+            const float mf = mip - m0;
+
+            DirectX::XMVECTOR normal = DirectX::XMVectorZero();
+            DirectX::XMVECTOR color = DirectX::XMVectorZero();
+
+            for (size_t m = m0; m <= m1; ++m)
+            {
+                const float wm = m == m0 ? (m0 == m1 ? 1.f : 1.f - mf) : mf;
+
+                if (wm <= 0.f)
+                    continue;
+
+                const float r = static_cast<float>(tree.resolution() >> m);
+
+                float u[3] = { p.x * r - 0.5f, p.y * r - 0.5f, p.z * r - 0.5f };
+                int i0[3];
+                float f[3];
+
+                for (size_t a = 0; a < 3; ++a)
+                {
+                    float fl = std::floor(u[a]);
+                    i0[a] = static_cast<int>(fl);
+                    f[a] = u[a] - fl;
+                }
+
+                for (int c = 0; c < 8; ++c)
+                {
+                    int x = i0[0] + (c & 1), y = i0[1] + ((c >> 1) & 1), z = i0[2] + ((c >> 2) & 1);
+
+                    float w = wm * ((c & 1) ? f[0] : 1.f - f[0]) * ((c & 2) ? f[1] : 1.f - f[1]) * ((c & 4) ? f[2] : 1.f - f[2]);
+
+                    voxel v;
+
+                    if (w <= 0.f || x < 0 || y < 0 || z < 0 || !tree.lookup(m, x, y, z, v))
+                        continue;
+
+                    normal = DirectX::XMVectorAdd(normal, DirectX::XMVectorScale(DirectX::XMLoadFloat4(&v.normal), w));
+                    color = DirectX::XMVectorAdd(color, DirectX::XMVectorScale(DirectX::XMLoadFloat4(&v.color), w));
+                }
+            }
+
+            DirectX::XMStoreFloat4(&result.normal, normal);
+            DirectX::XMStoreFloat4(&result.color, color);
+
+            return result;
+        }
+    }
+}
+
+#endif
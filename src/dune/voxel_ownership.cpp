@@ -0,0 +1,271 @@
+/*
+ * Dune D3D library - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+#include "voxel_ownership.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace dune
+{
+    voxel_ownership::voxel_ownership() :
+        volume_size_(0),
+        bricks_(0),
+        invalid_(true)
+    {
+        DirectX::XMStoreFloat4x4(&world_to_volume_, DirectX::XMMatrixIdentity());
+        std::memset(&stats_, 0, sizeof(stats_));
+    }
+
+    void voxel_ownership::create(uint32_t volume_size)
+    {
+        destroy();
+
+        volume_size_ = volume_size;
+        bricks_ = (volume_size + BRICK_SIZE - 1) / BRICK_SIZE;
+
+        owners_.resize(static_cast<size_t>(bricks_) * bricks_ * bricks_);
+    }
+
+    void voxel_ownership::destroy()
+    {
+        volume_size_ = 0;
+        bricks_ = 0;
+        invalid_ = true;
+
+        meshes_.clear();
+        owners_.clear();
+        regions_.clear();
+        dirty_meshes_.clear();
+
+        std::memset(&stats_, 0, sizeof(stats_));
+    }
+
+    void voxel_ownership::set_model_matrix(const DirectX::XMFLOAT4X4& model, const DirectX::XMFLOAT3& volume_min, const DirectX::XMFLOAT3& volume_max)
+    {
+        DirectX::XMMATRIX model_inv = DirectX::XMMatrixInverse(nullptr, DirectX::XMLoadFloat4x4(&model));
+
+        DirectX::XMMATRIX trans = DirectX::XMMatrixTranslation(-volume_min.x, -volume_min.y, -volume_min.z);
+        DirectX::XMMATRIX scale = DirectX::XMMatrixScaling(1.f / (volume_max.x - volume_min.x),
+                                                           1.f / (volume_max.y - volume_min.y),
+                                                           1.f / (volume_max.z - volume_min.z));
+
+        DirectX::XMFLOAT4X4 world_to_volume;
+        DirectX::XMStoreFloat4x4(&world_to_volume, model_inv * trans * scale);
+
+        if (std::memcmp(&world_to_volume, &world_to_volume_, sizeof(world_to_volume)) != 0)
+        {
+            world_to_volume_ = world_to_volume;
+            invalid_ = true;
+        }
+    }
+
+    void voxel_ownership::invalidate()
+    {
+        invalid_ = true;
+    }
+
+    void voxel_ownership::invalidate(size_t mesh)
+    {
+        if (mesh < meshes_.size())
+            meshes_[mesh].changed = true;
+    }
+
+    void voxel_ownership::set_mesh(size_t mesh, const DirectX::XMFLOAT3& bb_min, const DirectX::XMFLOAT3& bb_max, const DirectX::XMFLOAT4X4& world)
+    {
+        while (meshes_.size() <= mesh)
+        {
+            mesh_state m = {};
+            meshes_.push_back(m);
+        }
+
+        mesh_state& m = meshes_[mesh];
+
+        if (std::memcmp(&m.bb_min, &bb_min, sizeof(bb_min)) == 0 &&
+            std::memcmp(&m.bb_max, &bb_max, sizeof(bb_max)) == 0 &&
+            std::memcmp(&m.world, &world, sizeof(world)) == 0)
+            return;
+
+        m.bb_min = bb_min;
+        m.bb_max = bb_max;
+        m.world = world;
+        m.used = true;
+        m.changed = true;
+    }
+
+    void voxel_ownership::owned_bricks(mesh_state& m) const
+    {
+        DirectX::XMMATRIX to_volume = DirectX::XMMatrixMultiply(DirectX::XMLoadFloat4x4(&m.world), DirectX::XMLoadFloat4x4(&world_to_volume_));
+
+        DirectX::XMVECTOR lo = DirectX::XMVectorReplicate(std::numeric_limits<float>::max());
+        DirectX::XMVECTOR hi = DirectX::XMVectorReplicate(-std::numeric_limits<float>::max());
+
+        for (int c = 0; c < 8; ++c)
+        {
+            DirectX::XMVECTOR p = DirectX::XMVectorSet((c & 1) ? m.bb_max.x : m.bb_min.x,
+                                                       (c & 2) ? m.bb_max.y : m.bb_min.y,
+                                                       (c & 4) ? m.bb_max.z : m.bb_min.z, 1.f);
+
+            p = DirectX::XMVector3TransformCoord(p, to_volume);
+
+            lo = DirectX::XMVectorMin(lo, p);
+            hi = DirectX::XMVectorMax(hi, p);
+        }
+
+        DirectX::XMFLOAT3 vlo, vhi;
+        DirectX::XMStoreFloat3(&vlo, lo);
+        DirectX::XMStoreFloat3(&vhi, hi);
+
+        const float bmin[3] = { vlo.x, vlo.y, vlo.z };
+        const float bmax[3] = { vhi.x, vhi.y, vhi.z };
+        const float size = static_cast<float>(volume_size_);
+
+        for (size_t a = 0; a < 3; ++a)
+        {
+            // one voxel of margin for the conservative rasterization of the voxelizer
+            float v0 = std::max(std::floor(bmin[a] * size) - 1.f, 0.f);
+            float v1 = std::min(std::ceil(bmax[a] * size) + 1.f, size);
+
+            if (!(v0 < v1))
+            {
+                std::memset(m.brick_min, 0, sizeof(m.brick_min));
+                std::memset(m.brick_max, 0, sizeof(m.brick_max));
+                return;
+            }
+
+            m.brick_min[a] = static_cast<uint32_t>(v0) / BRICK_SIZE;
+            m.brick_max[a] = (static_cast<uint32_t>(v1) + BRICK_SIZE - 1) / BRICK_SIZE;
+        }
+    }
+
+    void voxel_ownership::set_owner(const mesh_state& m, uint32_t mesh, bool own)
+    {
+        for (uint32_t z = m.brick_min[2]; z < m.brick_max[2]; ++z)
+        for (uint32_t y = m.brick_min[1]; y < m.brick_max[1]; ++y)
+        for (uint32_t x = m.brick_min[0]; x < m.brick_max[0]; ++x)
+        {
+            std::vector<uint32_t>& owners = owners_[(static_cast<size_t>(z) * bricks_ + y) * bricks_ + x];
+
+            if (own)
+                owners.push_back(mesh);
+            else
+                owners.erase(std::remove(owners.begin(), owners.end(), mesh), owners.end());
+        }
+    }
+
+    void voxel_ownership::update()
+    {
+        regions_.clear();
+        dirty_meshes_.clear();
+
+        std::memset(&stats_, 0, sizeof(stats_));
+        stats_.meshes = meshes_.size();
+        stats_.bricks = owners_.size();
+        stats_.light_only = true;
+
+        if (volume_size_ == 0)
+            return;
+
+        std::vector<unsigned char> dirty_bricks(owners_.size(), invalid_ ? 1 : 0);
+        std::vector<unsigned char> voxelize(meshes_.size(), 0);
+
+        const auto mark = [&](const mesh_state& m)
+        {
+            for (uint32_t z = m.brick_min[2]; z < m.brick_max[2]; ++z)
+            for (uint32_t y = m.brick_min[1]; y < m.brick_max[1]; ++y)
+            for (uint32_t x = m.brick_min[0]; x < m.brick_max[0]; ++x)
+                dirty_bricks[(static_cast<size_t>(z) * bricks_ + y) * bricks_ + x] = 1;
+        };
+
+        if (invalid_)
+        {
+            for (auto o = owners_.begin(); o != owners_.end(); ++o)
+                o->clear();
+        }
+
+        for (size_t i = 0; i < meshes_.size(); ++i)
+        {
+            mesh_state& m = meshes_[i];
+
+            if (!m.used || (!invalid_ && !m.changed && m.voxelized))
+                continue;
+
+            // the bricks the mesh leaves
+            if (m.voxelized && !invalid_)
+            {
+                mark(m);
+                set_owner(m, static_cast<uint32_t>(i), false);
+            }
+
+            owned_bricks(m);
+
+            // and the bricks it enters
+            mark(m);
+            set_owner(m, static_cast<uint32_t>(i), true);
+
+            m.voxelized = true;
+            m.changed = false;
+            voxelize[i] = 1;
+        }
+
+        // clearing a brick removes the voxels of all other meshes in it as well
+        for (size_t b = 0; b < dirty_bricks.size(); ++b)
+        {
+            if (!dirty_bricks[b])
+                continue;
+
+            ++stats_.bricks_cleared;
+
+            for (auto o = owners_[b].begin(); o != owners_[b].end(); ++o)
+                voxelize[*o] = 1;
+        }
+
+        for (size_t i = 0; i < voxelize.size(); ++i)
+            if (voxelize[i])
+                dirty_meshes_.push_back(i);
+
+        // merge runs of dirty bricks along x into boxes, or clear everything at once
+        if (stats_.bricks_cleared == owners_.size())
+        {
+            voxel_box box = { { 0, 0, 0 }, { volume_size_, volume_size_, volume_size_ } };
+            regions_.push_back(box);
+        }
+        else for (uint32_t z = 0; z < bricks_; ++z)
+        for (uint32_t y = 0; y < bricks_; ++y)
+        {
+            const size_t row = (static_cast<size_t>(z) * bricks_ + y) * bricks_;
+
+            for (uint32_t x = 0; x < bricks_;)
+            {
+                if (!dirty_bricks[row + x])
+                {
+                    ++x;
+                    continue;
+                }
+
+                uint32_t end = x;
+                while (end < bricks_ && dirty_bricks[row + end])
+                    ++end;
+
+                voxel_box box =
+                {
+                    { x * BRICK_SIZE, y * BRICK_SIZE, z * BRICK_SIZE },
+                    { std::min(end * BRICK_SIZE, volume_size_), std::min((y + 1) * BRICK_SIZE, volume_size_), std::min((z + 1) * BRICK_SIZE, volume_size_) }
+                };
+
+                regions_.push_back(box);
+                x = end;
+            }
+        }
+
+        stats_.meshes_voxelized = dirty_meshes_.size();
+        stats_.light_only = stats_.bricks_cleared == 0;
+
+        invalid_ = false;
+    }
+}
@@ -0,0 +1,130 @@
+/*
+ * Dune D3D library - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+/*! \file */
+
+#ifndef DUNE_VOXEL_OWNERSHIP
+#define DUNE_VOXEL_OWNERSHIP
+
+#include <cstdint>
+#include <vector>
+
+#include <DirectXMath.h>
+
+namespace dune
+{
+    /*! \brief A box of voxels [min, max) of a volume. */
+    struct voxel_box
+    {
+        uint32_t min[3];
+        uint32_t max[3];
+    };
+
+    /*! \brief Counters of the work done and skipped by the last voxel_ownership::update(). */
+    struct revoxelization_stats
+    {
+        size_t meshes;
+        size_t meshes_voxelized;
+        size_t bricks;
+        size_t bricks_cleared;
+
+        /*! \brief True if no mesh changed, i.e. voxelization can be skipped and the light only re-injected. */
+        bool light_only;
+    };
+
+    /*!
+     * \brief Track which meshes occupy which bricks of a voxel volume to revoxelize only what changed.
+     *
+     * Voxelizing a scene is only necessary when its geometry changes. A change of the light alone only needs a
+     * new injection. Each frame, the bounding box and world matrix of every mesh are handed to set_mesh(),
+     * and update() compares them to the last frame. The bricks a changed mesh occupied before and occupies now
+     * have to be cleared, and every mesh overlapping one of these bricks has to be voxelized again, since
+     * clearing removed its voxels there as well. All other bricks keep their voxels.
+     *
+     * The volume is split into bricks of BRICK_SIZE^3 voxels. A mesh owns all bricks its bounding box overlaps,
+     * with a margin of one voxel for conservative voxelization.
+     */
+    class voxel_ownership
+    {
+    public:
+        /*! \brief The edge length of a brick in voxels. */
+        static const uint32_t BRICK_SIZE = 8;
+
+    protected:
+        struct mesh_state
+        {
+            DirectX::XMFLOAT3   bb_min, bb_max;
+            DirectX::XMFLOAT4X4 world;
+
+            // bricks [brick_min, brick_max) owned, empty if outside of the volume
+            uint32_t            brick_min[3];
+            uint32_t            brick_max[3];
+
+            bool                used;
+            bool                voxelized;
+            bool                changed;
+        };
+
+        uint32_t                                volume_size_;
+        uint32_t                                bricks_;
+        DirectX::XMFLOAT4X4                     world_to_volume_;
+        bool                                    invalid_;
+
+        std::vector<mesh_state>                 meshes_;
+        std::vector<std::vector<uint32_t>>      owners_;
+
+        std::vector<voxel_box>                  regions_;
+        std::vector<size_t>                     dirty_meshes_;
+        revoxelization_stats                    stats_;
+
+    protected:
+        void owned_bricks(mesh_state& m) const;
+        void set_owner(const mesh_state& m, uint32_t mesh, bool own);
+
+    public:
+        voxel_ownership();
+        virtual ~voxel_ownership() {}
+
+        /*! \brief Create a tracker for a volume of volume_size^3 voxels. */
+        void create(uint32_t volume_size);
+        void destroy();
+
+        /*! \brief Set the transformation of the volume, see sparse_voxel_octree::set_model_matrix(). Everything is revoxelized if it changed. */
+        void set_model_matrix(const DirectX::XMFLOAT4X4& model, const DirectX::XMFLOAT3& volume_min, const DirectX::XMFLOAT3& volume_max);
+
+        /*! \brief Revoxelize everything in the next update(), e.g. because the contents of the volume were replaced. */
+        void invalidate();
+
+        /*! \brief Revoxelize a mesh in the next update() because its geometry changed. */
+        void invalidate(size_t mesh);
+
+        /*!
+         * \brief Set the current state of a mesh.
+         *
+         * \param mesh The index of the mesh, which must be the same every frame. Indices never set are ignored.
+         * \param bb_min The minimum of the bounding box of the mesh in object space.
+         * \param bb_max The maximum of the bounding box of the mesh in object space.
+         * \param world The world matrix of the mesh.
+         */
+        void set_mesh(size_t mesh, const DirectX::XMFLOAT3& bb_min, const DirectX::XMFLOAT3& bb_max, const DirectX::XMFLOAT4X4& world);
+
+        /*! \brief Compare all meshes to the last update() and compute the regions to clear and the meshes to voxelize. */
+        void update();
+
+        /*! \brief Returns the boxes of voxels to clear before voxelizing, in volume coordinates. */
+        const std::vector<voxel_box>& regions() const { return regions_; }
+
+        /*! \brief Returns the indices of the meshes to voxelize, in ascending order. */
+        const std::vector<size_t>& meshes() const { return dirty_meshes_; }
+
+        /*! \brief Returns true if the last update() needs no voxelization at all. */
+        bool light_only() const { return stats_.light_only; }
+
+        const revoxelization_stats& stats() const { return stats_; }
+    };
+}
+
+#endif
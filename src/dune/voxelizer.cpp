@@ -0,0 +1,532 @@
+/*
+ * Dune D3D library - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+#include "voxelizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include "parallel_tools.h"
+
+namespace dune
+{
+    namespace detail
+    {
+        // a triangle in voxel coordinates with everything the overlap test needs
+        struct voxel_setup
+        {
+            float n[3];
+            float d1, d2;
+
+            // edge functions in the xy, yz and zx projections
+            float ne[3][3][2];
+            float de[3][3];
+
+            int lo[3], hi[3];
+
+            // the axis along which the triangle is flattest and its projection
+            size_t dominant, dominant_projection;
+
+            // barycentric coordinates of voxel centers
+            float v0[3], e0[3], e1[3];
+            float d00, d01, d11, inv_denom;
+
+            DirectX::XMFLOAT3 normal[3];
+            DirectX::XMFLOAT3 albedo;
+        };
+
+        const size_t PROJECTION_AXES[3][2] = { { 0, 1 }, { 1, 2 }, { 2, 0 } };
+
+        // the axis whose normal component orients the edges of each projection
+        const size_t PROJECTION_NORMAL[3] = { 2, 0, 1 };
+
+        inline float dot3(const float* a, const float* b)
+        {
+            return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+        }
+
+        bool setup_triangle(const voxel_triangle& t, DirectX::FXMMATRIX to_voxels, int resolution, voxel_setup& s)
+        {
+            float v[3][3];
+
+            for (size_t i = 0; i < 3; ++i)
+            {
+                DirectX::XMFLOAT3 p;
+                DirectX::XMStoreFloat3(&p, DirectX::XMVector3TransformCoord(DirectX::XMLoadFloat3(&t.position[i]), to_voxels));
+
+                v[i][0] = p.x;
+                v[i][1] = p.y;
+                v[i][2] = p.z;
+            }
+
+            for (size_t a = 0; a < 3; ++a)
+            {
+                float mi = std::min(v[0][a], std::min(v[1][a], v[2][a]));
+                float ma = std::max(v[0][a], std::max(v[1][a], v[2][a]));
+
+                if (!(ma >= 0.f && mi < static_cast<float>(resolution)))
+                    return false;
+
+                s.lo[a] = std::max(0, static_cast<int>(std::floor(mi)));
+                s.hi[a] = std::min(resolution - 1, static_cast<int>(std::floor(ma)));
+            }
+
+            float e[3][3];
+
+            for (size_t i = 0; i < 3; ++i)
+            for (size_t a = 0; a < 3; ++a)
+                e[i][a] = v[(i + 1) % 3][a] - v[i][a];
+
+            s.n[0] = e[0][1] * e[1][2] - e[0][2] * e[1][1];
+            s.n[1] = e[0][2] * e[1][0] - e[0][0] * e[1][2];
+            s.n[2] = e[0][0] * e[1][1] - e[0][1] * e[1][0];
+
+            // the corner of a unit box which is furthest along the normal, and its opposite
+            float c[3], c_inv[3];
+
+            for (size_t a = 0; a < 3; ++a)
+            {
+                c[a] = (s.n[a] > 0.f ? 1.f : 0.f) - v[0][a];
+                c_inv[a] = (s.n[a] > 0.f ? 0.f : 1.f) - v[0][a];
+            }
+
+            s.d1 = dot3(s.n, c);
+            s.d2 = dot3(s.n, c_inv);
+
+            s.dominant = 0;
+
+            for (size_t a = 1; a < 3; ++a)
+                if (std::abs(s.n[a]) > std::abs(s.n[s.dominant]))
+                    s.dominant = a;
+
+            for (size_t p = 0; p < 3; ++p)
+                if (PROJECTION_NORMAL[p] == s.dominant)
+                    s.dominant_projection = p;
+
+            for (size_t p = 0; p < 3; ++p)
+            {
+                const size_t a = PROJECTION_AXES[p][0];
+                const size_t b = PROJECTION_AXES[p][1];
+                const float sign = s.n[PROJECTION_NORMAL[p]] >= 0.f ? 1.f : -1.f;
+
+                for (size_t i = 0; i < 3; ++i)
+                {
+                    float nx = -e[i][b] * sign;
+                    float ny =  e[i][a] * sign;
+
+                    s.ne[p][i][0] = nx;
+                    s.ne[p][i][1] = ny;
+                    s.de[p][i] = -(nx * v[i][a] + ny * v[i][b]) + std::max(0.f, nx) + std::max(0.f, ny);
+                }
+            }
+
+            for (size_t a = 0; a < 3; ++a)
+            {
+                s.v0[a] = v[0][a];
+                s.e0[a] = e[0][a];
+                s.e1[a] = -e[2][a];
+            }
+
+            s.d00 = dot3(s.e0, s.e0);
+            s.d01 = dot3(s.e0, s.e1);
+            s.d11 = dot3(s.e1, s.e1);
+
+            float denom = s.d00 * s.d11 - s.d01 * s.d01;
+            s.inv_denom = std::abs(denom) > 1e-20f ? 1.f / denom : 0.f;
+
+            for (size_t i = 0; i < 3; ++i)
+                s.normal[i] = t.normal[i];
+
+            s.albedo = t.albedo;
+
+            return true;
+        }
+
+        inline bool overlaps_projection(const voxel_setup& s, size_t i, const float p[3])
+        {
+            const size_t a = PROJECTION_AXES[i][0];
+            const size_t b = PROJECTION_AXES[i][1];
+
+            for (size_t j = 0; j < 3; ++j)
+                if (s.ne[i][j][0] * p[a] + s.ne[i][j][1] * p[b] + s.de[i][j] < 0.f)
+                    return false;
+
+            return true;
+        }
+
+        /*
+         * Call f(x, y, z) for all voxels inside [lo, hi] which overlap a triangle. Instead of testing every voxel,
+         * the columns along the dominant axis are tested in the dominant projection first, and the plane test is
+         * solved for the range of voxels in each column. Rounding may move the bounds of the range across a voxel,
+         * so the range is widened by one voxel and each voxel is tested against the plane exactly.
+         */
+        template<typename F>
+        void for_each_overlap(const voxel_setup& s, const int lo[3], const int hi[3], F f)
+        {
+            const size_t d = s.dominant;
+            const size_t a = (d + 1) % 3;
+            const size_t b = (d + 2) % 3;
+
+            if (s.n[d] == 0.f)
+                return;
+
+            // n.p must lie between -d1 and -d2
+            const float t_lo = std::min(-s.d1, -s.d2);
+            const float t_hi = std::max(-s.d1, -s.d2);
+            const float inv_nd = 1.f / s.n[d];
+
+            float p[3];
+
+            for (int pa = lo[a]; pa <= hi[a]; ++pa)
+            for (int pb = lo[b]; pb <= hi[b]; ++pb)
+            {
+                p[a] = static_cast<float>(pa);
+                p[b] = static_cast<float>(pb);
+
+                if (!overlaps_projection(s, s.dominant_projection, p))
+                    continue;
+
+                const float k = s.n[a] * p[a] + s.n[b] * p[b];
+
+                float d0 = (t_lo - k) * inv_nd;
+                float d1 = (t_hi - k) * inv_nd;
+
+                if (d0 > d1)
+                    std::swap(d0, d1);
+
+                const int first = std::max(lo[d], static_cast<int>(std::ceil(d0)) - 1);
+                const int last = std::min(hi[d], static_cast<int>(std::floor(d1)) + 1);
+
+                for (int pd = first; pd <= last; ++pd)
+                {
+                    p[d] = static_cast<float>(pd);
+
+                    const float np = dot3(s.n, p);
+
+                    if ((np + s.d1) * (np + s.d2) > 0.f)
+                        continue;
+
+                    bool inside = true;
+
+                    for (size_t i = 0; i < 3 && inside; ++i)
+                        if (i != s.dominant_projection)
+                            inside = overlaps_projection(s, i, p);
+
+                    if (inside)
+                        f(static_cast<int>(p[0]), static_cast<int>(p[1]), static_cast<int>(p[2]));
+                }
+            }
+        }
+
+        // interpolate the vertex normals at the projection of the voxel center, clamped to the triangle
+        DirectX::XMVECTOR interpolate_normal(const voxel_setup& s, int x, int y, int z)
+        {
+            float u = 1.f / 3.f, v = 1.f / 3.f;
+
+            if (s.inv_denom != 0.f)
+            {
+                const float d[3] = { x + 0.5f - s.v0[0], y + 0.5f - s.v0[1], z + 0.5f - s.v0[2] };
+
+                const float d20 = dot3(d, s.e0);
+                const float d21 = dot3(d, s.e1);
+
+                u = std::max(0.f, (s.d11 * d20 - s.d01 * d21) * s.inv_denom);
+                v = std::max(0.f, (s.d00 * d21 - s.d01 * d20) * s.inv_denom);
+
+                float sum = u + v;
+
+                if (sum > 1.f)
+                {
+                    u /= sum;
+                    v /= sum;
+                }
+            }
+
+            DirectX::XMVECTOR n = DirectX::XMVectorScale(DirectX::XMLoadFloat3(&s.normal[0]), 1.f - u - v);
+            n = DirectX::XMVectorAdd(n, DirectX::XMVectorScale(DirectX::XMLoadFloat3(&s.normal[1]), u));
+            n = DirectX::XMVectorAdd(n, DirectX::XMVectorScale(DirectX::XMLoadFloat3(&s.normal[2]), v));
+
+            if (DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(n)) > 1e-12f)
+                n = DirectX::XMVector3Normalize(n);
+
+            return n;
+        }
+
+        // max blended voxels of one tile, private to a worker
+        struct voxel_tile
+        {
+            std::vector<DirectX::XMFLOAT4> normal;
+            std::vector<DirectX::XMFLOAT4> color;
+            std::vector<unsigned char> occupied;
+            std::vector<uint32_t> touched;
+
+            void resize(size_t n)
+            {
+                normal.assign(n, DirectX::XMFLOAT4(0.f, 0.f, 0.f, 0.f));
+                color.assign(n, DirectX::XMFLOAT4(0.f, 0.f, 0.f, 0.f));
+                occupied.assign(n, 0);
+                touched.clear();
+            }
+        };
+
+        inline DirectX::PackedVector::XMHALF4 max_half4(const DirectX::PackedVector::XMHALF4& h, const DirectX::XMFLOAT4& f)
+        {
+            DirectX::PackedVector::XMHALF4 r;
+            r.x = DirectX::PackedVector::XMConvertFloatToHalf(std::max(DirectX::PackedVector::XMConvertHalfToFloat(h.x), f.x));
+            r.y = DirectX::PackedVector::XMConvertFloatToHalf(std::max(DirectX::PackedVector::XMConvertHalfToFloat(h.y), f.y));
+            r.z = DirectX::PackedVector::XMConvertFloatToHalf(std::max(DirectX::PackedVector::XMConvertHalfToFloat(h.z), f.z));
+            r.w = DirectX::PackedVector::XMConvertFloatToHalf(std::max(DirectX::PackedVector::XMConvertHalfToFloat(h.w), f.w));
+            return r;
+        }
+    }
+
+    const float voxelizer::OCCUPIED = 0.5f;
+    const size_t voxelizer::TILE_SIZE;
+
+    voxelizer::voxelizer() :
+        resolution_(0),
+        normal_(),
+        color_()
+    {
+        DirectX::XMStoreFloat4x4(&world_to_volume_, DirectX::XMMatrixIdentity());
+    }
+
+    void voxelizer::create(size_t resolution, bool dense)
+    {
+        resolution_ = resolution;
+
+        if (dense)
+            clear();
+    }
+
+    void voxelizer::destroy()
+    {
+        resolution_ = 0;
+
+        normal_.clear();
+        normal_.shrink_to_fit();
+        color_.clear();
+        color_.shrink_to_fit();
+    }
+
+    void voxelizer::clear()
+    {
+        DirectX::PackedVector::XMHALF4 zero;
+        zero.x = zero.y = zero.z = zero.w = 0;
+
+        normal_.assign(resolution_ * resolution_ * resolution_, zero);
+        color_.assign(resolution_ * resolution_ * resolution_, zero);
+    }
+
+    void voxelizer::set_model_matrix(const DirectX::XMFLOAT4X4& model, const DirectX::XMFLOAT3& volume_min, const DirectX::XMFLOAT3& volume_max)
+    {
+        DirectX::XMMATRIX model_inv = DirectX::XMMatrixInverse(nullptr, DirectX::XMLoadFloat4x4(&model));
+
+        DirectX::XMMATRIX trans = DirectX::XMMatrixTranslation(-volume_min.x, -volume_min.y, -volume_min.z);
+        DirectX::XMMATRIX scale = DirectX::XMMatrixScaling(1.f / (volume_max.x - volume_min.x),
+                                                           1.f / (volume_max.y - volume_min.y),
+                                                           1.f / (volume_max.z - volume_min.z));
+
+        DirectX::XMStoreFloat4x4(&world_to_volume_, model_inv * trans * scale);
+    }
+
+    template<typename F>
+    void voxelizer::voxelize(const std::vector<voxel_triangle>& triangles, F flush) const
+    {
+        if (resolution_ == 0)
+            return;
+
+        const int res = static_cast<int>(resolution_);
+        const size_t tile_size = std::min(TILE_SIZE, resolution_);
+        const size_t tiles = (resolution_ + tile_size - 1) / tile_size;
+
+        const float r = static_cast<float>(resolution_);
+        const DirectX::XMMATRIX to_voxels = DirectX::XMMatrixMultiply(DirectX::XMLoadFloat4x4(&world_to_volume_), DirectX::XMMatrixScaling(r, r, r));
+
+        std::vector<detail::voxel_setup> setups(triangles.size());
+        std::vector<unsigned char> valid(triangles.size());
+
+        parallel_for(0, triangles.size(), [&](size_t first, size_t last)
+        {
+            for (size_t i = first; i < last; ++i)
+                valid[i] = detail::setup_triangle(triangles[i], to_voxels, res, setups[i]);
+        });
+
+        // bin triangles into all tiles their bounding box touches
+        std::vector<std::vector<std::pair<uint32_t, uint32_t>>> worker_bins(num_workers());
+
+        parallel_for_dynamic(0, triangles.size(), 1024, [&](size_t worker, size_t first, size_t last)
+        {
+            auto& bins = worker_bins[worker];
+
+            for (size_t i = first; i < last; ++i)
+            {
+                if (!valid[i])
+                    continue;
+
+                const detail::voxel_setup& s = setups[i];
+
+                for (size_t tz = s.lo[2] / tile_size; tz <= s.hi[2] / tile_size; ++tz)
+                for (size_t ty = s.lo[1] / tile_size; ty <= s.hi[1] / tile_size; ++ty)
+                for (size_t tx = s.lo[0] / tile_size; tx <= s.hi[0] / tile_size; ++tx)
+                    bins.push_back(std::make_pair(static_cast<uint32_t>((tz * tiles + ty) * tiles + tx), static_cast<uint32_t>(i)));
+            }
+        });
+
+        std::vector<std::pair<uint32_t, uint32_t>> bins;
+
+        for (auto b = worker_bins.begin(); b != worker_bins.end(); ++b)
+        {
+            bins.insert(bins.end(), b->begin(), b->end());
+            std::vector<std::pair<uint32_t, uint32_t>>().swap(*b);
+        }
+
+        parallel_sort(bins.begin(), bins.end(), [](const std::pair<uint32_t, uint32_t>& a, const std::pair<uint32_t, uint32_t>& b)
+        {
+            return a.first < b.first;
+        });
+
+        std::vector<size_t> starts;
+
+        for (size_t i = 0; i < bins.size(); ++i)
+            if (i == 0 || bins[i].first != bins[i - 1].first)
+                starts.push_back(i);
+
+        starts.push_back(bins.size());
+
+        std::vector<detail::voxel_tile> scratch(num_workers());
+
+        for (auto s = scratch.begin(); s != scratch.end(); ++s)
+            s->resize(tile_size * tile_size * tile_size);
+
+        // each tile is owned by one worker, so tiles can be written without synchronization
+        parallel_for_dynamic(0, starts.size() - 1, 1, [&](size_t worker, size_t first, size_t last)
+        {
+            detail::voxel_tile& tile = scratch[worker];
+
+            for (size_t t = first; t < last; ++t)
+            {
+                const uint32_t index = bins[starts[t]].first;
+
+                const int origin[3] =
+                {
+                    static_cast<int>((index % tiles) * tile_size),
+                    static_cast<int>((index / tiles % tiles) * tile_size),
+                    static_cast<int>((index / (tiles * tiles)) * tile_size)
+                };
+
+                const int ts = static_cast<int>(tile_size);
+
+                for (size_t b = starts[t]; b < starts[t + 1]; ++b)
+                {
+                    const detail::voxel_setup& s = setups[bins[b].second];
+
+                    int lo[3], hi[3];
+
+                    for (size_t a = 0; a < 3; ++a)
+                    {
+                        lo[a] = std::max(s.lo[a], origin[a]);
+                        hi[a] = std::min(s.hi[a], origin[a] + ts - 1);
+                    }
+
+                    detail::for_each_overlap(s, lo, hi, [&](int x, int y, int z)
+                    {
+                        const uint32_t local = static_cast<uint32_t>(((z - origin[2]) * ts + (y - origin[1])) * ts + (x - origin[0]));
+
+                        DirectX::XMVECTOR n = detail::interpolate_normal(s, x, y, z);
+                        n = DirectX::XMVectorMultiplyAdd(n, DirectX::XMVectorReplicate(0.5f), DirectX::XMVectorReplicate(0.5f));
+                        n = DirectX::XMVectorSetW(n, OCCUPIED);
+
+                        DirectX::XMVECTOR c = DirectX::XMVectorSetW(DirectX::XMLoadFloat3(&s.albedo), 1.f);
+
+                        // max blend, like bs_voxelize_
+                        DirectX::XMStoreFloat4(&tile.normal[local], DirectX::XMVectorMax(DirectX::XMLoadFloat4(&tile.normal[local]), n));
+                        DirectX::XMStoreFloat4(&tile.color[local], DirectX::XMVectorMax(DirectX::XMLoadFloat4(&tile.color[local]), c));
+
+                        if (!tile.occupied[local])
+                        {
+                            tile.occupied[local] = 1;
+                            tile.touched.push_back(local);
+                        }
+                    });
+                }
+
+                flush(worker, origin, tile);
+
+                for (auto l = tile.touched.begin(); l != tile.touched.end(); ++l)
+                {
+                    tile.normal[*l] = DirectX::XMFLOAT4(0.f, 0.f, 0.f, 0.f);
+                    tile.color[*l] = DirectX::XMFLOAT4(0.f, 0.f, 0.f, 0.f);
+                    tile.occupied[*l] = 0;
+                }
+
+                tile.touched.clear();
+            }
+        });
+    }
+
+    void voxelizer::voxelize(const std::vector<voxel_triangle>& triangles)
+    {
+        if (normal_.size() != resolution_ * resolution_ * resolution_)
+            clear();
+
+        const size_t ts = std::min(TILE_SIZE, resolution_);
+
+        voxelize(triangles, [&](size_t, const int origin[3], const detail::voxel_tile& tile)
+        {
+            for (auto l = tile.touched.begin(); l != tile.touched.end(); ++l)
+            {
+                size_t x = origin[0] + *l % ts;
+                size_t y = origin[1] + *l / ts % ts;
+                size_t z = origin[2] + *l / (ts * ts);
+
+                size_t i = (z * resolution_ + y) * resolution_ + x;
+
+                normal_[i] = detail::max_half4(normal_[i], tile.normal[*l]);
+                color_[i] = detail::max_half4(color_[i], tile.color[*l]);
+            }
+        });
+    }
+
+    void voxelizer::voxelize(const std::vector<voxel_triangle>& triangles, std::vector<voxel_fragment>& fragments) const
+    {
+        const size_t ts = std::min(TILE_SIZE, resolution_);
+
+        std::vector<std::vector<voxel_fragment>> worker_fragments(num_workers());
+
+        voxelize(triangles, [&](size_t worker, const int origin[3], const detail::voxel_tile& tile)
+        {
+            auto& out = worker_fragments[worker];
+
+            for (auto l = tile.touched.begin(); l != tile.touched.end(); ++l)
+            {
+                const DirectX::XMFLOAT4& n = tile.normal[*l];
+                const DirectX::XMFLOAT4& c = tile.color[*l];
+
+                voxel_fragment f;
+                f.x = static_cast<uint32_t>(origin[0] + *l % ts);
+                f.y = static_cast<uint32_t>(origin[1] + *l / ts % ts);
+                f.z = static_cast<uint32_t>(origin[2] + *l / (ts * ts));
+
+                DirectX::XMVECTOR N = DirectX::XMVectorSet(n.x * 2.f - 1.f, n.y * 2.f - 1.f, n.z * 2.f - 1.f, 0.f);
+
+                if (DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(N)) > 1e-12f)
+                    N = DirectX::XMVector3Normalize(N);
+
+                DirectX::XMStoreFloat3(&f.normal, N);
+                f.albedo = DirectX::XMFLOAT3(c.x, c.y, c.z);
+
+                out.push_back(f);
+            }
+        });
+
+        fragments.clear();
+
+        for (auto w = worker_fragments.begin(); w != worker_fragments.end(); ++w)
+            fragments.insert(fragments.end(), w->begin(), w->end());
+    }
+}
@@ -0,0 +1,104 @@
+/*
+ * Dune D3D library - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+/*! \file */
+
+#ifndef DUNE_VOXELIZER
+#define DUNE_VOXELIZER
+
+#include <vector>
+
+#include <DirectXMath.h>
+#include <DirectXPackedVector.h>
+
+#include "voxel_octree.h"
+
+namespace dune
+{
+    /*! \brief A triangle to voxelize, in world coordinates. */
+    struct voxel_triangle
+    {
+        DirectX::XMFLOAT3 position[3];
+        DirectX::XMFLOAT3 normal[3];
+        DirectX::XMFLOAT3 albedo;
+    };
+
+    /*!
+     * \brief A multithreaded CPU voxelizer.
+     *
+     * This is the CPU counterpart of sparse_voxel_octree::voxelize(), for baking, tests or preprocessing without a GPU.
+     * Triangles are voxelized conservatively with the triangle/box overlap test of [[Schwarz and Seidel 2010]](http://dl.acm.org/citation.cfm?id=1866201),
+     * i.e. every voxel touched by a triangle is set. Triangles are binned into tiles of 16^3 voxels, which are then
+     * processed in parallel.
+     *
+     * Like svo_voxelize.hlsl, each voxel stores its normal encoded as N * 0.5 + 0.5 with an occupancy marker in alpha,
+     * and a color. Triangles touching the same voxel are combined with a max blend. The normal is interpolated
+     * from the vertex normals at the projection of the voxel center onto the triangle, clamped to its edges.
+     *
+     * The dense target has the texel layout of the volumes of sparse_voxel_octree and can be uploaded with write_texture().
+     * The sparse target produces one voxel_fragment per occupied voxel to build a voxel_octree.
+     */
+    class voxelizer
+    {
+    protected:
+        size_t                                      resolution_;
+        DirectX::XMFLOAT4X4                         world_to_volume_;
+
+        std::vector<DirectX::PackedVector::XMHALF4> normal_;
+        std::vector<DirectX::PackedVector::XMHALF4> color_;
+
+    protected:
+        template<typename F>
+        void voxelize(const std::vector<voxel_triangle>& triangles, F flush) const;
+
+    public:
+        /*! \brief The alpha of the normal of an occupied voxel, the same svo_voxelize.hlsl writes. */
+        static const float OCCUPIED;
+
+        /*! \brief The edge length of the tiles triangles are binned into. */
+        static const size_t TILE_SIZE = 16;
+
+    public:
+        voxelizer();
+        virtual ~voxelizer() {}
+
+        /*!
+         * \brief Create a voxelizer.
+         *
+         * \param resolution The number of voxels along each axis.
+         * \param dense If true, memory for the dense target is allocated, which is not necessary to create fragments.
+         */
+        void create(size_t resolution, bool dense = true);
+        void destroy();
+
+        /*! \brief Reset the dense target to zero. */
+        void clear();
+
+        size_t resolution() const { return resolution_; }
+
+        /*! \brief Set the transformation of the volume, see sparse_voxel_octree::set_model_matrix(). */
+        void set_model_matrix(const DirectX::XMFLOAT4X4& model, const DirectX::XMFLOAT3& volume_min, const DirectX::XMFLOAT3& volume_max);
+
+        /*! \brief Voxelize triangles into the dense target, blending with what is already in it. */
+        void voxelize(const std::vector<voxel_triangle>& triangles);
+
+        /*!
+         * \brief Voxelize triangles into fragments.
+         *
+         * \param triangles The triangles.
+         * \param fragments One fragment per occupied voxel, in no particular order, with a decoded normal.
+         */
+        void voxelize(const std::vector<voxel_triangle>& triangles, std::vector<voxel_fragment>& fragments) const;
+
+        //!@{
+        /*! \brief Returns the RGBA16F volumes of the dense target, x fastest, then y, then z. */
+        const std::vector<DirectX::PackedVector::XMHALF4>& normals() const { return normal_; }
+        const std::vector<DirectX::PackedVector::XMHALF4>& colors() const { return color_; }
+        //!@}
+    };
+}
+
+#endif
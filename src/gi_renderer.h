@@ -32,26 +32,89 @@ public:
 
 protected:
     dune::profile_query profiler_;
+    dune::profile_query profiler_rsm_;
+
+    size_t stage_inject_;
+
+#ifdef LPV
+    size_t stage_propagate_;
+#else
+    size_t stage_voxelize_;
+    size_t stage_filter_;
+#endif
 
 #ifdef LPV
     dune::light_propagation_volume volume_;
+
+    // cascades in front of the camera, which replace the volume around the scene if cascaded_ is set
+    dune::lpv_cascades cascades_;
+    bool cascaded_;
 #define VOLUME_SIZE LPV_SIZE
 #define VOLUME_PARAMETERS_SLOT SLOT_LPV_PARAMETERS_VS_PS
+#define VOLUME_SNAPSHOT L"../../data/gi_snapshot_lpv.bin"
 #else
     dune::sparse_voxel_octree volume_;
+    dune::voxel_ownership ownership_;
+
+    // a window around the camera, which replaces the volume around the scene if clipmapped_ is set
+    dune::voxel_clipmap clipmap_;
+    bool clipmapped_;
 #define VOLUME_SIZE SVO_SIZE
 #define VOLUME_PARAMETERS_SLOT SLOT_SVO_PARAMETERS_VS_GS_PS
+#define VOLUME_SNAPSHOT L"../../data/gi_snapshot_svo.bin"
 #endif
 
+    // a snapshot is only tried for the first GI solution after loading a configuration,
+    // and saved if that solution had to be computed
+    bool snapshot_pending_;
+    bool snapshot_save_;
+    uint64_t snapshot_key_;
+
+public:
+    gi_renderer() :
+        snapshot_pending_(false),
+        snapshot_save_(false),
+        snapshot_key_(0)
+    {
+#ifdef LPV
+        cascaded_ = false;
+#else
+        clipmapped_ = false;
+#endif
+    }
+
 public:
     virtual void create(ID3D11Device* device)
     {
         rsm_renderer::create(device);
 
+#ifdef LPV
+        // propagation starts from the injection and overwrites it, so both run when the GI parameters change
+        stage_inject_ = pipeline_.add_stage(L"Inject", dune::gi_pipeline::WORLD | dune::gi_pipeline::GI_PARAMETERS, { stage_rsm_ });
+        stage_propagate_ = pipeline_.add_stage(L"Propagate", 0, { stage_inject_ });
+#else
+        // GI parameters are only read by the deferred shader, a clipmap voxelizes the slabs its window slid onto
+        stage_voxelize_ = pipeline_.add_stage(L"Voxelize", dune::gi_pipeline::GEOMETRY | dune::gi_pipeline::WORLD | dune::gi_pipeline::VOLUME_WINDOW);
+        stage_inject_ = pipeline_.add_stage(L"Inject", 0, { stage_rsm_, stage_voxelize_ });
+        stage_filter_ = pipeline_.add_stage(L"Filter", 0, { stage_inject_ });
+#endif
+
+#ifdef LPV
+        // the history is kept in FP16, settings can select a packed format
+        volume_.create(device, VOLUME_SIZE, dune::SH_FORMAT_FP16, LPV_CASCADES);
+
+        // the budget of amortized propagation, which spreads propagation over several frames so that moving
+        // the light doesn't stall a single one; it is off unless the settings turn it on
+        volume_.schedule().set_budget_iterations(8);
+        volume_.schedule().set_budget_ms(2.f);
+#else
         // create sparse voxel octree
         volume_.create(device, VOLUME_SIZE);
+        ownership_.create(VOLUME_SIZE);
+#endif
 
-        profiler_.create(device);
+        profiler_.create(device, "Deferred");
+        profiler_rsm_.create(device, "RSM");
 
         load_shader(device);
     }
@@ -61,6 +124,11 @@ public:
         rsm_renderer::destroy();
         volume_.destroy();
         profiler_.destroy();
+        profiler_rsm_.destroy();
+
+#ifndef LPV
+        ownership_.destroy();
+#endif
     }
 
     virtual void render(ID3D11DeviceContext* context, ID3D11RenderTargetView* backbuffer, ID3D11DepthStencilView* dsv)
@@ -131,6 +199,12 @@ protected:
         volume_.set_inject_shader(vs, gs, ps, ps1, SLOT_TEX_LPV_INJECT_RSM_START);
         cleanup();
 
+        // lpv geometry volume inject shader
+        dune::compile_shader(device, L"../../shader/lpv_inject.hlsl", "vs_5_0", "vs_gv_inject", shader_flags, nullptr, &vs);
+        dune::compile_shader(device, L"../../shader/lpv_inject.hlsl", "ps_5_0", "ps_gv_inject", shader_flags, nullptr, &ps);
+        volume_.set_geometry_inject_shader(vs, ps);
+        cleanup();
+
         // lpv propagate shader
         dune::compile_shader(device, L"../../shader/lpv_propagate.hlsl", "vs_5_0", "vs_lpv_propagate", shader_flags, nullptr, &vs, &vs_blob);
         dune::compile_shader(device, L"../../shader/lpv_propagate.hlsl", "gs_5_0", "gs_lpv_propagate", shader_flags, nullptr, &gs);
@@ -138,6 +212,11 @@ protected:
         volume_.set_propagate_shader(device, vs, gs, ps, vs_blob, SLOT_TEX_LPV_PROPAGATE_START);
         cleanup();
 
+        // lpv history pack shader
+        dune::compile_shader(device, L"../../shader/lpv_pack.hlsl", "ps_5_0", "ps_lpv_pack", shader_flags, nullptr, &ps);
+        volume_.set_pack_shader(ps);
+        cleanup();
+
         // lpv volume visualization
         dune::compile_shader(device, L"../../shader/lpv_rendervol.hlsl", "vs_5_0", "vs_rendervol", shader_flags, nullptr, &vs, &vs_blob);
         dune::compile_shader(device, L"../../shader/lpv_rendervol.hlsl", "ps_5_0", "ps_rendervol", shader_flags, nullptr, &ps);
@@ -159,6 +238,135 @@ protected:
 #endif
     }
 
+#ifdef LPV
+    /*!
+     * \brief Center the LPV cascades half the extent of the finest one in front of the camera.
+     *
+     * The finest cascade is as large as the volume around the scene, and is sized again if resize is set.
+     * If any cascade moved, the LPV is placed on the cascades and injected again.
+     */
+    void place_cascades(ID3D11DeviceContext* context, bool resize)
+    {
+        if (resize)
+        {
+            DirectX::XMMATRIX world = DirectX::XMLoadFloat4x4(&scene_.world());
+
+            DirectX::XMVECTOR diag = DirectX::XMVectorSubtract(
+                DirectX::XMVector3Transform(DirectX::XMLoadFloat3(&bb_max_), world),
+                DirectX::XMVector3Transform(DirectX::XMLoadFloat3(&bb_min_), world));
+
+            DirectX::XMFLOAT3 d;
+            DirectX::XMStoreFloat3(&d, DirectX::XMVectorAbs(diag));
+
+            float extent = d.x > d.y ? d.x : d.y;
+            extent = extent > d.z ? extent : d.z;
+
+            cascades_.create(LPV_CASCADES, LPV_SIZE, extent, false);
+        }
+
+        DirectX::XMVECTOR eye = camera_.GetEyePt();
+        DirectX::XMVECTOR ahead = DirectX::XMVector3Normalize(DirectX::XMVectorSubtract(camera_.GetLookAtPt(), eye));
+
+        DirectX::XMFLOAT3 center;
+        DirectX::XMStoreFloat3(&center, DirectX::XMVectorAdd(eye, DirectX::XMVectorScale(ahead, cascades_.cascade(0).extent * 0.5f)));
+
+        if (cascades_.update(center) || resize)
+        {
+            volume_.set_cascades(context, cascades_, SLOT_LPV_PARAMETERS_VS_PS);
+            pipeline_.invalidate(dune::gi_pipeline::GI_PARAMETERS);
+        }
+    }
+#else
+    /*!
+     * \brief Center a single level clipmap as large as the volume around the scene on the camera.
+     *
+     * The level is sized again if resize is set. If the window moved, the SVO is placed on it and the exposed
+     * slabs are voxelized in render_volume(). Cone tracing only uses this one level, coarser levels would need
+     * volumes of their own.
+     */
+    void place_clipmap(ID3D11DeviceContext* context, bool resize)
+    {
+        if (resize)
+        {
+            DirectX::XMMATRIX world = DirectX::XMLoadFloat4x4(&scene_.world());
+
+            DirectX::XMVECTOR diag = DirectX::XMVectorSubtract(
+                DirectX::XMVector3Transform(DirectX::XMLoadFloat3(&bb_max_), world),
+                DirectX::XMVector3Transform(DirectX::XMLoadFloat3(&bb_min_), world));
+
+            DirectX::XMFLOAT3 d;
+            DirectX::XMStoreFloat3(&d, DirectX::XMVectorAbs(diag));
+
+            float extent = d.x > d.y ? d.x : d.y;
+            extent = extent > d.z ? extent : d.z;
+
+            clipmap_.create(1, SVO_SIZE, extent / SVO_SIZE);
+        }
+
+        DirectX::XMFLOAT3 eye;
+        DirectX::XMStoreFloat3(&eye, camera_.GetEyePt());
+
+        clipmap_.update(eye);
+
+        if (!clipmap_.regions().empty())
+        {
+            volume_.set_clipmap(context, clipmap_, 0, SLOT_SVO_PARAMETERS_VS_GS_PS);
+            pipeline_.invalidate(dune::gi_pipeline::VOLUME_WINDOW);
+        }
+    }
+
+    /*! \brief Clear and voxelize the regions of the clipmap, or its whole window if a mesh changed. */
+    void voxelize_clipmap(ID3D11DeviceContext* context)
+    {
+        if (!ownership_.light_only())
+        {
+            DirectX::XMFLOAT3 eye;
+            DirectX::XMStoreFloat3(&eye, camera_.GetEyePt());
+
+            clipmap_.invalidate();
+            clipmap_.update(eye);
+        }
+
+        std::vector<dune::voxel_box> boxes;
+
+        for (auto r = clipmap_.regions().begin(); r != clipmap_.regions().end(); ++r)
+        {
+            boxes.clear();
+            clipmap_.texture_boxes(*r, boxes);
+            volume_.clear(context, boxes);
+
+            const int32_t* origin = clipmap_.origin(r->level);
+
+            dune::voxel_box window_voxels;
+
+            for (size_t a = 0; a < 3; ++a)
+            {
+                window_voxels.min[a] = static_cast<uint32_t>(r->min[a] - origin[a]);
+                window_voxels.max[a] = static_cast<uint32_t>(r->max[a] - origin[a]);
+            }
+
+            volume_.set_voxelize_region(context, window_voxels);
+
+            for (size_t x = 0; x < scene_.size(); ++x)
+            {
+                dune::gilga_mesh* m = dynamic_cast<dune::gilga_mesh*>(scene_[x].get());
+
+                if (m)
+                {
+                    m->set_shader_slots(SLOT_TEX_DIFFUSE);
+                    volume_.voxelize(context, *m, false);
+                }
+            }
+        }
+
+        // the whole window for inject()
+        dune::voxel_box all = { { 0, 0, 0 }, { SVO_SIZE, SVO_SIZE, SVO_SIZE } };
+        volume_.set_voxelize_region(context, all);
+
+        volume_.store_emissive(context);
+    }
+#endif
+
     /*! \brief Render/compute the GI volume, whether it be LPV or SVO. */
     void render_volume(ID3D11DeviceContext* context, float* clear_color)
     {
@@ -167,52 +375,204 @@ protected:
         context->PSSetShaderResources(SLOT_TEX_LPV_DEFERRED_START, 3, null_srv);
 
         // TODO: inject main_light, not main_light.rsm()
-        volume_.inject(context, main_light_.rsm(), true);
-        volume_.render(context);
+        if (pipeline_.runs(stage_inject_))
+            volume_.inject(context, main_light_.rsm(), true);
+
+        if (pipeline_.runs(stage_propagate_))
+            volume_.render(context);
+
         volume_.to_ps(context, SLOT_TEX_LPV_DEFERRED_START);
+        volume_.history_to_ps(context, SLOT_TEX_LPV_HISTORY_START);
 #else
-        // voxelize scene
-        for (size_t x = 0; x < scene_.size(); ++x)
+        // remove the last injection
+        if (pipeline_.runs(stage_inject_))
+            volume_.restore_emissive(context);
+
+        if (pipeline_.runs(stage_voxelize_))
+        {
+            // find meshes which moved since the last voxelization
+            for (size_t x = 0; x < scene_.size(); ++x)
+            {
+                dune::gilga_mesh* m = dynamic_cast<dune::gilga_mesh*>(scene_[x].get());
+                if (m) ownership_.set_mesh(x, m->bb_min(), m->bb_max(), m->world());
+            }
+
+            ownership_.update();
+        }
+
+        // clear and voxelize only the slabs the window slid onto, or the bricks touched by moved meshes
+        if (pipeline_.runs(stage_voxelize_) && clipmapped_)
+            voxelize_clipmap(context);
+        else if (pipeline_.runs(stage_voxelize_) && !ownership_.light_only())
         {
-            dune::gilga_mesh* m = dynamic_cast<dune::gilga_mesh*>(scene_[x].get());
-            m->set_shader_slots(SLOT_TEX_DIFFUSE);
-            if (m) volume_.voxelize(context, *m, x == 0);
+            volume_.clear(context, ownership_.regions());
+
+            for (auto x = ownership_.meshes().begin(); x != ownership_.meshes().end(); ++x)
+            {
+                dune::gilga_mesh* m = dynamic_cast<dune::gilga_mesh*>(scene_[*x].get());
+
+                if (m)
+                {
+                    m->set_shader_slots(SLOT_TEX_DIFFUSE);
+                    volume_.voxelize(context, *m, false);
+                }
+            }
+
+            volume_.store_emissive(context);
         }
 
-        volume_.inject(context, main_light_);
+        if (pipeline_.runs(stage_inject_))
+            volume_.inject(context, main_light_);
 
         // prefilter volume
-        volume_.filter(context);
+        if (pipeline_.runs(stage_filter_))
+            volume_.filter(context);
 
         // upload to gpu
         volume_.to_ps(context, SLOT_TEX_SVO_V_START);
 #endif
     }
 
+    /*! \brief Returns true if the GI volume is placed around the camera, i.e. LPV cascades or an SVO clipmap. */
+    bool follows_camera() const
+    {
+#ifdef LPV
+        return cascaded_;
+#else
+        return clipmapped_;
+#endif
+    }
+
+    /*! \brief Upload the GI volume from the snapshot file if its key matches the current scene and lighting. */
+    bool load_volume_snapshot(ID3D11DeviceContext* context)
+    {
+        // a volume placed around the camera depends on it, which the key doesn't cover
+        if (follows_camera())
+            return false;
+
+        dune::gi_snapshot snapshot;
+
+        if (!snapshot.load(VOLUME_SNAPSHOT) || snapshot.key() != snapshot_key_)
+            return false;
+
+        if (!volume_.load_snapshot(context, snapshot))
+            return false;
+
+#ifdef LPV
+        volume_.to_ps(context, SLOT_TEX_LPV_DEFERRED_START);
+        volume_.history_to_ps(context, SLOT_TEX_LPV_HISTORY_START);
+#else
+        volume_.to_ps(context, SLOT_TEX_SVO_V_START);
+
+        // the snapshot replaced the voxels, the next change needs a full voxelization
+        ownership_.invalidate();
+#endif
+
+        return true;
+    }
+
+    /*! \brief Write the GI volume to the snapshot file once it is complete. */
+    void save_volume_snapshot(ID3D11DeviceContext* context)
+    {
+        if (follows_camera())
+        {
+            snapshot_save_ = false;
+            return;
+        }
+
+#ifdef LPV
+        if (volume_.amortized() && !volume_.schedule().converged())
+            return;
+#endif
+
+        dune::gi_snapshot snapshot;
+        snapshot.set_key(snapshot_key_);
+        volume_.save_snapshot(context, snapshot);
+
+        try
+        {
+            snapshot.save(VOLUME_SNAPSHOT);
+        }
+        catch (dune::exception& e)
+        {
+            tcerr << L"Couldn't save GI snapshot: " << e.msg() << std::endl;
+        }
+
+        snapshot_save_ = false;
+    }
+
     /*!
     * \brief Compute global illumination for the scene.
     *
-    * This method first makes sure that the RSM/GI solution needs to be updated.
-    * If so, a new RSM is rendered for one directional light, which will then be injected
-    * into a volume and further processed.
+    * This method first schedules the stages of the RSM/GI solution whose inputs changed.
+    * The RSM is rendered for one directional light if the scene or the light changed, and
+    * the volume is voxelized, injected and further processed as far as needed.
     */
     void render_gi(ID3D11DeviceContext* context, float* clear_color)
     {
-        if (update_rsm_)
+        DUNE_PROFILE_ZONE("GI");
+
+#ifdef LPV
+        // moving the camera far enough moves the cascades
+        if (cascaded_)
+            place_cascades(context, false);
+#else
+        // moving the camera by two voxels slides the clipmap
+        if (clipmapped_)
+            place_clipmap(context, false);
+#endif
+
+        pipeline_.schedule();
+
+        if (pipeline_.busy())
         {
-            // setup rsm view
+            // setup rsm view, which injection reads as well
             update_rsm_camera_parameters(context, main_light_);
 
             // inject first bounce
-            profiler_.begin(context);
-            render_rsm(context, clear_color, main_light_.rsm());
-            time_rsm_ = profiler_.result();
+            if (pipeline_.runs(stage_rsm_))
+            {
+                profiler_rsm_.begin(context);
+                render_rsm(context, clear_color, main_light_.rsm());
+                profiler_rsm_.end();
+            }
+
+            // render gi volume, unless the last run left a snapshot of it
+            snapshot_save_ = false;
+
+            if (!snapshot_pending_)
+                render_volume(context, clear_color);
+            else if (!load_volume_snapshot(context))
+            {
+                render_volume(context, clear_color);
+                snapshot_save_ = true;
+            }
+
+            snapshot_pending_ = false;
+
+            if (snapshot_save_)
+                save_volume_snapshot(context);
+        }
+#ifdef LPV
+        else if (volume_.amortized() && !volume_.schedule().converged())
+        {
+            // continue propagating the last injection
+            ID3D11ShaderResourceView* null_srv[] = { nullptr, nullptr, nullptr };
+            context->PSSetShaderResources(SLOT_TEX_LPV_DEFERRED_START, 3, null_srv);
+            context->PSSetShaderResources(SLOT_TEX_LPV_HISTORY_START, 3, null_srv);
 
-            // render gi volume
-            render_volume(context, clear_color);
+            volume_.render_amortized(context);
+            volume_.to_ps(context, SLOT_TEX_LPV_DEFERRED_START);
+            volume_.history_to_ps(context, SLOT_TEX_LPV_HISTORY_START);
 
-            update_rsm_ = false;
+            if (snapshot_save_)
+                save_volume_snapshot(context);
         }
+#endif
+
+        // timings of earlier frames, also of stages which didn't run this one
+        time_rsm_ = profiler_rsm_.latest();
+        volume_.update_timings();
     }
 
 public:
@@ -220,11 +580,23 @@ public:
     {
         volume_.set_model_matrix(the_context, scene_.world(), bb_min_, bb_max_, SLOT_LPV_PARAMETERS_VS_PS);
         volume_.parameters().to_ps(context, SLOT_GI_PARAMETERS_PS);
-        update_rsm_ = true;
+
+#ifdef LPV
+        if (cascaded_)
+            place_cascades(context, true);
+#else
+        if (clipmapped_)
+            place_clipmap(context, true);
+        else
+            ownership_.set_model_matrix(scene_.world(), bb_min_, bb_max_);
+#endif
+        invalidate_gi_parameters(scene_.world());
     }
 
     void update_everything(ID3D11DeviceContext* context)
     {
+        pipeline_.invalidate(dune::gi_pipeline::ALL);
+
         update_scene(context, DirectX::XMMatrixIdentity());
         update_camera_parameters(context);
         update_light_parameters(context, main_light_);
@@ -243,6 +615,12 @@ public:
     {
         rsm_renderer::save(s);
         s << volume_;
+
+#ifdef LPV
+        s.put(L"gi.lpv.cascaded", static_cast<dune::BOOL>(cascaded_));
+#else
+        s.put(L"gi.svo.clipmap", static_cast<dune::BOOL>(clipmapped_));
+#endif
     }
 
     virtual void load(ID3D11DeviceContext* context, const dune::serializer& s)
@@ -251,6 +629,29 @@ public:
 
         s >> volume_;
 
+#ifdef LPV
+        try
+        {
+            cascaded_ = s.get<bool>(L"gi.lpv.cascaded");
+        }
+        catch (dune::exception& e)
+        {
+            tcerr << L"Couldn't load LPV cascades: " << e.msg() << std::endl;
+        }
+#else
+        try
+        {
+            set_clipmapped(s.get<bool>(L"gi.svo.clipmap"));
+        }
+        catch (dune::exception& e)
+        {
+            tcerr << L"Couldn't load SVO clipmap: " << e.msg() << std::endl;
+        }
+#endif
+
+        snapshot_key_ = dune::gi_snapshot_key(files_scene, s);
+        snapshot_pending_ = true;
+
         update_everything(context);
     }
 
@@ -258,6 +659,45 @@ public:
     {
         return volume_;
     }
+
+#ifdef LPV
+    //!@{
+    /*! \brief Get/set if the LPV cascades follow the camera instead of covering the scene, applied by update_gi_parameters(). */
+    bool cascaded() const { return cascaded_; }
+    void set_cascaded(bool c) { cascaded_ = c; }
+    //!@}
+#else
+    //!@{
+    /*! \brief Get/set if the SVO is a clipmap window around the camera instead of covering the scene, applied by update_gi_parameters(). */
+    bool clipmapped() const { return clipmapped_; }
+
+    void set_clipmapped(bool c)
+    {
+        if (c == clipmapped_)
+            return;
+
+        // the volume holds the other placement, so everything is voxelized again
+        clipmapped_ = c;
+        clipmap_.invalidate();
+        ownership_.invalidate();
+        pipeline_.invalidate(dune::gi_pipeline::VOLUME_WINDOW);
+    }
+    //!@}
+#endif
+
+    //!@{
+    /*! \brief Returns rolling statistics of the GPU timings of the RSM and the deferred pass. */
+    dune::profile_stats stats_rsm() const      { return profiler_rsm_.stats(); }
+    dune::profile_stats stats_deferred() const { return profiler_.stats(); }
+    //!@}
+
+#ifndef LPV
+    /*! \brief Returns what the last GI update voxelized and skipped. */
+    const dune::revoxelization_stats& revoxelization() const
+    {
+        return ownership_.stats();
+    }
+#endif
 };
 
 #endif
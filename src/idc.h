@@ -35,6 +35,14 @@ enum
     IDC_GI_INFO1,
     IDC_GI_INFO2,
     IDC_GI_INFO3,
+    IDC_LPV_AMORTIZED,
+    IDC_LPV_BUDGET_ITERATIONS,
+    IDC_LPV_BUDGET_MS,
+    IDC_LPV_BUDGET_INFO,
+    IDC_LPV_HISTORY_FORMAT,
+    IDC_LPV_CASCADED,
+    IDC_LPV_OCCLUSION,
+    IDC_SVO_CLIPMAP,
 
     IDC_SSAO_ENABLED,
     IDC_SSAO_SCALE,
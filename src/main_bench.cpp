@@ -0,0 +1,1007 @@
+/*
+ * The Dirtchamber - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+/*! \file */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <dune/anisotropic_voxels.h>
+#include <dune/cone_tracer.h>
+#include <dune/distance_field.h>
+#include <dune/frame_profiler.h>
+#include <dune/gi_snapshot.h>
+#include <dune/lpv_cascades.h>
+#include <dune/lpv_grid.h>
+#include <dune/parallel_tools.h>
+#include <dune/serializer.h>
+#include <dune/sh_packing.h>
+#include <dune/tiled_volume.h>
+#include <dune/unicode.h>
+#include <dune/voxel_octree.h>
+#include <dune/voxelizer.h>
+#include <dune/voxel_clipmap.h>
+#include <dune/voxel_dag.h>
+#include <dune/voxel_ownership.h>
+
+#include "bench_tools.h"
+
+namespace bench
+{
+    void lpv_propagate()
+    {
+        const size_t iterations = 8;
+        const size_t sizes[] = { 32, 64, 128 };
+
+        for (size_t s : sizes)
+        {
+            dune::lpv_grid grid;
+            grid.create(s, s, s);
+            grid.set_num_propagations(iterations);
+
+            random_inject(grid);
+            grid.normalize();
+
+            double ms = best_of(3, [&]()
+            {
+                grid.propagate(iterations);
+            });
+
+            double cells = static_cast<double>(s * s * s) * iterations;
+
+            tcout << L"lpv_propagate " << s << L"^3 x " << iterations << L": "
+                  << std::fixed << std::setprecision(2) << ms << L"ms, "
+                  << cells / (ms * 1000.0) << L" Mcells*iterations/s" << std::endl;
+
+            grid.destroy();
+        }
+    }
+
+    void lpv_sparse()
+    {
+        const size_t size = 64;
+        const size_t iterations = 8;
+
+        dune::lpv_grid grid;
+        grid.create(size, size, size);
+
+        // a few small light spots, like a spot light hitting a wall
+        auto inject_spots = [&]()
+        {
+            const size_t spots[][3] = { { 10, 4, 12 }, { 40, 20, 50 }, { 30, 60, 8 } };
+
+            grid.clear();
+
+            dune::sh_volume& v = grid.injected();
+
+            for (auto s = std::begin(spots); s != std::end(spots); ++s)
+            for (size_t z = (*s)[2]; z < (*s)[2] + 3; ++z)
+            for (size_t y = (*s)[1]; y < (*s)[1] + 3; ++y)
+            for (size_t x = (*s)[0]; x < (*s)[0] + 3; ++x)
+            {
+                for (size_t ch = 0; ch < 3; ++ch)
+                    v.set(ch, x, y, z, DirectX::XMFLOAT4(1.f, 0.f, 0.5f, 0.f));
+
+                grid.inject_counter()[v.index(x, y, z)] = 1.f;
+            }
+
+            grid.update_bricks();
+            grid.normalize();
+        };
+
+        grid.set_num_propagations(iterations);
+
+        for (bool sparse : { false, true })
+        {
+            grid.set_sparse(sparse);
+
+            double ms = std::numeric_limits<double>::max();
+
+            for (size_t i = 0; i < 3; ++i)
+            {
+                inject_spots();
+                grid.propagate(iterations);
+                ms = std::min(ms, static_cast<double>(grid.time_propagate_));
+            }
+
+            tcout << L"lpv_propagate " << (sparse ? L"sparse " : L"dense ") << size << L"^3 x " << iterations << L", 3 spots: "
+                  << std::fixed << std::setprecision(2) << ms << L"ms, "
+                  << grid.cells_updated() << L" cell updates" << std::endl;
+        }
+
+        grid.destroy();
+    }
+
+    void lpv_amortized()
+    {
+        const size_t size = 64;
+        const size_t iterations = 32;
+        const float budget_ms = 100.f;
+
+        dune::lpv_grid grid;
+        grid.create(size, size, size);
+        grid.set_num_propagations(iterations);
+        grid.schedule().set_budget_ms(budget_ms);
+
+        random_inject(grid);
+        grid.begin_amortized();
+
+        size_t frames = 0;
+        float worst = 0;
+
+        do
+        {
+            ++frames;
+            grid.render_amortized();
+            worst = std::max(worst, grid.time_propagate_);
+        } while (!grid.schedule().converged());
+
+        tcout << L"lpv_amortized " << size << L"^3 x " << iterations << L", " << budget_ms << L"ms budget: "
+              << frames << L" frames, worst frame " << std::fixed << std::setprecision(2) << worst << L"ms" << std::endl;
+
+        grid.destroy();
+    }
+
+    //! Time binning VPLs into the cascades around the origin.
+    void lpv_cascades()
+    {
+        const size_t num_vpls = 1024 * 1024;
+
+        std::mt19937 rng(1337);
+        std::uniform_real_distribution<float> pos(-60.f, 60.f);
+        std::uniform_real_distribution<float> dir(-1.f, 1.f);
+
+        std::vector<dune::vpl> vpls(num_vpls);
+
+        for (auto v = vpls.begin(); v != vpls.end(); ++v)
+        {
+            v->position = DirectX::XMFLOAT3(pos(rng), pos(rng) * 0.1f, pos(rng));
+            DirectX::XMStoreFloat3(&v->normal, DirectX::XMVector3Normalize(DirectX::XMVectorSet(dir(rng), dir(rng), dir(rng), 0)));
+            v->flux = DirectX::XMFLOAT3(1.f, 1.f, 1.f);
+        }
+
+        dune::lpv_cascades cascades;
+        cascades.create(3, 32, 16.f);
+        cascades.update(DirectX::XMFLOAT3(0.f, 0.f, 0.f));
+
+        double ms = best_of(3, [&]()
+        {
+            cascades.inject(vpls);
+        });
+
+        tcout << L"lpv_cascades inject " << num_vpls << L" VPLs: "
+              << std::fixed << std::setprecision(2) << ms << L"ms, "
+              << num_vpls / (ms * 1000.0) << L" MVPLs/s (";
+
+        for (size_t i = 0; i < cascades.num_cascades(); ++i)
+            tcout << (i > 0 ? L" " : L"") << cascades.binned(i).size();
+
+        tcout << L")" << std::endl;
+
+        cascades.destroy();
+    }
+
+    void gi_snapshots()
+    {
+        const size_t size = 32;
+        const size_t num_vpls = 4096;
+
+        // light in one corner only, so the far cells of the volume stay black
+        std::mt19937 rng(1337);
+        std::uniform_real_distribution<float> pos(0.f, 0.25f);
+        std::uniform_real_distribution<float> dir(-1.f, 1.f);
+
+        std::vector<dune::vpl> vpls(num_vpls);
+
+        for (auto v = vpls.begin(); v != vpls.end(); ++v)
+        {
+            v->position = DirectX::XMFLOAT3(pos(rng), pos(rng), pos(rng));
+            DirectX::XMStoreFloat3(&v->normal, DirectX::XMVector3Normalize(DirectX::XMVectorSet(dir(rng), dir(rng), dir(rng), 0)));
+            v->flux = DirectX::XMFLOAT3(1.f, 1.f, 1.f);
+        }
+
+        dune::lpv_grid grid;
+        grid.create(size, size, size);
+        grid.set_num_propagations(8);
+        grid.inject(vpls);
+        grid.render();
+
+        std::vector<unsigned char> packed;
+        dune::encode_sh(grid.result(), dune::SH_FORMAT_FP16, packed);
+
+        dune::gi_snapshot snapshot;
+        snapshot.set_key(dune::hash_bytes(&vpls[0], vpls.size() * sizeof(dune::vpl)));
+        snapshot.add("lpv", size, size, size, static_cast<uint32_t>(dune::sh_format_size(dune::SH_FORMAT_FP16))).data = packed;
+
+        for (bool compress : { false, true })
+        {
+            std::string file;
+
+            double ms_write = best_of(3, [&]()
+            {
+                std::ostringstream os;
+                snapshot.write(os, compress);
+                file = os.str();
+            });
+
+            dune::gi_snapshot loaded;
+
+            double ms_read = best_of(3, [&]()
+            {
+                std::istringstream is(file);
+                loaded.read(is);
+            });
+
+            tcout << L"gi_snapshot " << (compress ? L"compressed" : L"raw") << L": " << file.size() << L" bytes, "
+                  << std::fixed << std::setprecision(2) << ms_write << L"ms write, " << ms_read << L"ms read" << std::endl;
+        }
+
+        grid.destroy();
+    }
+
+    void svo_build(const std::vector<std::string>& scenes)
+    {
+        const size_t resolutions[] = { 256, 512 };
+
+        for (auto scene = scenes.begin(); scene != scenes.end(); ++scene)
+        for (size_t r : resolutions)
+        {
+            std::vector<dune::voxel_fragment> fragments;
+
+            if (!obj_fragments(*scene, r, fragments))
+            {
+                tcout << L"svo_build: cannot open " << dune::to_tstring(*scene) << std::endl;
+                break;
+            }
+
+            dune::voxel_octree svo;
+
+            double ms = best_of(3, [&]()
+            {
+                svo.create(r, fragments);
+            });
+
+            const double mb = 1.0 / (1024.0 * 1024.0);
+
+            tcout << L"svo_build " << dune::to_tstring(*scene) << L" " << r << L"^3: " << fragments.size() << L" fragments, "
+                  << svo.num_voxels() << L" voxels, " << std::fixed << std::setprecision(2) << ms << L"ms, "
+                  << svo.memory() * mb << L"MB vs. " << dune::voxel_octree::dense_memory(r) * mb << L"MB dense" << std::endl;
+        }
+    }
+
+    void svo_dag(const std::vector<std::string>& scenes)
+    {
+        const size_t resolutions[] = { 512, 1024 };
+
+        for (auto scene = scenes.begin(); scene != scenes.end(); ++scene)
+        for (size_t r : resolutions)
+        {
+            std::vector<dune::voxel_fragment> fragments;
+
+            if (!obj_fragments(*scene, r, fragments))
+            {
+                tcout << L"svo_dag: cannot open " << dune::to_tstring(*scene) << std::endl;
+                break;
+            }
+
+            dune::voxel_octree svo;
+            svo.create(r, fragments);
+
+            dune::voxel_dag dag;
+
+            double ms = best_of(1, [&]()
+            {
+                dag.create(svo);
+            });
+
+            // the cost of the rank computation of the DAG over the plain traversal of the tree, at occupied voxels of mip 0
+            std::vector<dune::voxel_fragment> probes;
+            const size_t stride = std::max<size_t>(1, fragments.size() / 100000);
+
+            for (size_t i = 0; i < fragments.size(); i += stride)
+                probes.push_back(fragments[i]);
+
+            const size_t occupied = probes.size();
+            float sum_svo = 0.f, sum_dag = 0.f;
+
+            double ms_svo = best_of(3, [&]()
+            {
+                dune::voxel v;
+
+                for (size_t i = 0; i < occupied; ++i)
+                {
+                    svo.lookup(0, probes[i].x, probes[i].y, probes[i].z, v);
+                    sum_svo += v.color.x;
+                }
+            });
+
+            double ms_dag = best_of(3, [&]()
+            {
+                dune::voxel v;
+
+                for (size_t i = 0; i < occupied; ++i)
+                {
+                    dag.lookup(0, probes[i].x, probes[i].y, probes[i].z, v);
+                    sum_dag += v.color.x;
+                }
+            });
+
+            const double mb = 1.0 / (1024.0 * 1024.0);
+            const size_t svo_nodes = svo.nodes().size() * sizeof(dune::voxel_octree::node);
+
+            tcout << L"svo_dag " << dune::to_tstring(*scene) << L" " << r << L"^3: " << dag.num_octree_nodes() << L" -> " << dag.num_nodes() << L" nodes, "
+                  << std::fixed << std::setprecision(2) << svo_nodes * mb << L"MB -> " << dag.node_memory() * mb << L"MB nodes, "
+                  << svo.memory() * mb << L"MB -> " << dag.memory() * mb << L"MB with " << dag.palette_size() << L" palette voxels, "
+                  << ms << L"ms, lookup " << ms_svo * 1e6 / occupied << L"ns vs. " << ms_dag * 1e6 / occupied << L"ns" << std::endl;
+        }
+    }
+
+    void voxelize(const std::vector<std::string>& scenes)
+    {
+        const size_t resolutions[] = { 128, 256, 512 };
+
+        for (auto scene = scenes.begin(); scene != scenes.end(); ++scene)
+        {
+            std::vector<dune::voxel_triangle> triangles;
+            DirectX::XMFLOAT3 bb_min, bb_max;
+
+            if (!obj_triangles(*scene, triangles, bb_min, bb_max))
+            {
+                tcout << L"voxelize: cannot open " << dune::to_tstring(*scene) << std::endl;
+                continue;
+            }
+
+            DirectX::XMFLOAT4X4 model;
+            DirectX::XMStoreFloat4x4(&model, DirectX::XMMatrixIdentity());
+
+            for (size_t r : resolutions)
+            {
+                // the dense target needs 16 bytes per voxel, skip it at 512^3
+                bool dense = r <= 256;
+
+                dune::voxelizer v;
+                v.create(r, dense);
+                v.set_model_matrix(model, bb_min, bb_max);
+
+                std::vector<dune::voxel_fragment> fragments;
+
+                double ms_sparse = best_of(3, [&]()
+                {
+                    v.voxelize(triangles, fragments);
+                });
+
+                tcout << L"voxelize " << dune::to_tstring(*scene) << L" " << r << L"^3: " << triangles.size() << L" triangles, "
+                      << fragments.size() << L" voxels, " << std::fixed << std::setprecision(2)
+                      << ms_sparse << L"ms sparse (" << triangles.size() / ms_sparse << L" Ktris/s, "
+                      << fragments.size() / (ms_sparse * 1000.0) << L" Mvoxels/s)";
+
+                if (dense)
+                {
+                    double ms_dense = best_of(3, [&]()
+                    {
+                        v.clear();
+                        v.voxelize(triangles);
+                    });
+
+                    tcout << L", " << ms_dense << L"ms dense";
+                }
+
+                tcout << std::endl;
+            }
+        }
+    }
+
+    //! Move cubes in a volume and revoxelize only what voxel_ownership reports, timed against a full voxelization.
+    void revoxelization()
+    {
+        const uint32_t r = 128;
+        const size_t grid = 4;
+
+        DirectX::XMFLOAT4X4 identity;
+        DirectX::XMStoreFloat4x4(&identity, DirectX::XMMatrixIdentity());
+
+        const DirectX::XMFLOAT3 bb_min(-0.5f, -0.5f, -0.5f), bb_max(0.5f, 0.5f, 0.5f);
+        const DirectX::XMFLOAT3 volume_min(0.f, 0.f, 0.f), volume_max(1.f, 1.f, 1.f);
+
+        // a grid of cubes on the floor of the volume
+        std::vector<DirectX::XMFLOAT4X4> worlds(grid * grid);
+
+        const auto place = [&](size_t i, float dx, float dy)
+        {
+            float x = (i % grid + 0.5f) / grid + dx, z = (i / grid + 0.5f) / grid;
+            DirectX::XMStoreFloat4x4(&worlds[i], DirectX::XMMatrixScaling(0.1f, 0.1f, 0.1f) * DirectX::XMMatrixTranslation(x, 0.1f + dy, z));
+        };
+
+        for (size_t i = 0; i < worlds.size(); ++i)
+            place(i, 0.f, 0.f);
+
+        dune::voxelizer v;
+        v.create(r, false);
+        v.set_model_matrix(identity, volume_min, volume_max);
+
+        dune::voxel_ownership ownership;
+        ownership.create(r);
+        ownership.set_model_matrix(identity, volume_min, volume_max);
+
+        std::vector<unsigned char> occupancy(static_cast<size_t>(r) * r * r, 0);
+        std::vector<dune::voxel_fragment> fragments;
+
+        const auto voxelize_mesh = [&](size_t i, std::vector<unsigned char>& target)
+        {
+            std::vector<dune::voxel_triangle> triangles;
+            cube_triangles(worlds[i], triangles);
+
+            v.voxelize(triangles, fragments);
+
+            for (auto f = fragments.begin(); f != fragments.end(); ++f)
+                target[(static_cast<size_t>(f->z) * r + f->y) * r + f->x] = 1;
+        };
+
+        const wchar_t* frames[] = { L"initial", L"light only", L"one cube lifted", L"cube moved back, neighbour moved next to it", L"light only" };
+
+        for (size_t frame = 0; frame < 5; ++frame)
+        {
+            if (frame == 2)
+                place(5, 0.f, 0.2f);
+
+            if (frame == 3)
+            {
+                place(5, 0.f, 0.f);
+                place(6, -0.12f, 0.f);
+            }
+
+            auto start = clock::now();
+
+            for (size_t i = 0; i < worlds.size(); ++i)
+                ownership.set_mesh(i, bb_min, bb_max, worlds[i]);
+
+            ownership.update();
+
+            for (auto b = ownership.regions().begin(); b != ownership.regions().end(); ++b)
+                for (uint32_t z = b->min[2]; z < b->max[2]; ++z)
+                for (uint32_t y = b->min[1]; y < b->max[1]; ++y)
+                    std::fill_n(occupancy.begin() + (static_cast<size_t>(z) * r + y) * r + b->min[0], b->max[0] - b->min[0], 0);
+
+            for (auto i = ownership.meshes().begin(); i != ownership.meshes().end(); ++i)
+                voxelize_mesh(*i, occupancy);
+
+            double ms = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+
+            // everything from scratch
+            std::vector<unsigned char> full(occupancy.size(), 0);
+
+            start = clock::now();
+
+            for (size_t i = 0; i < worlds.size(); ++i)
+                voxelize_mesh(i, full);
+
+            double ms_full = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+
+            const dune::revoxelization_stats& s = ownership.stats();
+
+            tcout << L"revoxelization " << frames[frame] << L": " << s.meshes_voxelized << L"/" << s.meshes << L" meshes, "
+                  << s.bricks_cleared << L"/" << s.bricks << L" bricks, " << ownership.regions().size() << L" boxes, "
+                  << std::fixed << std::setprecision(2) << ms << L"ms instead of " << ms_full << L"ms"
+                  << (s.light_only ? L", light only" : L"") << std::endl;
+        }
+    }
+
+    //! Compare neighbour-heavy kernels in linear, Morton and bricked layouts.
+    void volume_layouts()
+    {
+        const uint32_t resolutions[] = { 128, 256 };
+        const dune::volume_layout layouts[] = { dune::LAYOUT_LINEAR, dune::LAYOUT_MORTON, dune::LAYOUT_BRICKED };
+        const wchar_t* names[] = { L"linear", L"morton", L"bricked" };
+
+        for (uint32_t r : resolutions)
+        {
+            std::vector<DirectX::XMFLOAT4> input(static_cast<size_t>(r) * r * r);
+
+            std::mt19937 gen(r);
+            std::uniform_real_distribution<float> dist(0.f, 1.f);
+
+            for (auto t = input.begin(); t != input.end(); ++t)
+                *t = DirectX::XMFLOAT4(dist(gen), dist(gen), dist(gen), dist(gen));
+
+            for (size_t l = 0; l < 3; ++l)
+            {
+                dune::tiled_volume<DirectX::XMFLOAT4> src, dst, half;
+                src.create(r, layouts[l]);
+                dst.create(r, layouts[l]);
+                half.create(r / 2, layouts[l]);
+
+                double ms_in = best_of(3, [&]() { src.from_linear(input); });
+                double ms_stencil = best_of(3, [&]() { stencil_step(src, dst); });
+                double ms_reduce = best_of(3, [&]() { reduce_step(src, half); });
+
+                std::vector<DirectX::XMFLOAT4> out;
+
+                double ms_out = best_of(3, [&]() { dst.to_linear(out); });
+
+                tcout << L"volume_layout " << names[l] << L" " << r << L"^3: " << std::fixed << std::setprecision(2)
+                      << ms_stencil << L"ms 6-neighbour step, " << ms_reduce << L"ms 2x2x2 reduction, "
+                      << ms_in << L"ms from linear, " << ms_out << L"ms to linear" << std::endl;
+            }
+        }
+    }
+
+    //! Filter a voxelized scene into six directional mip chains and compare opacity against the isotropic box filter.
+    void anisotropic_mips(const std::string& scene)
+    {
+        const size_t r = 256;
+
+        std::vector<dune::voxel_triangle> triangles;
+        DirectX::XMFLOAT3 bb_min, bb_max;
+
+        if (!obj_triangles(scene, triangles, bb_min, bb_max))
+        {
+            tcout << L"anisotropic_mips: cannot open " << dune::to_tstring(scene) << std::endl;
+            return;
+        }
+
+        DirectX::XMFLOAT4X4 model;
+        DirectX::XMStoreFloat4x4(&model, DirectX::XMMatrixIdentity());
+
+        dune::anisotropic_voxels volume;
+        volume.create(r);
+
+        {
+            dune::voxelizer v;
+            v.create(r);
+            v.set_model_matrix(model, bb_min, bb_max);
+            v.voxelize(triangles);
+
+            // occupied voxels are opaque, with the albedo premultiplied
+            for (size_t i = 0; i < volume.base().size(); ++i)
+            {
+                DirectX::XMVECTOR n = DirectX::PackedVector::XMLoadHalf4(&v.normals()[i]);
+                DirectX::XMVECTOR c = DirectX::PackedVector::XMLoadHalf4(&v.colors()[i]);
+
+                float alpha = DirectX::XMVectorGetW(n) > 0.f ? 1.f : 0.f;
+                DirectX::XMStoreFloat4(&volume.base()[i], DirectX::XMVectorSetW(DirectX::XMVectorScale(c, alpha), alpha));
+            }
+        }
+
+        std::vector<std::vector<DirectX::XMFLOAT4>> iso;
+
+        double ms_aniso = best_of(3, [&]() { volume.filter(); });
+        double ms_iso = best_of(3, [&]() { dune::generate_mips(volume.base(), r, iso); });
+
+        tcout << L"anisotropic_mips " << dune::to_tstring(scene) << L" " << r << L"^3: " << std::fixed << std::setprecision(2)
+              << ms_aniso << L"ms six chains, " << ms_iso << L"ms isotropic reference" << std::endl;
+
+        // mean opacity of non-empty voxels: thin walls keep their opacity along their normal
+        for (size_t mip = 1; mip < 5; ++mip)
+        {
+            double sum_iso = 0, sum_aniso = 0;
+            size_t n = 0;
+
+            for (size_t i = 0; i < iso[mip - 1].size(); ++i)
+            {
+                if (iso[mip - 1][i].w <= 0.f)
+                    continue;
+
+                float a = 0.f;
+
+                for (size_t d = 0; d < 6; ++d)
+                    a = std::max(a, volume.level(static_cast<dune::anisotropic_voxels::direction>(d), mip)[i].w);
+
+                sum_iso += iso[mip - 1][i].w;
+                sum_aniso += a;
+                ++n;
+            }
+
+            tcout << L"  mip " << mip << L": " << n << L" voxels, mean opacity " << std::setprecision(3)
+                  << sum_iso / n << L" isotropic, " << sum_aniso / n << L" along the most opaque direction" << std::endl;
+        }
+    }
+
+    //! Trace a G-buffer with and without skipping empty space with the distance field of the volume.
+    void empty_space_skipping(dune::cone_tracer& tracer, const std::vector<DirectX::XMFLOAT4>& voxels, const dune::gbuffer_image& gbuffer, const DirectX::XMFLOAT3& camera_pos)
+    {
+        dune::distance_field field;
+        field.create(tracer.resolution());
+
+        double ms_build = best_of(3, [&]() { field.build(voxels); });
+
+        size_t empty = 0;
+
+        for (auto d = field.distances().begin(); d != field.distances().end(); ++d)
+            if (*d > 0)
+                ++empty;
+
+        tcout << L"empty_space_skipping " << tracer.resolution() << L"^3: " << std::fixed << std::setprecision(2) << ms_build
+              << L"ms distance field, " << 100.0 * empty / field.distances().size() << L"% empty" << std::endl;
+
+        // the cones of the shader, and narrow cones which take many more samples
+        const size_t cones[] = { 9, 9, 1 };
+        const float apertures[] = { 0.6f, 0.1f, 0.02f };
+
+        for (size_t k = 0; k < 3; ++k)
+        {
+            const size_t c = cones[k];
+
+            dune::float_image images[2];
+            dune::cone_trace_stats stats[2];
+            double ms[2];
+
+            for (size_t skip = 0; skip < 2; ++skip)
+            {
+                dune::cone_parameters parameters;
+                parameters.num_diffuse_cones = c;
+                parameters.diffuse_aperture = apertures[k];
+                parameters.skip_empty_space = skip == 1;
+
+                tracer.set_parameters(parameters);
+
+                ms[skip] = best_of(3, [&]() { stats[skip] = tracer.render(gbuffer, camera_pos, images[skip]); });
+            }
+
+            tcout << L"  " << c << L" diffuse cones, aperture " << std::setprecision(2) << apertures[k] << L": " << ms[0] << L"ms marching, " << ms[1] << L"ms skipping, "
+                  << std::setprecision(1) << static_cast<double>(stats[0].steps) / stats[0].cones << L" -> "
+                  << static_cast<double>(stats[1].steps) / stats[1].cones << L" samples/cone ("
+                  << static_cast<double>(stats[1].skips) / stats[1].cones << L" skips/cone)" << std::endl;
+        }
+    }
+
+    //! Voxelize a scene, light it with a directional light and trace the indirect light of a G-buffer ray cast into the voxels.
+    void cone_tracing(const std::string& scene, const std::string& image_file)
+    {
+        const size_t r = 128;
+        const size_t width = 320, height = 240;
+
+        std::vector<dune::voxel_triangle> triangles;
+        DirectX::XMFLOAT3 bb_min, bb_max;
+
+        if (!obj_triangles(scene, triangles, bb_min, bb_max))
+        {
+            tcout << L"cone_tracing: cannot open " << dune::to_tstring(scene) << std::endl;
+            return;
+        }
+
+        DirectX::XMFLOAT4X4 model;
+        DirectX::XMStoreFloat4x4(&model, DirectX::XMMatrixIdentity());
+
+        dune::voxelizer v;
+        v.create(r);
+        v.set_model_matrix(model, bb_min, bb_max);
+        v.voxelize(triangles);
+
+        // the bounce of a directional light without shadows, and the occupancy of svo_voxelize.hlsl
+        const DirectX::XMVECTOR L = DirectX::XMVector3Normalize(DirectX::XMVectorSet(0.3f, 1.f, 0.5f, 0.f));
+
+        std::vector<DirectX::XMFLOAT4> voxels(r * r * r);
+
+        for (size_t i = 0; i < voxels.size(); ++i)
+        {
+            DirectX::XMVECTOR n = DirectX::PackedVector::XMLoadHalf4(&v.normals()[i]);
+            DirectX::XMVECTOR c = DirectX::PackedVector::XMLoadHalf4(&v.colors()[i]);
+
+            DirectX::XMVECTOR N = DirectX::XMVectorSubtract(DirectX::XMVectorScale(n, 2.f), DirectX::XMVectorSplatOne());
+            float NoL = std::max(DirectX::XMVectorGetX(DirectX::XMVector3Dot(N, L)), 0.f);
+
+            DirectX::XMStoreFloat4(&voxels[i], DirectX::XMVectorSetW(DirectX::XMVectorScale(c, NoL), DirectX::XMVectorGetW(n)));
+        }
+
+        dune::cone_tracer tracer;
+        tracer.create(r);
+        tracer.set_model_matrix(model, bb_min, bb_max);
+        tracer.set_volume(voxels);
+
+        // a camera in the front of the volume looking along -z, casting rays until they hit an occupied voxel
+        const DirectX::XMVECTOR lo = DirectX::XMLoadFloat3(&bb_min), hi = DirectX::XMLoadFloat3(&bb_max);
+        const DirectX::XMVECTOR extent = DirectX::XMVectorSubtract(hi, lo);
+
+        DirectX::XMFLOAT3 camera_pos;
+        DirectX::XMStoreFloat3(&camera_pos, DirectX::XMVectorMultiplyAdd(extent, DirectX::XMVectorSet(0.5f, 0.5f, 0.9f, 0.f), lo));
+
+        dune::gbuffer_image gbuffer;
+        gbuffer.create(width, height);
+
+        const float tan_fov = std::tan(DirectX::XM_PI / 6.f);
+        const float step = DirectX::XMVectorGetX(extent) / (2.f * r);
+
+        for (size_t y = 0; y < height; ++y)
+        for (size_t x = 0; x < width; ++x)
+        {
+            DirectX::XMVECTOR dir = DirectX::XMVector3Normalize(DirectX::XMVectorSet(
+                (2.f * (x + 0.5f) / width - 1.f) * tan_fov * width / height,
+                (1.f - 2.f * (y + 0.5f) / height) * tan_fov, -1.f, 0.f));
+
+            for (float t = 0.f; t < 2.f * DirectX::XMVectorGetX(extent); t += step)
+            {
+                DirectX::XMVECTOR P = DirectX::XMVectorMultiplyAdd(dir, DirectX::XMVectorReplicate(t), DirectX::XMLoadFloat3(&camera_pos));
+
+                DirectX::XMFLOAT3 vp;
+                DirectX::XMStoreFloat3(&vp, DirectX::XMVectorScale(DirectX::XMVectorDivide(DirectX::XMVectorSubtract(P, lo), extent), static_cast<float>(r)));
+
+                if (vp.x < 0.f || vp.y < 0.f || vp.z < 0.f || vp.x >= r || vp.y >= r || vp.z >= r)
+                    continue;
+
+                size_t i = (static_cast<size_t>(vp.z) * r + static_cast<size_t>(vp.y)) * r + static_cast<size_t>(vp.x);
+
+                DirectX::XMVECTOR n = DirectX::PackedVector::XMLoadHalf4(&v.normals()[i]);
+
+                if (DirectX::XMVectorGetW(n) <= 0.f)
+                    continue;
+
+                dune::gbuffer_texel& gb = gbuffer(x, y);
+
+                DirectX::XMStoreFloat3(&gb.position, P);
+                DirectX::XMStoreFloat3(&gb.normal, DirectX::XMVectorSubtract(DirectX::XMVectorScale(n, 2.f), DirectX::XMVectorSplatOne()));
+                DirectX::XMStoreFloat3(&gb.diffuse_albedo, DirectX::PackedVector::XMLoadHalf4(&v.colors()[i]));
+                gb.specular_albedo = DirectX::XMFLOAT3(0.5f, 0.5f, 0.5f);
+                break;
+            }
+        }
+
+        // the reference takes four times as many samples per cone
+        dune::cone_parameters reference_parameters;
+        reference_parameters.step_scale = 0.25f;
+
+        dune::float_image reference;
+        tracer.set_parameters(reference_parameters);
+        dune::cone_trace_stats reference_stats = tracer.render(gbuffer, camera_pos, reference);
+
+        tcout << L"cone_tracing " << dune::to_tstring(scene) << L" " << r << L"^3, " << width << L"x" << height << L": " << std::fixed << std::setprecision(2)
+              << reference_stats.ms << L"ms reference, " << reference_stats.pixels << L" pixels" << std::endl;
+
+        if (!image_file.empty())
+        {
+            std::vector<dune::float_image> mips(1, reference);
+            dune::save_dds(dune::to_tstring(image_file), mips);
+        }
+
+        const size_t cones[] = { 1, 5, 9 };
+        const float step_scales[] = { 1.f, 2.f };
+
+        for (size_t c : cones)
+        for (float s : step_scales)
+        {
+            dune::cone_parameters parameters;
+            parameters.num_diffuse_cones = c;
+            parameters.step_scale = s;
+
+            tracer.set_parameters(parameters);
+
+            dune::float_image image;
+            dune::cone_trace_stats stats;
+
+            double ms = best_of(3, [&]() { stats = tracer.render(gbuffer, camera_pos, image); });
+
+            // relative RMS error of the luminance to the reference
+            double error = 0, sum = 0;
+
+            for (size_t i = 0; i < image.texels.size(); ++i)
+            {
+                const DirectX::XMFLOAT4& a = image.texels[i];
+                const DirectX::XMFLOAT4& b = reference.texels[i];
+
+                double la = a.x + a.y + a.z, lb = b.x + b.y + b.z;
+
+                error += (la - lb) * (la - lb);
+                sum += lb * lb;
+            }
+
+            tcout << L"  " << c << L" diffuse cones, step " << std::setprecision(2) << s << L": " << ms << L"ms, "
+                  << stats.cones / (ms * 1000.0) << L" Mcones/s, " << std::setprecision(1)
+                  << static_cast<double>(stats.steps) / stats.cones << L" samples/cone, " << std::setprecision(2)
+                  << 100.0 * std::sqrt(error / std::max(sum, 1e-12)) << L"% error" << std::endl;
+        }
+
+        empty_space_skipping(tracer, voxels, gbuffer, camera_pos);
+    }
+
+    //! Move a camera through a voxel clipmap and time its updates, with and without a budget for revoxelized slabs.
+    void clipmap()
+    {
+        const size_t levels = 5;
+        const uint32_t r = 64;
+        const float voxel_size = 0.25f;
+        const size_t frames = 300;
+
+        for (size_t budget : { static_cast<size_t>(0), static_cast<size_t>(r * r * 8) })
+        {
+            dune::voxel_clipmap map;
+            map.create(levels, r, voxel_size);
+            map.set_budget(budget);
+
+            size_t voxels = 0, voxels_full = 0, moved = 0, deferred = 0;
+            double ms = 0;
+
+            for (size_t f = 0; f < frames; ++f)
+            {
+                // walk, then run, then teleport
+                const float t = static_cast<float>(f);
+                const float speed = f < 100 ? 0.05f : (f < 200 ? 0.6f : 0.6f + (f % 50 == 0 ? 500.f : 0.f));
+
+                DirectX::XMFLOAT3 camera(std::sin(t * 0.01f) * 40.f + t * speed, 2.f + std::sin(t * 0.1f), -t * speed * 0.5f);
+
+                auto start = clock::now();
+                map.update(camera);
+                ms += std::chrono::duration<double, std::milli>(clock::now() - start).count();
+
+                voxels += map.stats().voxels;
+                voxels_full += map.stats().voxels_full;
+                moved += map.stats().levels_moved;
+                deferred += map.stats().levels_deferred;
+            }
+
+            tcout << L"clipmap " << levels << L" levels of " << r << L"^3, " << frames << L" frames, budget " << budget << L": "
+                  << std::fixed << std::setprecision(2) << ms * 1000.0 / frames << L"us/frame, " << moved << L" level moves, " << deferred
+                  << L" deferred, " << std::setprecision(1) << voxels / 1000.0 / frames << L"K voxels/frame instead of "
+                  << voxels_full / 1000.0 / frames << L"K" << std::endl;
+        }
+    }
+
+    //! Record nested zones on all workers and a GPU track, and time the cost of recording a zone.
+    void frame_profiler()
+    {
+        dune::frame_profiler& profiler = dune::frame_profiler::i();
+        profiler.set_thread_name("Bench");
+
+        const size_t frames = 100;
+        const size_t zones = 16;
+
+        for (size_t f = 0; f < frames; ++f)
+        {
+            DUNE_PROFILE_ZONE("Frame");
+
+            dune::parallel_for(0, dune::num_workers(), [&](size_t first, size_t last)
+            {
+                for (size_t w = first; w < last; ++w)
+                {
+                    DUNE_PROFILE_ZONE("Worker");
+
+                    for (size_t z = 0; z < zones; ++z)
+                    {
+                        DUNE_PROFILE_ZONE("Zone");
+                    }
+                }
+            });
+
+            profiler.gpu_zone("Pass", dune::frame_profiler::now(), 0.5f);
+        }
+
+        auto stats = profiler.zone_stats();
+
+        std::ostringstream trace;
+        profiler.write_trace(trace);
+
+        const std::string json = trace.str();
+
+        // the cost of recording, which also overwrites the ring of this thread
+        const size_t overhead_zones = 1000000;
+
+        double overhead_ms = best_of(3, [&]()
+        {
+            for (size_t z = 0; z < overhead_zones; ++z)
+            {
+                DUNE_PROFILE_ZONE("Overhead");
+            }
+        });
+
+        tcout << L"frame_profiler " << frames << L" frames, " << dune::num_workers() << L" workers: " << std::fixed << std::setprecision(1)
+              << overhead_ms * 1e6 / overhead_zones << L"ns per zone, " << stats.size() << L" zones, trace " << json.size() / 1024 << L"KB" << std::endl;
+
+        for (auto z = stats.begin(); z != stats.end(); ++z)
+            tcout << L"frame_profiler " << (z->gpu ? L"GPU " : L"CPU ") << dune::to_tstring(z->name) << L": " << z->count << L"x, avg "
+                  << std::setprecision(4) << z->average << L"ms, min " << z->min << L"ms, max " << z->max << L"ms" << std::endl;
+    }
+
+    //! Time loading large settings and camera paths with boost::property_tree and the serializer, and getting all their keys.
+    void serializer()
+    {
+        // a large settings file and a camera path with a key frame per frame of a minute at 60Hz
+        write_settings("bench_settings.xml", 500, "bench_camera_path.xml", 3600);
+
+        for (const char* file : { "bench_settings.xml", "bench_camera_path.xml" })
+        {
+            reference_settings reference;
+            dune::serializer s;
+
+            const double reference_load = best_of(5, [&]() { reference.load(file); });
+            const double streaming_load = best_of(5, [&]() { s = dune::serializer(); s.load(dune::to_tstring(file)); });
+
+            std::vector<dune::tstring> keys;
+
+            for (auto p = reference.properties.begin(); p != reference.properties.end(); ++p)
+                keys.push_back(p->first);
+
+            // every key as a float, strings included, like a loader which reads all parameters
+            std::vector<float> expected(keys.size(), 0.f), result(keys.size(), 0.f);
+            std::vector<char> valid(keys.size(), 0);
+
+            const double reference_get = best_of(5, [&]()
+            {
+                for (size_t k = 0; k < keys.size(); ++k)
+                    valid[k] = reference.get(keys[k], expected[k]);
+            });
+
+            const double streaming_get = best_of(5, [&]()
+            {
+                for (size_t k = 0; k < keys.size(); ++k)
+                    if (valid[k])
+                        result[k] = s.get<float>(keys[k].c_str());
+            });
+
+            std::ifstream is(file, std::ios::binary | std::ios::ate);
+
+            tcout << L"serializer " << file << L" " << keys.size() << L" keys, " << is.tellg() / 1024 << L"KB: load "
+                  << std::fixed << std::setprecision(2) << reference_load << L"ms boost, " << streaming_load << L"ms streaming; get "
+                  << reference_get * 1e6 / keys.size() << L"ns stringstream, " << streaming_get * 1e6 / keys.size() << L"ns typed" << std::endl;
+        }
+
+        std::remove("bench_settings.xml");
+        std::remove("bench_camera_path.xml");
+    }
+}
+
+/*
+ * Times the CPU side of dune. Correctness is checked by the tests executable. Scenes default to
+ * the data directory:
+ *
+ * bench [--data directory] [scene] [second svo scene] [second voxelize scene] [dds image]
+ */
+int main(int argc, char* argv[])
+{
+    std::vector<std::string> args(argv + 1, argv + argc);
+
+    const std::string data = bench::data_directory(args);
+
+    args.resize(std::max<size_t>(args.size(), 4));
+
+    const std::string scene = !args[0].empty() ? args[0] : data + "cornellbox/cornellbox.obj";
+    const std::string svo_scene = !args[1].empty() ? args[1] : data + "tracked/happy.obj";
+    const std::string voxelize_scene = !args[2].empty() ? args[2] : data + "skydome/skydome_sphere.obj";
+    const std::string image_file = args[3];
+
+    tcout << L"Workers: " << dune::num_workers() << std::endl;
+
+    const std::function<void()> benches[] =
+    {
+        bench::lpv_propagate,
+        bench::lpv_sparse,
+        bench::lpv_amortized,
+        bench::lpv_cascades,
+        bench::gi_snapshots,
+        bench::frame_profiler,
+        bench::serializer,
+        [&]() { bench::voxelize({ scene, voxelize_scene }); },
+        bench::revoxelization,
+        bench::clipmap,
+        bench::volume_layouts,
+        [&]() { bench::anisotropic_mips(scene); },
+        [&]() { bench::cone_tracing(scene, image_file); },
+        [&]() { bench::svo_build({ scene, svo_scene }); },
+        [&]() { bench::svo_dag({ scene, svo_scene }); },
+    };
+
+    // a bench which can't load its input doesn't stop the others
+    for (auto b = std::begin(benches); b != std::end(benches); ++b)
+    {
+        try
+        {
+            (*b)();
+        }
+        catch (std::exception& e)
+        {
+            tcout << e.what() << std::endl;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,412 @@
+/*
+ * The Dirtchamber - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+/*! \file */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef ASSIMP
+#include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+#endif
+
+#include <dune/common_tools.h>
+#include <dune/exception.h>
+#include <dune/serializer.h>
+#include <dune/summed_area_tables.h>
+#include <dune/unicode.h>
+#include <dune/voxelizer.h>
+
+#define STBI_HEADER_FILE_ONLY
+#include "ext/stb/stb_image.h"
+
+/*
+ * Runs the CPU stages of loading a scene without a window or a D3D device and prints the timings as JSON.
+ * Inputs which aren't given are taken from the data directory, by default ../../data relative to the executable:
+ *
+ * bench_headless [--data directory] [--scene file.obj]... [--settings file.xml] [--image file]... [--lights n] [--runs n] [--out file.json]
+ */
+namespace headless
+{
+    typedef std::chrono::high_resolution_clock clock;
+
+    struct options
+    {
+        std::vector<std::string> scenes;
+        std::vector<std::string> images;
+        std::string settings;
+        std::string out;
+        size_t lights;
+        size_t runs;
+    };
+
+    struct stage
+    {
+        std::string name;
+        std::string unit;
+        std::vector<double> ms;
+        double work;            //!< units of work per run
+    };
+
+    struct skipped
+    {
+        std::string name;
+        std::string reason;
+    };
+
+    //! Run a stage a number of times. f returns the units of work it did.
+    stage run(const std::string& name, const std::string& unit, size_t runs, const std::function<double()>& f)
+    {
+        stage s = { name, unit, std::vector<double>(), 0 };
+
+        for (size_t i = 0; i < runs; ++i)
+        {
+            auto start = clock::now();
+            s.work = f();
+            s.ms.push_back(std::chrono::duration<double, std::milli>(clock::now() - start).count());
+        }
+
+        return s;
+    }
+
+    //! Nearest-rank percentile of sorted times.
+    double percentile(const std::vector<double>& sorted, double p)
+    {
+        size_t rank = static_cast<size_t>(std::ceil(p * sorted.size()));
+        return sorted[std::min(std::max<size_t>(rank, 1), sorted.size()) - 1];
+    }
+
+    std::string json_string(const std::string& s)
+    {
+        std::string r = "\"";
+
+        for (auto c = s.begin(); c != s.end(); ++c)
+        {
+            if (*c == '"' || *c == '\\')
+                r += '\\';
+
+            r += *c;
+        }
+
+        return r + "\"";
+    }
+
+    void write_json(std::ostream& out, const options& o, const std::vector<stage>& stages, const std::vector<skipped>& skips)
+    {
+        out << "{\n  \"runs\": " << o.runs << ",\n  \"settings\": " << json_string(o.settings) << ",\n  \"scenes\": [";
+
+        for (size_t i = 0; i < o.scenes.size(); ++i)
+            out << (i ? ", " : "") << json_string(o.scenes[i]);
+
+        out << "],\n  \"stages\": [";
+
+        for (size_t i = 0; i < stages.size(); ++i)
+        {
+            const stage& s = stages[i];
+
+            std::vector<double> sorted = s.ms;
+            std::sort(sorted.begin(), sorted.end());
+
+            double mean = 0;
+
+            for (auto t = sorted.begin(); t != sorted.end(); ++t)
+                mean += *t;
+
+            mean /= sorted.size();
+
+            out << (i ? "," : "") << "\n    { \"name\": " << json_string(s.name)
+                << ", \"mean_ms\": " << mean
+                << ", \"p50_ms\": " << percentile(sorted, 0.5)
+                << ", \"p95_ms\": " << percentile(sorted, 0.95)
+                << ", \"min_ms\": " << sorted.front()
+                << ", \"work\": " << s.work
+                << ", \"throughput\": " << (mean > 0 ? s.work / (mean / 1000.0) : 0.0)
+                << ", \"unit\": " << json_string(s.unit + "/s") << " }";
+        }
+
+        out << "\n  ],\n  \"skipped\": [";
+
+        for (size_t i = 0; i < skips.size(); ++i)
+            out << (i ? "," : "") << "\n    { \"name\": " << json_string(skips[i].name) << ", \"reason\": " << json_string(skips[i].reason) << " }";
+
+        out << "\n  ]\n}\n";
+    }
+
+#ifdef ASSIMP
+    //! The post-processing of assimp_mesh::load().
+    const unsigned int import_flags =
+        aiProcess_CalcTangentSpace |
+        aiProcess_Triangulate |
+        aiProcess_MakeLeftHanded |
+        aiProcess_JoinIdenticalVertices |
+        aiProcess_SortByPType |
+        aiProcess_GenSmoothNormals |
+        aiProcess_RemoveRedundantMaterials |
+        aiProcess_OptimizeMeshes |
+        aiProcess_GenUVCoords |
+        aiProcess_TransformUVCoords;
+
+    //! Flatten an imported scene into world space triangles with the diffuse color of their material, like gilga_mesh::voxel_triangles().
+    void ingest(const aiScene* scene, const aiNode* node, const aiMatrix4x4& parent, std::vector<dune::voxel_triangle>& triangles)
+    {
+        aiMatrix4x4 transform = parent * node->mTransformation;
+        aiMatrix3x3 normal_transform(transform);
+
+        for (size_t m = 0; m < node->mNumMeshes; ++m)
+        {
+            const aiMesh* mesh = scene->mMeshes[node->mMeshes[m]];
+
+            aiColor4D color(0.f, 0.f, 0.f, 0.f);
+            scene->mMaterials[mesh->mMaterialIndex]->Get(AI_MATKEY_COLOR_DIFFUSE, color);
+
+            for (size_t f = 0; f < mesh->mNumFaces; ++f)
+            {
+                const aiFace& face = mesh->mFaces[f];
+
+                if (face.mNumIndices != 3)
+                    continue;
+
+                dune::voxel_triangle t;
+                t.albedo = DirectX::XMFLOAT3(color.r, color.g, color.b);
+
+                // assimp_mesh reverses the winding
+                for (size_t k = 0; k < 3; ++k)
+                {
+                    unsigned int i = face.mIndices[2 - k];
+
+                    aiVector3D p = transform * mesh->mVertices[i];
+                    aiVector3D n = mesh->HasNormals() ? normal_transform * mesh->mNormals[i] : aiVector3D(0.f, 1.f, 0.f);
+                    n.Normalize();
+
+                    t.position[k] = DirectX::XMFLOAT3(p.x, p.y, p.z);
+                    t.normal[k] = DirectX::XMFLOAT3(n.x, n.y, n.z);
+                }
+
+                triangles.push_back(t);
+            }
+        }
+
+        for (size_t c = 0; c < node->mNumChildren; ++c)
+            ingest(scene, node->mChildren[c], transform, triangles);
+    }
+#endif
+
+    //! An image decoded like texture_cache does it, i.e. to RGBA8 unless it is HDR.
+    struct image
+    {
+        int width, height;
+        std::vector<unsigned char> rgba;
+    };
+
+    double decode(const std::string& file, image* result)
+    {
+        int width, height, nc;
+
+        if (file.find(".hdr") != std::string::npos)
+        {
+            float* hdr = stbi_loadf(file.c_str(), &width, &height, &nc, 4);
+
+            if (!hdr)
+                throw dune::exception(L"Can't decode " + dune::to_tstring(file));
+
+            stbi_image_free(hdr);
+        }
+        else
+        {
+            unsigned char* ldr = stbi_load(file.c_str(), &width, &height, &nc, 4);
+
+            if (!ldr)
+                throw dune::exception(L"Can't decode " + dune::to_tstring(file));
+
+            if (result)
+            {
+                result->width = width;
+                result->height = height;
+                result->rgba.assign(ldr, ldr + width * height * 4);
+            }
+
+            stbi_image_free(ldr);
+        }
+
+        return static_cast<double>(width) * height;
+    }
+
+    options parse(int argc, char* argv[])
+    {
+        options o;
+        o.lights = 6;
+        o.runs = 10;
+
+        std::string data = dune::to_string(dune::make_absolute_path(L"../../data/"));
+
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+
+            if (i + 1 >= argc)
+                throw dune::exception(L"Missing value for " + dune::to_tstring(arg));
+
+            std::string value = argv[++i];
+
+            if (arg == "--data")
+                data = value + "/";
+            else if (arg == "--scene")
+                o.scenes.push_back(value);
+            else if (arg == "--image")
+                o.images.push_back(value);
+            else if (arg == "--settings")
+                o.settings = value;
+            else if (arg == "--out")
+                o.out = value;
+            else if (arg == "--lights")
+                o.lights = std::stoul(value);
+            else if (arg == "--runs")
+                o.runs = std::max<size_t>(std::stoul(value), 1);
+            else
+                throw dune::exception(L"Unknown argument " + dune::to_tstring(arg));
+        }
+
+        if (o.scenes.empty())
+            o.scenes.push_back(data + "cornellbox/cornellbox.obj");
+
+        if (o.images.empty())
+        {
+            o.images.push_back(data + "skydome/sunny_day.jpg");
+            o.images.push_back(data + "real_static_scene.png");
+        }
+
+        if (o.settings.empty())
+            o.settings = data + "demo_gi.xml";
+
+        return o;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    using namespace headless;
+
+    try
+    {
+        options o = parse(argc, argv);
+
+        std::vector<stage> stages;
+        std::vector<skipped> skips;
+
+        stages.push_back(run("serializer_load", "keys", o.runs, [&]()
+        {
+            dune::serializer s;
+            s.load(dune::to_tstring(o.settings));
+            return static_cast<double>(s.size());
+        }));
+
+#ifdef ASSIMP
+        stages.push_back(run("assimp_import", "triangles", o.runs, [&]()
+        {
+            double faces = 0;
+
+            for (auto f = o.scenes.begin(); f != o.scenes.end(); ++f)
+            {
+                Assimp::Importer importer;
+                const aiScene* scene = importer.ReadFile(f->c_str(), import_flags);
+
+                if (!scene)
+                    throw dune::exception(L"Can't import " + dune::to_tstring(*f) + L": " + dune::to_tstring(importer.GetErrorString()));
+
+                for (size_t m = 0; m < scene->mNumMeshes; ++m)
+                    faces += scene->mMeshes[m]->mNumFaces;
+            }
+
+            return faces;
+        }));
+
+        {
+            std::vector<std::unique_ptr<Assimp::Importer>> importers;
+
+            for (auto f = o.scenes.begin(); f != o.scenes.end(); ++f)
+            {
+                importers.push_back(std::unique_ptr<Assimp::Importer>(new Assimp::Importer()));
+
+                if (!importers.back()->ReadFile(f->c_str(), import_flags))
+                    throw dune::exception(L"Can't import " + dune::to_tstring(*f));
+            }
+
+            stages.push_back(run("assimp_ingest", "triangles", o.runs, [&]()
+            {
+                std::vector<dune::voxel_triangle> triangles;
+
+                for (auto i = importers.begin(); i != importers.end(); ++i)
+                {
+                    const aiScene* scene = (*i)->GetScene();
+                    ingest(scene, scene->mRootNode, aiMatrix4x4(), triangles);
+                }
+
+                return static_cast<double>(triangles.size());
+            }));
+        }
+#else
+        skipped no_assimp = { "assimp_import", "built without Assimp" };
+        skips.push_back(no_assimp);
+#endif
+
+        stages.push_back(run("texture_decode", "pixels", o.runs, [&]()
+        {
+            double pixels = 0;
+
+            for (auto f = o.images.begin(); f != o.images.end(); ++f)
+                pixels += decode(*f, nullptr);
+
+            return pixels;
+        }));
+
+        // median cut of the first image, e.g. the environment map
+        image env;
+        decode(o.images.front(), &env);
+
+        if (!env.rgba.empty())
+        {
+            stages.push_back(run("median_cut", "pixels", o.runs, [&]()
+            {
+                std::vector<dune::environment_light> lights;
+                dune::median_cut(&env.rgba[0], env.width, env.height, o.lights, lights);
+                return static_cast<double>(env.width) * env.height;
+            }));
+        }
+
+        skipped tracker = { "tracker", "tracker::track_frame() needs a D3D render_target" };
+        skips.push_back(tracker);
+
+        if (o.out.empty())
+            write_json(std::cout, o, stages, skips);
+        else
+        {
+            std::ofstream f(o.out.c_str());
+            write_json(f, o, stages, skips);
+        }
+    }
+    catch (dune::exception& e)
+    {
+        tcerr << e.msg() << std::endl;
+        return 1;
+    }
+    catch (std::exception& e)
+    {
+        tcerr << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -14,19 +14,34 @@ void update_timings_gui()
 {
     dune::tstringstream ss;
 
-    ss  << L"RSM: " << renderer.time_rsm_ << L"ms\n"
+    using dc::gui::timing_text;
+
+    ss  << L"RSM: " << timing_text(renderer.time_rsm_, renderer.stats_rsm()) << L"\n"
 #ifdef LPV
-        << L"Inject: " << renderer.volume().time_inject_ << L"ms\n"
-        << L"Normalize: " << renderer.volume().time_normalize_ << L"ms\n"
-        << L"Propagate: " << renderer.volume().time_propagate_ << L"ms\n"
+        << L"Inject: " << timing_text(renderer.volume().time_inject_, renderer.volume().stats_inject()) << L"\n"
+        << L"Normalize: " << timing_text(renderer.volume().time_normalize_, renderer.volume().stats_normalize()) << L"\n"
+        << L"Propagate: " << timing_text(renderer.volume().time_propagate_, renderer.volume().stats_propagate()) << L"\n"
 #else
-        << L"Inject: " << renderer.volume().time_inject_ << L"ms\n"
-        << L"Voxelize: " << renderer.volume().time_voxelize_ << L"ms\n"
-        << L"Filtering: " << renderer.volume().time_mip_ << L"ms\n"
+        << L"Inject: " << timing_text(renderer.volume().time_inject_, renderer.volume().stats_inject()) << L"\n"
+        << L"Voxelize: " << timing_text(renderer.volume().time_voxelize_, renderer.volume().stats_voxelize()) << L"\n"
+        << L"Revoxelized: " << renderer.revoxelization().meshes_voxelized << L"/" << renderer.revoxelization().meshes << L" meshes, "
+        << renderer.revoxelization().bricks_cleared << L"/" << renderer.revoxelization().bricks << L" bricks"
+        << (renderer.revoxelization().light_only ? L" (light only)" : L"") << L"\n"
+        << L"Filtering: " << timing_text(renderer.volume().time_mip_, renderer.volume().stats_mip()) << L"\n"
 #endif
-        << L"Deferred: " << renderer.time_deferred_ << "ms\n"
+        << L"Deferred: " << timing_text(renderer.time_deferred_, renderer.stats_deferred()) << L"\n"
         ;
 
+    // the GI stages which ran this frame
+    const dune::gi_pipeline& pipeline = renderer.pipeline();
+
+    ss  << L"GI stages:";
+
+    for (auto s = pipeline.stats().ran.begin(); s != pipeline.stats().ran.end(); ++s)
+        ss << L" " << pipeline.name(*s);
+
+    ss  << (pipeline.busy() ? L"\n" : L" none\n");
+
     dc::gui::set_text(IDC_DEBUG_INFO + 0, ss.str().c_str());
 }
 
@@ -43,6 +58,12 @@ void CALLBACK on_keyboard(UINT nChar, bool bKeyDown, bool bAltDown, void* pUserC
             dc::gui::set_parameters(renderer.postprocessor());
             dc::gui::set_parameters(renderer.volume());
             dc::gui::set_parameters(renderer.main_light(), renderer.scene(), z_near, z_far);
+
+#ifdef LPV
+            dc::gui::set_checkbox_value(IDC_LPV_CASCADED, renderer.cascaded());
+#else
+            dc::gui::set_checkbox_value(IDC_SVO_CLIPMAP, renderer.clipmapped());
+#endif
         }
     }
 }
@@ -84,6 +105,13 @@ void CALLBACK on_gui_event(UINT nEvent, int nControlID, CDXUTControl* pControl,
     if (current_tab == &dc::gui::hud_gi)
     {
         dc::gui::get_parameters(renderer.volume());
+
+#ifdef LPV
+        renderer.set_cascaded(dc::gui::checkbox_value(IDC_LPV_CASCADED));
+#else
+        renderer.set_clipmapped(dc::gui::checkbox_value(IDC_SVO_CLIPMAP));
+#endif
+
         renderer.update_gi_parameters(the_context);
     }
 
@@ -103,6 +131,7 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPWSTR lpCmdLi
     try
     {
         dune::logger::init(L"../../data/log.txt");
+        dune::frame_profiler::i().set_thread_name("Main");
 
         files_scene = dune::files_from_args(lpCmdLine, L"../../data/cornellbox/cornellbox.obj");
 
@@ -20,29 +20,44 @@ void update_timings_gui()
 
     float time_sum = 0;
 
-    ss  << L"RSM mu: " << renderer.time_rsm_mu_ << L"ms\n"
-        << L"RSM rho: " << renderer.time_rsm_rho_ << L"ms\n";
+    using dc::gui::timing_text;
+
+    ss  << L"RSM mu: " << timing_text(renderer.time_rsm_mu_, renderer.stats_rsm_mu()) << L"\n"
+        << L"RSM rho: " << timing_text(renderer.time_rsm_rho_, renderer.stats_rsm_rho()) << L"\n";
 
     time_sum += renderer.time_rsm_mu_ + renderer.time_rsm_rho_;
 
 #ifdef DLPV
-    ss  << L"Inject: " << renderer.drf().time_inject_ << L"ms\n"
-        << L"Normalize: " << renderer.drf().time_normalize_ << L"ms\n"
-        << L"Propagate: " << renderer.drf().time_propagate_ << L"ms\n";
+    ss  << L"Inject: " << timing_text(renderer.drf().time_inject_, renderer.drf().stats_inject()) << L"\n"
+        << L"Normalize: " << timing_text(renderer.drf().time_normalize_, renderer.drf().stats_normalize()) << L"\n"
+        << L"Propagate: " << timing_text(renderer.drf().time_propagate_, renderer.drf().stats_propagate()) << L"\n";
 
     time_sum += renderer.drf().time_inject_ + renderer.drf().time_normalize_ + renderer.drf().time_propagate_;
 #else
-    ss  << L"Voxelize: " << renderer.drf().time_voxelize_ << L"ms\n"
-        << L"Inject: " << renderer.drf().time_inject_ << L"ms\n"
-        << L"Filtering: " << renderer.drf().time_mip_ << L"ms\n";
+    ss  << L"Voxelize: " << timing_text(renderer.drf().time_voxelize_, renderer.drf().stats_voxelize()) << L"\n"
+        << L"Revoxelized: " << renderer.revoxelization().meshes_voxelized << L"/" << renderer.revoxelization().meshes << L" meshes, "
+        << renderer.revoxelization().bricks_cleared << L"/" << renderer.revoxelization().bricks << L" bricks"
+        << (renderer.revoxelization().light_only ? L" (light only)" : L"") << L"\n"
+        << L"Inject: " << timing_text(renderer.drf().time_inject_, renderer.drf().stats_inject()) << L"\n"
+        << L"Filtering: " << timing_text(renderer.drf().time_mip_, renderer.drf().stats_mip()) << L"\n";
 
     time_sum += renderer.drf().time_voxelize_ + renderer.drf().time_inject_ + renderer.drf().time_mip_;
 #endif
 
-    ss  << L"Deferred: " << renderer.time_deferred_ << L"ms\n"
+    ss  << L"Deferred: " << timing_text(renderer.time_deferred_, renderer.stats_deferred()) << L"\n"
         << L"Tracking: " << renderer.tracker().time_track_ << L"ms \n"
         << L"Sum Render:" << time_sum + renderer.time_deferred_ << L"ms\n";
 
+    // the GI stages which ran this frame
+    const dune::gi_pipeline& pipeline = renderer.pipeline();
+
+    ss  << L"GI stages:";
+
+    for (auto s = pipeline.stats().ran.begin(); s != pipeline.stats().ran.end(); ++s)
+        ss << L" " << pipeline.name(*s);
+
+    ss  << (pipeline.busy() ? L"\n" : L" none\n");
+
     dc::gui::set_text(IDC_DEBUG_INFO + 0, ss.str().c_str());
 }
 
@@ -153,6 +168,7 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPWSTR lpCmdLi
     try
     {
         dune::logger::init(L"../../data/log.txt");
+        dune::frame_profiler::i().set_thread_name("Main");
 
         files_scene = dune::files_from_args(lpCmdLine);
 
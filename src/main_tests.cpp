@@ -0,0 +1,2544 @@
+/*
+ * The Dirtchamber - Tobias Alexander Franke 2014
+ * For copyright and license see LICENSE
+ * http://www.tobias-franke.eu
+ */
+
+/*! \file */
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <dune/anisotropic_voxels.h>
+#include <dune/cone_tracer.h>
+#include <dune/constant_upload.h>
+#include <dune/distance_field.h>
+#include <dune/frame_profiler.h>
+#include <dune/geometry_volume.h>
+#include <dune/gi_pipeline.h>
+#include <dune/gi_snapshot.h>
+#include <dune/lpv_cascades.h>
+#include <dune/lpv_grid.h>
+#include <dune/parallel_tools.h>
+#include <dune/profile_ring.h>
+#include <dune/serializer.h>
+#include <dune/sh_packing.h>
+#include <dune/state_filter.h>
+#include <dune/tiled_volume.h>
+#include <dune/unicode.h>
+#include <dune/voxel_octree.h>
+#include <dune/voxelizer.h>
+#include <dune/voxel_clipmap.h>
+#include <dune/voxel_dag.h>
+#include <dune/voxel_ownership.h>
+
+#include "bench_tools.h"
+
+/*
+ * Checks the CPU side of dune against references and known values. Every test returns the number
+ * of its checks which failed, and the executable fails if any test does:
+ *
+ * tests [--data directory] [test]...
+ */
+namespace tests
+{
+    /*!
+     * \brief A scalar transcription of ps_lpv_propagate() in lpv_propagate.hlsl.
+     *
+     * Runs num_iterations steps on a copy of src, cell by cell and neighbor by neighbor, and
+     * returns the sum of all steps in accum. Cells outside of the volume read as zero.
+     */
+    void reference_propagate(const dune::sh_volume& src, size_t num_iterations, float flux_amplifier, dune::sh_volume& accum)
+    {
+        const int offsets[6][3] =
+        {
+            { 0, 0, 1 }, { 1, 0, 0 }, { 0, 0,-1 }, {-1, 0, 0 }, { 0, 1, 0 }, { 0,-1, 0 },
+        };
+
+        const float pi = 3.14159265358979f;
+
+        auto sh4 = [](float x, float y, float z)
+        {
+            return DirectX::XMFLOAT4(0.282094792f, -0.4886025119f * y, 0.4886025119f * z, -0.4886025119f * x);
+        };
+
+        auto sh_clamped_cos_coeff = [&](float x, float y, float z)
+        {
+            DirectX::XMFLOAT4 v = sh4(x, y, z);
+            float d = (2.f * pi) / 3.f;
+            return DirectX::XMFLOAT4(pi * v.x, d * v.y, d * v.z, d * v.w);
+        };
+
+        const int w = static_cast<int>(src.width);
+        const int h = static_cast<int>(src.height);
+        const int d = static_cast<int>(src.depth);
+
+        dune::sh_volume curr, next;
+        curr.create(src.width, src.height, src.depth);
+        next.create(src.width, src.height, src.depth);
+        accum.create(src.width, src.height, src.depth);
+
+        for (size_t c = 0; c < 12; ++c)
+            std::copy(src.coeffs[c].begin(), src.coeffs[c].end(), curr.coeffs[c].begin());
+
+        auto load = [&](size_t ch, int x, int y, int z)
+        {
+            if (x < 0 || y < 0 || z < 0 || x >= w || y >= h || z >= d)
+                return DirectX::XMFLOAT4(0, 0, 0, 0);
+
+            return curr.get(ch, x, y, z);
+        };
+
+        for (size_t iteration = 0; iteration < num_iterations; ++iteration)
+        {
+            for (int z = 0; z < d; ++z)
+            for (int y = 0; y < h; ++y)
+            for (int x = 0; x < w; ++x)
+            for (size_t ch = 0; ch < 3; ++ch)
+            {
+                float new_sh[4] = { 0, 0, 0, 0 };
+                DirectX::XMFLOAT4 old_sh(0, 0, 0, 0);
+
+                for (size_t neighbor = 0; neighbor < 6; ++neighbor)
+                {
+                    const int* n = offsets[neighbor];
+
+                    old_sh = load(ch, x + n[0], y + n[1], z + n[2]);
+
+                    for (size_t face = 0; face < 6; ++face)
+                    {
+                        const int* f = offsets[face];
+
+                        float dx = f[0] * 0.5f - n[0];
+                        float dy = f[1] * 0.5f - n[1];
+                        float dz = f[2] * 0.5f - n[2];
+
+                        float len = std::sqrt(dx*dx + dy*dy + dz*dz);
+
+                        float solid_angle = 0;
+
+                        if (len > 0.5f)
+                            solid_angle = len >= 1.5f ? 22.95668f/(4*180.0f) : 24.26083f/(4*180.0f);
+
+                        if (len > 0.f)
+                        {
+                            dx /= len; dy /= len; dz /= len;
+                        }
+
+                        DirectX::XMFLOAT4 dir = sh4(dx, dy, dz);
+
+                        float r = flux_amplifier * solid_angle * (old_sh.x*dir.x + old_sh.y*dir.y + old_sh.z*dir.z + old_sh.w*dir.w);
+                        r = std::max(0.f, r);
+
+                        DirectX::XMFLOAT4 coeffs = sh_clamped_cos_coeff(static_cast<float>(f[0]), static_cast<float>(f[1]), static_cast<float>(f[2]));
+
+                        new_sh[0] += r * coeffs.x;
+                        new_sh[1] += r * coeffs.y;
+                        new_sh[2] += r * coeffs.z;
+                        new_sh[3] += r * coeffs.w;
+                    }
+                }
+
+                // the shader adds the flux of the last position it read, which is the neighbor at y-1
+                if (iteration == 0)
+                {
+                    new_sh[0] += old_sh.x * flux_amplifier;
+                    new_sh[1] += old_sh.y * flux_amplifier;
+                    new_sh[2] += old_sh.z * flux_amplifier;
+                    new_sh[3] += old_sh.w * flux_amplifier;
+                }
+
+                next.set(ch, x, y, z, DirectX::XMFLOAT4(new_sh[0], new_sh[1], new_sh[2], new_sh[3]));
+
+                DirectX::XMFLOAT4 a = accum.get(ch, x, y, z);
+                accum.set(ch, x, y, z, DirectX::XMFLOAT4(a.x + new_sh[0], a.y + new_sh[1], a.z + new_sh[2], a.w + new_sh[3]));
+            }
+
+            std::swap(curr, next);
+        }
+    }
+
+    //! Compare propagation against the scalar transcription of the shader, including a size which isn't a multiple of four.
+    size_t lpv_propagate()
+    {
+        const size_t iterations = 8;
+        const size_t reference_sizes[][3] = { { 32, 32, 32 }, { 37, 29, 23 } };
+
+        size_t failed = 0;
+
+        for (auto rs = std::begin(reference_sizes); rs != std::end(reference_sizes); ++rs)
+        {
+            dune::lpv_grid grid;
+            grid.create((*rs)[0], (*rs)[1], (*rs)[2]);
+            grid.set_num_propagations(iterations);
+
+            bench::random_inject(grid);
+            grid.normalize();
+
+            dune::sh_volume reference;
+            reference_propagate(grid.injected(), iterations, grid.flux_amplifier(), reference);
+
+            grid.propagate(iterations);
+
+            const dune::sh_volume& result = grid.result();
+
+            float peak = 0;
+
+            for (size_t c = 0; c < 12; ++c)
+            for (size_t i = 0; i < reference.size(); ++i)
+                peak = std::max(peak, std::abs(reference.coeffs[c][i]));
+
+            // relative to the coefficient itself, but not below a thousandth of the peak
+            float max_abs = 0, max_rel = 0;
+
+            for (size_t c = 0; c < 12; ++c)
+            for (size_t i = 0; i < reference.size(); ++i)
+            {
+                float e = std::abs(result.coeffs[c][i] - reference.coeffs[c][i]);
+
+                max_abs = std::max(max_abs, e);
+                max_rel = std::max(max_rel, e / std::max(std::abs(reference.coeffs[c][i]), peak * 1e-3f));
+            }
+
+            // the SIMD path only reorders the sums of the shader
+            if (!(max_rel < 1e-4f))
+                ++failed;
+
+            tcout << L"lpv_propagate " << (*rs)[0] << L"x" << (*rs)[1] << L"x" << (*rs)[2] << L" x " << iterations
+                  << L" against scalar reference: max abs error " << std::scientific << std::setprecision(2) << max_abs
+                  << L", max rel error " << max_rel << L" (peak " << std::fixed << peak << L")" << std::endl;
+
+            grid.destroy();
+        }
+
+        return failed;
+    }
+
+    //! Propagate a few light spots with and without skipping dark bricks, which has to give the same volume.
+    size_t lpv_sparse()
+    {
+        const size_t size = 64;
+        const size_t iterations = 8;
+        const size_t spots[][3] = { { 10, 4, 12 }, { 40, 20, 50 }, { 30, 60, 8 } };
+
+        dune::lpv_grid grid;
+        grid.create(size, size, size);
+        grid.set_num_propagations(iterations);
+
+        // the dense result of the same injection, which the sparse one is compared against
+        dune::sh_volume dense;
+
+        size_t cells_updated[2] = {};
+
+        for (bool sparse : { false, true })
+        {
+            grid.set_sparse(sparse);
+            grid.clear();
+
+            dune::sh_volume& v = grid.injected();
+
+            for (auto s = std::begin(spots); s != std::end(spots); ++s)
+            for (size_t z = (*s)[2]; z < (*s)[2] + 3; ++z)
+            for (size_t y = (*s)[1]; y < (*s)[1] + 3; ++y)
+            for (size_t x = (*s)[0]; x < (*s)[0] + 3; ++x)
+            {
+                for (size_t ch = 0; ch < 3; ++ch)
+                    v.set(ch, x, y, z, DirectX::XMFLOAT4(1.f, 0.f, 0.5f, 0.f));
+
+                grid.inject_counter()[v.index(x, y, z)] = 1.f;
+            }
+
+            grid.update_bricks();
+            grid.normalize();
+            grid.propagate(iterations);
+
+            cells_updated[sparse] = grid.cells_updated();
+
+            if (!sparse)
+                dense = grid.result();
+        }
+
+        const dune::sh_volume& result = grid.result();
+
+        float max_diff = 0;
+        size_t cells_differing = 0;
+
+        for (size_t i = 0; i < result.size(); ++i)
+        {
+            float diff = 0;
+
+            for (size_t c = 0; c < 12; ++c)
+                diff = std::max(diff, std::abs(result.coeffs[c][i] - dense.coeffs[c][i]));
+
+            max_diff = std::max(max_diff, diff);
+
+            if (diff > 0)
+                ++cells_differing;
+        }
+
+        tcout << L"lpv_sparse against dense " << size << L"^3 x " << iterations << L", 3 spots: " << cells_updated[1] << L" instead of "
+              << cells_updated[0] << L" cell updates, max difference " << std::scientific << std::setprecision(2) << max_diff
+              << L", " << cells_differing << L" of " << result.size() << L" cells differ" << std::fixed << std::endl;
+
+        grid.destroy();
+
+        return cells_differing + (cells_updated[1] < cells_updated[0] ? 0 : 1);
+    }
+
+    //! Propagate in batches over several frames, which has to converge to propagating all iterations at once.
+    size_t lpv_amortized()
+    {
+        const size_t size = 32;
+        const size_t iterations = 32;
+        const size_t budget_iterations = 5;
+
+        dune::lpv_grid grid;
+        grid.create(size, size, size);
+        grid.set_num_propagations(iterations);
+        grid.schedule().set_budget_iterations(budget_iterations);
+
+        bench::random_inject(grid);
+        grid.begin_amortized();
+
+        size_t frames = 0;
+
+        do
+        {
+            ++frames;
+            grid.render_amortized();
+        } while (!grid.schedule().converged() && frames <= iterations);
+
+        const bool converged = grid.schedule().converged();
+
+        dune::sh_volume amortized = grid.result();
+
+        bench::random_inject(grid);
+        grid.normalize();
+        grid.propagate(iterations);
+
+        float max_diff = 0;
+
+        for (size_t c = 0; c < 12; ++c)
+        for (size_t i = 0; i < amortized.size(); ++i)
+            max_diff = std::max(max_diff, std::abs(amortized.coeffs[c][i] - grid.result().coeffs[c][i]));
+
+        tcout << L"lpv_amortized " << size << L"^3 x " << iterations << L" in batches of " << budget_iterations << L": " << frames
+              << L" frames, max difference to a single propagation " << std::scientific << std::setprecision(2) << max_diff << std::fixed << std::endl;
+
+        grid.destroy();
+
+        return (max_diff == 0.f ? 0 : 1) + (converged ? 0 : 1);
+    }
+
+    /*!
+     * \brief Runs a propagation_schedule against a simulated GPU.
+     *
+     * Each iteration costs ms_per_iteration, and like a timestamp query the cost of a frame only
+     * arrives latency frames later. Counts the frames until the schedule converges and the batches
+     * which don't fit into the budget, except for the single iteration probing the cost.
+     *
+     * \return 1 if the schedule took another number of frames than expected, ran the wrong number of iterations or exceeded the budget.
+     */
+    size_t schedule_run(size_t total, size_t budget_iterations, float budget_ms, float ms_per_iteration, size_t latency, size_t expected_frames)
+    {
+        dune::propagation_schedule schedule;
+        schedule.set_budget_iterations(budget_iterations);
+        schedule.set_budget_ms(budget_ms);
+        schedule.restart(total);
+
+        std::vector<size_t> batches;
+        size_t over_budget = 0, run = 0;
+
+        while (!schedule.converged() && batches.size() < total * 2)
+        {
+            if (batches.size() >= latency + 1)
+            {
+                size_t n = batches[batches.size() - latency - 1];
+                schedule.measured(n, n * ms_per_iteration);
+            }
+
+            size_t n = schedule.next_batch();
+
+            if (n == 0 || (budget_iterations > 0 && n > budget_iterations) || (budget_ms > 0 && n > 1 && n * ms_per_iteration > budget_ms))
+                ++over_budget;
+
+            schedule.completed(n);
+            batches.push_back(n);
+            run += n;
+        }
+
+        tcout << L"propagation_schedule " << total << L" iterations, budget " << budget_iterations << L" it. " << budget_ms << L"ms, "
+              << ms_per_iteration << L"ms per iteration: " << batches.size() << L" frames (expected " << expected_frames << L"), "
+              << run << L" iterations run, " << over_budget << L" batches over budget" << std::endl;
+
+        return batches.size() == expected_frames && run == total && over_budget == 0 ? 0 : 1;
+    }
+
+    size_t propagation_schedule()
+    {
+        tcout << std::fixed << std::setprecision(1);
+
+        size_t failed = 0;
+
+        // 32 iterations in batches of 5
+        failed += schedule_run(32, 5, 0.f, 0.5f, 0, 7);
+
+        // 2 iterations fit into 1.5ms; one probe, then 2 frames of waiting for its measurement, then 15 frames of 2
+        failed += schedule_run(32, 0, 1.5f, 0.7f, 2, 18);
+
+        // the iteration budget is the tighter one once the probes are done: 3 frames of 1, then 10 frames of 3
+        failed += schedule_run(32, 3, 10.f, 0.7f, 2, 13);
+
+        // iterations more expensive than the whole budget still make progress one by one
+        failed += schedule_run(16, 0, 1.f, 4.f, 1, 16);
+
+        return failed;
+    }
+
+    //! Check the placement, snapping and cascade selection of lpv_cascades against known values, and the bins of injected VPLs.
+    size_t lpv_cascades()
+    {
+        const size_t num_vpls = 64 * 1024;
+
+        size_t mismatches = 0;
+
+        auto check_offset = [&](const dune::lpv_cascades& c, size_t i, int x, int y, int z, float ox, float oy, float oz)
+        {
+            const dune::lpv_cascade& l = c.cascade(i);
+
+            if (l.cell_offset.x != x || l.cell_offset.y != y || l.cell_offset.z != z ||
+                l.origin.x != ox || l.origin.y != oy || l.origin.z != oz)
+                ++mismatches;
+
+            // origin maps to 0 and the opposite corner to 1
+            DirectX::XMMATRIX m = DirectX::XMLoadFloat4x4(&l.world_to_lpv);
+
+            DirectX::XMFLOAT3 lo, hi;
+            DirectX::XMStoreFloat3(&lo, DirectX::XMVector4Transform(DirectX::XMVectorSet(ox, oy, oz, 1), m));
+            DirectX::XMStoreFloat3(&hi, DirectX::XMVector4Transform(DirectX::XMVectorSet(ox + l.extent, oy + l.extent, oz + l.extent, 1), m));
+
+            if (std::abs(lo.x) > 1e-5f || std::abs(lo.y) > 1e-5f || std::abs(lo.z) > 1e-5f ||
+                std::abs(hi.x - 1) > 1e-5f || std::abs(hi.y - 1) > 1e-5f || std::abs(hi.z - 1) > 1e-5f)
+                ++mismatches;
+        };
+
+        // cell sizes 0.5, 1 and 2, extents 16, 32 and 64
+        dune::lpv_cascades placed;
+        placed.create(3, 32, 16.f, false);
+
+        placed.update(DirectX::XMFLOAT3(0.3f, -0.7f, 100.2f));
+        check_offset(placed, 0, -16, -18, 184, -8.f, -9.f, 92.f);
+        check_offset(placed, 1, -16, -17, 84, -16.f, -17.f, 84.f);
+        check_offset(placed, 2, -16, -17, 34, -32.f, -34.f, 68.f);
+
+        // less than a cell of the finest cascade doesn't move anything
+        if (placed.update(DirectX::XMFLOAT3(0.4f, -0.7f, 100.2f)))
+            ++mismatches;
+
+        // one cell of the finest cascade moves only the finest cascade
+        if (!placed.update(DirectX::XMFLOAT3(0.5f, -0.7f, 100.2f)))
+            ++mismatches;
+
+        check_offset(placed, 0, -15, -18, 184, -7.5f, -9.f, 92.f);
+        check_offset(placed, 1, -16, -17, 84, -16.f, -17.f, 84.f);
+        check_offset(placed, 2, -16, -17, 34, -32.f, -34.f, 68.f);
+
+        // centered on 0 the cascades keep one cell from their border: [-7.5, 7.5), [-15, 15), [-30, 30)
+        placed.update(DirectX::XMFLOAT3(0.f, 0.f, 0.f));
+
+        struct { float x, y, z; size_t cascade; } selections[] =
+        {
+            {   0.f,     0.f, 0.f, 0 },
+            {  -7.5f,    0.f, 0.f, 0 },
+            {   7.4f,    0.f, 0.f, 0 },
+            {   7.5f,    0.f, 0.f, 1 },
+            {  -7.6f,    0.f, 0.f, 1 },
+            {   0.f,   -15.f, 0.f, 1 },
+            {  15.f,     0.f, 0.f, 2 },
+            {  29.9f,    0.f, 0.f, 2 },
+            {  31.5f,    0.f, 0.f, 2 },  // the coarsest cascade without margin
+            { -32.f,     0.f, 0.f, 2 },
+            {  32.f,     0.f, 0.f, 3 },  // no cascade
+            {   0.f,   -32.1f, 0.f, 3 },
+        };
+
+        for (auto s = std::begin(selections); s != std::end(selections); ++s)
+            if (placed.select(DirectX::XMFLOAT3(s->x, s->y, s->z)) != s->cascade)
+                ++mismatches;
+
+        placed.destroy();
+
+        std::mt19937 rng(1337);
+        std::uniform_real_distribution<float> pos(-60.f, 60.f);
+        std::uniform_real_distribution<float> dir(-1.f, 1.f);
+
+        std::vector<dune::vpl> vpls(num_vpls);
+
+        for (auto v = vpls.begin(); v != vpls.end(); ++v)
+        {
+            v->position = DirectX::XMFLOAT3(pos(rng), pos(rng) * 0.1f, pos(rng));
+            DirectX::XMStoreFloat3(&v->normal, DirectX::XMVector3Normalize(DirectX::XMVectorSet(dir(rng), dir(rng), dir(rng), 0)));
+            v->flux = DirectX::XMFLOAT3(1.f, 1.f, 1.f);
+        }
+
+        dune::lpv_cascades cascades;
+        cascades.create(3, 32, 16.f);
+        cascades.update(DirectX::XMFLOAT3(0.f, 0.f, 0.f));
+
+        cascades.inject(vpls);
+
+        // every bin holds exactly the VPLs select() assigns to it
+        std::vector<size_t> selected(cascades.num_cascades() + 1, 0);
+
+        for (auto v = vpls.begin(); v != vpls.end(); ++v)
+            ++selected[cascades.select(v->position)];
+
+        for (size_t i = 0; i < cascades.num_cascades(); ++i)
+            if (cascades.binned(i).size() != selected[i])
+                ++mismatches;
+
+        tcout << L"lpv_cascades inject " << num_vpls << L" VPLs (";
+
+        for (size_t i = 0; i < cascades.num_cascades(); ++i)
+            tcout << (i > 0 ? L" " : L"") << cascades.binned(i).size();
+
+        tcout << L"): " << mismatches << L" mismatches in placement, selection and binning" << std::endl;
+
+        cascades.destroy();
+
+        return mismatches;
+    }
+
+    //! Inject a tilted surfel into a geometry volume with flat cells and check the direction of its blocking potential.
+    size_t geometry_volume_normals()
+    {
+        // cells are 1 x 0.25 x 1, so positions scale by (1, 4, 1) and normals by the inverse transpose (1, 0.25, 1)
+        DirectX::XMFLOAT4X4 model;
+        DirectX::XMStoreFloat4x4(&model, DirectX::XMMatrixIdentity());
+
+        dune::geometry_volume gv;
+        gv.create(4, 4, 4);
+        gv.set_model_matrix(model, DirectX::XMFLOAT3(0.f, 0.f, 0.f), DirectX::XMFLOAT3(4.f, 1.f, 4.f));
+
+        dune::surfel s;
+        s.position = DirectX::XMFLOAT3(2.f, 0.5f, 2.f);
+        DirectX::XMStoreFloat3(&s.normal, DirectX::XMVector3Normalize(DirectX::XMVectorSet(1.f, 1.f, 0.f, 0.f)));
+        s.area = 1.f;
+
+        gv.inject(std::vector<dune::surfel>(1, s));
+
+        DirectX::XMFLOAT3 n;
+        DirectX::XMStoreFloat3(&n, DirectX::XMVector3Normalize(DirectX::XMVectorSet(1.f, 0.25f, 0.f, 0.f)));
+
+        DirectX::XMFLOAT4 expected = dune::sh_clamped_cos_coeff(n.x, n.y, n.z);
+        DirectX::XMFLOAT4 c = gv.get(2, 2, 2);
+
+        // compare directions only, the DC of a single lobe is positive
+        float error = std::max(std::max(std::abs(c.y / c.x - expected.y / expected.x),
+                                        std::abs(c.z / c.x - expected.z / expected.x)),
+                                        std::abs(c.w / c.x - expected.w / expected.x));
+
+        tcout << L"geometry_volume normals in 1 x 0.25 x 1 cells: largest error " << std::scientific << std::setprecision(2) << error
+              << (error < 1e-4f ? L"" : L" (wrong normal transform)") << std::fixed << std::endl;
+
+        gv.destroy();
+
+        return error < 1e-4f ? 0 : 1;
+    }
+
+    /*!
+     * Propagate a point light next to the blue wall of the cornellbox and measure how much of the
+     * accumulated flux ends up behind the wall, with and without a geometry volume. The geometry
+     * volume has to block at least a quarter of it.
+     */
+    size_t lpv_leakage(const std::string& scene)
+    {
+        const size_t size = 32;
+        const size_t iterations = 16;
+
+        std::vector<dune::surfel> surfels;
+
+        if (!bench::obj_surfels(scene, 16.f, surfels))
+        {
+            tcout << L"lpv_leakage: cannot open " << dune::to_tstring(scene) << std::endl;
+            return 1;
+        }
+
+        // one unit per cell, the room spans [-10,10] x [0,20] x [-10,10] and is open towards +z
+        const DirectX::XMFLOAT3 lpv_min(-16.f, -6.f, -16.f), lpv_max(16.f, 26.f, 16.f);
+
+        DirectX::XMFLOAT4X4 model;
+        DirectX::XMStoreFloat4x4(&model, DirectX::XMMatrixIdentity());
+
+        dune::geometry_volume gv;
+        gv.create(size, size, size);
+        gv.set_model_matrix(model, lpv_min, lpv_max);
+        gv.inject(surfels);
+        gv.update();
+
+        dune::lpv_grid grid;
+        grid.create(size, size, size);
+        grid.set_model_matrix(model, lpv_min, lpv_max);
+
+        double leaked[2] = {};
+
+        for (bool occlusion : { false, true })
+        {
+            grid.set_geometry(occlusion ? &gv : nullptr);
+            grid.clear();
+
+            // an isotropic light a cell and a half in front of the blue wall at x = 10
+            dune::sh_volume& v = grid.injected();
+            size_t light = v.index(24, 16, 16);
+
+            for (size_t ch = 0; ch < 3; ++ch)
+                v.set(ch, 24, 16, 16, DirectX::XMFLOAT4(1.f, 0.f, 0.f, 0.f));
+
+            grid.inject_counter()[light] = 1.f;
+            grid.update_bricks();
+
+            grid.normalize();
+            grid.propagate(iterations);
+
+            // DC of the red channel in front of and behind the wall, the cell containing the wall counts as in front
+            const dune::sh_volume& r = grid.result();
+
+            double inside = 0, behind = 0;
+
+            for (size_t z = 0; z < size; ++z)
+            for (size_t y = 0; y < size; ++y)
+            for (size_t x = 0; x < size; ++x)
+            {
+                float dc = std::max(0.f, r.get(0, x, y, z).x);
+
+                if (x > 26)
+                    behind += dc;
+                else
+                    inside += dc;
+            }
+
+            leaked[occlusion] = behind / (inside + behind);
+
+            tcout << L"lpv_leakage cornellbox " << size << L"^3 x " << iterations << (occlusion ? L", with GV: " : L", without GV: ")
+                  << std::fixed << std::setprecision(2) << 100.0 * leaked[occlusion] << L"% of flux behind the wall ("
+                  << surfels.size() << L" surfels)" << std::endl;
+        }
+
+        grid.destroy();
+        gv.destroy();
+
+        return leaked[1] < leaked[0] * 0.75 ? 0 : 1;
+    }
+
+    /*!
+     * Encode a propagated volume lit by colored VPLs with every SH format and compare the decoded
+     * volume against the full precision one.
+     */
+    size_t sh_formats()
+    {
+        const size_t size = 32;
+        const size_t num_vpls = 4096;
+
+        std::mt19937 rng(1337);
+        std::uniform_real_distribution<float> pos(0.f, 1.f);
+        std::uniform_real_distribution<float> dir(-1.f, 1.f);
+
+        std::vector<dune::vpl> vpls(num_vpls);
+
+        for (auto v = vpls.begin(); v != vpls.end(); ++v)
+        {
+            v->position = DirectX::XMFLOAT3(pos(rng), pos(rng), pos(rng));
+            DirectX::XMStoreFloat3(&v->normal, DirectX::XMVector3Normalize(DirectX::XMVectorSet(dir(rng), dir(rng), dir(rng), 0)));
+            v->flux = DirectX::XMFLOAT3(pos(rng), pos(rng), pos(rng));
+        }
+
+        dune::lpv_grid grid;
+        grid.create(size, size, size);
+        grid.set_num_propagations(8);
+        grid.inject(vpls);
+        grid.render();
+
+        const dune::sh_volume& reference = grid.result();
+
+        dune::sh_volume decoded;
+        decoded.create(size, size, size);
+
+        const dune::sh_format formats[] = { dune::SH_FORMAT_FP16, dune::SH_FORMAT_SHARED_EXPONENT, dune::SH_FORMAT_YCOCG };
+        const wchar_t* names[] = { L"fp16", L"shared exponent", L"ycocg" };
+
+        // the relative error each format is expected to stay below
+        const float tolerances[] = { 1e-3f, 1e-1f, 5e-2f };
+
+        size_t failed = 0;
+
+        for (size_t f = 0; f < 3; ++f)
+        {
+            std::vector<unsigned char> packed;
+
+            dune::encode_sh(reference, formats[f], packed);
+            dune::decode_sh(packed, formats[f], decoded);
+
+            dune::sh_error err = dune::measure_sh_error(reference, decoded);
+
+            tcout << L"sh_format " << names[f] << L": " << dune::sh_format_size(formats[f]) << L" bytes/cell, "
+                  << std::scientific << std::setprecision(2) << err.relative_rms << L" relative rms, "
+                  << err.irradiance_rms << L" irradiance rms, " << err.max_abs << L" max" << std::fixed << std::endl;
+
+            if (!(err.relative_rms < tolerances[f]))
+                ++failed;
+        }
+
+        grid.destroy();
+
+        return failed;
+    }
+
+    //! Round trip a snapshot through memory and a file, and reject files which can't be written or claim huge volumes.
+    size_t gi_snapshots()
+    {
+        const size_t size = 32;
+        const size_t num_vpls = 4096;
+
+        // light in one corner only, so the far cells of the volume stay black
+        std::mt19937 rng(1337);
+        std::uniform_real_distribution<float> pos(0.f, 0.25f);
+        std::uniform_real_distribution<float> dir(-1.f, 1.f);
+
+        std::vector<dune::vpl> vpls(num_vpls);
+
+        for (auto v = vpls.begin(); v != vpls.end(); ++v)
+        {
+            v->position = DirectX::XMFLOAT3(pos(rng), pos(rng), pos(rng));
+            DirectX::XMStoreFloat3(&v->normal, DirectX::XMVector3Normalize(DirectX::XMVectorSet(dir(rng), dir(rng), dir(rng), 0)));
+            v->flux = DirectX::XMFLOAT3(1.f, 1.f, 1.f);
+        }
+
+        dune::lpv_grid grid;
+        grid.create(size, size, size);
+        grid.set_num_propagations(8);
+        grid.inject(vpls);
+        grid.render();
+
+        std::vector<unsigned char> packed;
+        dune::encode_sh(grid.result(), dune::SH_FORMAT_FP16, packed);
+
+        dune::gi_snapshot snapshot;
+        snapshot.set_key(dune::hash_bytes(&vpls[0], vpls.size() * sizeof(dune::vpl)));
+        snapshot.add("lpv", size, size, size, static_cast<uint32_t>(dune::sh_format_size(dune::SH_FORMAT_FP16))).data = packed;
+
+        size_t failed = 0;
+
+        for (bool compress : { false, true })
+        {
+            std::ostringstream os;
+            snapshot.write(os, compress);
+
+            const std::string file = os.str();
+
+            std::istringstream is(file);
+            dune::gi_snapshot loaded;
+
+            const bool ok = loaded.read(is) && loaded.key() == snapshot.key() && loaded.find("lpv") && loaded.find("lpv")->data == packed;
+
+            if (!ok)
+                ++failed;
+
+            tcout << L"gi_snapshot " << (compress ? L"compressed" : L"raw") << L": " << file.size() << L" bytes, "
+                  << (ok ? L"round trip ok" : L"round trip FAILED") << std::endl;
+        }
+
+        // a complete file replaces an older one, and a file which can't be written throws
+        const dune::tstring path = L"gi_snapshot_test.bin";
+
+        bool saved = false, thrown = false;
+
+        try
+        {
+            snapshot.save(path);
+            snapshot.save(path);
+
+            dune::gi_snapshot loaded;
+            saved = loaded.load(path) && loaded.find("lpv") && loaded.find("lpv")->data == packed;
+        }
+        catch (dune::exception&)
+        {
+        }
+
+        std::remove(dune::to_string(path).c_str());
+
+        try
+        {
+            snapshot.save(L"no_such_directory/gi_snapshot_test.bin");
+        }
+        catch (dune::exception&)
+        {
+            thrown = true;
+        }
+
+        // a header claiming a huge volume is rejected before allocating it, the width follows the name "lpv"
+        std::ostringstream os;
+        snapshot.write(os, false);
+
+        std::string corrupt = os.str();
+        const uint32_t huge = 1u << 20;
+        std::memcpy(&corrupt[4 + 4 + 8 + 4 + 4 + 3], &huge, sizeof(huge));
+
+        std::istringstream is(corrupt);
+        dune::gi_snapshot rejected;
+        const bool huge_rejected = !rejected.read(is) && rejected.size() == 0;
+
+        tcout << L"gi_snapshot save: " << (saved ? L"file round trip ok" : L"file round trip FAILED") << L", "
+              << (thrown ? L"unwritable file throws" : L"unwritable file did NOT throw") << L", "
+              << (huge_rejected ? L"huge volume rejected" : L"huge volume NOT rejected") << std::endl;
+
+        grid.destroy();
+
+        return failed + (saved ? 0 : 1) + (thrown ? 0 : 1) + (huge_rejected ? 0 : 1);
+    }
+
+    //! Build a tree from known fragments and check every voxel of mip 0 and 1 against the expected averages.
+    size_t svo_lookup()
+    {
+        const uint32_t r = 64;
+
+        std::mt19937 rng(1337);
+        std::uniform_int_distribution<uint32_t> coord(0, r - 1);
+        std::uniform_real_distribution<float> unit(-1.f, 1.f);
+
+        struct expected_voxel
+        {
+            float normal[3], albedo[3];
+            size_t count;
+        };
+
+        std::vector<expected_voxel> expected(r * r * r, expected_voxel());
+        std::vector<dune::voxel_fragment> fragments;
+
+        for (size_t i = 0; i < 20000; ++i)
+        {
+            dune::voxel_fragment f;
+
+            // cluster some fragments so that voxels receive several
+            f.x = coord(rng) / 4 * 4; f.y = coord(rng) / 2 * 2; f.z = coord(rng);
+
+            DirectX::XMVECTOR n = DirectX::XMVector3Normalize(DirectX::XMVectorSet(unit(rng), unit(rng), unit(rng), 0.f));
+            DirectX::XMStoreFloat3(&f.normal, n);
+            f.albedo = DirectX::XMFLOAT3(std::abs(unit(rng)), std::abs(unit(rng)), std::abs(unit(rng)));
+
+            fragments.push_back(f);
+
+            expected_voxel& e = expected[(f.z * r + f.y) * r + f.x];
+            e.normal[0] += f.normal.x; e.normal[1] += f.normal.y; e.normal[2] += f.normal.z;
+            e.albedo[0] += f.albedo.x; e.albedo[1] += f.albedo.y; e.albedo[2] += f.albedo.z;
+            ++e.count;
+        }
+
+        // fragments outside of the tree are skipped
+        dune::voxel_fragment outside = fragments.back();
+        outside.x = r;
+        fragments.push_back(outside);
+
+        dune::voxel_octree svo;
+        svo.create(r, fragments);
+
+        // the expected finest level, and its box filtered mip
+        std::vector<dune::voxel> mip0(r * r * r), mip1((r / 2) * (r / 2) * (r / 2));
+
+        for (size_t i = 0; i < expected.size(); ++i)
+        {
+            const expected_voxel& e = expected[i];
+            dune::voxel& v = mip0[i];
+
+            v.normal = DirectX::XMFLOAT4(0.f, 0.f, 0.f, 0.f);
+            v.color = DirectX::XMFLOAT4(0.f, 0.f, 0.f, 0.f);
+
+            if (e.count == 0)
+                continue;
+
+            DirectX::XMVECTOR n = DirectX::XMVectorSet(e.normal[0], e.normal[1], e.normal[2], 0.f);
+
+            if (DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(n)) > 1e-12f)
+                n = DirectX::XMVector3Normalize(n);
+
+            DirectX::XMStoreFloat4(&v.normal, DirectX::XMVectorSetW(n, 1.f));
+            v.color = DirectX::XMFLOAT4(e.albedo[0] / e.count, e.albedo[1] / e.count, e.albedo[2] / e.count, 0.f);
+        }
+
+        const uint32_t h = r / 2;
+
+        for (uint32_t z = 0; z < h; ++z)
+        for (uint32_t y = 0; y < h; ++y)
+        for (uint32_t x = 0; x < h; ++x)
+        {
+            float sum[8] = {};
+
+            for (uint32_t o = 0; o < 8; ++o)
+            {
+                const dune::voxel& c = mip0[((z*2 + (o >> 2)) * r + y*2 + ((o >> 1) & 1)) * r + x*2 + (o & 1)];
+                const float* cv[2] = { &c.normal.x, &c.color.x };
+
+                for (size_t k = 0; k < 8; ++k)
+                    sum[k] += cv[k / 4][k % 4];
+            }
+
+            dune::voxel& v = mip1[(z * h + y) * h + x];
+            v.normal = DirectX::XMFLOAT4(sum[0] / 8, sum[1] / 8, sum[2] / 8, sum[3] / 8);
+            v.color = DirectX::XMFLOAT4(sum[4] / 8, sum[5] / 8, sum[6] / 8, sum[7] / 8);
+        }
+
+        const std::vector<dune::voxel>* levels[] = { &mip0, &mip1 };
+
+        size_t failed = 0;
+
+        for (size_t m = 0; m < 2; ++m)
+        {
+            const uint32_t mr = r >> m;
+
+            size_t occupied = 0, wrong_occupancy = 0;
+            float max_error = 0;
+
+            for (uint32_t z = 0; z < mr; ++z)
+            for (uint32_t y = 0; y < mr; ++y)
+            for (uint32_t x = 0; x < mr; ++x)
+            {
+                const dune::voxel& e = (*levels[m])[(z * mr + y) * mr + x];
+
+                dune::voxel v;
+                bool found = svo.lookup(m, x, y, z, v);
+
+                if (found != (e.normal.w > 0.f))
+                    ++wrong_occupancy;
+
+                if (found)
+                    ++occupied;
+
+                const float* a[2] = { &v.normal.x, &v.color.x };
+                const float* b[2] = { &e.normal.x, &e.color.x };
+
+                for (size_t k = 0; k < 8; ++k)
+                    max_error = std::max(max_error, std::abs(a[k / 4][k % 4] - b[k / 4][k % 4]));
+            }
+
+            tcout << L"svo_lookup " << r << L"^3 mip " << m << L": " << occupied << L" occupied voxels, "
+                  << wrong_occupancy << L" wrong occupancy, max error " << std::scientific << std::setprecision(2) << max_error
+                  << std::fixed << std::endl;
+
+            // averages are stored as half floats
+            failed += wrong_occupancy + (max_error < 1e-3f ? 0 : 1);
+        }
+
+        dune::voxel v;
+        const bool found_outside = svo.lookup(0, r, 0, 0, v);
+
+        tcout << L"svo_lookup outside of the tree: " << (found_outside ? L"found" : L"empty") << std::endl;
+
+        return failed + (found_outside ? 1 : 0);
+    }
+
+    //! Compress octrees of scenes into DAGs and compare lookups and samples of occupied and random voxels at all mips.
+    size_t svo_dag(const std::vector<std::string>& scenes)
+    {
+        const size_t resolutions[] = { 128, 256 };
+
+        size_t failed = 0;
+
+        for (auto scene = scenes.begin(); scene != scenes.end(); ++scene)
+        for (size_t r : resolutions)
+        {
+            std::vector<dune::voxel_fragment> fragments;
+
+            if (!bench::obj_fragments(*scene, r, fragments))
+            {
+                tcout << L"svo_dag: cannot open " << dune::to_tstring(*scene) << std::endl;
+                ++failed;
+                break;
+            }
+
+            dune::voxel_octree svo;
+            svo.create(r, fragments);
+
+            dune::voxel_dag dag;
+            dag.create(svo);
+
+            // occupied voxels at all mips and random ones, mostly empty, have to match the tree
+            std::vector<dune::voxel_fragment> probes;
+            const size_t stride = std::max<size_t>(1, fragments.size() / 100000);
+
+            for (size_t i = 0; i < fragments.size(); i += stride)
+                probes.push_back(fragments[i]);
+
+            std::mt19937 rng(7);
+            std::uniform_int_distribution<uint32_t> coord(0, static_cast<uint32_t>(r - 1));
+
+            for (size_t i = 0; i < 100000; ++i)
+            {
+                dune::voxel_fragment f;
+                f.x = coord(rng);
+                f.y = coord(rng);
+                f.z = coord(rng);
+                probes.push_back(f);
+            }
+
+            size_t mismatches = 0;
+
+            for (auto p = probes.begin(); p != probes.end(); ++p)
+            for (size_t m = 0; m < svo.num_mips(); ++m)
+            {
+                dune::voxel a, b;
+
+                bool found_a = svo.lookup(m, p->x >> m, p->y >> m, p->z >> m, a);
+                bool found_b = dag.lookup(m, p->x >> m, p->y >> m, p->z >> m, b);
+
+                if (found_a != found_b || std::memcmp(&a, &b, sizeof(a)) != 0)
+                    ++mismatches;
+            }
+
+            for (size_t i = 0; i < 1000; ++i)
+            {
+                DirectX::XMFLOAT3 p(coord(rng) / static_cast<float>(r), coord(rng) / static_cast<float>(r), coord(rng) / static_cast<float>(r));
+                const float mip = (i % 40) * 0.25f;
+
+                dune::voxel a = svo.sample(p, mip), b = dag.sample(p, mip);
+
+                if (std::memcmp(&a, &b, sizeof(a)) != 0)
+                    ++mismatches;
+            }
+
+            tcout << L"svo_dag " << dune::to_tstring(*scene) << L" " << r << L"^3: " << dag.num_octree_nodes() << L" -> " << dag.num_nodes()
+                  << L" nodes, " << probes.size() << L" probes, " << mismatches << L" mismatches" << std::endl;
+
+            failed += mismatches;
+        }
+
+        return failed;
+    }
+
+    /*!
+     * Voxelize triangles by brute force: every voxel in the bounding box of a triangle is tested with the triangle/box
+     * overlap test of Schwarz and Seidel, and overlapping voxels are max blended like bs_voxelize_. The result is
+     * compared with the dense target and the fragments of a voxelizer, which voxelized the same triangles before.
+     *
+     * \return The number of voxels which differ, except for those which a triangle touches within rounding.
+     */
+    size_t voxelize_check(const std::vector<dune::voxel_triangle>& triangles, const DirectX::XMFLOAT3& bb_min, const DirectX::XMFLOAT3& bb_max,
+                        const dune::voxelizer& v, const std::vector<dune::voxel_fragment>& fragments)
+    {
+        const int r = static_cast<int>(v.resolution());
+        const size_t n = v.resolution() * v.resolution() * v.resolution();
+
+        const float rf = static_cast<float>(r);
+        const DirectX::XMMATRIX to_voxels =
+            DirectX::XMMatrixTranslation(-bb_min.x, -bb_min.y, -bb_min.z) *
+            DirectX::XMMatrixScaling(1.f / (bb_max.x - bb_min.x), 1.f / (bb_max.y - bb_min.y), 1.f / (bb_max.z - bb_min.z)) *
+            DirectX::XMMatrixScaling(rf, rf, rf);
+
+        std::vector<DirectX::XMFLOAT4> normal(n, DirectX::XMFLOAT4(0.f, 0.f, 0.f, 0.f));
+        std::vector<DirectX::XMFLOAT4> color(n, DirectX::XMFLOAT4(0.f, 0.f, 0.f, 0.f));
+        std::vector<unsigned char> occupied(n, 0);
+
+        // voxels a triangle touches within rounding, where the voxelizer may decide either way
+        std::vector<unsigned char> borderline(n, 0);
+
+        size_t tests = 0;
+
+        for (auto t = triangles.begin(); t != triangles.end(); ++t)
+        {
+            float p[3][3];
+
+            for (size_t i = 0; i < 3; ++i)
+            {
+                DirectX::XMFLOAT3 q;
+                DirectX::XMStoreFloat3(&q, DirectX::XMVector3TransformCoord(DirectX::XMLoadFloat3(&t->position[i]), to_voxels));
+                p[i][0] = q.x; p[i][1] = q.y; p[i][2] = q.z;
+            }
+
+            int lo[3], hi[3];
+            bool inside = true;
+
+            for (size_t a = 0; a < 3; ++a)
+            {
+                float mi = std::min(p[0][a], std::min(p[1][a], p[2][a]));
+                float ma = std::max(p[0][a], std::max(p[1][a], p[2][a]));
+
+                inside = inside && ma >= 0.f && mi < rf;
+                lo[a] = std::max(0, static_cast<int>(std::floor(mi)));
+                hi[a] = std::min(r - 1, static_cast<int>(std::floor(ma)));
+            }
+
+            if (!inside)
+                continue;
+
+            float e[3][3];
+
+            for (size_t i = 0; i < 3; ++i)
+            for (size_t a = 0; a < 3; ++a)
+                e[i][a] = p[(i + 1) % 3][a] - p[i][a];
+
+            const float nrm[3] =
+            {
+                e[0][1] * e[1][2] - e[0][2] * e[1][1],
+                e[0][2] * e[1][0] - e[0][0] * e[1][2],
+                e[0][0] * e[1][1] - e[0][1] * e[1][0]
+            };
+
+            // degenerate triangles cover no voxel
+            if (nrm[0] == 0.f && nrm[1] == 0.f && nrm[2] == 0.f)
+                continue;
+
+            // the plane through the triangle must separate the critical point c and its opposite corner of the box
+            float d1 = 0, d2 = 0;
+
+            for (size_t a = 0; a < 3; ++a)
+            {
+                float c = nrm[a] > 0.f ? 1.f : 0.f;
+                d1 += nrm[a] * (c - p[0][a]);
+                d2 += nrm[a] * ((1.f - c) - p[0][a]);
+            }
+
+            // the three axis aligned projections xy, yz and zx, edge normals oriented by the triangle normal
+            const size_t proj[3][3] = { { 0, 1, 2 }, { 1, 2, 0 }, { 2, 0, 1 } };
+            float ne[3][3][2], de[3][3];
+
+            for (size_t k = 0; k < 3; ++k)
+            {
+                const size_t a = proj[k][0], b = proj[k][1], c = proj[k][2];
+                const float sign = nrm[c] >= 0.f ? 1.f : -1.f;
+
+                for (size_t i = 0; i < 3; ++i)
+                {
+                    ne[k][i][0] = -e[i][b] * sign;
+                    ne[k][i][1] =  e[i][a] * sign;
+                    de[k][i] = -(ne[k][i][0] * p[i][a] + ne[k][i][1] * p[i][b]) + std::max(0.f, ne[k][i][0]) + std::max(0.f, ne[k][i][1]);
+                }
+            }
+
+            for (int z = lo[2]; z <= hi[2]; ++z)
+            for (int y = lo[1]; y <= hi[1]; ++y)
+            for (int x = lo[0]; x <= hi[0]; ++x)
+            {
+                ++tests;
+
+                const float q[3] = { static_cast<float>(x), static_cast<float>(y), static_cast<float>(z) };
+
+                const float np = nrm[0] * q[0] + nrm[1] * q[1] + nrm[2] * q[2];
+
+                // the smallest margin of the plane and edge tests, the box overlaps the triangle if it isn't negative.
+                // d1 >= d2, so (np + d1) * (np + d2) <= 0 is np + d2 <= 0 <= np + d1.
+                float margin = std::min(np + d1, -(np + d2));
+                float tolerance = 1e-6f * (std::abs(np) + std::abs(d1) + std::abs(d2));
+
+                for (size_t k = 0; k < 3; ++k)
+                for (size_t i = 0; i < 3; ++i)
+                {
+                    const float ea = ne[k][i][0] * q[proj[k][0]], eb = ne[k][i][1] * q[proj[k][1]];
+
+                    margin = std::min(margin, ea + eb + de[k][i]);
+                    tolerance = std::max(tolerance, 1e-6f * (std::abs(ea) + std::abs(eb) + std::abs(de[k][i])));
+                }
+
+                // a margin within rounding may flip with the order of evaluation, e.g. when a compiler fuses multiply-adds,
+                // but a margin of exactly zero, as for boxes touching axis aligned walls, is computed without rounding
+                if (margin != 0.f && std::abs(margin) <= tolerance)
+                    borderline[(static_cast<size_t>(z) * r + y) * r + x] = 1;
+
+                if (margin < 0.f)
+                    continue;
+
+                // the vertex normals interpolated at the projection of the voxel center, clamped to the triangle
+                const float e0[3] = { e[0][0], e[0][1], e[0][2] };
+                const float e1[3] = { -e[2][0], -e[2][1], -e[2][2] };
+                const float d[3] = { x + 0.5f - p[0][0], y + 0.5f - p[0][1], z + 0.5f - p[0][2] };
+
+                auto dot = [](const float* u, const float* w) { return u[0] * w[0] + u[1] * w[1] + u[2] * w[2]; };
+
+                const float d00 = dot(e0, e0), d01 = dot(e0, e1), d11 = dot(e1, e1);
+                const float d20 = dot(d, e0), d21 = dot(d, e1);
+                const float denom = d00 * d11 - d01 * d01;
+
+                float u = 1.f / 3.f, w = 1.f / 3.f;
+
+                if (std::abs(denom) > 1e-20f)
+                {
+                    u = std::max(0.f, (d11 * d20 - d01 * d21) * (1.f / denom));
+                    w = std::max(0.f, (d00 * d21 - d01 * d20) * (1.f / denom));
+
+                    if (u + w > 1.f)
+                    {
+                        float sum = u + w;
+                        u /= sum;
+                        w /= sum;
+                    }
+                }
+
+                DirectX::XMVECTOR N = DirectX::XMVectorScale(DirectX::XMLoadFloat3(&t->normal[0]), 1.f - u - w);
+                N = DirectX::XMVectorAdd(N, DirectX::XMVectorScale(DirectX::XMLoadFloat3(&t->normal[1]), u));
+                N = DirectX::XMVectorAdd(N, DirectX::XMVectorScale(DirectX::XMLoadFloat3(&t->normal[2]), w));
+
+                if (DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(N)) > 1e-12f)
+                    N = DirectX::XMVector3Normalize(N);
+
+                DirectX::XMFLOAT4 nv;
+                DirectX::XMStoreFloat4(&nv, N);
+
+                const size_t i = (static_cast<size_t>(z) * r + y) * r + x;
+
+                DirectX::XMFLOAT4& on = normal[i];
+                on.x = std::max(on.x, nv.x * 0.5f + 0.5f);
+                on.y = std::max(on.y, nv.y * 0.5f + 0.5f);
+                on.z = std::max(on.z, nv.z * 0.5f + 0.5f);
+                on.w = std::max(on.w, dune::voxelizer::OCCUPIED);
+
+                DirectX::XMFLOAT4& oc = color[i];
+                oc.x = std::max(oc.x, t->albedo.x);
+                oc.y = std::max(oc.y, t->albedo.y);
+                oc.z = std::max(oc.z, t->albedo.z);
+                oc.w = 1.f;
+
+                occupied[i] = 1;
+            }
+        }
+
+        // occupancy and values of the dense target, values of borderline voxels may include a triangle or not
+        size_t voxels = 0, dense_missing = 0, dense_extra = 0, dense_borderline = 0;
+        float max_error = 0;
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            DirectX::XMFLOAT4 dn, dc;
+            DirectX::XMStoreFloat4(&dn, DirectX::PackedVector::XMLoadHalf4(&v.normals()[i]));
+            DirectX::XMStoreFloat4(&dc, DirectX::PackedVector::XMLoadHalf4(&v.colors()[i]));
+
+            const bool dense_occupied = dn.w > 0.f;
+
+            voxels += occupied[i];
+
+            if (borderline[i])
+            {
+                dense_borderline += occupied[i] != dense_occupied;
+                continue;
+            }
+
+            dense_missing += occupied[i] && !dense_occupied;
+            dense_extra += !occupied[i] && dense_occupied;
+
+            const float a[8] = { dn.x, dn.y, dn.z, dn.w, dc.x, dc.y, dc.z, dc.w };
+            const float b[8] = { normal[i].x, normal[i].y, normal[i].z, normal[i].w, color[i].x, color[i].y, color[i].z, color[i].w };
+
+            for (size_t k = 0; k < 8; ++k)
+                max_error = std::max(max_error, std::abs(a[k] - b[k]));
+        }
+
+        // the fragments must cover the same voxels, once each
+        std::vector<unsigned char> covered(n, 0);
+        size_t fragments_wrong = 0;
+
+        for (auto f = fragments.begin(); f != fragments.end(); ++f)
+        {
+            const size_t i = (static_cast<size_t>(f->z) * r + f->y) * r + f->x;
+
+            if ((!occupied[i] && !borderline[i]) || covered[i])
+                ++fragments_wrong;
+
+            covered[i] = 1;
+        }
+
+        for (size_t i = 0; i < n; ++i)
+            fragments_wrong += occupied[i] && !covered[i] && !borderline[i];
+
+        tcout << L"  brute force " << r << L"^3: " << tests << L" triangle/box tests, " << voxels << L" voxels, "
+              << dense_missing << L" missing, " << dense_extra << L" extra, " << dense_borderline << L" borderline, "
+              << fragments_wrong << L" wrong fragments, max error "
+              << std::scientific << std::setprecision(2) << max_error << std::fixed << std::endl;
+
+        // the dense target stores half floats
+        return dense_missing + dense_extra + fragments_wrong + (max_error < 1e-3f ? 0 : 1);
+    }
+
+    //! Voxelize scenes into fragments and the dense target, and compare both against the brute force overlap test.
+    size_t voxelize(const std::vector<std::string>& scenes)
+    {
+        const size_t r = 128;
+
+        size_t failed = 0;
+
+        for (auto scene = scenes.begin(); scene != scenes.end(); ++scene)
+        {
+            std::vector<dune::voxel_triangle> triangles;
+            DirectX::XMFLOAT3 bb_min, bb_max;
+
+            if (!bench::obj_triangles(*scene, triangles, bb_min, bb_max))
+            {
+                tcout << L"voxelize: cannot open " << dune::to_tstring(*scene) << std::endl;
+                ++failed;
+                continue;
+            }
+
+            DirectX::XMFLOAT4X4 model;
+            DirectX::XMStoreFloat4x4(&model, DirectX::XMMatrixIdentity());
+
+            dune::voxelizer v;
+            v.create(r, true);
+            v.set_model_matrix(model, bb_min, bb_max);
+
+            std::vector<dune::voxel_fragment> fragments;
+            v.voxelize(triangles, fragments);
+
+            v.clear();
+            v.voxelize(triangles);
+
+            tcout << L"voxelize " << dune::to_tstring(*scene) << L" " << r << L"^3: " << triangles.size() << L" triangles, "
+                  << fragments.size() << L" voxels" << std::endl;
+
+            failed += voxelize_check(triangles, bb_min, bb_max, v, fragments);
+        }
+
+        return failed;
+    }
+
+    //! Move cubes in a volume and revoxelize only what voxel_ownership reports, checked against a full voxelization.
+    size_t revoxelization()
+    {
+        const uint32_t r = 128;
+        const size_t grid = 4;
+
+        DirectX::XMFLOAT4X4 identity;
+        DirectX::XMStoreFloat4x4(&identity, DirectX::XMMatrixIdentity());
+
+        const DirectX::XMFLOAT3 bb_min(-0.5f, -0.5f, -0.5f), bb_max(0.5f, 0.5f, 0.5f);
+        const DirectX::XMFLOAT3 volume_min(0.f, 0.f, 0.f), volume_max(1.f, 1.f, 1.f);
+
+        // a grid of cubes on the floor of the volume
+        std::vector<DirectX::XMFLOAT4X4> worlds(grid * grid);
+
+        const auto place = [&](size_t i, float dx, float dy)
+        {
+            float x = (i % grid + 0.5f) / grid + dx, z = (i / grid + 0.5f) / grid;
+            DirectX::XMStoreFloat4x4(&worlds[i], DirectX::XMMatrixScaling(0.1f, 0.1f, 0.1f) * DirectX::XMMatrixTranslation(x, 0.1f + dy, z));
+        };
+
+        for (size_t i = 0; i < worlds.size(); ++i)
+            place(i, 0.f, 0.f);
+
+        dune::voxelizer v;
+        v.create(r, false);
+        v.set_model_matrix(identity, volume_min, volume_max);
+
+        dune::voxel_ownership ownership;
+        ownership.create(r);
+        ownership.set_model_matrix(identity, volume_min, volume_max);
+
+        std::vector<unsigned char> occupancy(static_cast<size_t>(r) * r * r, 0);
+        std::vector<dune::voxel_fragment> fragments;
+
+        const auto voxelize_mesh = [&](size_t i, std::vector<unsigned char>& target)
+        {
+            std::vector<dune::voxel_triangle> triangles;
+            bench::cube_triangles(worlds[i], triangles);
+
+            v.voxelize(triangles, fragments);
+
+            for (auto f = fragments.begin(); f != fragments.end(); ++f)
+                target[(static_cast<size_t>(f->z) * r + f->y) * r + f->x] = 1;
+        };
+
+        const wchar_t* frames[] = { L"initial", L"light only", L"one cube lifted", L"cube moved back, neighbour moved next to it", L"light only" };
+        const size_t expected_meshes[] = { 16, 0, 1, 2, 0 };
+
+        size_t failed = 0;
+
+        for (size_t frame = 0; frame < 5; ++frame)
+        {
+            if (frame == 2)
+                place(5, 0.f, 0.2f);
+
+            if (frame == 3)
+            {
+                place(5, 0.f, 0.f);
+                place(6, -0.12f, 0.f);
+            }
+
+            for (size_t i = 0; i < worlds.size(); ++i)
+                ownership.set_mesh(i, bb_min, bb_max, worlds[i]);
+
+            ownership.update();
+
+            for (auto b = ownership.regions().begin(); b != ownership.regions().end(); ++b)
+                for (uint32_t z = b->min[2]; z < b->max[2]; ++z)
+                for (uint32_t y = b->min[1]; y < b->max[1]; ++y)
+                    std::fill_n(occupancy.begin() + (static_cast<size_t>(z) * r + y) * r + b->min[0], b->max[0] - b->min[0], 0);
+
+            for (auto i = ownership.meshes().begin(); i != ownership.meshes().end(); ++i)
+                voxelize_mesh(*i, occupancy);
+
+            // reference: everything from scratch
+            std::vector<unsigned char> reference(occupancy.size(), 0);
+
+            for (size_t i = 0; i < worlds.size(); ++i)
+                voxelize_mesh(i, reference);
+
+            const dune::revoxelization_stats& s = ownership.stats();
+
+            tcout << L"revoxelization " << frames[frame] << L": " << s.meshes_voxelized << L"/" << s.meshes << L" meshes, "
+                  << s.bricks_cleared << L"/" << s.bricks << L" bricks, " << ownership.regions().size() << L" boxes, "
+                  << (s.light_only ? L"light only" : L"geometry") << (occupancy == reference ? L"" : L", MISMATCH") << std::endl;
+
+            if (occupancy != reference || s.meshes_voxelized != expected_meshes[frame])
+                ++failed;
+        }
+
+        return failed;
+    }
+
+    //! Run neighbour-heavy kernels in Morton and bricked layouts, which have to give the results of the linear layout.
+    size_t volume_layouts()
+    {
+        const uint32_t resolutions[] = { 32, 64 };
+
+        size_t failed = 0;
+        const dune::volume_layout layouts[] = { dune::LAYOUT_LINEAR, dune::LAYOUT_MORTON, dune::LAYOUT_BRICKED };
+        const wchar_t* names[] = { L"linear", L"morton", L"bricked" };
+
+        for (uint32_t r : resolutions)
+        {
+            std::vector<DirectX::XMFLOAT4> input(static_cast<size_t>(r) * r * r);
+
+            std::mt19937 gen(r);
+            std::uniform_real_distribution<float> dist(0.f, 1.f);
+
+            for (auto t = input.begin(); t != input.end(); ++t)
+                *t = DirectX::XMFLOAT4(dist(gen), dist(gen), dist(gen), dist(gen));
+
+            std::vector<DirectX::XMFLOAT4> reference_stencil, reference_reduce;
+
+            for (size_t l = 0; l < 3; ++l)
+            {
+                dune::tiled_volume<DirectX::XMFLOAT4> src, dst, half;
+                src.create(r, layouts[l]);
+                dst.create(r, layouts[l]);
+                half.create(r / 2, layouts[l]);
+
+                src.from_linear(input);
+                bench::stencil_step(src, dst);
+                bench::reduce_step(src, half);
+
+                std::vector<DirectX::XMFLOAT4> out_stencil, out_reduce;
+
+                dst.to_linear(out_stencil);
+                half.to_linear(out_reduce);
+
+                if (l == 0)
+                {
+                    reference_stencil = out_stencil;
+                    reference_reduce = out_reduce;
+                }
+
+                bool match = std::memcmp(out_stencil.data(), reference_stencil.data(), out_stencil.size() * sizeof(DirectX::XMFLOAT4)) == 0 &&
+                             std::memcmp(out_reduce.data(), reference_reduce.data(), out_reduce.size() * sizeof(DirectX::XMFLOAT4)) == 0;
+
+                if (!match)
+                    ++failed;
+
+                tcout << L"volume_layout " << names[l] << L" " << r << L"^3: 6-neighbour step and 2x2x2 reduction "
+                      << (match ? L"match" : L"MISMATCH") << std::endl;
+            }
+        }
+
+        return failed;
+    }
+
+    //! Trace the indirect light of a G-buffer ray cast into a lit voxelized scene with and without skipping empty space.
+    size_t cone_tracing(const std::string& scene)
+    {
+        const size_t r = 64;
+        const size_t width = 160, height = 120;
+
+        std::vector<dune::voxel_triangle> triangles;
+        DirectX::XMFLOAT3 bb_min, bb_max;
+
+        if (!bench::obj_triangles(scene, triangles, bb_min, bb_max))
+        {
+            tcout << L"cone_tracing: cannot open " << dune::to_tstring(scene) << std::endl;
+            return 1;
+        }
+
+        DirectX::XMFLOAT4X4 model;
+        DirectX::XMStoreFloat4x4(&model, DirectX::XMMatrixIdentity());
+
+        dune::voxelizer v;
+        v.create(r);
+        v.set_model_matrix(model, bb_min, bb_max);
+        v.voxelize(triangles);
+
+        // the bounce of a directional light without shadows, and the occupancy of svo_voxelize.hlsl
+        const DirectX::XMVECTOR L = DirectX::XMVector3Normalize(DirectX::XMVectorSet(0.3f, 1.f, 0.5f, 0.f));
+
+        std::vector<DirectX::XMFLOAT4> voxels(r * r * r);
+
+        for (size_t i = 0; i < voxels.size(); ++i)
+        {
+            DirectX::XMVECTOR n = DirectX::PackedVector::XMLoadHalf4(&v.normals()[i]);
+            DirectX::XMVECTOR c = DirectX::PackedVector::XMLoadHalf4(&v.colors()[i]);
+
+            DirectX::XMVECTOR N = DirectX::XMVectorSubtract(DirectX::XMVectorScale(n, 2.f), DirectX::XMVectorSplatOne());
+            float NoL = std::max(DirectX::XMVectorGetX(DirectX::XMVector3Dot(N, L)), 0.f);
+
+            DirectX::XMStoreFloat4(&voxels[i], DirectX::XMVectorSetW(DirectX::XMVectorScale(c, NoL), DirectX::XMVectorGetW(n)));
+        }
+
+        dune::cone_tracer tracer;
+        tracer.create(r);
+        tracer.set_model_matrix(model, bb_min, bb_max);
+        tracer.set_volume(voxels);
+
+        // a camera in the front of the volume looking along -z, casting rays until they hit an occupied voxel
+        const DirectX::XMVECTOR lo = DirectX::XMLoadFloat3(&bb_min), hi = DirectX::XMLoadFloat3(&bb_max);
+        const DirectX::XMVECTOR extent = DirectX::XMVectorSubtract(hi, lo);
+
+        DirectX::XMFLOAT3 camera_pos;
+        DirectX::XMStoreFloat3(&camera_pos, DirectX::XMVectorMultiplyAdd(extent, DirectX::XMVectorSet(0.5f, 0.5f, 0.9f, 0.f), lo));
+
+        dune::gbuffer_image gbuffer;
+        gbuffer.create(width, height);
+
+        const float tan_fov = std::tan(DirectX::XM_PI / 6.f);
+        const float step = DirectX::XMVectorGetX(extent) / (2.f * r);
+
+        for (size_t y = 0; y < height; ++y)
+        for (size_t x = 0; x < width; ++x)
+        {
+            DirectX::XMVECTOR dir = DirectX::XMVector3Normalize(DirectX::XMVectorSet(
+                (2.f * (x + 0.5f) / width - 1.f) * tan_fov * width / height,
+                (1.f - 2.f * (y + 0.5f) / height) * tan_fov, -1.f, 0.f));
+
+            for (float t = 0.f; t < 2.f * DirectX::XMVectorGetX(extent); t += step)
+            {
+                DirectX::XMVECTOR P = DirectX::XMVectorMultiplyAdd(dir, DirectX::XMVectorReplicate(t), DirectX::XMLoadFloat3(&camera_pos));
+
+                DirectX::XMFLOAT3 vp;
+                DirectX::XMStoreFloat3(&vp, DirectX::XMVectorScale(DirectX::XMVectorDivide(DirectX::XMVectorSubtract(P, lo), extent), static_cast<float>(r)));
+
+                if (vp.x < 0.f || vp.y < 0.f || vp.z < 0.f || vp.x >= r || vp.y >= r || vp.z >= r)
+                    continue;
+
+                size_t i = (static_cast<size_t>(vp.z) * r + static_cast<size_t>(vp.y)) * r + static_cast<size_t>(vp.x);
+
+                DirectX::XMVECTOR n = DirectX::PackedVector::XMLoadHalf4(&v.normals()[i]);
+
+                if (DirectX::XMVectorGetW(n) <= 0.f)
+                    continue;
+
+                dune::gbuffer_texel& gb = gbuffer(x, y);
+
+                DirectX::XMStoreFloat3(&gb.position, P);
+                DirectX::XMStoreFloat3(&gb.normal, DirectX::XMVectorSubtract(DirectX::XMVectorScale(n, 2.f), DirectX::XMVectorSplatOne()));
+                DirectX::XMStoreFloat3(&gb.diffuse_albedo, DirectX::PackedVector::XMLoadHalf4(&v.colors()[i]));
+                gb.specular_albedo = DirectX::XMFLOAT3(0.5f, 0.5f, 0.5f);
+                break;
+            }
+        }
+
+        // skipping empty space may only leave out samples of empty voxels, for wide cones and for narrow cones which take many samples
+        const size_t cones[] = { 9, 1 };
+        const float apertures[] = { 0.6f, 0.02f };
+
+        size_t failed = 0;
+
+        for (size_t k = 0; k < 2; ++k)
+        {
+            dune::float_image images[2];
+            dune::cone_trace_stats stats[2];
+
+            for (size_t skip = 0; skip < 2; ++skip)
+            {
+                dune::cone_parameters parameters;
+                parameters.num_diffuse_cones = cones[k];
+                parameters.diffuse_aperture = apertures[k];
+                parameters.skip_empty_space = skip == 1;
+
+                tracer.set_parameters(parameters);
+                stats[skip] = tracer.render(gbuffer, camera_pos, images[skip]);
+            }
+
+            double error = 0, sum = 0;
+
+            for (size_t i = 0; i < images[0].texels.size(); ++i)
+            {
+                const DirectX::XMFLOAT4& a = images[1].texels[i];
+                const DirectX::XMFLOAT4& b = images[0].texels[i];
+
+                double la = a.x + a.y + a.z, lb = b.x + b.y + b.z;
+
+                error += (la - lb) * (la - lb);
+                sum += lb * lb;
+            }
+
+            const double difference = std::sqrt(error / std::max(sum, 1e-12));
+
+            if (!(difference < 1e-3) || stats[1].steps > stats[0].steps)
+                ++failed;
+
+            tcout << L"cone_tracing " << dune::to_tstring(scene) << L" " << r << L"^3, " << width << L"x" << height << L", " << cones[k]
+                  << L" diffuse cones, aperture " << std::fixed << std::setprecision(2) << apertures[k] << L": "
+                  << std::setprecision(1) << static_cast<double>(stats[0].steps) / stats[0].cones << L" -> "
+                  << static_cast<double>(stats[1].steps) / stats[1].cones << L" samples/cone when skipping, " << std::setprecision(3)
+                  << 100.0 * difference << L"% difference" << std::endl;
+        }
+
+        return failed;
+    }
+
+    //! Move a camera through a voxel clipmap and check that the slabs it revoxelizes keep every level consistent.
+    size_t clipmap()
+    {
+        const size_t levels = 5;
+        const uint32_t r = 32;
+        const float voxel_size = 0.25f;
+        const size_t frames = 300;
+
+        const int32_t ri = static_cast<int32_t>(r);
+
+        size_t failed = 0;
+
+        for (size_t budget : { static_cast<size_t>(0), static_cast<size_t>(r * r * 8) })
+        {
+            dune::voxel_clipmap map;
+            map.create(levels, r, voxel_size);
+            map.set_budget(budget);
+
+            // every texel remembers the voxel coordinate it was last voxelized for
+            std::vector<std::vector<int32_t>> texels(levels, std::vector<int32_t>(r * r * r * 3, std::numeric_limits<int32_t>::min()));
+
+            size_t moved = 0, deferred = 0, mismatches = 0, box_mismatches = 0;
+
+            std::vector<dune::voxel_box> boxes;
+
+            for (size_t f = 0; f < frames; ++f)
+            {
+                // walk, then run, then teleport
+                const float t = static_cast<float>(f);
+                const float speed = f < 100 ? 0.05f : (f < 200 ? 0.6f : 0.6f + (f % 50 == 0 ? 500.f : 0.f));
+
+                DirectX::XMFLOAT3 camera(std::sin(t * 0.01f) * 40.f + t * speed, 2.f + std::sin(t * 0.1f), -t * speed * 0.5f);
+
+                map.update(camera);
+
+                moved += map.stats().levels_moved;
+                deferred += map.stats().levels_deferred;
+
+                for (auto region = map.regions().begin(); region != map.regions().end(); ++region)
+                {
+                    std::vector<int32_t>& level = texels[region->level];
+
+                    size_t inside = 0;
+
+                    boxes.clear();
+                    map.texture_boxes(*region, boxes);
+
+                    for (int32_t z = region->min[2]; z < region->max[2]; ++z)
+                    for (int32_t y = region->min[1]; y < region->max[1]; ++y)
+                    for (int32_t x = region->min[0]; x < region->max[0]; ++x)
+                    {
+                        const uint32_t tx = map.texel(x), ty = map.texel(y), tz = map.texel(z);
+                        const size_t i = ((static_cast<size_t>(tz) * r + ty) * r + tx) * 3;
+
+                        level[i + 0] = x;
+                        level[i + 1] = y;
+                        level[i + 2] = z;
+
+                        for (auto b = boxes.begin(); b != boxes.end(); ++b)
+                            if (tx >= b->min[0] && tx < b->max[0] && ty >= b->min[1] && ty < b->max[1] && tz >= b->min[2] && tz < b->max[2])
+                                ++inside;
+                    }
+
+                    size_t box_voxels = 0;
+
+                    for (auto b = boxes.begin(); b != boxes.end(); ++b)
+                        box_voxels += static_cast<size_t>(b->max[0] - b->min[0]) * (b->max[1] - b->min[1]) * (b->max[2] - b->min[2]);
+
+                    const size_t region_voxels = static_cast<size_t>(region->max[0] - region->min[0]) * (region->max[1] - region->min[1]) * (region->max[2] - region->min[2]);
+
+                    if (inside != region_voxels || box_voxels != region_voxels)
+                        ++box_mismatches;
+                }
+
+                // every voxel of every window has to be in its texel
+                for (size_t l = 0; l < levels; ++l)
+                {
+                    if (!map.valid(l))
+                        continue;
+
+                    const int32_t* o = map.origin(l);
+
+                    for (int32_t z = o[2]; z < o[2] + ri; ++z)
+                    for (int32_t y = o[1]; y < o[1] + ri; ++y)
+                    for (int32_t x = o[0]; x < o[0] + ri; ++x)
+                    {
+                        const size_t i = ((static_cast<size_t>(map.texel(z)) * r + map.texel(y)) * r + map.texel(x)) * 3;
+
+                        if (texels[l][i] != x || texels[l][i + 1] != y || texels[l][i + 2] != z)
+                            ++mismatches;
+                    }
+
+                    // the toroidal texture coordinate of the center of a voxel of the window addresses its texel
+                    DirectX::XMFLOAT3 bb_min, bb_max;
+                    map.bounds(l, bb_min, bb_max);
+
+                    const float vs = map.voxel_size(l);
+                    DirectX::XMFLOAT4X4 world_to_svo = map.world_to_svo(l);
+
+                    DirectX::XMFLOAT3 p(bb_min.x + 0.5f * vs, bb_max.y - 0.5f * vs, bb_min.z + (ri / 3 + 0.5f) * vs);
+                    DirectX::XMFLOAT3 uv;
+                    DirectX::XMStoreFloat3(&uv, DirectX::XMVector3TransformCoord(DirectX::XMLoadFloat3(&p), DirectX::XMLoadFloat4x4(&world_to_svo)));
+
+                    const float u[3] = { uv.x, uv.y, uv.z };
+                    const int32_t v[3] = { o[0], o[1] + ri - 1, o[2] + ri / 3 };
+
+                    for (size_t a = 0; a < 3; ++a)
+                        if (map.texel(static_cast<int32_t>(std::floor((u[a] - std::floor(u[a])) * r))) != map.texel(v[a]))
+                            ++mismatches;
+
+                    // so does the voxel of the window it is voxelized into, offset like svo_texel() in svo_parameters.hlsl
+                    DirectX::XMFLOAT4X4 world_to_window = map.world_to_window(l);
+                    DirectX::XMStoreFloat3(&uv, DirectX::XMVector3TransformCoord(DirectX::XMLoadFloat3(&p), DirectX::XMLoadFloat4x4(&world_to_window)));
+
+                    const float w[3] = { uv.x, uv.y, uv.z };
+
+                    for (size_t a = 0; a < 3; ++a)
+                    {
+                        const int32_t window_voxel = static_cast<int32_t>(std::floor(w[a] * r));
+
+                        if (window_voxel != v[a] - o[a] || (static_cast<uint32_t>(window_voxel) + map.texel(o[a])) % r != map.texel(v[a]))
+                            ++mismatches;
+                    }
+                }
+            }
+
+            tcout << L"clipmap " << levels << L" levels of " << r << L"^3, " << frames << L" frames, budget " << budget << L": "
+                  << moved << L" level moves, " << deferred << L" deferred, " << mismatches << L" mismatches, " << box_mismatches
+                  << L" box mismatches" << std::endl;
+
+            failed += mismatches + box_mismatches;
+        }
+
+        return failed;
+    }
+
+    //! Check which stages of the GI pipelines of gi_renderer run after typical changes.
+    size_t gi_stages()
+    {
+        typedef dune::gi_pipeline p;
+
+        struct event
+        {
+            const wchar_t* name;
+            uint32_t inputs;
+            const wchar_t* expected[2];     //!< the stages of the SVO and the LPV pipeline
+        };
+
+        const event events[] =
+        {
+            { L"start", p::ALL, { L" RSM Voxelize Inject Filter", L" RSM Inject Propagate" } },
+            { L"camera", 0, { L" none", L" none" } },
+            { L"clipmap window", p::VOLUME_WINDOW, { L" Voxelize Inject Filter", L" none" } },
+            { L"GI slider", p::GI_PARAMETERS, { L" none", L" Inject Propagate" } },
+            { L"light", p::LIGHT, { L" RSM Inject Filter", L" RSM Inject Propagate" } },
+            { L"world", p::WORLD | p::GI_PARAMETERS, { L" RSM Voxelize Inject Filter", L" RSM Inject Propagate" } },
+            { L"load", p::ALL, { L" RSM Voxelize Inject Filter", L" RSM Inject Propagate" } },
+        };
+
+        size_t failed = 0;
+
+        for (size_t lpv = 0; lpv < 2; ++lpv)
+        {
+            dune::gi_pipeline pipeline;
+
+            size_t rsm = pipeline.add_stage(L"RSM", p::GEOMETRY | p::WORLD | p::LIGHT);
+
+            if (lpv)
+            {
+                size_t inject = pipeline.add_stage(L"Inject", p::WORLD | p::GI_PARAMETERS, { rsm });
+                pipeline.add_stage(L"Propagate", 0, { inject });
+            }
+            else
+            {
+                size_t voxelize = pipeline.add_stage(L"Voxelize", p::GEOMETRY | p::WORLD | p::VOLUME_WINDOW);
+                size_t inject = pipeline.add_stage(L"Inject", 0, { rsm, voxelize });
+                pipeline.add_stage(L"Filter", 0, { inject });
+            }
+
+            for (auto e = std::begin(events); e != std::end(events); ++e)
+            {
+                pipeline.invalidate(e->inputs);
+                pipeline.schedule();
+
+                dune::tstring ran;
+
+                for (auto s = pipeline.stats().ran.begin(); s != pipeline.stats().ran.end(); ++s)
+                    ran += L" " + pipeline.name(*s);
+
+                if (!pipeline.busy())
+                    ran = L" none";
+
+                if (ran != e->expected[lpv])
+                    ++failed;
+
+                tcout << L"gi_stages " << (lpv ? L"LPV " : L"SVO ") << e->name << L":" << ran
+                      << (ran == e->expected[lpv] ? L"" : L", expected" + dune::tstring(e->expected[lpv])) << std::endl;
+            }
+        }
+
+        return failed;
+    }
+
+    //! A query_source whose sets finish a fixed number of frames after they were ended.
+    class fake_queries : public dune::query_source
+    {
+    public:
+        size_t frame;
+        size_t latency;
+        std::vector<size_t> ended;
+        std::vector<uint64_t> issued;
+
+        fake_queries(size_t sets, size_t latency) :
+            frame(0), latency(latency), ended(sets, 0), issued(sets, 0)
+        {
+        }
+
+        // the time of a pass which started in frame f, disjoint every 50 frames
+        static float time(size_t f) { return 1.f + (f * 7919 % 100) / 100.f; }
+        static bool disjoint(size_t f) { return f % 50 == 49; }
+
+        virtual void begin_query(size_t set) { issued[set] = frame; }
+        virtual void end_query(size_t set) { ended[set] = frame; }
+
+        virtual bool read_query(size_t set, float& ms, bool& valid)
+        {
+            if (frame < ended[set] + latency)
+                return false;
+
+            valid = !disjoint(static_cast<size_t>(issued[set]));
+            ms = time(static_cast<size_t>(issued[set]));
+            return true;
+        }
+    };
+
+    /*!
+     * Drive a profile_ring with fake queries of increasing latency. Every sample has to carry the time of
+     * its frame, and every frame has to be completed, dropped, invalid or still in flight.
+     */
+    size_t profile_ring()
+    {
+        const size_t sets = 8;
+        const size_t frames = 1000;
+        const size_t latencies[] = { 0, 2, 7, 12 };
+
+        size_t failed = 0;
+
+        for (auto l = std::begin(latencies); l != std::end(latencies); ++l)
+        {
+            fake_queries queries(sets, *l);
+
+            dune::profile_ring ring;
+            ring.create(&queries, sets, 64);
+
+            size_t lag = 0, mismatches = 0;
+
+            for (queries.frame = 0; queries.frame < frames; ++queries.frame)
+            {
+                ring.begin(queries.frame);
+                ring.end();
+                ring.poll();
+
+                if (ring.completed() > 0)
+                {
+                    const dune::profile_sample& s = ring.last();
+
+                    lag = std::max(lag, queries.frame - static_cast<size_t>(s.tag));
+
+                    if (s.ms != fake_queries::time(static_cast<size_t>(s.tag)))
+                        ++mismatches;
+                }
+            }
+
+            dune::profile_stats stats = ring.stats();
+
+            tcout << L"profile_ring " << sets << L" sets, latency " << *l << L": " << ring.completed() << L"/" << frames << L" completed, "
+                  << ring.dropped() << L" dropped, " << ring.invalid() << L" invalid, lag " << lag << L" frames, " << mismatches << L" mismatches, "
+                  << std::fixed << std::setprecision(2) << L"avg " << stats.average << L" min " << stats.min << L" p50 " << stats.p50
+                  << L" p95 " << stats.p95 << L" p99 " << stats.p99 << L" max " << stats.max << L"ms" << std::endl;
+
+            const size_t in_flight = std::min(*l, sets);
+
+            if (ring.completed() + ring.dropped() + ring.invalid() + in_flight != frames || (*l < sets && ring.dropped() > 0))
+                ++failed;
+
+            failed += mismatches;
+
+            ring.destroy();
+        }
+
+        return failed;
+    }
+
+    //! Record nested zones on all workers and a GPU track, then check the exported trace and snapshots taken during recording.
+    size_t frame_profiler()
+    {
+        dune::frame_profiler& profiler = dune::frame_profiler::i();
+        profiler.set_thread_name("Tests");
+
+        const size_t frames = 100;
+        const size_t zones = 16;
+
+        for (size_t f = 0; f < frames; ++f)
+        {
+            DUNE_PROFILE_ZONE("Frame");
+
+            dune::parallel_for(0, dune::num_workers(), [&](size_t first, size_t last)
+            {
+                for (size_t w = first; w < last; ++w)
+                {
+                    DUNE_PROFILE_ZONE("Worker");
+
+                    for (size_t z = 0; z < zones; ++z)
+                    {
+                        DUNE_PROFILE_ZONE("Zone");
+                    }
+                }
+            });
+
+            profiler.gpu_zone("Pass", dune::frame_profiler::now(), 0.5f);
+        }
+
+        auto stats = profiler.zone_stats();
+
+        std::ostringstream trace;
+        profiler.write_trace(trace);
+
+        const std::string json = trace.str();
+        size_t open = std::count(json.begin(), json.end(), '{');
+        size_t close = std::count(json.begin(), json.end(), '}');
+
+        // every zone which was recorded shows up in the statistics, the GPU pass on its own track
+        size_t missing = 0;
+
+        for (const char* name : { "Frame", "Worker", "Zone", "Pass" })
+        {
+            const bool gpu = std::strcmp(name, "Pass") == 0;
+
+            if (std::none_of(stats.begin(), stats.end(), [&](const dune::profile_zone_stats& z) { return z.name == name && z.gpu == gpu && z.count > 0; }))
+                ++missing;
+        }
+
+        tcout << L"frame_profiler " << frames << L" frames, " << dune::num_workers() << L" workers: " << stats.size() << L" zones, "
+              << missing << L" missing, trace " << json.size() / 1024 << L"KB" << (open == close ? L"" : L" unbalanced") << std::endl;
+
+        // take snapshots while another thread keeps overwriting its ring; the name of each of its
+        // events follows from the start, so a torn copy shows up as a mismatch
+        static const char* const names[] = { "A", "B", "C", "D", "E", "F", "G" };
+
+        std::atomic<bool> done(false);
+
+        std::thread writer([&]()
+        {
+            profiler.set_thread_name("Writer");
+
+            for (uint64_t n = 0; !done; ++n)
+                profiler.gpu_zone(names[n % 7], n, 0.f);
+        });
+
+        const size_t snapshots = 200;
+        size_t checked = 0, torn = 0, unordered = 0, max_events = 0;
+
+        for (size_t k = 0; k < snapshots; ++k)
+        {
+            std::vector<dune::profile_event> all = profiler.events();
+
+            size_t count = 0;
+            uint64_t previous = 0;
+
+            for (auto e = all.begin(); e != all.end(); ++e)
+            {
+                if (std::strlen(e->name) != 1 || e->name[0] < 'A' || e->name[0] > 'G')
+                    continue;
+
+                if (e->name != names[e->start % 7] || !e->gpu || e->duration != 0)
+                    ++torn;
+
+                if (count > 0 && e->start != previous + 1)
+                    ++unordered;
+
+                previous = e->start;
+                ++count;
+            }
+
+            checked += count;
+            max_events = std::max(max_events, count);
+        }
+
+        done = true;
+        writer.join();
+
+        tcout << L"frame_profiler " << snapshots << L" snapshots during recording: " << checked << L" events, at most " << max_events
+              << L" of " << dune::frame_profiler::CAPACITY << L" per snapshot, " << torn << L" torn, " << unordered << L" gaps" << std::endl;
+
+        return missing + (open == close ? 0 : 1) + torn + unordered;
+    }
+
+    //! An upload_target backed by memory, which checks that nothing is overwritten without discarding first.
+    class fake_upload_target : public dune::upload_target
+    {
+    public:
+        std::vector<unsigned char> buffer;
+        std::vector<unsigned char> written;     // bytes written since the last discard
+        std::vector<unsigned char> before;
+        size_t maps, discards, overwrites;
+
+        explicit fake_upload_target(size_t size) :
+            buffer(size, 0), written(size, 0), before(size, 0), maps(0), discards(0), overwrites(0)
+        {
+        }
+
+        virtual void* begin_upload(bool discard)
+        {
+            ++maps;
+
+            if (discard)
+            {
+                ++discards;
+                std::fill(written.begin(), written.end(), 0);
+            }
+
+            before = buffer;
+            return &buffer[0];
+        }
+
+        virtual void end_upload()
+        {
+            for (size_t i = 0; i < buffer.size(); ++i)
+            {
+                if (buffer[i] == before[i])
+                    continue;
+
+                if (written[i])
+                    ++overwrites;
+
+                written[i] = 1;
+            }
+        }
+    };
+
+    //! Check that constants are only mapped when they change, and push per-draw constants of many meshes through an upload_ring.
+    size_t constant_uploads()
+    {
+        struct transform
+        {
+            DirectX::XMFLOAT4X4 world;
+        };
+
+        const size_t frames = 100;
+
+        // one buffer bound to three stages per frame, which changes every 10th frame
+        fake_upload_target cb(sizeof(transform));
+        dune::tracked_constants<transform> constants;
+
+        dune::reset_upload_stats();
+
+        for (size_t f = 0; f < frames; ++f)
+        {
+            if (f % 10 == 0)
+                constants.data().world._11 = static_cast<float>(f);
+
+            for (size_t stage = 0; stage < 3; ++stage)
+                constants.upload(cb);
+        }
+
+        dune::upload_counters tracked = dune::reset_upload_stats();
+
+        const bool current = std::memcmp(&cb.buffer[0], &constants.data(), sizeof(transform)) == 0;
+
+        tcout << L"constant_uploads cbuffer " << frames << L" frames, 3 stages: " << tracked.maps << L" maps, " << tracked.skipped
+              << L" skipped" << (current ? L"" : L", stale") << std::endl;
+
+        // per-draw world matrices and materials of many meshes, with 256 byte aligned ranges
+        const size_t meshes = 500;
+        const size_t capacity = 1 << 16;
+
+        fake_upload_target ring_buffer(capacity);
+
+        dune::upload_ring ring;
+        ring.create(&ring_buffer, capacity, 256);
+
+        size_t mismatches = 0;
+
+        for (size_t f = 0; f < frames; ++f)
+        {
+            for (size_t m = 0; m < meshes; ++m)
+            {
+                transform t = {};
+                t.world._11 = static_cast<float>(f);
+                t.world._44 = static_cast<float>(m + 1);
+
+                dune::upload_range range;
+
+                if (!ring.push(&t, sizeof(transform), range) || std::memcmp(&ring_buffer.buffer[range.offset], &t, sizeof(transform)) != 0)
+                    ++mismatches;
+            }
+        }
+
+        dune::upload_counters pushed = dune::reset_upload_stats();
+
+        tcout << L"constant_uploads ring " << frames << L" frames, " << meshes << L" meshes, " << capacity / 1024 << L"KB: "
+              << pushed.ring_pushes << L" pushes, " << pushed.ring_bytes / 1024 << L"KB, " << pushed.ring_discards << L" discards, "
+              << ring_buffer.overwrites << L" overwrites, " << mismatches << L" mismatches" << std::endl;
+
+        ring.destroy();
+
+        // one map per change, and the other uploads of the frame skipped
+        const bool tracked_ok = tracked.maps == frames / 10 && tracked.skipped == frames * 3 - frames / 10 && current;
+
+        return (tracked_ok ? 0 : 1) + (pushed.ring_pushes == frames * meshes ? 0 : 1) + ring_buffer.overwrites + mismatches;
+    }
+
+    //! Records the bindings of a pipeline like an ID3D11DeviceContext would keep them.
+    struct recording_pipeline
+    {
+        typedef dune::state_filter filter;
+
+        dune::state_binding states[filter::NUM_STATES];
+        std::vector<dune::state_binding> slots[filter::NUM_SLOTS];
+        size_t calls;
+
+        recording_pipeline() :
+            calls(0)
+        {
+            for (size_t s = 0; s < filter::NUM_STATES; ++s)
+                states[s] = dune::make_binding(nullptr);
+
+            for (size_t s = 0; s < filter::NUM_SLOTS; ++s)
+                slots[s].assign(filter::size(static_cast<filter::slots>(s)), dune::make_binding(nullptr));
+        }
+
+        bool bound_as_target(const void* object) const
+        {
+            const std::vector<dune::state_binding>& targets = slots[filter::RENDER_TARGETS];
+
+            for (size_t i = 0; i < targets.size(); ++i)
+                if (object && targets[i].object == object)
+                    return true;
+
+            return false;
+        }
+
+        void set(filter::state s, const dune::state_binding& binding)
+        {
+            states[s] = binding;
+            ++calls;
+        }
+
+        void set(filter::slots array, size_t start, size_t count, const dune::state_binding* bindings)
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                slots[array][start + i] = bindings[i];
+
+                // D3D refuses to read a resource which is bound for writing
+                if (array < filter::CONSTANTS && bound_as_target(bindings[i].object))
+                    slots[array][start + i] = dune::make_binding(nullptr);
+            }
+
+            ++calls;
+        }
+
+        void set_render_targets(const dune::state_binding* targets, const dune::state_binding& dsv)
+        {
+            std::copy(targets, targets + slots[filter::RENDER_TARGETS].size(), slots[filter::RENDER_TARGETS].begin());
+            states[filter::DEPTH_STENCIL_VIEW] = dsv;
+
+            // D3D unbinds shader resources which are now bound for writing
+            for (size_t s = filter::RESOURCES; s < filter::CONSTANTS; ++s)
+                for (auto i = slots[s].begin(); i != slots[s].end(); ++i)
+                    if (bound_as_target(i->object))
+                        *i = dune::make_binding(nullptr);
+
+            ++calls;
+        }
+
+        bool operator==(const recording_pipeline& other) const
+        {
+            auto equal = [](const dune::state_binding& a, const dune::state_binding& b)
+            {
+                return a.object == b.object && std::equal(a.args, a.args + 5, b.args);
+            };
+
+            for (size_t s = 0; s < filter::NUM_STATES; ++s)
+                if (!equal(states[s], other.states[s]))
+                    return false;
+
+            for (size_t s = 0; s < filter::NUM_SLOTS; ++s)
+                if (!std::equal(slots[s].begin(), slots[s].end(), other.slots[s].begin(), equal))
+                    return false;
+
+            return true;
+        }
+    };
+
+    //! Passes state changes through a state_filter to a recording_pipeline, like a state_cache does to a context.
+    struct filtered_pipeline
+    {
+        typedef dune::state_filter filter;
+
+        filter shadow;
+        recording_pipeline& pipeline;
+        size_t issued, dropped;
+
+        filtered_pipeline(recording_pipeline& p) :
+            shadow(),
+            pipeline(p),
+            issued(0),
+            dropped(0)
+        {
+        }
+
+        bool count(bool issue)
+        {
+            ++(issue ? issued : dropped);
+            return issue;
+        }
+
+        void set(filter::state s, const dune::state_binding& binding)
+        {
+            if (count(shadow.set(s, binding)))
+                pipeline.set(s, binding);
+        }
+
+        void set(filter::slots array, size_t start, size_t count, const dune::state_binding* bindings)
+        {
+            size_t first, changed;
+
+            if (this->count(shadow.set(array, start, count, bindings, first, changed)))
+                pipeline.set(array, first, changed, bindings + (first - start));
+        }
+
+        void set_render_targets(const dune::state_binding* targets, const dune::state_binding& dsv)
+        {
+            size_t first, changed;
+
+            const bool t = shadow.set(filter::RENDER_TARGETS, 0, filter::size(filter::RENDER_TARGETS), targets, first, changed);
+            const bool d = shadow.set(filter::DEPTH_STENCIL_VIEW, dsv);
+
+            if (!count(t || d))
+                return;
+
+            pipeline.set_render_targets(targets, dsv);
+
+            for (size_t s = filter::RESOURCES; s < filter::CONSTANTS; ++s)
+                shadow.invalidate(static_cast<filter::slots>(s));
+        }
+    };
+
+    //! Replay random state changes with and without a state_filter and compare the pipelines at every draw.
+    size_t state_filter()
+    {
+        typedef dune::state_filter filter;
+
+        // a few objects to bind, so that most changes rebind what is bound already
+        static int objects[12];
+
+        std::mt19937 gen(7);
+        auto pick = [&](size_t n) { return std::uniform_int_distribution<size_t>(0, n - 1)(gen); };
+        auto object = [&](size_t n) -> const void* { size_t i = pick(n + 1); return i == n ? nullptr : &objects[i]; };
+
+        recording_pipeline reference, target;
+        filtered_pipeline filtered(target);
+
+        const size_t draws = 100000;
+        size_t mismatches = 0, resets = 0;
+
+        for (size_t d = 0; d < draws; ++d)
+        {
+            const size_t changes = 1 + pick(12);
+
+            for (size_t c = 0; c < changes; ++c)
+            {
+                dune::state_binding bindings[8];
+
+                switch (pick(6))
+                {
+                case 0:
+                {
+                    const filter::state s = static_cast<filter::state>(pick(filter::DEPTH_STENCIL_VIEW));
+                    const dune::state_binding b = dune::make_binding(object(3), static_cast<uint32_t>(pick(2)));
+
+                    reference.set(s, b);
+                    filtered.set(s, b);
+                    break;
+                }
+                case 1:
+                case 2:
+                {
+                    // shader resources share their objects with render targets to provoke hazards
+                    const filter::slots array = filter::slots_of(static_cast<filter::slots>(filter::RESOURCES + pick(3) * dune::NUM_STAGES),
+                                                                 static_cast<dune::shader_stage>(pick(dune::NUM_STAGES)));
+                    const size_t start = pick(6), count = 1 + pick(3);
+
+                    for (size_t i = 0; i < count; ++i)
+                        bindings[i] = dune::make_binding(object(4), array >= filter::CONSTANTS && array < filter::SAMPLERS ? static_cast<uint32_t>(pick(2)) : 0);
+
+                    reference.set(array, start, count, bindings);
+                    filtered.set(array, start, count, bindings);
+                    break;
+                }
+                case 3:
+                {
+                    const size_t count = 1 + pick(2);
+
+                    for (size_t i = 0; i < count; ++i)
+                        bindings[i] = dune::make_binding(object(3), 16, static_cast<uint32_t>(pick(2) * 64));
+
+                    reference.set(filter::VERTEX_BUFFERS, 0, count, bindings);
+                    filtered.set(filter::VERTEX_BUFFERS, 0, count, bindings);
+                    break;
+                }
+                case 4:
+                {
+                    const size_t count = 1 + pick(3);
+
+                    for (size_t i = 0; i < 8; ++i)
+                        bindings[i] = dune::make_binding(i < count ? object(4) : nullptr);
+
+                    const dune::state_binding dsv = dune::make_binding(object(1));
+
+                    reference.set_render_targets(bindings, dsv);
+                    filtered.set_render_targets(bindings, dsv);
+                    break;
+                }
+                default:
+                {
+                    // someone uses the context directly and the filter has to forget everything
+                    if (pick(20) == 0)
+                    {
+                        const dune::state_binding b = dune::make_binding(object(3));
+
+                        reference.set(filter::PS, b);
+                        target.set(filter::PS, b);
+                        filtered.shadow.invalidate();
+                        ++resets;
+                    }
+                    break;
+                }
+                }
+            }
+
+            if (!(reference == target))
+                ++mismatches;
+        }
+
+        tcout << L"state_filter " << draws << L" draws, " << resets << L" resets: " << reference.calls << L" calls unfiltered, "
+              << filtered.issued << L" issued, " << filtered.dropped << L" dropped, " << mismatches << L" mismatches" << std::endl;
+
+        return mismatches;
+    }
+
+    /*!
+     * Check that the serializer reads the demo settings like boost::property_tree, that the loaders read every
+     * key of them, and that large generated settings and camera paths round trip.
+     */
+    size_t serializer(const std::string& data)
+    {
+        // the keys read by the loaders in serializer_tools.cpp, pppipe.cpp and gi_renderer.h
+        static const wchar_t* const floats[] =
+        {
+            L"camera.pos.x", L"camera.pos.y", L"camera.pos.z", L"camera.lookat.x", L"camera.lookat.y", L"camera.lookat.z",
+            L"light.position.x", L"light.position.y", L"light.position.z", L"light.direction.x", L"light.direction.y", L"light.direction.z",
+            L"light.flux.r", L"light.flux.g", L"light.flux.b", L"gi.scale", L"gi.lpv.flux_amplifier", L"gi.lpv.num_propagations", L"gi.svo.glossiness",
+            L"gi.lpv.budget_iterations", L"gi.lpv.budget_ms", L"gi.lpv.history_format",
+            L"postprocessing.bloom.sigma", L"postprocessing.bloom.threshold", L"postprocessing.dof.coc_scale", L"postprocessing.dof.focal_plane",
+            L"postprocessing.exposure.key", L"postprocessing.exposure.speed", L"postprocessing.godrays.tau", L"postprocessing.ssao.scale"
+        };
+
+        static const wchar_t* const bools[] =
+        {
+            L"gi.debug", L"gi.lpv.amortized", L"gi.lpv.cascaded", L"gi.lpv.occlusion", L"gi.svo.clipmap", L"postprocessing.bloom.enabled", L"postprocessing.crt.enabled", L"postprocessing.film_grain.enabled",
+            L"postprocessing.dof.enabled", L"postprocessing.exposure.adapt", L"postprocessing.fxaa.enabled", L"postprocessing.godrays.enabled",
+            L"postprocessing.ssao.enabled"
+        };
+
+        static const wchar_t* const vectors[] = { L"camera.pos", L"camera.lookat", L"light.position", L"light.direction", L"light.flux" };
+
+        size_t failed = 0;
+
+        for (const std::string& file : { data + "demo_gi.xml", data + "demo_gi_mr.xml" })
+        {
+            bench::reference_settings reference;
+            dune::serializer s;
+
+            try
+            {
+                reference.load(file);
+                s.load(dune::to_tstring(file));
+            }
+            catch (std::exception& e)
+            {
+                tcout << L"serializer: " << e.what() << std::endl;
+                ++failed;
+                continue;
+            }
+
+            size_t mismatches = s.properties() == reference.properties ? 0 : 1;
+
+            for (auto key : floats)
+            {
+                float expected = 0;
+
+                if (reference.get(key, expected) && s.get<float>(key) != expected)
+                    ++mismatches;
+            }
+
+            for (auto key : bools)
+            {
+                bool expected = false;
+
+                if (reference.get(key, expected) && s.get<bool>(key) != expected)
+                    ++mismatches;
+            }
+
+            for (auto key : vectors)
+            {
+                const DirectX::XMFLOAT3 v = s.get<DirectX::XMFLOAT3>(key);
+                const bool rgb = std::wcscmp(key, L"light.flux") == 0;
+
+                float x = 0, y = 0, z = 0;
+                reference.get(dune::tstring(key) + (rgb ? L".r" : L".x"), x);
+                reference.get(dune::tstring(key) + (rgb ? L".g" : L".y"), y);
+                reference.get(dune::tstring(key) + (rgb ? L".b" : L".z"), z);
+
+                if (v.x != x || v.y != y || v.z != z)
+                    ++mismatches;
+            }
+
+            tcout << L"serializer " << dune::to_tstring(file) << L": " << s.size() << L" keys, " << mismatches << L" mismatches, unread:";
+
+            // a key nobody reads is misspelled or dead
+            auto unread = s.unread();
+
+            for (auto k = unread.begin(); k != unread.end(); ++k)
+                tcout << L" " << *k;
+
+            tcout << std::endl;
+
+            failed += mismatches + unread.size();
+        }
+
+        // generated settings and a camera path with a key frame per frame of six seconds at 60Hz
+        bench::write_settings("tests_settings.xml", 50, "tests_camera_path.xml", 360);
+
+        for (const char* file : { "tests_settings.xml", "tests_camera_path.xml" })
+        {
+            bench::reference_settings reference;
+            reference.load(file);
+
+            dune::serializer s;
+            s.load(dune::to_tstring(file));
+
+            size_t mismatches = s.properties() == reference.properties ? 0 : 1;
+
+            // every key as a float, strings included, like a loader which reads all parameters
+            for (auto p = reference.properties.begin(); p != reference.properties.end(); ++p)
+            {
+                float expected = 0;
+
+                if (reference.get(p->first, expected) && s.get<float>(p->first.c_str()) != expected)
+                    ++mismatches;
+            }
+
+            tcout << L"serializer " << file << L": " << reference.properties.size() << L" keys, " << mismatches << L" mismatches" << std::endl;
+
+            failed += mismatches;
+        }
+
+        std::remove("tests_settings.xml");
+        std::remove("tests_camera_path.xml");
+
+        return failed;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    std::vector<std::string> args(argv + 1, argv + argc);
+
+    const std::string data = bench::data_directory(args);
+    const std::string cornellbox = data + "cornellbox/cornellbox.obj";
+
+    typedef std::pair<const char*, std::function<size_t()>> test;
+
+    const test all[] =
+    {
+        test("lpv_propagate",           tests::lpv_propagate),
+        test("lpv_sparse",              tests::lpv_sparse),
+        test("propagation_schedule",    tests::propagation_schedule),
+        test("lpv_amortized",           tests::lpv_amortized),
+        test("lpv_cascades",            tests::lpv_cascades),
+        test("geometry_volume_normals", tests::geometry_volume_normals),
+        test("lpv_leakage",             [&]() { return tests::lpv_leakage(cornellbox); }),
+        test("sh_formats",              tests::sh_formats),
+        test("gi_snapshots",            tests::gi_snapshots),
+        test("gi_stages",               tests::gi_stages),
+        test("profile_ring",            tests::profile_ring),
+        test("frame_profiler",          tests::frame_profiler),
+        test("constant_uploads",        tests::constant_uploads),
+        test("state_filter",            tests::state_filter),
+        test("serializer",              [&]() { return tests::serializer(data); }),
+        test("voxelize",                [&]() { return tests::voxelize({ cornellbox, data + "skydome/skydome_sphere.obj" }); }),
+        test("revoxelization",          tests::revoxelization),
+        test("clipmap",                 tests::clipmap),
+        test("volume_layouts",          tests::volume_layouts),
+        test("cone_tracing",            [&]() { return tests::cone_tracing(cornellbox); }),
+        test("svo_lookup",              tests::svo_lookup),
+        test("svo_dag",                 [&]() { return tests::svo_dag({ cornellbox, data + "tracked/happy.obj" }); }),
+    };
+
+    size_t run = 0, failed = 0;
+
+    for (auto t = std::begin(all); t != std::end(all); ++t)
+    {
+        // the remaining arguments select tests by name
+        if (!args.empty() && std::find(args.begin(), args.end(), t->first) == args.end())
+            continue;
+
+        size_t failures = 0;
+
+        try
+        {
+            failures = t->second();
+        }
+        catch (std::exception& e)
+        {
+            tcout << t->first << L": " << e.what() << std::endl;
+            failures = 1;
+        }
+
+        tcout << (failures == 0 ? L"PASSED " : L"FAILED ") << t->first << std::endl;
+
+        ++run;
+
+        if (failures != 0)
+            ++failed;
+    }
+
+    tcout << failed << L" of " << run << L" tests failed" << std::endl;
+
+    return failed == 0 && run > 0 ? 0 : 1;
+}